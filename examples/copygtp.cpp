@@ -9,13 +9,13 @@ using namespace UPF;
 
 NetworkLib::PacketBufferPool packetPool;
 
-class GTPDecapper : public NetworkLib::EthPacketProcessor {
+// Processing methods are resolved at compile time (see
+// NetworkLib::BasicEthPacketProcessor): no virtual calls per packet.
+class GTPDecapper : public NetworkLib::BasicEthPacketProcessor<GTPDecapper> {
   public:
     GTPDecapper(NetworkLib::IPv4PacketSink &sink) : mSink(sink) {}
 
-    virtual ~GTPDecapper() {}
-
-    virtual bool processGTPv1U_IPv4(Context &ctx) {
+    bool processGTPv1U_IPv4(Context &ctx) {
         if (ctx.gtpv1uDecoder) {
             mSink.consumeIPv4Packet(ctx.gtpv1uDecoder->getData());
         }
@@ -66,12 +66,18 @@ int main(int argc, char *argv[]) {
             recordCounter++;
         }
 
+        // Malformed packets are just dropped, and counted.
+        std::cout << gtpsink.getDropCounters() << '\n';
+
     } catch (std::exception &e) {
 
         std::cerr << "*** caught exception: " << e.what() << '\n';
         return 1;
     }
 
-    std::cout << "Pool capacity: " << packetPool.capacity() << '\n'
-              << "    Pool free: " << packetPool.free_count() << '\n';
+    std::cout << "Pool statistics:\n" << packetPool.getStats() << '\n';
+
+    for (const auto &b : packetPool.getOutstandingBuffers()) {
+        std::cout << "Buffer still in use: " << b << '\n';
+    }
 }
@@ -42,13 +42,16 @@ int main(int argc, char *argv[]) {
         // Simple loop which reads a packet, dumps info and send it out again
 
         // Install callback to extract GTPv1-U data and to re-encapsulate it.
+        //
+        // The processor already described the packet (and the one in
+        // the tunnel): no need to decode them again.
         upfRouter.onGTPv1U_IPv4([&](const auto &context) -> bool {
             const NetworkLib::BufferView &ipv4Data =
                 context.gtpv1uDecoder->getData();
 
-            if (upfRouter.isIPv4TrafficOfKnownUE(ipv4Data)) {
+            if (upfRouter.isIPv4TrafficOfKnownUE(context.descriptor)) {
                 std::cout << "Got GTPv1-U traffic from known UE\n";
-                sink.consumeIPv4Packet(ipv4Data);
+                sink.consumeIPv4Packet(ipv4Data, context.descriptor);
                 return false;
             } else {
                 std::cout << "Got GTPv1-U traffic from UNKNOWN UE\n";
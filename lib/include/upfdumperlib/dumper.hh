@@ -216,6 +216,26 @@ std::ostream &operator<<(std::ostream &ostr, const PcapRecord::Header &header);
 std::ostream &operator<<(std::ostream &ostr,
                          const PcapRecord::LinuxCooked &header);
 
+/// @brief Dump the statistics of a buffer pool in a human-readable
+///        form.
+std::ostream &operator<<(std::ostream &ostr, const PoolStats &stats);
+
+/// @brief Dump a buffer still in use in a human-readable form.
+std::ostream &operator<<(std::ostream &ostr, const OutstandingBuffer &b);
+
+/// @brief Convert a DecodeStatus to a human-readable string
+std::string to_string(DecodeStatus status);
+
+/// @brief Dump a DecodeStatus in a human-readable form.
+inline std::ostream &operator<<(std::ostream &ostr, DecodeStatus status) {
+    ostr << to_string(status);
+    return ostr;
+}
+
+/// @brief Dump the counters of dropped packets in a human-readable
+///        form (only the reasons with any drops).
+std::ostream &operator<<(std::ostream &ostr, const DropCounters &counters);
+
 } // namespace NetworkLib
 
 namespace S1APLib {
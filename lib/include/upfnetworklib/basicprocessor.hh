@@ -0,0 +1,1328 @@
+#ifndef UPFNETWORKLIB_BASICPROCESSOR_HH
+#define UPFNETWORKLIB_BASICPROCESSOR_HH
+
+#include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/decodestatus.hh>
+#include <upfnetworklib/interfaces.hh>
+#include <upfnetworklib/packetdescriptor.hh>
+#include <upfnetworklib/utils.hh>
+
+// Include code for decoders
+#include <upfnetworklib/ethernet.hh>
+#include <upfnetworklib/gtp_u.hh>
+#include <upfnetworklib/ipv4.hh>
+#include <upfnetworklib/sctp.hh>
+#include <upfnetworklib/tcp.hh>
+#include <upfnetworklib/udp.hh>
+
+// For std::min()
+#include <algorithm>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+// For std::exception_ptr
+#include <exception>
+
+// For placement new
+#include <new>
+
+// For std::aligned_storage and std::is_same
+#include <type_traits>
+
+// For std::forward()
+#include <utility>
+
+namespace UPF {
+namespace NetworkLib {
+
+/// @brief Maximum number of frames BasicEthPacketProcessor::consumeEthPackets()
+///        processes together (one per bit of a batch mask: larger
+///        arrays are split).
+constexpr std::size_t maxProcessorBatchSize = 64;
+
+template <typename Derived> class BasicEthPacketProcessor;
+
+/// @brief A context given to each processing method of
+///        BasicEthPacketProcessor (and EthPacketProcessor), providing
+///        decoders and other info.
+///
+/// Packet data should be obtained via the available decoders.
+///
+/// @note All pointer members would be C++17's `std::optional<T>`
+struct EthPacketContext {
+    ///@name Decoders
+    ///@{
+
+    /// @brief Ethernet decoder instance (if any)
+    const EthFrameDecoder *ethFrameDecoder = nullptr;
+
+    /// @brief IPv4 decoder instance (if any)
+    const IPv4Decoder *ipv4Decoder = nullptr;
+
+    /// @brief TCP decoder instance (if any)
+    const TCPDecoder *tcpDecoder = nullptr;
+
+    /// @brief UDP decoder instance (if any)
+    const UDPDecoder *udpDecoder = nullptr;
+
+    /// @brief GTPv1-U decoder instance (if any)
+    const GTPv1UDecoder *gtpv1uDecoder = nullptr;
+
+    /// @brief SCTP decoder instance (if any)
+    const SCTPDecoder *sctpDecoder = nullptr;
+
+    /// @brief SCTP generic chunk decoder instance (if any)
+    const SCTPGenericChunkDecoder *sctpGenericChunkDecoder = nullptr;
+
+    /// @brief SCTP DATA chunk decoder instance (if any)
+    const SCTPDataChunkDecoder *sctpDataChunkDecoder = nullptr;
+
+    ///@}
+
+    /// @brief Description of the packet, filled as its headers are
+    ///        decoded.
+    ///
+    /// Unlike decoders, it stays there once a header has been
+    /// processed (e.g. it can be looked at by finalProcess()), so
+    /// it's what should be handed over to whoever gets the packet
+    /// next, rather than decoding it again.
+    PacketDescriptor descriptor;
+
+    ///@name Postprocessing flags
+    ///
+    /// Each of these flags control if the postProcess*() method
+    /// with the same name gets called.
+    ///
+    /// @note Currently, we are interested only in postprocessing
+    ///       IPv4 traffic, so there's just one flag.
+    ///
+    ///@{
+
+    /// @brief When `true` an nobody else stopped processing, call
+    ///        also 'postProcessIPv4()' on IPv4 data.
+    ///
+    /// This is meant to be updated (usually to `false`) by
+    /// specializations of the processing methods
+    bool postProcessIPv4 = true;
+
+    ///@}
+
+    ///@name User data
+    ///@{
+
+    /// @brief User data, provided via the EthPacketSink
+    ///        interface.
+    ///
+    /// It's plain old C-style user data to callbacks.  It's up to
+    /// specializations of EthPacketProcessor (or
+    /// BasicEthPacketProcessor) to give it a meaning, if needed.
+    ///
+    /// It also carries the offload metadata of the frame, if any
+    /// (see ContextUserData::offloadInfo).
+    ContextUserData userData;
+
+    /// @}
+};
+
+
+/**
+ * @brief A batch of packets at the same processing stage, given
+ *        to the batch variants of the processing methods of
+ *        BasicEthPacketProcessor.
+ *
+ * Batch methods drop packets from the batch to stop processing
+ * them (the equivalent of returning `false` from the single
+ * packet methods), usually via filter().
+ *
+ * Packets are always iterated in arrival order:
+ *
+ *     for (EthPacketContext &context : batch) {
+ *         // ...
+ *     }
+ *
+ * It's just a bit mask over the contexts of the whole batch, so
+ * it's cheap to copy.
+ */
+class EthPacketBatch {
+  public:
+    /// @brief Iterator over the contexts of a batch.
+    class Iterator {
+      public:
+        EthPacketContext &operator*() const {
+            return mContexts[firstIndex(mMask)];
+        }
+
+        Iterator &operator++() {
+            mMask &= mMask - 1;
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const {
+            return mMask == other.mMask;
+        }
+
+        bool operator!=(const Iterator &other) const {
+            return mMask != other.mMask;
+        }
+
+      private:
+        friend class EthPacketBatch;
+
+        EthPacketContext *mContexts;
+        std::uint64_t mMask;
+
+        Iterator(EthPacketContext *contexts, std::uint64_t mask)
+            : mContexts(contexts), mMask(mask) {}
+    };
+
+    /// @brief Return the number of packets.
+    std::size_t size() const {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>(__builtin_popcountll(mMask));
+#else
+        std::size_t count = 0;
+
+        for (std::uint64_t m = mMask; m != 0; m &= m - 1) {
+            ++count;
+        }
+
+        return count;
+#endif
+    }
+
+    /// @brief Return true if there are no packets.
+    bool empty() const { return mMask == 0; }
+
+    ///@name Iteration, in arrival order
+    ///@{
+    Iterator begin() const { return Iterator(mContexts, mMask); }
+    Iterator end() const { return Iterator(mContexts, 0); }
+    ///@}
+
+    /// @brief Keep only the packets for which
+    ///        ``keep(EthPacketContext &)`` returns true.
+    ///
+    /// If it throws, the packet is dropped, and the exception is
+    /// rethrown by consumeEthPackets() once done with the batch.
+    template <typename Predicate> void filter(Predicate keep) {
+        std::uint64_t kept = 0;
+
+        for (std::uint64_t m = mMask; m != 0; m &= m - 1) {
+            try {
+                if (keep(mContexts[firstIndex(m)])) {
+                    kept |= m & (~m + 1);
+                }
+            } catch (...) {
+                saveError();
+            }
+        }
+
+        mMask = kept;
+    }
+
+  private:
+    template <typename Derived> friend class BasicEthPacketProcessor;
+
+    EthPacketContext *mContexts;
+    std::uint64_t mMask = 0;
+    std::exception_ptr *mError;
+
+    EthPacketBatch(EthPacketContext *contexts, std::exception_ptr &error)
+        : mContexts(contexts), mError(&error) {}
+
+    // Return the index of the lowest bit set in a (non-zero) mask.
+    static std::size_t firstIndex(std::uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<std::size_t>(__builtin_ctzll(mask));
+#else
+        std::size_t i = 0;
+
+        while ((mask & 1) == 0) {
+            mask >>= 1;
+            ++i;
+        }
+
+        return i;
+#endif
+    }
+
+    void add(std::size_t index) { mMask |= std::uint64_t{1} << index; }
+
+    void clear() { mMask = 0; }
+
+    // Add the packets of another batch of the same contexts.
+    void merge(const EthPacketBatch &other) { mMask |= other.mMask; }
+
+    // Keep the first exception thrown while processing the batch.
+    void saveError() {
+        if (!*mError) {
+            *mError = std::current_exception();
+        }
+    }
+
+    // Move out to a new batch the packets for which
+    // ``pred(EthPacketContext &)`` (which mustn't throw) returns true.
+    template <typename Predicate> EthPacketBatch takeIf(Predicate pred) {
+        EthPacketBatch taken(mContexts, *mError);
+
+        for (std::uint64_t m = mMask; m != 0; m &= m - 1) {
+            if (pred(mContexts[firstIndex(m)])) {
+                taken.mMask |= m & (~m + 1);
+            }
+        }
+
+        mMask &= ~taken.mMask;
+        return taken;
+    }
+};
+
+/**
+ * @brief A generic "processor" of Ethernet packets, calling the
+ *        processing methods of `Derived` with no virtual calls.
+ *
+ * It's meant to be the base of `Derived` (i.e. the "curiously
+ * recurring template pattern"):
+ *
+ *     class GTPDecapper
+ *         : public NetworkLib::BasicEthPacketProcessor<GTPDecapper> {
+ *       public:
+ *         bool processGTPv1U_IPv4(Context &ctx) {
+ *             // ...
+ *             return false;
+ *         }
+ *     };
+ *
+ * It decodes and processes packets exactly as EthPacketProcessor
+ * (which is itself `BasicEthPacketProcessor<EthPacketProcessor>`, see
+ * there for the processing methods and when they are called), but
+ * processing methods are looked up at compile time: those `Derived`
+ * defines (with the same name and signature, and no need for
+ * `virtual`) are called directly, and can be inlined into the
+ * decoding loop, while the others are the defaults below, which do
+ * nothing and compile away.
+ *
+ * Processing methods can be protected or private in `Derived`, as
+ * long as it declares ``friend class BasicEthPacketProcessor<Derived>``.
+ *
+ * Unlike EthPacketProcessor, `Derived` can also define batch
+ * variants of the processing methods (see the defaults below), given
+ * whole sub-batches by consumeEthPackets(). Single frames given to
+ * consumeEthPacket() are decoded straight through the single packet
+ * methods, unless `Derived` defines any batch method: then they're
+ * processed as batches of one, so that those see them as well.
+ *
+ * Packets which can't be decoded (e.g. truncated, or with
+ * inconsistent lengths) are dropped with no exceptions, and counted
+ * by reason (see getDropCounters()).
+ */
+template <typename Derived>
+class BasicEthPacketProcessor : public EthPacketSink {
+  public:
+    /// @brief See EthPacketContext.
+    using Context = EthPacketContext;
+
+    /// @brief See EthPacketBatch.
+    using Batch = EthPacketBatch;
+
+    /// @name EthPacketSink interface
+    ///@{
+
+    /// @brief Feed Ethernet traffic to this processor.
+    ///
+    /// @param ethData A BufferView with the Ethernet data to be
+    ///        processed.
+    ///
+    /// @param userData This is made available in Context.userData,
+    ///        so callbacks may have it.
+    virtual void consumeEthPacket(
+        const BufferView &ethData,
+        ContextUserData &userData = defaultContextUserData) override;
+
+    /// @brief Feed several Ethernet frames to this processor, in
+    ///        batches of up to maxProcessorBatchSize.
+    ///
+    /// If processing a frame throws, that frame is dropped, the others
+    /// are processed anyways, and then the first exception is
+    /// rethrown.
+    ///
+    /// @param ethData An array of `count` BufferView objects with the
+    ///        Ethernet data to be processed.
+    ///
+    /// @param count The number of frames.
+    ///
+    /// @param userData This is made available in Context.userData of
+    ///        each frame, so callbacks may have it.
+    virtual void consumeEthPackets(
+        const BufferView *ethData, std::size_t count,
+        ContextUserData &userData = defaultContextUserData) override;
+
+    ///@}
+
+    ///@name SCTP checksum verification
+    ///
+    /// SCTP packets with a bad CRC32c are usually dropped by the
+    /// receiving end anyways, so there's no point in decoding
+    /// their chunks (e.g. S1AP messages). Verifying checksums costs
+    /// a fraction of a nanosecond per byte.
+    ///
+    ///@{
+
+    /// @brief Enable/disable verifying SCTP checksums (default is
+    ///        disabled): when enabled, SCTP packets with a bad
+    ///        checksum are dropped before parsing their chunks.
+    void enableSCTPChecksumVerification(bool enable) {
+        mVerifySCTPChecksum = enable;
+    }
+
+    /// @brief Return whether SCTP checksum verification is enabled.
+    bool enableSCTPChecksumVerification() const { return mVerifySCTPChecksum; }
+
+    /// @brief Return how many SCTP packets were dropped because of a
+    ///        bad checksum.
+    std::uint64_t getSCTPChecksumErrorCount() const {
+        return mDropCounters.get(DecodeStatus::SCTPBadChecksum);
+    }
+
+    ///@}
+
+    /// @brief Return how many packets were dropped because they
+    ///        couldn't be decoded, by reason.
+    const DropCounters &getDropCounters() const { return mDropCounters; }
+
+  protected:
+    ///@name Default processing and chaining methods
+    ///
+    /// They do nothing and return true, telling to proceed and chain
+    /// (see EthPacketProcessor).
+    ///
+    ///@{
+
+    bool processEth(Context &) { return true; }
+    bool processIPv4(Context &) { return true; }
+    bool processTCP(Context &) { return true; }
+    bool processSCTP(Context &) { return true; }
+    bool processSCTP_GenericChunk(Context &) { return true; }
+    bool processSCTP_DataChunk(Context &) { return true; }
+    bool processUDP(Context &) { return true; }
+    bool processGTPv1U(Context &) { return true; }
+    bool processGTPv1U_IPv4(Context &) { return true; }
+    bool processNonIPv4(Context &) { return true; }
+    bool chainOnProcessEth(Context &) { return true; }
+    bool chainOnProcessIPv4(Context &) { return true; }
+    bool chainOnProcessTCP(Context &) { return true; }
+    bool chainOnProcessSCTP(Context &) { return true; }
+    bool chainOnProcessSCTP_GenericChunk(Context &) { return true; }
+    bool chainOnProcessSCTP_DataChunk(Context &) { return true; }
+    bool chainOnProcessUDP(Context &) { return true; }
+    bool chainOnProcessGTPv1U(Context &) { return true; }
+
+    ///@}
+
+    ///@name Default batch processing methods
+    ///
+    /// They call the single packet method of `Derived` on each packet,
+    /// dropping from the batch the ones for which it returns `false`
+    /// (see EthPacketProcessor), unless `Derived` doesn't define it:
+    /// then they do nothing at all.
+    ///
+    ///@{
+
+    void processEthBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processEth)) {
+            batch.filter(
+                [this](Context &c) { return derived().processEth(c); });
+        }
+    }
+
+    void chainOnProcessEthBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::chainOnProcessEth)) {
+            batch.filter(
+                [this](Context &c) { return derived().chainOnProcessEth(c); });
+        }
+    }
+
+    void processNonIPv4Batch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processNonIPv4)) {
+            batch.filter(
+                [this](Context &c) { return derived().processNonIPv4(c); });
+        }
+    }
+
+    void processIPv4Batch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processIPv4)) {
+            batch.filter(
+                [this](Context &c) { return derived().processIPv4(c); });
+        }
+    }
+
+    void chainOnProcessIPv4Batch(Batch &batch) {
+        if (isDerivedMethod(&Derived::chainOnProcessIPv4)) {
+            batch.filter(
+                [this](Context &c) { return derived().chainOnProcessIPv4(c); });
+        }
+    }
+
+    void processTCPBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processTCP)) {
+            batch.filter(
+                [this](Context &c) { return derived().processTCP(c); });
+        }
+    }
+
+    void chainOnProcessTCPBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::chainOnProcessTCP)) {
+            batch.filter(
+                [this](Context &c) { return derived().chainOnProcessTCP(c); });
+        }
+    }
+
+    void processSCTPBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processSCTP)) {
+            batch.filter(
+                [this](Context &c) { return derived().processSCTP(c); });
+        }
+    }
+
+    void chainOnProcessSCTPBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::chainOnProcessSCTP)) {
+            batch.filter(
+                [this](Context &c) { return derived().chainOnProcessSCTP(c); });
+        }
+    }
+
+    void processUDPBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processUDP)) {
+            batch.filter(
+                [this](Context &c) { return derived().processUDP(c); });
+        }
+    }
+
+    void chainOnProcessUDPBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::chainOnProcessUDP)) {
+            batch.filter(
+                [this](Context &c) { return derived().chainOnProcessUDP(c); });
+        }
+    }
+
+    void processGTPv1UBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processGTPv1U)) {
+            batch.filter(
+                [this](Context &c) { return derived().processGTPv1U(c); });
+        }
+    }
+
+    void chainOnProcessGTPv1UBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::chainOnProcessGTPv1U)) {
+            batch.filter([this](Context &c) {
+                return derived().chainOnProcessGTPv1U(c);
+            });
+        }
+    }
+
+    void processGTPv1U_IPv4Batch(Batch &batch) {
+        if (isDerivedMethod(&Derived::processGTPv1U_IPv4)) {
+            batch.filter(
+                [this](Context &c) { return derived().processGTPv1U_IPv4(c); });
+        }
+    }
+
+    void postProcessIPv4Batch(Batch &batch) {
+        if (isDerivedMethod(&Derived::postProcessIPv4)) {
+            batch.filter(
+                [this](Context &c) { return derived().postProcessIPv4(c); });
+        }
+    }
+
+    void finalProcessBatch(Batch &batch) {
+        if (isDerivedMethod(&Derived::finalProcess)) {
+            batch.filter([this](Context &c) {
+                derived().finalProcess(c);
+                return true;
+            });
+        }
+    }
+
+    ///@}
+
+    ///@name Default post-processing and final processing methods
+    ///
+    /// See EthPacketProcessor.
+    ///
+    ///@{
+
+    bool postProcessIPv4(Context &) { return true; }
+
+    void finalProcess(Context &) {}
+
+    bool finalProcessOnIPv4() { return false; }
+
+    ///@}
+
+    /// @brief Interface to inject directly IPv4 data in the
+    ///        processor.
+    ///
+    /// This allows specializations of this class to push down also
+    /// IPv4 data.  Note that in this case,
+    /// 'Context.ethFrameDecoder' will be `nullptr`.
+    void pushIPv4Packet(const BufferView &ipv4Data, ContextUserData &userData);
+
+    /// @brief Count a packet dropped because it couldn't be decoded.
+    ///
+    /// That's for specializations decoding more protocols (e.g.
+    /// S1APLib::S1APProcessor).
+    void countDrop(DecodeStatus status) { mDropCounters.count(status); }
+
+  private:
+    // How many frames ahead headers are prefetched, while decoding the
+    // Ethernet ones.
+    static constexpr std::size_t prefetchDistance = 4;
+
+    // Room for up to maxProcessorBatchSize objects of type T,
+    // constructed only when needed (e.g. a batch of one doesn't pay
+    // for the others).
+    template <typename T> class Slots {
+      public:
+        Slots() {}
+        Slots(const Slots &) = delete;
+        Slots &operator=(const Slots &) = delete;
+
+        ~Slots() {
+            while (mCount > 0) {
+                get(--mCount).~T();
+            }
+        }
+
+        template <typename... Args> T &emplace(Args &&... args) {
+            T *p = new (&mStorage[mCount]) T(std::forward<Args>(args)...);
+            ++mCount;
+            return *p;
+        }
+
+        // Default-initialize, rather than value-initialize (i.e. zero
+        // first) as the above would.
+        T &emplace() {
+            T *p = new (&mStorage[mCount]) T;
+            ++mCount;
+            return *p;
+        }
+
+        T &get(std::size_t i) { return data()[i]; }
+
+        T *data() { return reinterpret_cast<T *>(&mStorage[0]); }
+
+        std::size_t size() const { return mCount; }
+
+      private:
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type
+            mStorage[maxProcessorBatchSize];
+        std::size_t mCount = 0;
+    };
+
+    // Storage for the contexts and decoders of a batch.
+    struct BatchState {
+        explicit BatchState(std::exception_ptr &e) : error(e) {}
+
+        std::exception_ptr &error;
+
+        Slots<Context> contexts;
+        Slots<EthFrameDecoder> ethFrameDecoders;
+        Slots<IPv4Decoder> ipv4Decoders;
+        Slots<TCPDecoder> tcpDecoders;
+        Slots<UDPDecoder> udpDecoders;
+        Slots<GTPv1UDecoder> gtpv1uDecoders;
+        Slots<SCTPDecoder> sctpDecoders;
+
+        // Return an empty batch of the contexts.
+        Batch makeBatch() { return Batch(contexts.data(), error); }
+
+        // Add a context, with the same index as the bit of a batch
+        // mask.
+        std::size_t addContext(const ContextUserData &userData) {
+            Context &context = contexts.emplace();
+            context.userData = userData;
+            return contexts.size() - 1;
+        }
+    };
+
+    Derived &derived() { return static_cast<Derived &>(*this); }
+
+    // Return true if `status` is DecodeStatus::Ok, and count a drop
+    // otherwise.
+    bool checkDecoded(DecodeStatus status) {
+        if (status == DecodeStatus::Ok) {
+            return true;
+        }
+
+        countDrop(status);
+        return false;
+    }
+
+    // Decode the given data into one of `slots`, with no exceptions:
+    // return the decoder, or nullptr (counting the drop) if the data
+    // can't be decoded.
+    template <typename Decoder>
+    const Decoder *tryDecode(Slots<Decoder> &slots, const BufferView &data) {
+        DecodeStatus status;
+        const Decoder &decoder = slots.emplace(data, status);
+        return checkDecoded(status) ? &decoder : nullptr;
+    }
+
+    // The same, for the payload of the IPv4 packet of a context.
+    template <typename Decoder>
+    const Decoder *tryDecodeIPv4Data(Slots<Decoder> &slots,
+                                     const Context &context) {
+        const IPv4Decoder &ipv4Decoder = *context.ipv4Decoder;
+
+        return checkDecoded(ipv4Decoder.checkData())
+                   ? tryDecode(slots, ipv4Decoder.getData())
+                   : nullptr;
+    }
+
+    // Offset of the IPv4 header of a context: after the Ethernet
+    // header, or 0 for packets given to pushIPv4Packet().
+    static std::uint32_t l3Offset(const Context &context) {
+        return context.ethFrameDecoder != nullptr
+                   ? static_cast<std::uint32_t>(
+                         context.ethFrameDecoder->getDataOffset())
+                   : 0;
+    }
+
+    // Describe the ports of a context, if its TCP, UDP or SCTP header
+    // could be decoded: return false otherwise.
+    template <typename Decoder>
+    static bool describePorts(Context &context, const Decoder *decoder) {
+        if (decoder == nullptr) {
+            return false;
+        }
+
+        context.descriptor.describePorts(*decoder);
+        return true;
+    }
+
+    // Prefetch the headers of a frame: Ethernet, IPv4, UDP and GTP-U
+    // ones all fit in the first two cache lines.
+    static void prefetchHeaders(const BufferView &ethData) {
+#if defined(__GNUC__) || defined(__clang__)
+        const unsigned char *p = ethData.getUnderlyingBufferPtr();
+
+        if (ethData.size() > 0) {
+            __builtin_prefetch(p);
+        }
+
+        if (ethData.size() > 64) {
+            __builtin_prefetch(p + 64);
+        }
+#else
+        (void)ethData;
+#endif
+    }
+
+    // The class `M` is a pointer to a member of.
+    template <typename M> struct ClassOf;
+
+    template <typename T, typename C> struct ClassOf<T C::*> {
+        using type = C;
+    };
+
+    // Return true if `M` is a pointer to a method declared by `Derived`
+    // (rather than inherited from here).
+    template <typename M> static constexpr bool isDerivedMethod(M) {
+        return !std::is_same<typename ClassOf<M>::type,
+                             BasicEthPacketProcessor>::value;
+    }
+
+    // Return true if `Derived` declares any batch method.
+    static constexpr bool hasBatchMethods() {
+        return isDerivedMethod(&Derived::processEthBatch) ||
+               isDerivedMethod(&Derived::chainOnProcessEthBatch) ||
+               isDerivedMethod(&Derived::processNonIPv4Batch) ||
+               isDerivedMethod(&Derived::processIPv4Batch) ||
+               isDerivedMethod(&Derived::chainOnProcessIPv4Batch) ||
+               isDerivedMethod(&Derived::processTCPBatch) ||
+               isDerivedMethod(&Derived::chainOnProcessTCPBatch) ||
+               isDerivedMethod(&Derived::processSCTPBatch) ||
+               isDerivedMethod(&Derived::chainOnProcessSCTPBatch) ||
+               isDerivedMethod(&Derived::processUDPBatch) ||
+               isDerivedMethod(&Derived::chainOnProcessUDPBatch) ||
+               isDerivedMethod(&Derived::processGTPv1UBatch) ||
+               isDerivedMethod(&Derived::chainOnProcessGTPv1UBatch) ||
+               isDerivedMethod(&Derived::processGTPv1U_IPv4Batch) ||
+               isDerivedMethod(&Derived::postProcessIPv4Batch) ||
+               isDerivedMethod(&Derived::finalProcessBatch);
+    }
+
+    // Does the actual processing of a single packet, when batch
+    // methods aren't used: the same as a batch of one, with no batch
+    // to keep track of.
+    void doProcessEth(const BufferView &ethData, ContextUserData &userData);
+    bool doProcessIPv4(const BufferView &ipv4Data, Context &context);
+    bool doProcessSCTP(const BufferView &sctpData, Context &context);
+    bool doProcessUDP(const BufferView &udpData, Context &context);
+    bool doProcessTCP(const BufferView &tcpData, Context &context);
+
+    // Does the actual processing of a batch, stage by stage. Each
+    // stage leaves in the given Batch the packets to be processed to
+    // the end.
+    void doProcessEthBatch(BatchState &state, const BufferView *ethData,
+                           std::size_t count, ContextUserData &userData);
+    void doProcessIPv4Batch(BatchState &state, Batch &batch);
+    void doProcessSCTPBatch(BatchState &state, Batch &batch);
+    bool doProcessSCTPChunks(Context &context);
+    void doProcessUDPBatch(BatchState &state, Batch &batch);
+    void doProcessTCPBatch(BatchState &state, Batch &batch);
+
+    // Call a batch method on the given batch (via `call()`), unless
+    // it's empty, dropping the whole batch if it throws.
+    template <typename Call> void callBatchMethod(Batch &batch, Call call) {
+        if (batch.empty()) {
+            return;
+        }
+
+        try {
+            call();
+        } catch (...) {
+            batch.saveError();
+            batch.clear();
+        }
+    }
+
+    bool mVerifySCTPChecksum = false;
+    DropCounters mDropCounters;
+};
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::consumeEthPacket(
+    const BufferView &ethData, ContextUserData &userData) {
+    if (hasBatchMethods()) {
+        // Not a virtual call: specializations may implement
+        // consumeEthPackets() via consumeEthPacket().
+        BasicEthPacketProcessor::consumeEthPackets(&ethData, 1, userData);
+    } else {
+        doProcessEth(ethData, userData);
+    }
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::consumeEthPackets(
+    const BufferView *ethData, std::size_t count, ContextUserData &userData) {
+    std::exception_ptr error;
+
+    while (count > 0) {
+        const std::size_t n = std::min(count, maxProcessorBatchSize);
+        BatchState state(error);
+
+        doProcessEthBatch(state, ethData, n, userData);
+
+        ethData += n;
+        count -= n;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::pushIPv4Packet(
+    const BufferView &ipv4Data, ContextUserData &userData) {
+    if (!hasBatchMethods()) {
+        Context context;
+        context.userData = userData;
+
+        if (doProcessIPv4(ipv4Data, context) &&
+            derived().finalProcessOnIPv4()) {
+            derived().finalProcess(context);
+        }
+
+        return;
+    }
+
+    std::exception_ptr error;
+
+    {
+        BatchState state(error);
+        Batch batch = state.makeBatch();
+
+        batch.add(state.addContext(userData));
+        batch.filter([&](Context &c) {
+            c.ipv4Decoder = tryDecode(state.ipv4Decoders, ipv4Data);
+
+            if (c.ipv4Decoder == nullptr) {
+                return false;
+            }
+
+            c.descriptor.describeIPv4(*c.ipv4Decoder, 0);
+            return true;
+        });
+
+        doProcessIPv4Batch(state, batch);
+
+        if (derived().finalProcessOnIPv4()) {
+            callBatchMethod(batch, [&] { derived().finalProcessBatch(batch); });
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::doProcessEth(
+    const BufferView &ethData, ContextUserData &userData) {
+    DecodeStatus status;
+    EthFrameDecoder ethFrameDecoder(ethData, status);
+
+    if (!checkDecoded(status)) {
+        return;
+    }
+
+    Context context;
+    context.userData = userData;
+    context.ethFrameDecoder = &ethFrameDecoder;
+
+    if (derived().processEth(context)) {
+        if (derived().chainOnProcessEth(context)) {
+            if (ethFrameDecoder.isIPv4()) {
+                if (doProcessIPv4(ethFrameDecoder.getData(), context)) {
+                    // We arrived at the end with nobody stopping
+                    // processing. Do final processing.
+                    derived().finalProcess(context);
+                }
+            } else {
+                // Not IPv4, and Eth chaining didn't stop processing?
+                //
+                // Process non-IPv4 traffic.
+                if (derived().processNonIPv4(context)) {
+                    // Do final processing.
+                    derived().finalProcess(context);
+                }
+            }
+        }
+    }
+}
+
+template <typename Derived>
+bool BasicEthPacketProcessor<Derived>::doProcessIPv4(
+    const BufferView &ipv4Data, Context &context) {
+    DecodeStatus status;
+    IPv4Decoder ipv4Decoder(ipv4Data, status);
+
+    if (!checkDecoded(status)) {
+        return false;
+    }
+
+    context.ipv4Decoder = &ipv4Decoder;
+    auto f = finally([&] { context.ipv4Decoder = nullptr; });
+
+    context.descriptor.describeIPv4(ipv4Decoder, l3Offset(context));
+
+    bool doContinueProcessing = false;
+
+    if (derived().processIPv4(context)) {
+        if (derived().chainOnProcessIPv4(context)) {
+            if (ipv4Decoder.isUDP()) {
+
+                doContinueProcessing =
+                    checkDecoded(ipv4Decoder.checkData()) &&
+                    doProcessUDP(ipv4Decoder.getData(), context);
+
+            } else if (ipv4Decoder.isSCTP()) {
+
+                doContinueProcessing =
+                    checkDecoded(ipv4Decoder.checkData()) &&
+                    doProcessSCTP(ipv4Decoder.getData(), context);
+
+            } else if (ipv4Decoder.isTCP()) {
+
+                doContinueProcessing =
+                    checkDecoded(ipv4Decoder.checkData()) &&
+                    doProcessTCP(ipv4Decoder.getData(), context);
+            } else {
+                doContinueProcessing = true;
+            }
+
+            if (doContinueProcessing && context.postProcessIPv4) {
+                doContinueProcessing = derived().postProcessIPv4(context);
+            }
+        }
+    }
+
+    return doContinueProcessing;
+}
+
+template <typename Derived>
+bool BasicEthPacketProcessor<Derived>::doProcessSCTP(
+    const BufferView &sctpData, Context &context) {
+    if (mVerifySCTPChecksum && !SCTPDecoder::verifyChecksum(sctpData)) {
+        countDrop(DecodeStatus::SCTPBadChecksum);
+        return false;
+    }
+
+    DecodeStatus status;
+    SCTPDecoder sctpDecoder(sctpData, status);
+
+    if (!checkDecoded(status)) {
+        return false;
+    }
+
+    context.sctpDecoder = &sctpDecoder;
+    auto f = finally([&] { context.sctpDecoder = nullptr; });
+
+    context.descriptor.describePorts(sctpDecoder);
+
+    if (derived().processSCTP(context)) {
+        if (derived().chainOnProcessSCTP(context)) {
+            return doProcessSCTPChunks(context);
+        }
+    }
+
+    return false;
+}
+
+template <typename Derived>
+bool BasicEthPacketProcessor<Derived>::doProcessUDP(const BufferView &udpData,
+                                                    Context &context) {
+    DecodeStatus status;
+    UDPDecoder udpDecoder(udpData, status);
+
+    if (!checkDecoded(status)) {
+        return false;
+    }
+
+    context.udpDecoder = &udpDecoder;
+    auto f = finally([&] { context.udpDecoder = nullptr; });
+
+    context.descriptor.describePorts(udpDecoder);
+
+    bool doContinueProcessing = false;
+
+    if (derived().processUDP(context)) {
+        if (derived().chainOnProcessUDP(context)) {
+            if (udpDecoder.isGTPv1U()) {
+                GTPv1UDecoder gtpv1uDecoder(udpDecoder.getData(), status);
+
+                if (!checkDecoded(status)) {
+                    return false;
+                }
+
+                context.gtpv1uDecoder = &gtpv1uDecoder;
+                auto f = finally([&] { context.gtpv1uDecoder = nullptr; });
+
+                context.descriptor.describeGTPv1U(gtpv1uDecoder);
+
+                if (derived().processGTPv1U(context)) {
+                    if (derived().chainOnProcessGTPv1U(context)) {
+                        if (gtpv1uDecoder.isIPv4PDU()) {
+                            if (!checkDecoded(gtpv1uDecoder.checkData())) {
+                                return false;
+                            }
+
+                            context.descriptor.describeTunneledIPv4(
+                                gtpv1uDecoder);
+
+                            doContinueProcessing =
+                                derived().processGTPv1U_IPv4(context);
+                        } else {
+                            // Not IPv4 traffic and chaining didn't
+                            // stop processing? Continue processing to
+                            // the end.
+                            doContinueProcessing = true;
+                        }
+                    }
+                }
+            } else {
+                // Not GTPv1-U and UDP chaining didn't stop
+                // processing?  Continue processing to the end.
+                doContinueProcessing = true;
+            }
+        }
+    }
+
+    return doContinueProcessing;
+}
+
+template <typename Derived>
+bool BasicEthPacketProcessor<Derived>::doProcessTCP(const BufferView &tcpData,
+                                                    Context &context) {
+    DecodeStatus status;
+    TCPDecoder tcpDecoder(tcpData, status);
+
+    if (!checkDecoded(status)) {
+        return false;
+    }
+
+    context.tcpDecoder = &tcpDecoder;
+    auto f = finally([&] { context.tcpDecoder = nullptr; });
+
+    context.descriptor.describePorts(tcpDecoder);
+
+    bool doContinueProcessing = false;
+
+    if (derived().processTCP(context)) {
+        if (derived().chainOnProcessTCP(context)) {
+            doContinueProcessing = true;
+        }
+    }
+
+    return doContinueProcessing;
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::doProcessEthBatch(
+    BatchState &state, const BufferView *ethData, std::size_t count,
+    ContextUserData &userData) {
+    Batch batch = state.makeBatch();
+
+    for (std::size_t i = 0; i < count && i < prefetchDistance; ++i) {
+        prefetchHeaders(ethData[i]);
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        if (i + prefetchDistance < count) {
+            prefetchHeaders(ethData[i + prefetchDistance]);
+        }
+
+        const std::size_t index = state.addContext(userData);
+        Context &context = state.contexts.get(index);
+
+        context.ethFrameDecoder = tryDecode(state.ethFrameDecoders, ethData[i]);
+
+        if (context.ethFrameDecoder != nullptr) {
+            batch.add(index);
+        }
+    }
+
+    callBatchMethod(batch, [&] { derived().processEthBatch(batch); });
+    callBatchMethod(batch, [&] { derived().chainOnProcessEthBatch(batch); });
+
+    Batch ipv4 =
+        batch.takeIf([](Context &c) { return c.ethFrameDecoder->isIPv4(); });
+
+    // Not IPv4, and Eth chaining didn't stop processing?
+    //
+    // Process non-IPv4 traffic.
+    callBatchMethod(batch, [&] { derived().processNonIPv4Batch(batch); });
+
+    ipv4.filter([this, &state](Context &c) {
+        c.ipv4Decoder =
+            tryDecode(state.ipv4Decoders, c.ethFrameDecoder->getData());
+
+        if (c.ipv4Decoder == nullptr) {
+            return false;
+        }
+
+        c.descriptor.describeIPv4(*c.ipv4Decoder, l3Offset(c));
+        return true;
+    });
+
+    doProcessIPv4Batch(state, ipv4);
+
+    // We arrived at the end with nobody stopping processing. Do final
+    // processing (in arrival order, as always).
+    batch.merge(ipv4);
+    callBatchMethod(batch, [&] { derived().finalProcessBatch(batch); });
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::doProcessIPv4Batch(
+    BatchState &state, Batch &batch) {
+    callBatchMethod(batch, [&] { derived().processIPv4Batch(batch); });
+    callBatchMethod(batch, [&] { derived().chainOnProcessIPv4Batch(batch); });
+
+    if (batch.empty()) {
+        return;
+    }
+
+    Batch udp = batch.takeIf([](Context &c) { return c.ipv4Decoder->isUDP(); });
+    Batch sctp =
+        batch.takeIf([](Context &c) { return c.ipv4Decoder->isSCTP(); });
+    Batch tcp = batch.takeIf([](Context &c) { return c.ipv4Decoder->isTCP(); });
+
+    doProcessUDPBatch(state, udp);
+    doProcessSCTPBatch(state, sctp);
+    doProcessTCPBatch(state, tcp);
+
+    // Packets left in `batch` are of other protocols, and continue
+    // processing to the end.
+    batch.merge(udp);
+    batch.merge(sctp);
+    batch.merge(tcp);
+
+    Batch post = batch.takeIf([](Context &c) { return c.postProcessIPv4; });
+
+    callBatchMethod(post, [&] { derived().postProcessIPv4Batch(post); });
+    batch.merge(post);
+
+    for (Context &c : batch) {
+        c.ipv4Decoder = nullptr;
+    }
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::doProcessSCTPBatch(
+    BatchState &state, Batch &batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    batch.filter([this, &state](Context &c) {
+        if (!checkDecoded(c.ipv4Decoder->checkData())) {
+            return false;
+        }
+
+        const BufferView sctpData = c.ipv4Decoder->getData();
+
+        if (mVerifySCTPChecksum && !SCTPDecoder::verifyChecksum(sctpData)) {
+            countDrop(DecodeStatus::SCTPBadChecksum);
+            return false;
+        }
+
+        c.sctpDecoder = tryDecode(state.sctpDecoders, sctpData);
+        return describePorts(c, c.sctpDecoder);
+    });
+
+    callBatchMethod(batch, [&] { derived().processSCTPBatch(batch); });
+    callBatchMethod(batch, [&] { derived().chainOnProcessSCTPBatch(batch); });
+
+    batch.filter([this](Context &c) { return doProcessSCTPChunks(c); });
+
+    for (Context &c : batch) {
+        c.sctpDecoder = nullptr;
+    }
+}
+
+template <typename Derived>
+bool BasicEthPacketProcessor<Derived>::doProcessSCTPChunks(Context &context) {
+    bool doContinueProcessing = false;
+
+    // Process SCTP chunks
+    for (auto &genericChunk : context.sctpDecoder->chunks()) {
+        context.sctpGenericChunkDecoder = &genericChunk;
+        auto f = finally([&] { context.sctpGenericChunkDecoder = nullptr; });
+
+        if (derived().processSCTP_GenericChunk(context)) {
+            if (derived().chainOnProcessSCTP_GenericChunk(context)) {
+                if (genericChunk.isDataChunk()) {
+                    DecodeStatus status;
+                    NetworkLib::SCTPDataChunkDecoder dataChunkDecoder(
+                        genericChunk.getData(), status);
+
+                    if (!checkDecoded(status)) {
+                        // Drop the whole packet, as if it couldn't
+                        // be decoded at all.
+                        return false;
+                    }
+
+                    context.sctpDataChunkDecoder = &dataChunkDecoder;
+                    auto f = finally(
+                        [&] { context.sctpDataChunkDecoder = nullptr; });
+
+                    if (derived().processSCTP_DataChunk(context)) {
+                        if (derived().chainOnProcessSCTP_DataChunk(context)) {
+                            doContinueProcessing = true;
+                        }
+                    }
+                } else {
+                    // Are there non-DATA chunks as well, and SCTP
+                    // generic chunk chaining didn't stop processing?
+                    // Continue processing to the end.
+                    doContinueProcessing = true;
+                }
+            }
+        }
+    }
+
+    return doContinueProcessing;
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::doProcessUDPBatch(
+    BatchState &state, Batch &batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    batch.filter([this, &state](Context &c) {
+        c.udpDecoder = tryDecodeIPv4Data(state.udpDecoders, c);
+        return describePorts(c, c.udpDecoder);
+    });
+
+    callBatchMethod(batch, [&] { derived().processUDPBatch(batch); });
+    callBatchMethod(batch, [&] { derived().chainOnProcessUDPBatch(batch); });
+
+    // Not GTPv1-U and UDP chaining didn't stop processing? Continue
+    // processing to the end (i.e. leave them in `batch`).
+    Batch gtpv1u =
+        batch.takeIf([](Context &c) { return c.udpDecoder->isGTPv1U(); });
+
+    gtpv1u.filter([this, &state](Context &c) {
+        c.gtpv1uDecoder =
+            tryDecode(state.gtpv1uDecoders, c.udpDecoder->getData());
+
+        if (c.gtpv1uDecoder == nullptr) {
+            return false;
+        }
+
+        c.descriptor.describeGTPv1U(*c.gtpv1uDecoder);
+        return true;
+    });
+
+    callBatchMethod(gtpv1u, [&] { derived().processGTPv1UBatch(gtpv1u); });
+    callBatchMethod(gtpv1u,
+                    [&] { derived().chainOnProcessGTPv1UBatch(gtpv1u); });
+
+    // Not IPv4 traffic and chaining didn't stop processing? Continue
+    // processing to the end (i.e. leave them in `gtpv1u`).
+    Batch gtpv1uIPv4 = gtpv1u.takeIf(
+        [](Context &c) { return c.gtpv1uDecoder->isIPv4PDU(); });
+
+    gtpv1uIPv4.filter([this](Context &c) {
+        if (!checkDecoded(c.gtpv1uDecoder->checkData())) {
+            return false;
+        }
+
+        c.descriptor.describeTunneledIPv4(*c.gtpv1uDecoder);
+        return true;
+    });
+
+    callBatchMethod(gtpv1uIPv4,
+                    [&] { derived().processGTPv1U_IPv4Batch(gtpv1uIPv4); });
+
+    batch.merge(gtpv1u);
+    batch.merge(gtpv1uIPv4);
+
+    for (Context &c : batch) {
+        c.udpDecoder = nullptr;
+        c.gtpv1uDecoder = nullptr;
+    }
+}
+
+template <typename Derived>
+void BasicEthPacketProcessor<Derived>::doProcessTCPBatch(
+    BatchState &state, Batch &batch) {
+    if (batch.empty()) {
+        return;
+    }
+
+    batch.filter([this, &state](Context &c) {
+        c.tcpDecoder = tryDecodeIPv4Data(state.tcpDecoders, c);
+        return describePorts(c, c.tcpDecoder);
+    });
+
+    callBatchMethod(batch, [&] { derived().processTCPBatch(batch); });
+    callBatchMethod(batch, [&] { derived().chainOnProcessTCPBatch(batch); });
+
+    for (Context &c : batch) {
+        c.tcpDecoder = nullptr;
+    }
+}
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
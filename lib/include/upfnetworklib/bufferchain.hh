@@ -0,0 +1,146 @@
+#ifndef UPFNETWORKLIB_BUFFERCHAIN_HH
+#define UPFNETWORKLIB_BUFFERCHAIN_HH
+
+#include <upfnetworklib/buffers.hh>
+
+// For std::array
+#include <array>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::length_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+namespace UPF {
+namespace NetworkLib {
+
+/// @brief Maximum number of segments of a BufferChain.
+constexpr std::size_t maxBufferChainSegments = 8;
+
+/// @brief Largest BufferChain flattened into a pooled buffer (see
+///        BufferChain::flatten()).
+constexpr std::size_t maxPooledFlattenSize = 2048;
+
+/**
+ * @brief A packet made of a few BufferView segments, to be sent out
+ *        back to back (i.e. a scatter-gather list).
+ *
+ * It lets headers be built apart from the payload they go in front of
+ * (e.g. in a small per-flow template), while the payload stays where
+ * it was received: sinks supporting it (see
+ * EthPacketSink::consumeEthPacketChain()) write segments out with a
+ * single ``writev()``/``sendmsg()``, instead of copying them into a
+ * single buffer first.
+ *
+ * Segments are kept inline, so building a BufferChain never
+ * allocates. Like any BufferView, each segment keeps its underlying
+ * buffer alive, unless it's non-owning.
+ *
+ * Example:
+ *
+ *     NetworkLib::BufferChain chain;
+ *     chain.append(ethHeader).append(ipv4Data);
+ *
+ *     RawSocketsUtil::sendData(fd, chain);
+ */
+class BufferChain {
+  public:
+    ///@name Constructors
+    ///@{
+
+    /// @brief Constructor of an empty BufferChain.
+    BufferChain() noexcept {}
+
+    /// @brief Constructor of a BufferChain with a single segment.
+    explicit BufferChain(const BufferView &segment) { append(segment); }
+
+    ///@}
+
+    /// @brief Append a segment (empty segments are skipped).
+    ///
+    /// Throw std::length_error if there are already
+    /// maxBufferChainSegments segments.
+    ///
+    /// @return A reference to self, so method calls can be chained.
+    BufferChain &append(const BufferView &segment) {
+        if (segment.empty()) {
+            return *this;
+        }
+
+        if (mCount == mSegments.size()) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION << ": too many segments (max "
+                << mSegments.size() << ')';
+            throw std::length_error(err.str());
+        }
+
+        mSegments[mCount++] = segment;
+        mSize += segment.size();
+        return *this;
+    }
+
+    /// @brief Remove all the segments.
+    void clear() {
+        for (std::size_t i = 0; i < mCount; ++i) {
+            mSegments[i] = BufferView();
+        }
+
+        mCount = 0;
+        mSize = 0;
+    }
+
+    /// @brief Return true when there's no data.
+    bool empty() const { return mSize == 0; }
+
+    /// @brief Return the total size, in bytes, of all the segments.
+    std::size_t size() const { return mSize; }
+
+    /// @brief Return the number of segments.
+    std::size_t getSegmentCount() const { return mCount; }
+
+    /// @brief Return the segment with the given index (not checking
+    ///        bounds).
+    const BufferView &getSegment(std::size_t i) const {
+        return mSegments[i];
+    }
+
+    ///@name Iteration over segments
+    ///@{
+    const BufferView *begin() const { return mSegments.data(); }
+    const BufferView *end() const { return mSegments.data() + mCount; }
+    ///@}
+
+    /// @brief Copy all the data, segment after segment, to the given
+    ///        raw buffer, which must be at least size() bytes long.
+    void copyTo(unsigned char *dest) const {
+        for (std::size_t i = 0; i < mCount; ++i) {
+            mSegments[i].copyTo(0, mSegments[i].size(), dest);
+            dest += mSegments[i].size();
+        }
+    }
+
+    /// @brief Get all the data as a single BufferView.
+    ///
+    /// With a single segment, that's just the segment. Otherwise
+    /// the data is copied into a buffer taken from a thread-safe pool
+    /// (see ConcurrentPacketBufferSizedPool), which goes back to it
+    /// when the last view on it goes away, or into a newly allocated
+    /// one when the chain is bigger than maxPooledFlattenSize (e.g. a
+    /// GSO super-packet): this is the fallback for sinks not
+    /// supporting chains.
+    BufferView flatten() const;
+
+  private:
+    std::array<BufferView, maxBufferChainSegments> mSegments;
+    std::size_t mCount = 0;
+    std::size_t mSize = 0;
+};
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
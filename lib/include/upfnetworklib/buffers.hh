@@ -1,12 +1,20 @@
 #ifndef UPFNETWORKLIB_BUFFERS_HH
 #define UPFNETWORKLIB_BUFFERS_HH
 
+#include <upfnetworklib/checksum.hh>
+#include <upfnetworklib/poolstats.hh>
 #include <upfnetworklib/utils.hh>
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
 
 namespace UPF {
 namespace NetworkLib {
@@ -17,9 +25,33 @@ namespace NetworkLib {
  *
  * Neither this type nor its specializations are meant to be used
  * directly: instead, use BufferView and BufferWritableView.
+ *
+ * Each PacketBuffer carries its own reference count, managed by
+ * PacketBufferRef handles: when the last reference is dropped,
+ * recycle() is called, which by default deletes the PacketBuffer
+ * (buffers from pools and rings override it to give the buffer back
+ * instead). This way, getting a buffer or a view on it never
+ * allocates anything.
+ *
+ * The reference count is atomic by default. Buffers which are known
+ * to be referenced by a single thread (e.g. those of a
+ * PacketBufferSizedPool) can turn it into a plain counter via
+ * setThreadSafeReferences(false), which is cheaper.
  */
 class PacketBuffer {
   public:
+    PacketBuffer() noexcept = default;
+
+    /// @brief Copy constructor: the reference count isn't copied.
+    PacketBuffer(const PacketBuffer &other) noexcept
+        : mThreadSafeReferences(other.mThreadSafeReferences) {}
+
+    /// @brief Copy assignment: the reference count isn't copied.
+    PacketBuffer &operator=(const PacketBuffer &other) noexcept {
+        mThreadSafeReferences = other.mThreadSafeReferences;
+        return *this;
+    }
+
     virtual ~PacketBuffer() {}
 
     /// @brief Get the PacketBuffer size.
@@ -27,6 +59,156 @@ class PacketBuffer {
 
     /// @brief Get a pointer to the underlying buffer.
     virtual unsigned char *data() = 0;
+
+    ///@name Reference counting (see PacketBufferRef)
+    ///@{
+
+    /// @brief Add a reference.
+    void addReference() noexcept {
+        if (mThreadSafeReferences) {
+            mReferences.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // Just a plain load and store, with no atomic
+            // read-modify-write.
+            mReferences.store(mReferences.load(std::memory_order_relaxed) +
+                                  1,
+                              std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Drop a reference, recycling the PacketBuffer if it was
+    ///        the last one.
+    void dropReference() noexcept {
+        if (mThreadSafeReferences) {
+            if (mReferences.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                recycle();
+            }
+        } else {
+            const std::uint32_t n =
+                mReferences.load(std::memory_order_relaxed) - 1;
+
+            mReferences.store(n, std::memory_order_relaxed);
+
+            if (n == 0) {
+                recycle();
+            }
+        }
+    }
+
+    /// @brief Get the current number of references.
+    std::uint32_t getReferenceCount() const noexcept {
+        return mReferences.load(std::memory_order_relaxed);
+    }
+
+    ///@}
+
+  protected:
+    /// @brief Called when the last reference is dropped. By default,
+    ///        delete the PacketBuffer, which must have been allocated
+    ///        via `new`.
+    virtual void recycle() noexcept { delete this; }
+
+    /// @brief Choose between an atomic (the default) or a plain
+    ///        reference count. Must be called while there are no
+    ///        references.
+    void setThreadSafeReferences(bool threadSafe) noexcept {
+        mThreadSafeReferences = threadSafe;
+    }
+
+  private:
+    std::atomic<std::uint32_t> mReferences{0};
+    bool mThreadSafeReferences = true;
+};
+
+/**
+ * @brief A handle holding a reference to a PacketBuffer, in the
+ *        spirit of ``boost::intrusive_ptr``.
+ *
+ * Unlike a ``std::shared_ptr``, the reference count is stored in the
+ * PacketBuffer itself, so nothing is allocated when making a handle.
+ */
+class PacketBufferRef {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Constructor of a null handle.
+    PacketBufferRef() noexcept = default;
+
+    /// @brief Constructor of a null handle.
+    PacketBufferRef(std::nullptr_t) noexcept {}
+
+    /// @brief Constructor adding a reference to the given
+    ///        PacketBuffer (if any).
+    explicit PacketBufferRef(PacketBuffer *p) noexcept : mPtr(p) {
+        if (mPtr != nullptr) {
+            mPtr->addReference();
+        }
+    }
+
+    /// @brief Make a handle on a PacketBuffer owned by a
+    ///        ``std::shared_ptr``, which is kept alive as long as
+    ///        there are references.
+    ///
+    /// This allocates a wrapper: it's meant for compatibility only.
+    static PacketBufferRef fromSharedPtr(std::shared_ptr<PacketBuffer> b);
+
+    ~PacketBufferRef() { reset(); }
+
+    ///@}
+
+    ///@name Copy semantic
+    ///@{
+    PacketBufferRef(const PacketBufferRef &other) noexcept
+        : PacketBufferRef(other.mPtr) {}
+
+    PacketBufferRef &operator=(const PacketBufferRef &other) noexcept {
+        if (other.mPtr != nullptr) {
+            other.mPtr->addReference();
+        }
+
+        reset();
+        mPtr = other.mPtr;
+        return *this;
+    }
+    ///@}
+
+    ///@name Move semantic
+    ///@{
+    PacketBufferRef(PacketBufferRef &&other) noexcept : mPtr(other.mPtr) {
+        other.mPtr = nullptr;
+    }
+
+    PacketBufferRef &operator=(PacketBufferRef &&other) noexcept {
+        if (this != &other) {
+            reset();
+            mPtr = other.mPtr;
+            other.mPtr = nullptr;
+        }
+        return *this;
+    }
+    ///@}
+
+    /// @brief Drop the reference, if any.
+    void reset() noexcept {
+        if (mPtr != nullptr) {
+            // Clear it first, in case recycling ends up here again.
+            PacketBuffer *p = mPtr;
+            mPtr = nullptr;
+            p->dropReference();
+        }
+    }
+
+    /// @brief Get the PacketBuffer (or `nullptr`).
+    PacketBuffer *get() const noexcept { return mPtr; }
+
+    PacketBuffer *operator->() const noexcept { return mPtr; }
+
+    /// @brief True if not null.
+    explicit operator bool() const noexcept { return mPtr != nullptr; }
+
+  private:
+    PacketBuffer *mPtr = nullptr;
 };
 
 /**
@@ -61,7 +243,7 @@ template <std::size_t s> class PacketBufferArrayBased : public PacketBuffer {
  * * nothing at all: in this case we have an empty BufferView;
  *
  * * a PacketBuffer: the BufferView shares ownership of the
- *   PacketBuffer via a ``std::shared_ptr<PacketBuffer>``;
+ *   PacketBuffer via a PacketBufferRef;
  *
  * * a generic buffer of ``unsigned char`` of arbitrary size,
  *   **non-owned**.  Users must ensure that the underlying buffer exists
@@ -75,20 +257,28 @@ template <std::size_t s> class PacketBufferArrayBased : public PacketBuffer {
  *
  * * it's not a template;
  *
- * * it can use a ``std::shared_ptr<PacketBuffer>`` to manage the lifecycle
- *   of the underlying PacketBuffer;
+ * * it can use a PacketBufferRef (an intrusive reference count) to
+ *   manage the lifecycle of the underlying PacketBuffer;
  *
  * * data in the buffer is read-only;
  *
  * * most of all, it provides methods to easily access data as
  *   commonly stored in network packet buffers (e.g. integers of
  *   variuos sizes stored in network order, addresses, etc.).
+ *
+ * A BufferView also knows its *headroom*: how many bytes of the same
+ * underlying buffer precede it, which BufferWritableView::prepend()
+ * can use to put headers in front of a packet without copying it
+ * (see getHeadroom()).
  */
 class BufferView {
   public:
     /// @brief Hex dump of the BufferView content.
     friend std::ostream &operator<<(std::ostream &ostr, const BufferView &obj);
 
+    // For access to the protected members of plain BufferView objects.
+    friend class BufferWritableView;
+
     ///@name Constructors
     ///@{
 
@@ -97,7 +287,20 @@ class BufferView {
     /// An empty BufferView is pretty useless in itself, but this allows
     /// declaring a BufferView that can be assigned to in a subsequent
     /// moment.
-    BufferView() noexcept : mBufferPtr(nullptr), mSize(0), mPtr(nullptr) {}
+    BufferView() noexcept
+        : mBufferPtr(), mSize(0), mPtr(nullptr), mHeadroom(0) {}
+
+    /// @brief Constructor from a PacketBufferRef.
+    ///
+    /// @param b A reference to a PacketBuffer. When null, just
+    ///        construct an empty BufferView.
+    ///
+    /// The resulting BufferView comprises all the underlying
+    /// PacketBuffer.
+    explicit BufferView(PacketBufferRef b) noexcept
+        : mBufferPtr(std::move(b)),
+          mSize{mBufferPtr ? mBufferPtr->size() : 0},
+          mPtr{(mSize > 0) ? mBufferPtr->data() : nullptr}, mHeadroom(0) {}
 
     /// @brief Constructor from a `std::shared_ptr<PacketBuffer>`.
     ///
@@ -108,11 +311,10 @@ class BufferView {
     /// The resulting BufferView comprises all the underlying
     /// PacketBuffer.
     ///
+    /// @note This allocates a wrapper around the std::shared_ptr:
+    ///       prefer the PacketBufferRef constructor.
     explicit BufferView(std::shared_ptr<PacketBuffer> b)
-        : mBufferPtr(b), mSize{b ? b->size() : 0}, mPtr{(b != nullptr &&
-                                                         mSize > 0)
-                                                            ? b->data()
-                                                            : nullptr} {}
+        : BufferView(PacketBufferRef::fromSharedPtr(std::move(b))) {}
 
     /// @brief Make a BufferView which is attached to some buffer
     ///        allocated externally.
@@ -129,7 +331,8 @@ class BufferView {
 
         // Note: we cast away constness from ptr, but a BufferView
         //       won't ever change data through it.
-        return BufferView(nullptr, const_cast<unsigned char *>(ptr), length);
+        return BufferView(PacketBufferRef(), const_cast<unsigned char *>(ptr),
+                          length);
     }
 
     ///@}
@@ -152,6 +355,18 @@ class BufferView {
     /// @brief Return the BufferView size.
     std::size_t size() const { return mSize; }
 
+    /// @brief Return the headroom of the BufferView, i.e. how many
+    ///        bytes of the underlying buffer there are in front of
+    ///        it.
+    ///
+    /// A view got via getSub() has the headroom of its parent plus
+    /// the offset it starts at, so e.g. the IPv4 packet in a Ethernet
+    /// frame has at least 14 bytes of headroom. To have more, receive
+    /// frames into buffers from a pool with some headroom (see e.g.
+    /// PacketBufferSizedPool), or past the start of a buffer (e.g.
+    /// into ``buffer.getSub(defaultHeadroom)``).
+    std::size_t getHeadroom() const { return mHeadroom; }
+
     /// @brief Sum the BufferView contents as 16-bit integers.
     ///
     /// Consider the BufferView content as an array of
@@ -163,30 +378,12 @@ class BufferView {
     ///
     /// This method is needed to compute UDP and IPv4 checksums. See
     /// also RFC 1071, 1141 et alt.
+    ///
+    /// It uses SIMD instructions where available (see sum16()).
     std::uint32_t getSum16() const {
         // Note: don't bother checking if the BufferView is empty,
         //       as the result will be 0 anyways.
-        const std::size_t evenSize = mSize - (mSize % 2);
-        const unsigned char *p = mPtr;
-        const unsigned char *endP = mPtr + evenSize;
-        std::uint_fast32_t sum1 = 0;
-        std::uint_fast32_t sum2 = 0;
-        std::uint32_t result = 0;
-
-        while (p != endP) {
-            sum1 += *p++;
-            sum2 += *p++;
-        }
-
-        result = sum2 + (sum1 << 8);
-
-        if (mSize != evenSize) {
-            // Add the bits of the last byte as if a 0 was appended
-            // to make the size even.
-            result += (*p) << 8;
-        }
-
-        return result;
+        return sum16(mPtr, mSize);
     }
 
     /// @brief Get a new BufferView entirely contained within this
@@ -204,7 +401,7 @@ class BufferView {
         throwExceptionIfOutOfBounds(NETWORKLIB_CURRENT_FUNCTION, offset, len);
 
         // Note: keep in mind that mBufferPtr can (legally) be NULL.
-        return BufferView(mBufferPtr, mPtr + offset, len);
+        return BufferView(mBufferPtr, mPtr + offset, len, mHeadroom + offset);
     }
 
     /// @brief Get a new BufferView contained within this BufferView,
@@ -229,7 +426,8 @@ class BufferView {
             throw std::out_of_range(err.str());
         }
 
-        return BufferView(mBufferPtr, mPtr + offset, mSize - offset);
+        return BufferView(mBufferPtr, mPtr + offset, mSize - offset,
+                          mHeadroom + offset);
     }
 
     /// @brief Shrink the size of this BufferView to the given new
@@ -530,20 +728,34 @@ class BufferView {
 
   protected:
     /// @brief Points either to `nullptr` or to the underlying PacketBuffer
-    std::shared_ptr<PacketBuffer> mBufferPtr;
+    PacketBufferRef mBufferPtr;
 
     /// @brief Size of the view
     std::size_t mSize;
 
     /// @brief Pointer either to nullptr, or to the buffer.
+    ///
+    /// Empty views with some headroom (e.g. ``view.getSub(view.size())``)
+    /// keep pointing to the buffer, so that they can be prepended to.
     unsigned char *mPtr;
 
+    /// @brief Bytes of the underlying buffer in front of mPtr.
+    std::size_t mHeadroom;
+
     /// @brief Constructor to be used by specializations.
-    explicit BufferView(std::shared_ptr<PacketBuffer> b, unsigned char *ptr,
-                        std::size_t size)
-        : mBufferPtr(b), mSize(size), mPtr{(size > 0) ? ptr : nullptr} {}
+    explicit BufferView(PacketBufferRef b, unsigned char *ptr,
+                        std::size_t size, std::size_t headroom = 0) noexcept
+        : mBufferPtr(std::move(b)), mSize(size),
+          mPtr{(size > 0 || headroom > 0) ? ptr : nullptr},
+          mHeadroom(headroom) {}
 };
 
+/// @brief Headroom suggested for receiving frames (see
+///        BufferView::getHeadroom()), enough to add outer headers in
+///        place up to a GTPv1-U encapsulation in Ethernet, while
+///        keeping the frame aligned to a cache line.
+constexpr std::size_t defaultHeadroom = 64;
+
 /**
  * @brief A **writable** BufferView
  *
@@ -562,12 +774,12 @@ class BufferView {
  * pointing to a free buffer:
  *
  * 1. get one from a PacketBufferPool (or from a
- *    PacketBufferSizedPool). Its std::shared_ptr takes care of
+ *    PacketBufferSizedPool). Its PacketBufferRef takes care of
  *    returning the underlying PacketBuffer to the buffer pool when
  *    it's not needed any more.
  *
  * 2. allocate a new one on the heap via static method
- *    `makeEthBuffer()`.  Its std::shared_ptr takes care of freeing
+ *    `makeEthBuffer()`.  Its PacketBufferRef takes care of freeing
  *    the underlying PacketBuffer when it's not needed any more.
  *    Please use this sparingly.
  *
@@ -593,15 +805,39 @@ class BufferWritableView : public BufferView {
     /// Such object is pretty useless, but this allows declaring a
     /// BufferWritableView that can be assigned to in a subsequent
     /// moment.
-    BufferWritableView() noexcept : BufferView(nullptr, nullptr, 0) {}
+    BufferWritableView() noexcept : BufferView() {}
+
+    /// Constructor from a PacketBufferRef.
+    ///
+    /// The BufferWritableView comprises all the PacketBuffer.
+    ///
+    /// When the reference is null, construct an empty BufferWritableView
+    explicit BufferWritableView(PacketBufferRef b) noexcept
+        : BufferView(std::move(b)) {}
+
+    /// Constructor from a PacketBufferRef, leaving the first
+    /// `headroom` bytes of the PacketBuffer in front of the
+    /// BufferWritableView (see getHeadroom()).
+    ///
+    /// The BufferWritableView comprises the rest of the PacketBuffer:
+    /// `headroom` must not be larger than it.
+    BufferWritableView(PacketBufferRef b, std::size_t headroom) noexcept
+        : BufferView(std::move(b)) {
+        mPtr += headroom;
+        mSize -= headroom;
+        mHeadroom = headroom;
+    }
 
     /// Constructor from a std::shared_ptr<PacketBuffer>.
     ///
     /// The BufferWritableView comprises all the PacketBuffer.
     ///
     /// When the shared pointer is null, construct an empty BufferWritableView
+    ///
+    /// @note This allocates a wrapper around the std::shared_ptr:
+    ///       prefer the PacketBufferRef constructor.
     explicit BufferWritableView(std::shared_ptr<PacketBuffer> b)
-        : BufferView(b, (b ? b->data() : nullptr), (b ? b->size() : 0)) {}
+        : BufferView(std::move(b)) {}
 
     ///@}
 
@@ -620,23 +856,21 @@ class BufferWritableView : public BufferView {
     /// @param length length of the buffer.
     static BufferWritableView
     makeNonOwningBufferWritableView(unsigned char *ptr, std::size_t length) {
-        return BufferWritableView(nullptr, ptr, length);
+        return BufferWritableView(PacketBufferRef(), ptr, length);
     }
 
     /// @brief Allocate on the heap a BufferWritableView suitable for
     ///        storing a Ethernet Frame.
     static BufferWritableView makeEthBuffer() {
-        auto pd = std::make_shared<PacketBufferArrayBased<66500>>();
-        auto pb = std::static_pointer_cast<PacketBuffer>(pd);
-        return BufferWritableView(pb);
+        return BufferWritableView(
+            PacketBufferRef(new PacketBufferArrayBased<66500>()));
     }
 
     /// @brief Allocate on the heap a BufferWritableView suitable for
     ///        storing a IPv4 packet.
     static BufferWritableView makeIPv4Buffer() {
-        auto pd = std::make_shared<PacketBufferArrayBased<66500>>();
-        auto pb = std::static_pointer_cast<PacketBuffer>(pd);
-        return BufferWritableView(pb);
+        return BufferWritableView(
+            PacketBufferRef(new PacketBufferArrayBased<66500>()));
     }
 
     ///@}
@@ -677,7 +911,8 @@ class BufferWritableView : public BufferView {
 
     BufferWritableView getSub(std::size_t offset, std::size_t len) const {
         throwExceptionIfOutOfBounds(NETWORKLIB_CURRENT_FUNCTION, offset, len);
-        return BufferWritableView(mBufferPtr, mPtr + offset, len);
+        return BufferWritableView(mBufferPtr, mPtr + offset, len,
+                                  mHeadroom + offset);
     }
 
     /// @brief Get a new BufferWritableView contained inside a
@@ -702,7 +937,43 @@ class BufferWritableView : public BufferView {
             throw std::runtime_error(err.str());
         }
 
-        return BufferWritableView(mBufferPtr, mPtr + offset, mSize - offset);
+        return BufferWritableView(mBufferPtr, mPtr + offset, mSize - offset,
+                                  mHeadroom + offset);
+    }
+
+    /// @brief Get a new BufferWritableView starting `n` bytes before
+    ///        this one, in its headroom, up to the same end: the room
+    ///        to write a header in front of a packet, without copying
+    ///        the packet.
+    ///
+    /// The new BufferWritableView shares its buffer with its parent
+    /// BufferWritableView, and has `n` bytes less of headroom.
+    ///
+    /// Throw std::out_of_range if the headroom is smaller than `n`.
+    BufferWritableView prepend(std::size_t n) const {
+        if (n > mHeadroom) {
+            // Throw exception
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION << ": can't prepend " << n
+                << " bytes (headroom: " << mHeadroom << ")";
+            throw std::out_of_range(err.str());
+        }
+
+        return BufferWritableView(mBufferPtr, mPtr - n, mSize + n,
+                                  mHeadroom - n);
+    }
+
+    /// @brief Get write access to the data of a BufferView, and its
+    ///        headroom.
+    ///
+    /// This is meant for the last stage of a processing chain, which
+    /// gets packets as BufferView objects, but owns them at that
+    /// point, so it can e.g. encapsulate them in place (see
+    /// GTPv1UIPv4Encap::initInPlace()). Nothing else should be
+    /// reading the data, or the headroom, at the same time.
+    static BufferWritableView makeWritable(const BufferView &view) noexcept {
+        return BufferWritableView(view.mBufferPtr, view.mPtr, view.mSize,
+                                  view.mHeadroom);
     }
 
     ///@name Data setters (checking bounds)
@@ -899,9 +1170,10 @@ class BufferWritableView : public BufferView {
 
   protected:
     /// @brief An ad-hoc constructor
-    explicit BufferWritableView(std::shared_ptr<PacketBuffer> b,
-                                unsigned char *ptr, std::size_t size)
-        : BufferView(b, ptr, size) {}
+    explicit BufferWritableView(PacketBufferRef b, unsigned char *ptr,
+                                std::size_t size,
+                                std::size_t headroom = 0) noexcept
+        : BufferView(std::move(b), ptr, size, headroom) {}
 };
 
 /**
@@ -912,18 +1184,51 @@ class BufferWritableView : public BufferView {
  * automatically returned to the pool when they are not needed any
  * more.
  *
+ * The pool isn't thread safe: buffers must be got and released (i.e.
+ * their last view destroyed) by the same thread. Otherwise, use a
+ * ConcurrentPacketBufferSizedPool.
+ *
+ * The pool keeps statistics (see getStats()), which any thread can
+ * read. With allocation tracking enabled, it also records where each
+ * buffer in use was got, to find leaks or views kept for too long
+ * (see getOutstandingBuffers()).
+ *
+ * Views can be given out with some headroom (see
+ * BufferView::getHeadroom()), e.g. for receiving frames to be
+ * encapsulated in place.
+ *
  * @param s The desired size of the PacketBuffer
  */
 template <std::size_t s> class PacketBufferSizedPool {
   public:
+    /// @brief Size of the PacketBuffer objects of the pool, headroom
+    ///        included.
+    static constexpr std::size_t bufferSize = s;
+
     /// @brief Default constructor
     ///
     /// @param initial_capacity The initial capacity of the pool.
-    PacketBufferSizedPool(std::size_t initial_capacity = 16)
-        : mPool(initial_capacity) {
+    ///
+    /// @param headroom Bytes left in front of the views given out
+    ///        (e.g. defaultHeadroom).
+    ///
+    /// Throw std::invalid_argument if the headroom doesn't leave room
+    /// for anything in the buffers.
+    PacketBufferSizedPool(std::size_t initial_capacity = 16,
+                          std::size_t headroom = 0)
+        : mPool(initial_capacity), mCapacity(initial_capacity),
+          mHeadroom(headroom) {
+        if (headroom >= s) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION << ": headroom " << headroom
+                << " leaves no room in buffers of " << s << " bytes";
+            throw std::invalid_argument(err.str());
+        }
+
         // The pool already contains its initial capacity.  Let's
         // fix the free deque, just as growBy() would do.
         for (auto &i : mPool) {
+            i.mPool = this;
             mFree.push_back(&i);
         }
     }
@@ -933,8 +1238,15 @@ template <std::size_t s> class PacketBufferSizedPool {
     /// Release to the pool is automatic when all the
     /// BufferWritableView and BufferView objects referring to the
     /// PacketBuffer are destroyed..
-    BufferWritableView getBufferWritableView() {
-        return BufferWritableView(getPacketBuffer());
+    ///
+    /// The view comprises the whole PacketBuffer but the headroom
+    /// given on construction.
+    ///
+    /// @param site Where the buffer is got (the caller, by default),
+    ///        recorded if allocation tracking is enabled.
+    BufferWritableView
+    getBufferWritableView(AllocationSite site = NETWORKLIB_ALLOCATION_SITE) {
+        return BufferWritableView(getPacketBuffer(site), mHeadroom);
     }
 
     ///@name Info on the pool
@@ -948,35 +1260,108 @@ template <std::size_t s> class PacketBufferSizedPool {
     //        currently in the pool.
     std::size_t free_count() const { return mFree.size(); }
 
+    /// @brief Return the headroom of the views given out.
+    std::size_t getHeadroom() const { return mHeadroom; }
+
+    /// @brief Get a snapshot of the pool statistics.
+    ///
+    /// Unlike other methods, it can be called by any thread.
+    PoolStats getStats() const {
+        PoolStats stats;
+
+        mCounters.addTo(stats);
+        stats.capacity = mCapacity.load(std::memory_order_relaxed);
+        stats.highWaterMark = mHighWaterMark.load(std::memory_order_relaxed);
+
+        return stats;
+    }
+
+    ///@}
+
+    ///@name Allocation tracking
+    ///@{
+
+    /// @brief Enable/disable recording where and when each buffer is
+    ///        got (see getDefaultAllocationTracking() for the
+    ///        default).
+    void enableAllocationTracking(bool enable) { mTracking = enable; }
+
+    /// @brief Return whether allocation tracking is enabled.
+    bool enableAllocationTracking() const { return mTracking; }
+
+    /// @brief Return the buffers in use, with their allocation site
+    ///        and age when allocation tracking is enabled.
+    std::vector<OutstandingBuffer> getOutstandingBuffers() const {
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<OutstandingBuffer> result;
+
+        for (const auto &b : mPool) {
+            if (b.mInUse) {
+                OutstandingBuffer o;
+                o.site = b.mSite;
+
+                if (b.mSite.file != nullptr) {
+                    o.age = now - b.mSince;
+                }
+
+                result.push_back(o);
+            }
+        }
+
+        return result;
+    }
+
     ///@}
 
   private:
-    using PacketBufferImplType = PacketBufferArrayBased<s>;
+    // A PacketBuffer going back to its pool when the last reference
+    // to it is dropped. As buffers never leave the pool thread, a
+    // plain reference count is enough.
+    class PooledBuffer : public PacketBufferArrayBased<s> {
+      public:
+        PooledBuffer() noexcept { this->setThreadSafeReferences(false); }
 
-    std::deque<PacketBufferImplType *> mFree;
-    std::deque<PacketBufferImplType> mPool;
+        PacketBufferSizedPool *mPool = nullptr;
+
+        // Allocation tracking
+        bool mInUse = false;
+        AllocationSite mSite;
+        std::chrono::steady_clock::time_point mSince;
+
+      protected:
+        void recycle() noexcept override { mPool->releaseToPool(this); }
+    };
+
+    std::deque<PooledBuffer *> mFree;
+    std::deque<PooledBuffer> mPool;
+
+    // Statistics (mCapacity mirrors mPool.size(), for other threads)
+    PoolCounters mCounters;
+    std::atomic<std::size_t> mCapacity{0};
+    std::atomic<std::size_t> mHighWaterMark{0};
+    bool mTracking = getDefaultAllocationTracking();
+
+    const std::size_t mHeadroom;
 
     void growBy(std::size_t size) {
         for (std::size_t i = 0; i < size; ++i) {
             // Add a new free buffer
             mPool.emplace_back();
+            mPool.back().mPool = this;
             mFree.push_back(&(mPool.back()));
         }
-    }
 
-    void releaseToPool(PacketBuffer *p) {
-        auto *p1 = dynamic_cast<PacketBufferImplType *>(p);
+        mCounters.countGrowth();
+        mCapacity.store(mPool.size(), std::memory_order_relaxed);
+    }
 
-        if (p1 == nullptr) {
-            // Note: this should be completely impossible, as
-            //       this method is private, thus the release of
-            //       buffers can happen only through our
-            //       custom deleter;
-            return;
-        }
+    void releaseToPool(PooledBuffer *p) noexcept {
+        p->mInUse = false;
+        p->mSite = AllocationSite();
+        mCounters.countFree();
 
         try {
-            mFree.push_back(p1);
+            mFree.push_back(p);
         } catch (...) {
             // Don't allow exceptions to propagate, as that would
             // result in a call to std::terminate().
@@ -984,22 +1369,49 @@ template <std::size_t s> class PacketBufferSizedPool {
     }
 
     // Get a PacketBuffer from the pool
-    std::shared_ptr<PacketBuffer> getPacketBuffer() {
+    PacketBufferRef getPacketBuffer(const AllocationSite &site) {
+        const bool sample = mCounters.shouldSampleLatency();
+        const auto start = sample ? std::chrono::steady_clock::now()
+                                  : std::chrono::steady_clock::time_point();
+
         if (mFree.empty()) {
             growBy(1);
         }
 
         // Get a buffer from the pool
-        PacketBuffer *p = mFree.back();
+        PooledBuffer *p = mFree.back();
         mFree.pop_back();
 
-        // Return a std::shared_ptr with a custom deleter
-        // which returns the buffer to the pool
-        return std::shared_ptr<PacketBuffer>(
-            p, [this](PacketBuffer *p) { this->releaseToPool(p); });
+        p->mInUse = true;
+
+        if (mTracking) {
+            p->mSite = site;
+            p->mSince = std::chrono::steady_clock::now();
+        }
+
+        mCounters.countAllocation();
+
+        // Only this thread changes it, so there's no race.
+        const std::size_t inUse = mPool.size() - mFree.size();
+
+        if (inUse > mHighWaterMark.load(std::memory_order_relaxed)) {
+            mHighWaterMark.store(inUse, std::memory_order_relaxed);
+        }
+
+        if (sample) {
+            mCounters.recordAllocationLatency(std::chrono::steady_clock::now() -
+                                              start);
+        }
+
+        // The buffer comes back to the pool via PooledBuffer::recycle()
+        // when the last reference is dropped.
+        return PacketBufferRef(p);
     }
 };
 
+template <std::size_t s>
+constexpr std::size_t PacketBufferSizedPool<s>::bufferSize;
+
 /// @brief A type for a pool of PacketBuffer objects sized for common
 ///        needs.
 ///
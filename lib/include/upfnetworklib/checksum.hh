@@ -0,0 +1,125 @@
+#ifndef UPFNETWORKLIB_CHECKSUM_HH
+#define UPFNETWORKLIB_CHECKSUM_HH
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint16_t, std::uint32_t and std::uint64_t
+#include <cstdint>
+
+namespace UPF {
+namespace NetworkLib {
+
+///@name Internet checksum (RFC 1071)
+///
+/// Helpers to compute and update the one's complement checksums of
+/// IPv4, UDP, TCP, etc.
+///
+///@{
+
+/// @brief Sum the given data as 16-bit integers stored in **network
+///        order**, as if a ``0x00`` byte was appended when the size
+///        is odd (see BufferView::getSum16()).
+///
+/// The sum isn't folded: it's exactly the sum of all values, modulo
+/// 2^32 (which can't overflow for anything up to a 128 KB buffer).
+///
+/// It uses the widest SIMD instructions the CPU supports (AVX-512,
+/// AVX2 or SSE2, see getSum16Implementation()), picked on first use,
+/// and falls back to plain C++ otherwise.
+std::uint32_t sum16(const unsigned char *data, std::size_t size);
+
+/// @brief Same as sum16(), but never uses SIMD instructions.
+std::uint32_t sum16Scalar(const unsigned char *data, std::size_t size);
+
+/// @brief Return the name of the implementation used by sum16():
+///        ``"avx512"``, ``"avx2"``, ``"sse2"`` or ``"scalar"``.
+const char *getSum16Implementation();
+
+/// @brief Fold a sum of 16-bit values (e.g. as returned by sum16())
+///        into 16 bits, with end-around carry.
+inline std::uint16_t foldSum16(std::uint64_t sum) {
+    while ((sum >> 16) != 0) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return static_cast<std::uint16_t>(sum);
+}
+
+/// @brief Update a checksum after a 16-bit field it covers changed
+///        from `oldValue` to `newValue`, without summing the data
+///        again (RFC 1624, eqn. 3: ``HC' = ~(~HC + ~m + m')``).
+///
+/// E.g. after changing the IPv4 total length, or the identification
+/// field:
+///
+///     const auto old = packet.getUint16At(2);
+///     packet.setUint16At(2, newLength);
+///     packet.setUint16At(10, updateChecksum16(packet.getUint16At(10),
+///                                             old, newLength));
+///
+/// @note A UDP checksum of ``0x0000`` means "no checksum": don't
+///       update it, and send a resulting ``0x0000`` as ``0xFFFF``.
+inline std::uint16_t updateChecksum16(std::uint16_t checksum,
+                                      std::uint16_t oldValue,
+                                      std::uint16_t newValue) {
+    const std::uint32_t sum =
+        static_cast<std::uint16_t>(~checksum) +
+        static_cast<std::uint16_t>(~oldValue) + std::uint32_t{newValue};
+
+    return static_cast<std::uint16_t>(~foldSum16(sum));
+}
+
+/// @brief Update a checksum after a 32-bit field it covers (e.g. a
+///        IPv4 address, which also affects the UDP/TCP checksum via
+///        the pseudo-header) changed from `oldValue` to `newValue`.
+///
+/// See updateChecksum16().
+inline std::uint16_t updateChecksum32(std::uint16_t checksum,
+                                      std::uint32_t oldValue,
+                                      std::uint32_t newValue) {
+    const std::uint32_t sum =
+        static_cast<std::uint16_t>(~checksum) +
+        static_cast<std::uint16_t>(~(oldValue >> 16)) +
+        static_cast<std::uint16_t>(~oldValue) + (newValue >> 16) +
+        (newValue & 0xFFFF);
+
+    return static_cast<std::uint16_t>(~foldSum16(sum));
+}
+
+///@}
+
+///@name CRC32c (RFC 3309)
+///
+/// The CRC used by SCTP (and iSCSI), with the Castagnoli polynomial.
+///
+///@{
+
+/// @brief Compute the CRC32c of the given data.
+///
+/// A CRC can be computed piecewise, passing the result of the
+/// previous call as `crc`, e.g.:
+///
+///     std::uint32_t crc = crc32c(header, headerSize);
+///     crc = crc32c(payload, payloadSize, crc);
+///
+/// It uses the SSE4.2 ``crc32`` instruction when available (see
+/// getCRC32cImplementation()), and falls back to plain C++
+/// otherwise.
+std::uint32_t crc32c(const unsigned char *data, std::size_t size,
+                     std::uint32_t crc = 0);
+
+/// @brief Same as crc32c(), but never uses the ``crc32`` instruction.
+std::uint32_t crc32cSoftware(const unsigned char *data, std::size_t size,
+                             std::uint32_t crc = 0);
+
+/// @brief Return the name of the implementation used by crc32c():
+///        ``"sse4.2"`` or ``"software"``.
+const char *getCRC32cImplementation();
+
+///@}
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
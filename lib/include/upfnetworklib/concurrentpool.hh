@@ -0,0 +1,693 @@
+#ifndef UPFNETWORKLIB_CONCURRENTPOOL_HH
+#define UPFNETWORKLIB_CONCURRENTPOOL_HH
+
+// For PacketBufferArrayBased and BufferWritableView
+#include <upfnetworklib/buffers.hh>
+
+// For PoolStats and PoolCounters
+#include <upfnetworklib/poolstats.hh>
+
+// For std::atomic
+#include <atomic>
+
+// For std::chrono::steady_clock
+#include <chrono>
+
+// For std::function
+#include <functional>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint32_t and std::uint64_t
+#include <cstdint>
+
+// For std::unique_ptr
+#include <memory>
+
+// For std::mutex and std::lock_guard
+#include <mutex>
+
+// For placement new
+#include <new>
+
+// For std::ostringstream
+#include <sstream>
+
+// For std::invalid_argument and std::runtime_error
+#include <stdexcept>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace NetworkLib {
+
+/// @brief Maximum number of threads having a per-thread cache in
+///        ConcurrentPacketBufferSizedPool objects at the same time.
+///        Further threads go straight to the shared free list.
+constexpr std::size_t maxThreadCacheSlots = 128;
+
+/// @brief Value returned by getThisThreadCacheSlot() when no slot is
+///        available.
+constexpr std::size_t noThreadCacheSlot = maxThreadCacheSlots;
+
+/// @brief Get the per-thread cache slot (0 to maxThreadCacheSlots - 1)
+///        of the calling thread, or noThreadCacheSlot.
+///
+/// A slot is assigned to a thread on its first call, and given back
+/// when the thread exits, so that it can be reused by another thread.
+/// Calls made while the thread exits after that (e.g. from destructors
+/// of thread_local objects) get noThreadCacheSlot.
+std::size_t getThisThreadCacheSlot() noexcept;
+
+/// @brief Take the given cache slot, if no thread has it.
+///
+/// This lets a pool reclaim the caches left by exited threads.
+///
+/// @return false if the slot is already taken.
+bool tryTakeThreadCacheSlot(std::size_t slot) noexcept;
+
+/// @brief Give back a slot taken via tryTakeThreadCacheSlot().
+void releaseThreadCacheSlot(std::size_t slot) noexcept;
+
+/// @brief Allocate `size` bytes of memory for pool buffers, in pages
+///        of their own (i.e. page-aligned, and shared with no other
+///        allocation), so that they can be placed on their own (see
+///        ConcurrentPoolConfig::placeMemory).
+///
+/// Throw std::bad_alloc on failure.
+void *allocatePoolMemory(std::size_t size);
+
+/// @brief Free memory got via allocatePoolMemory().
+void freePoolMemory(void *memory) noexcept;
+
+/**
+ * @brief Configuration of a ConcurrentPacketBufferSizedPool.
+ */
+struct ConcurrentPoolConfig {
+    /// @brief Number of buffers allocated on construction.
+    std::size_t initialCapacity = 16;
+
+    /// @brief Hard limit on the number of buffers: once reached,
+    ///        getting a buffer fails rather than allocating.
+    ///
+    /// Free buffers cached by a thread (up to
+    /// ConcurrentPacketBufferSizedPool::maxCachedPerThread each) can
+    /// only be got by that thread while it's alive: account for them
+    /// when sizing the pool, e.g. by adding that many buffers per
+    /// thread using it.
+    std::size_t maxCapacity = 4096;
+
+    /// @brief Number of buffers allocated at once when the pool needs
+    ///        to grow.
+    std::size_t growBy = 64;
+
+    /// @brief Bytes left in front of the views given out (see
+    ///        BufferView::getHeadroom()), e.g. defaultHeadroom. Must
+    ///        be smaller than the buffers.
+    std::size_t headroom = 0;
+
+    /// @brief If set, called with the memory of each new chunk of
+    ///        buffers (page-aligned) before it's first touched, e.g.
+    ///        to take it from the NUMA node of the NIC the buffers
+    ///        are used with:
+    ///
+    ///     config.placeMemory = [node](void *memory, std::size_t size) {
+    ///         RawSocketsUtil::preferNUMANode(memory, size, node);
+    ///     };
+    ///
+    /// Otherwise, memory comes from the NUMA node of the thread
+    /// growing the pool (the one constructing it, for the initial
+    /// capacity).
+    std::function<void(void *memory, std::size_t size)> placeMemory;
+};
+
+/**
+ * @brief A thread-safe pool of PacketBuffer objects of the given size.
+ *
+ * It gives out BufferWritableView objects just like
+ * PacketBufferSizedPool, but buffers can be got and released by any
+ * thread (e.g. got by a capture thread, released by a worker).
+ *
+ * Free buffers are kept in a lock-free stack shared by all threads,
+ * and in a small cache (a "magazine") per thread: threads mostly get
+ * and release buffers from/to their own magazine, moving buffers
+ * from/to the shared stack in bulk, with a single atomic operation,
+ * when it's empty/full.
+ *
+ * The pool grows in steps of ConcurrentPoolConfig::growBy buffers, up
+ * to ConcurrentPoolConfig::maxCapacity: after that
+ * tryGetBufferWritableView() returns an empty view and
+ * getBufferWritableView() throws. Note that this may happen while
+ * other threads still have free buffers in their magazines (up to
+ * maxCachedPerThread each): magazines of live threads are only
+ * touched by their owners.
+ *
+ * PacketBufferSizedPool is still the faster choice for buffers which
+ * never leave a single thread.
+ *
+ * Statistics (see getStats()) are kept per thread, in the same cache
+ * lines as magazines, and summed up when read. Allocation tracking
+ * works as in PacketBufferSizedPool.
+ *
+ * @note The pool must outlive all the views on its buffers. Buffers
+ *       left in the magazine of a thread which exits are reused by
+ *       the next thread taking its cache slot (see
+ *       getThisThreadCacheSlot()), or reclaimed once the pool is at
+ *       its hard capacity.
+ *
+ * @param s The desired size of the PacketBuffer
+ */
+template <std::size_t s> class ConcurrentPacketBufferSizedPool {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Constructor.
+    ///
+    /// Throw std::invalid_argument if the configuration isn't valid.
+    explicit ConcurrentPacketBufferSizedPool(
+        const ConcurrentPoolConfig &config = ConcurrentPoolConfig())
+        : mConfig(checkConfig(config)),
+          mBuffers(new PooledBuffer *[config.maxCapacity]),
+          mNext(new std::atomic<std::uint32_t>[config.maxCapacity]),
+          mMagazines(maxThreadCacheSlots) {
+        grow(mConfig.initialCapacity);
+    }
+
+    ~ConcurrentPacketBufferSizedPool() = default;
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    ConcurrentPacketBufferSizedPool(const ConcurrentPacketBufferSizedPool &) =
+        delete;
+    ConcurrentPacketBufferSizedPool &
+    operator=(const ConcurrentPacketBufferSizedPool &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    ConcurrentPacketBufferSizedPool(ConcurrentPacketBufferSizedPool &&) =
+        delete;
+    ConcurrentPacketBufferSizedPool &
+    operator=(ConcurrentPacketBufferSizedPool &&) = delete;
+    ///@}
+
+    /// @brief Get a BufferWritableView from the pool.
+    ///
+    /// Release to the pool is automatic when all the
+    /// BufferWritableView and BufferView objects referring to the
+    /// PacketBuffer are destroyed, by whatever thread.
+    ///
+    /// The view comprises the whole PacketBuffer but the headroom
+    /// (see ConcurrentPoolConfig::headroom).
+    ///
+    /// Throw std::runtime_error if the pool is exhausted.
+    ///
+    /// @param site Where the buffer is got (the caller, by default),
+    ///        recorded if allocation tracking is enabled.
+    BufferWritableView
+    getBufferWritableView(AllocationSite site = NETWORKLIB_ALLOCATION_SITE) {
+        BufferWritableView b = tryGetBufferWritableView(site);
+
+        if (b.empty()) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION << ": pool exhausted ("
+                << mConfig.maxCapacity << " buffers in use)";
+            throw std::runtime_error(err.str());
+        }
+
+        return b;
+    }
+
+    /// @brief Get a BufferWritableView from the pool, or an empty one
+    ///        if the pool is exhausted.
+    BufferWritableView tryGetBufferWritableView(
+        AllocationSite site = NETWORKLIB_ALLOCATION_SITE) {
+        PoolCounters &counters = getThisThreadCounters();
+        const bool sample = counters.shouldSampleLatency();
+        const auto start = sample ? std::chrono::steady_clock::now()
+                                  : std::chrono::steady_clock::time_point();
+
+        const std::uint32_t index = getIndex();
+
+        if (index == endOfList) {
+            counters.countFailure();
+            return BufferWritableView();
+        }
+
+        PooledBuffer *p = mBuffers[index];
+
+        p->inUse.store(true, std::memory_order_relaxed);
+
+        if (mTracking.load(std::memory_order_relaxed)) {
+            p->file.store(site.file, std::memory_order_relaxed);
+            p->line.store(site.line, std::memory_order_relaxed);
+            p->since.store(
+                std::chrono::steady_clock::now().time_since_epoch().count(),
+                std::memory_order_relaxed);
+        }
+
+        counters.countAllocation();
+
+        if (sample) {
+            counters.recordAllocationLatency(std::chrono::steady_clock::now() -
+                                             start);
+        }
+
+        // The buffer comes back to the pool via PooledBuffer::recycle()
+        // when the last reference is dropped, by whatever thread.
+        return BufferWritableView(PacketBufferRef(p), mConfig.headroom);
+    }
+
+    /// @brief Maximum number of free buffers cached by each thread
+    ///        (see ConcurrentPoolConfig::maxCapacity).
+    static constexpr std::size_t maxCachedPerThread = 32;
+
+    ///@name Info on the pool
+    ///@{
+
+    /// @brief Return how many PacketBuffer instances have been
+    ///        allocated so far (both busy and free).
+    std::size_t capacity() const {
+        return mCapacity.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Return the hard limit on capacity().
+    std::size_t maxCapacity() const { return mConfig.maxCapacity; }
+
+    /// @brief Get a snapshot of the pool statistics.
+    ///
+    /// Counters of different threads aren't read atomically all
+    /// together: e.g. a buffer may show up as freed, but not yet as
+    /// allocated.
+    PoolStats getStats() const {
+        PoolStats stats;
+
+        for (const auto &m : mMagazines) {
+            m.counters.addTo(stats);
+        }
+
+        mSharedCounters.addTo(stats);
+        stats.capacity = capacity();
+        stats.highWaterMark = mHighWaterMark.load(std::memory_order_relaxed);
+
+        return stats;
+    }
+
+    ///@}
+
+    ///@name Allocation tracking
+    ///@{
+
+    /// @brief Enable/disable recording where and when each buffer is
+    ///        got (see getDefaultAllocationTracking() for the
+    ///        default).
+    void enableAllocationTracking(bool enable) {
+        mTracking.store(enable, std::memory_order_relaxed);
+    }
+
+    /// @brief Return whether allocation tracking is enabled.
+    bool enableAllocationTracking() const {
+        return mTracking.load(std::memory_order_relaxed);
+    }
+
+    /// @brief Return the buffers in use (including those being got
+    ///        or released at the same time by other threads), with
+    ///        their allocation site and age when allocation tracking
+    ///        is enabled.
+    std::vector<OutstandingBuffer> getOutstandingBuffers() const {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point now = Clock::now();
+        const std::size_t count = capacity();
+        std::vector<OutstandingBuffer> result;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const PooledBuffer &b = *mBuffers[i];
+
+            if (!b.inUse.load(std::memory_order_relaxed)) {
+                continue;
+            }
+
+            OutstandingBuffer o;
+            o.site.file = b.file.load(std::memory_order_relaxed);
+            o.site.line = b.line.load(std::memory_order_relaxed);
+
+            if (o.site.file != nullptr) {
+                o.age = now - Clock::time_point(Clock::duration(
+                                  b.since.load(std::memory_order_relaxed)));
+            }
+
+            result.push_back(o);
+        }
+
+        return result;
+    }
+
+    ///@}
+
+  private:
+    // Marks the end of a list of buffers.
+    static constexpr std::uint32_t endOfList = 0xFFFFFFFF;
+
+    // Buffers in a magazine, and buffers moved at once between a
+    // magazine and the shared stack.
+    static constexpr std::size_t magazineSize = maxCachedPerThread;
+    static constexpr std::size_t transferSize = magazineSize / 2;
+
+    // A PacketBuffer knowing its own index, going back to its pool
+    // when the last reference to it is dropped.
+    class PooledBuffer : public PacketBufferArrayBased<s> {
+      public:
+        ConcurrentPacketBufferSizedPool *pool = nullptr;
+        std::uint32_t index = 0;
+
+        // Allocation tracking (read by any thread)
+        std::atomic<bool> inUse{false};
+        std::atomic<const char *> file{nullptr};
+        std::atomic<unsigned int> line{0};
+        std::atomic<std::chrono::steady_clock::rep> since{0};
+
+      protected:
+        void recycle() noexcept override { pool->releaseToPool(this); }
+    };
+
+    // A per-thread cache, with its statistics, padded so that two of
+    // them never share a cache line.
+    struct Magazine {
+        std::size_t count = 0;
+        std::uint32_t indexes[magazineSize];
+        PoolCounters counters;
+        char padding[64];
+    };
+
+    ConcurrentPoolConfig mConfig;
+
+    // Buffers by index, and the link to the next buffer in the
+    // shared stack. Entries are written once, under mGrowMutex,
+    // before being published via mHead.
+    std::unique_ptr<PooledBuffer *[]> mBuffers;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> mNext;
+
+    // Top of the shared stack: the index of the first buffer in the
+    // lower 32 bits, and a counter bumped by each change in the upper
+    // ones (preventing the ABA problem).
+    std::atomic<std::uint64_t> mHead{endOfList};
+
+    std::vector<Magazine> mMagazines;
+
+    // Destroys a chunk of buffers made by makeChunk().
+    struct ChunkDeleter {
+        std::size_t count;
+
+        void operator()(PooledBuffer *chunk) const noexcept {
+            for (std::size_t i = 0; i < count; ++i) {
+                chunk[i].~PooledBuffer();
+            }
+
+            freePoolMemory(chunk);
+        }
+    };
+
+    using Chunk = std::unique_ptr<PooledBuffer, ChunkDeleter>;
+
+    std::mutex mGrowMutex;
+    std::atomic<std::size_t> mCapacity{0};
+    std::vector<Chunk> mChunks;
+
+    // Statistics: counters of threads with no cache slot, buffers in
+    // the shared stack, and the high-water mark of the others.
+    PoolCounters mSharedCounters{true};
+    std::atomic<std::size_t> mStackCount{0};
+    std::atomic<std::size_t> mHighWaterMark{0};
+    std::atomic<bool> mTracking{getDefaultAllocationTracking()};
+
+    static const ConcurrentPoolConfig &
+    checkConfig(const ConcurrentPoolConfig &config) {
+        if (config.maxCapacity == 0 || config.maxCapacity >= endOfList ||
+            config.initialCapacity > config.maxCapacity ||
+            config.growBy == 0 || config.headroom >= s) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": invalid configuration (initial capacity "
+                << config.initialCapacity << ", max capacity "
+                << config.maxCapacity << ", grow by " << config.growBy
+                << ", headroom " << config.headroom << " in buffers of "
+                << s << " bytes)";
+            throw std::invalid_argument(err.str());
+        }
+
+        return config;
+    }
+
+    static std::uint64_t makeHead(std::uint64_t old, std::uint32_t index) {
+        return ((old & 0xFFFFFFFF00000000ULL) + 0x100000000ULL) | index;
+    }
+
+    // Push the list first -> ... -> last, of `count` buffers, on the
+    // shared stack.
+    void pushList(std::uint32_t first, std::uint32_t last,
+                  std::size_t count) noexcept {
+        std::uint64_t head = mHead.load(std::memory_order_relaxed);
+
+        do {
+            mNext[last].store(static_cast<std::uint32_t>(head),
+                              std::memory_order_relaxed);
+        } while (!mHead.compare_exchange_weak(head, makeHead(head, first),
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+
+        mStackCount.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    // Pop up to `count` buffers from the shared stack into `out`,
+    // returning how many were popped.
+    std::size_t popList(std::uint32_t *out, std::size_t count) noexcept {
+        std::uint64_t head = mHead.load(std::memory_order_acquire);
+
+        for (;;) {
+            std::uint32_t index = static_cast<std::uint32_t>(head);
+            std::size_t n = 0;
+
+            // The links may be changed by other threads while walking
+            // them: in that case the head has changed too, and the
+            // exchange below fails.
+            while (n < count && index != endOfList) {
+                out[n++] = index;
+                index = mNext[index].load(std::memory_order_relaxed);
+            }
+
+            if (mHead.compare_exchange_weak(head, makeHead(head, index),
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                updateHighWaterMark(n);
+                return n;
+            }
+        }
+    }
+
+    // Make a chunk of `count` buffers, in memory placed as told by
+    // the configuration.
+    Chunk makeChunk(std::size_t count) {
+        const std::size_t size = count * sizeof(PooledBuffer);
+        void *memory = allocatePoolMemory(size);
+
+        if (mConfig.placeMemory) {
+            try {
+                mConfig.placeMemory(memory, size);
+            } catch (...) {
+                freePoolMemory(memory);
+                throw;
+            }
+        }
+
+        PooledBuffer *chunk = static_cast<PooledBuffer *>(memory);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            new (&chunk[i]) PooledBuffer();
+        }
+
+        return Chunk(chunk, ChunkDeleter{count});
+    }
+
+    // Allocate up to `count` more buffers, within the hard capacity,
+    // pushing them on the shared stack. Return false if the pool
+    // can't grow.
+    bool grow(std::size_t count) {
+        std::lock_guard<std::mutex> lock(mGrowMutex);
+
+        const std::size_t capacity = mCapacity.load(std::memory_order_relaxed);
+
+        // Another thread may have grown the pool in the meantime.
+        if (static_cast<std::uint32_t>(
+                mHead.load(std::memory_order_relaxed)) != endOfList) {
+            return true;
+        }
+
+        if (count > mConfig.maxCapacity - capacity) {
+            count = mConfig.maxCapacity - capacity;
+        }
+
+        if (count == 0) {
+            return false;
+        }
+
+        Chunk chunk = makeChunk(count);
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::uint32_t index = static_cast<std::uint32_t>(capacity + i);
+            PooledBuffer &b = chunk.get()[i];
+            b.pool = this;
+            b.index = index;
+            mBuffers[index] = &b;
+            mNext[index].store((i + 1 < count) ? index + 1 : endOfList,
+                               std::memory_order_relaxed);
+        }
+
+        mChunks.push_back(std::move(chunk));
+        mCapacity.store(capacity + count, std::memory_order_relaxed);
+
+        pushList(static_cast<std::uint32_t>(capacity),
+                 static_cast<std::uint32_t>(capacity + count - 1), count);
+
+        getThisThreadCounters().countGrowth();
+
+        return true;
+    }
+
+    // Account for `popped` buffers just taken off the shared stack:
+    // all the others are in use, or cached by threads.
+    void updateHighWaterMark(std::size_t popped) noexcept {
+        if (popped == 0) {
+            return;
+        }
+
+        const std::size_t stackCount =
+            mStackCount.fetch_sub(popped, std::memory_order_relaxed) - popped;
+
+        raiseHighWaterMark(mHighWaterMark,
+                           mCapacity.load(std::memory_order_relaxed) -
+                               stackCount);
+    }
+
+    // Get the counters of the calling thread.
+    PoolCounters &getThisThreadCounters() noexcept {
+        const std::size_t slot = getThisThreadCacheSlot();
+
+        return (slot == noThreadCacheSlot) ? mSharedCounters
+                                           : mMagazines[slot].counters;
+    }
+
+    // Push the first `count` buffers of a magazine on the shared
+    // stack.
+    void pushMagazine(Magazine &m, std::size_t count) noexcept {
+        for (std::size_t i = 0; i + 1 < count; ++i) {
+            mNext[m.indexes[i]].store(m.indexes[i + 1],
+                                      std::memory_order_relaxed);
+        }
+
+        pushList(m.indexes[0], m.indexes[count - 1], count);
+    }
+
+    // Move the buffers left in the magazines of exited threads to the
+    // shared stack. Return false if there were none.
+    bool reclaimOrphanedMagazines() noexcept {
+        bool reclaimed = false;
+
+        for (std::size_t slot = 0; slot < maxThreadCacheSlots; ++slot) {
+            if (!tryTakeThreadCacheSlot(slot)) {
+                continue;
+            }
+
+            Magazine &m = mMagazines[slot];
+
+            if (m.count != 0) {
+                pushMagazine(m, m.count);
+                m.count = 0;
+                reclaimed = true;
+            }
+
+            releaseThreadCacheSlot(slot);
+        }
+
+        return reclaimed;
+    }
+
+    // Make some buffers available on the shared stack, growing the
+    // pool or, when at its hard capacity, reclaiming buffers. Return
+    // false if there are none.
+    bool refill() {
+        return grow(mConfig.growBy) || reclaimOrphanedMagazines();
+    }
+
+    // Get the index of a free buffer, or endOfList.
+    std::uint32_t getIndex() {
+        const std::size_t slot = getThisThreadCacheSlot();
+
+        if (slot == noThreadCacheSlot) {
+            std::uint32_t index;
+
+            while (popList(&index, 1) == 0) {
+                if (!refill()) {
+                    return endOfList;
+                }
+            }
+
+            return index;
+        }
+
+        Magazine &m = mMagazines[slot];
+
+        while (m.count == 0) {
+            m.count = popList(m.indexes, transferSize);
+
+            if (m.count == 0 && !refill()) {
+                return endOfList;
+            }
+        }
+
+        return m.indexes[--m.count];
+    }
+
+    void releaseToPool(PooledBuffer *p) noexcept {
+        const std::uint32_t index = p->index;
+        const std::size_t slot = getThisThreadCacheSlot();
+
+        p->inUse.store(false, std::memory_order_relaxed);
+        p->file.store(nullptr, std::memory_order_relaxed);
+
+        if (slot == noThreadCacheSlot) {
+            mSharedCounters.countFree();
+            pushList(index, index, 1);
+            return;
+        }
+
+        Magazine &m = mMagazines[slot];
+        m.counters.countFree();
+
+        if (m.count == magazineSize) {
+            // Give back the oldest half.
+            pushMagazine(m, transferSize);
+
+            for (std::size_t i = transferSize; i < magazineSize; ++i) {
+                m.indexes[i - transferSize] = m.indexes[i];
+            }
+
+            m.count -= transferSize;
+        }
+
+        m.indexes[m.count++] = index;
+    }
+};
+
+/// @brief A type for a thread-safe pool of PacketBuffer objects sized
+///        for common needs (see PacketBufferPool).
+using ConcurrentPacketBufferPool = ConcurrentPacketBufferSizedPool<66500>;
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
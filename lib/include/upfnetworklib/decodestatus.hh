@@ -0,0 +1,149 @@
+#ifndef UPFNETWORKLIB_DECODESTATUS_HH
+#define UPFNETWORKLIB_DECODESTATUS_HH
+
+// For std::array
+#include <array>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+namespace UPF {
+namespace NetworkLib {
+
+/**
+ * @brief Result of decoding a header without exceptions.
+ *
+ * Decoders have non-throwing constructors taking a DecodeStatus as
+ * well, which they set to DecodeStatus::Ok or to the reason why the
+ * BufferView couldn't be decoded (and then the decoder mustn't be
+ * used). They are meant for the packet processing path, where
+ * malformed packets are just dropped and counted (see DropCounters),
+ * and building exceptions for each of them would be too slow.
+ */
+enum class DecodeStatus {
+    /// @brief Decoded fine.
+    Ok = 0,
+
+    ///@name Ethernet
+    ///@{
+
+    /// @brief Shorter than 14 bytes.
+    EthFrameTooShort,
+
+    /// @brief 802.1Q/802.1ad tags up to the end of the frame.
+    EthMissingEtherType,
+
+    ///@}
+
+    ///@name IPv4
+    ///@{
+
+    /// @brief Shorter than the IPv4 header.
+    IPv4TooShort,
+
+    /// @brief Version is not 4.
+    IPv4BadVersion,
+
+    /// @brief Header length and total length don't match the buffer.
+    IPv4BadLength,
+
+    ///@}
+
+    ///@name UDP and TCP
+    ///@{
+
+    /// @brief Shorter than the UDP header.
+    UDPTooShort,
+
+    /// @brief Shorter than the TCP header.
+    TCPTooShort,
+
+    ///@}
+
+    ///@name GTPv1-U
+    ///@{
+
+    /// @brief Shorter than the GTPv1-U header (with the optional
+    ///        fields, when there).
+    GTPv1UTooShort,
+
+    /// @brief Not GTPv1 (protocol type and version).
+    GTPv1UBadVersion,
+
+    /// @brief Extension header of length 0, or past the end of the
+    ///        buffer.
+    GTPv1UBadExtensionHeader,
+
+    /// @brief Message length doesn't match the buffer.
+    GTPv1UBadLength,
+
+    ///@}
+
+    ///@name SCTP
+    ///@{
+
+    /// @brief Shorter than the SCTP common header.
+    SCTPTooShort,
+
+    /// @brief Wrong CRC32c (when verified).
+    SCTPBadChecksum,
+
+    /// @brief Chunk shorter than its header, or past the end of the
+    ///        packet.
+    SCTPBadChunk,
+
+    /// @brief DATA chunk shorter than its header.
+    SCTPDataChunkTooShort,
+
+    ///@}
+
+    /// @brief S1AP PDU which can't be decoded (see S1APLib).
+    S1APBadPDU,
+};
+
+/// @brief Number of DecodeStatus values (including
+///        DecodeStatus::Ok).
+constexpr std::size_t decodeStatusCount =
+    static_cast<std::size_t>(DecodeStatus::S1APBadPDU) + 1;
+
+/**
+ * @brief Counters of packets dropped because they couldn't be
+ *        decoded, by reason.
+ *
+ * Counters only ever grow.
+ */
+class DropCounters {
+  public:
+    /// @brief Count a packet dropped for the given reason.
+    void count(DecodeStatus status) noexcept {
+        ++mCounters[static_cast<std::size_t>(status)];
+    }
+
+    /// @brief Return the packets dropped for the given reason.
+    std::uint64_t get(DecodeStatus status) const noexcept {
+        return mCounters[static_cast<std::size_t>(status)];
+    }
+
+    /// @brief Return the packets dropped for any reason.
+    std::uint64_t total() const noexcept {
+        std::uint64_t sum = 0;
+
+        for (std::size_t i = 1; i < decodeStatusCount; ++i) {
+            sum += mCounters[i];
+        }
+
+        return sum;
+    }
+
+  private:
+    // Indexed by DecodeStatus (DecodeStatus::Ok is never counted).
+    std::array<std::uint64_t, decodeStatusCount> mCounters{};
+};
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
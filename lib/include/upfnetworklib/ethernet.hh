@@ -10,6 +10,9 @@
 // For EthPacketSink
 #include <upfnetworklib/interfaces.hh>
 
+// For DecodeStatus
+#include <upfnetworklib/decodestatus.hh>
+
 // For std::array<>
 #include <array>
 
@@ -22,6 +25,9 @@
 // For iterators (needed?)
 #include <iterator>
 
+// For std::vector
+#include <vector>
+
 namespace UPF {
 namespace NetworkLib {
 
@@ -73,6 +79,22 @@ class EthFrameDecoder {
         computeDynamicData();
     }
 
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or tells why the BufferView
+    /// is unsuitable (and then the decoder mustn't be used).
+    EthFrameDecoder(const BufferView &ethdata, DecodeStatus &status) noexcept
+        : mActualEtherType(0), mDataOffset(0), mBufferView(ethdata) {
+        if (mBufferView.size() < minFrameSize) {
+            status = DecodeStatus::EthFrameTooShort;
+        } else if (!findEtherType()) {
+            status = DecodeStatus::EthMissingEtherType;
+        } else {
+            status = DecodeStatus::Ok;
+        }
+    }
+
     ///@}
 
     ///@name No default constructor.
@@ -154,6 +176,12 @@ class EthFrameDecoder {
         dstMACAddressOffset = 0,
         srcMACAddressOffset = 6,
         dynamicHeadersOffset = 12,
+
+        // The very minimum length of an Ethernet frame is
+        // - 6 bytes for dst MAC address
+        // - 6 bytes for src MAC address
+        // - 2 bytes for EtherType/802.1Q/802.1ad tags)
+        minFrameSize = 14,
     };
 
     // Dynamically-determined data (cached, thus mutable)
@@ -168,13 +196,10 @@ class EthFrameDecoder {
 
     // Helper methods
     void computeDynamicData();
+    bool findEtherType() noexcept;
     void throwIfBufferIsUnsuitable(const char *method) {
         // Catch some quirks early
-        if (mBufferView.size() < 14) {
-            // The very minimum length of an Ethernet frame is
-            // - 6 bytes for dst MAC address
-            // - 6 bytes for src MAC address
-            // - 2 bytes for EtherType/802.1Q/802.1ad tags)
+        if (mBufferView.size() < minFrameSize) {
             std::ostringstream err;
             err << method
                 << " called "
@@ -207,6 +232,32 @@ class EthPacketTap : public EthPacketSink {
         mUserData = userData;
     }
 
+    /// @brief Consume a Ethernet frame made of several segments,
+    ///        copying them into a buffer owned by the tap (and reused
+    ///        for every frame).
+    ///
+    /// The frame returned by getLastEthFrame() is then valid until
+    /// the next frame is consumed.
+    virtual void consumeEthPacketChain(
+        const BufferChain &ethData,
+        ContextUserData &userData = defaultContextUserData) override {
+        if (ethData.getSegmentCount() <= 1) {
+            consumeEthPacket(ethData.flatten(), userData);
+            return;
+        }
+
+        // Note: the buffer only grows, so it's soon big enough for
+        //       every frame.
+        if (mChainData.size() < ethData.size()) {
+            mChainData.resize(ethData.size());
+        }
+
+        ethData.copyTo(mChainData.data());
+        consumeEthPacket(BufferView::makeNonOwningBufferView(
+                             mChainData.data(), ethData.size()),
+                         userData);
+    }
+
     ///@}
 
     ///@brief Return the last consumed Ethernet frame
@@ -218,6 +269,9 @@ class EthPacketTap : public EthPacketSink {
   private:
     BufferView mEthFrame;
     ContextUserData mUserData;
+
+    // Where frames made of several segments are put together.
+    std::vector<unsigned char> mChainData;
 };
 
 } // namespace NetworkLib
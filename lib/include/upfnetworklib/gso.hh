@@ -0,0 +1,90 @@
+#ifndef UPFNETWORKLIB_GSO_HH
+#define UPFNETWORKLIB_GSO_HH
+
+#include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/interfaces.hh>
+
+// For std::size_t
+#include <cstddef>
+
+namespace UPF {
+namespace NetworkLib {
+
+/**
+ * @brief Split a IPv4 GSO super-packet (see OffloadInfo::gsoType) in
+ *        software, into the segments a device would send.
+ *
+ * It's meant for code that can't hand a super-packet over as it is,
+ * e.g. because each segment needs its own outer headers when
+ * encapsulated. TCP (GSOType::TCPV4) and UDP (GSOType::UDP_L4)
+ * segmentation are supported.
+ *
+ * Each segment gets a copy of the IPv4 and TCP/UDP headers, with the
+ * lengths, the IPv4 identification, and the TCP sequence number and
+ * flags updated as the kernel does, and complete checksums (so a
+ * partial checksum of the super-packet doesn't need completing
+ * first).
+ *
+ * Example:
+ *
+ *     const GSOSegmenter segmenter(ipv4Data, userData.offloadInfo);
+ *
+ *     for (std::size_t i = 0; i < segmenter.getSegmentCount(); ++i) {
+ *         const BufferWritableView segment =
+ *             segmenter.writeSegment(i, buffer);
+ *         // ...
+ *     }
+ *
+ * It keeps the super-packet alive, and doesn't allocate anything.
+ */
+class GSOSegmenter {
+  public:
+    ///@name Constructors
+    ///@{
+
+    /// @brief Constructor, for the given super-packet described by
+    ///        `offloadInfo`.
+    ///
+    /// Throws std::invalid_argument if the packet can't be segmented
+    /// as described (its GSO type isn't supported, it doesn't carry
+    /// the right protocol, or the segment size is 0), and exceptions
+    /// if the packet is malformed, as the decoders do.
+    GSOSegmenter(const BufferView &ipv4Data, const OffloadInfo &offloadInfo);
+
+    ///@}
+
+    /// @brief Return the number of segments.
+    std::size_t getSegmentCount() const { return mSegmentCount; }
+
+    /// @brief Return the length of the i-th segment, headers
+    ///        included.
+    std::size_t getSegmentLength(std::size_t i) const;
+
+    /// @brief Write the i-th segment at the start of `buffer`.
+    ///
+    /// Throws std::out_of_range if there's no such segment, and
+    /// std::length_error if the buffer is too short for it.
+    ///
+    /// @return A view of the segment.
+    BufferWritableView writeSegment(std::size_t i,
+                                    const BufferWritableView &buffer) const;
+
+  private:
+    // The super-packet, trimmed to its IPv4 total length.
+    BufferView mPacket;
+
+    GSOType::Type mType;
+    std::size_t mIPv4HeaderLength;
+
+    // Length of the IPv4 and TCP/UDP headers.
+    std::size_t mHeaderLength;
+
+    // Payload size of each segment (but the last one).
+    std::size_t mSegmentSize;
+    std::size_t mSegmentCount;
+};
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
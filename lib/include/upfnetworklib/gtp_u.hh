@@ -9,8 +9,11 @@
 // For Port
 #include <upfnetworklib/ipv4.hh>
 
-// For std::vector
-#include <vector>
+// For HeaderOverlay
+#include <upfnetworklib/headerlayout.hh>
+
+// For DecodeStatus
+#include <upfnetworklib/decodestatus.hh>
 
 // For std::size_t
 #include <cstddef>
@@ -55,20 +58,137 @@ struct GTPv1UEndPoint {
     GTP_TEID::Number teid = GTP_TEID::Unspecified;
 };
 
+/// @brief Layout of the GTPv1-U header.
+struct GTPv1UHeader : HeaderLayout<8> {
+    using Flags = HeaderField<0, std::uint8_t>;
+    using Version = HeaderBits<Flags, 5, 3>;
+    using ProtocolType = HeaderBits<Flags, 4, 1>;
+    using NextExtensionFlag = HeaderBits<Flags, 2, 1>;
+    using SequenceNumberFlag = HeaderBits<Flags, 1, 1>;
+    using NPDUFlag = HeaderBits<Flags, 0, 1>;
+    using OptionalFieldsFlags = HeaderBits<Flags, 0, 3>;
+    using MessageType = HeaderField<1, std::uint8_t>;
+    using MessageLength = HeaderField<2, std::uint16_t>;
+    using TEID = HeaderField<4, std::uint32_t>;
+
+    ///@name Optional fields
+    ///
+    /// They are all there when any of the ``E``, ``S`` or ``PN``
+    /// flags is set (see OptionalFieldsFlags).
+    ///
+    ///@{
+    using SequenceNumber = HeaderField<8, std::uint16_t>;
+    using NPDUNumber = HeaderField<10, std::uint8_t>;
+    using NextExtensionType = HeaderField<11, std::uint8_t>;
+    ///@}
+};
+
 /**
  * @brief Decode a GTPv1-U packet stored in a BufferView.
  */
 class GTPv1UDecoder {
   public:
+    /**
+     * @brief The Extension Headers of a GTPv1-U packet, as returned
+     *        by getExtensionHeaders().
+     *
+     * Extension headers are checked once on construction of the
+     * GTPv1UDecoder, and then just walked over, so there's no
+     * collection to allocate for each packet. Each one is a
+     * BufferView, as described in getExtensionHeaders().
+     *
+     * It refers to the GTPv1UDecoder data, so it mustn't outlive it.
+     */
+    class ExtensionHeaders {
+      public:
+        /// @brief Iterator over the extension headers, in packet
+        ///        order.
+        ///
+        /// The BufferView it refers to is part of the iterator, so
+        /// it's only valid until the iterator is incremented.
+        class Iterator {
+          public:
+            const BufferView &operator*() const { return mHeader; }
+
+            const BufferView *operator->() const { return &mHeader; }
+
+            Iterator &operator++() {
+                mOffset += mHeader.size();
+                load();
+                return *this;
+            }
+
+            bool operator==(const Iterator &other) const {
+                return mOffset == other.mOffset;
+            }
+
+            bool operator!=(const Iterator &other) const {
+                return mOffset != other.mOffset;
+            }
+
+          private:
+            friend class ExtensionHeaders;
+
+            const BufferView *mGTPv1UData;
+            std::size_t mOffset;
+            std::size_t mEnd;
+            BufferView mHeader;
+
+            Iterator(const BufferView &gtpuData, std::size_t offset,
+                     std::size_t end)
+                : mGTPv1UData(&gtpuData), mOffset(offset), mEnd(end) {
+                load();
+            }
+
+            // Attach mHeader to the extension header at mOffset, if
+            // any (lengths have already been checked by
+            // extractExtensionHeaders()).
+            void load() {
+                if (mOffset != mEnd) {
+                    mHeader = mGTPv1UData->getSub(
+                        mOffset,
+                        4 * mGTPv1UData->getUint8At_nocheck(mOffset + 1));
+                }
+            }
+        };
+
+        ///@name Iteration, in packet order
+        ///@{
+        Iterator begin() const {
+            return Iterator(*mGTPv1UData, endOfOptionalFieldsOffset, mEnd);
+        }
+
+        Iterator end() const { return Iterator(*mGTPv1UData, mEnd, mEnd); }
+        ///@}
+
+        /// @brief Return the number of extension headers.
+        std::size_t size() const { return mCount; }
+
+        /// @brief Return true if there are no extension headers.
+        bool empty() const { return mCount == 0; }
+
+      private:
+        friend class GTPv1UDecoder;
+
+        const BufferView *mGTPv1UData;
+        std::size_t mEnd;
+        std::size_t mCount;
+
+        ExtensionHeaders(const BufferView &gtpuData, std::size_t end,
+                         std::size_t count)
+            : mGTPv1UData(&gtpuData), mEnd(end), mCount(count) {}
+    };
+
     ///@name Constructors
 
     /// @brief Constructor attaching to the given BufferView.
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    GTPv1UDecoder(const BufferView &gtpuData) : mBufferView(gtpuData) {
-        throwIfBufferIsUnsuitable(
-            NETWORKLIB_CURRENT_FUNCTION);
+    GTPv1UDecoder(const BufferView &gtpuData)
+        : mBufferView(gtpuData),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {
+        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
         extractExtensionHeadersAndFindPayload();
     }
 
@@ -76,11 +196,35 @@ class GTPv1UDecoder {
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    GTPv1UDecoder(BufferView &&gtpuData) : mBufferView{std::move(gtpuData)} {
+    GTPv1UDecoder(BufferView &&gtpuData)
+        : mBufferView{std::move(gtpuData)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {
         throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
         extractExtensionHeadersAndFindPayload();
     }
 
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or tells why the BufferView
+    /// is unsuitable (and then the decoder mustn't be used).
+    ///
+    /// @note Forcibly inlined: BasicEthPacketProcessor constructs one
+    ///       per GTPv1-U packet.
+    NETWORKLIB_ALWAYS_INLINE
+    GTPv1UDecoder(const BufferView &gtpuData, DecodeStatus &status) noexcept
+        : mBufferView(gtpuData),
+          mHeader(mBufferView, status, DecodeStatus::GTPv1UTooShort),
+          mDataOffset(0), mDataLengthBytes(0) {
+        if (status == DecodeStatus::Ok) {
+            status = checkBuffer();
+        }
+
+        if (status == DecodeStatus::Ok) {
+            status = findExtensionHeadersAndPayload();
+        }
+    }
+
     ///@}
 
     ///@name No default constructor
@@ -104,69 +248,61 @@ class GTPv1UDecoder {
     ///@{
 
     unsigned char getVersion() const {
-        // Bounds already checked on construction
-        return (mBufferView.getUint8At_nocheck(0) >> 5) & 0x07;
+        return mHeader.get<GTPv1UHeader::Version>();
     }
 
     unsigned char getProtocolType() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint8At_nocheck(0) & 0x10) != 0) ? 1 : 0;
+        return mHeader.get<GTPv1UHeader::ProtocolType>();
     }
 
     bool hasNextExtensionField() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint8At_nocheck(0) & 0x04) != 0);
+        return mHeader.get<GTPv1UHeader::NextExtensionFlag>();
     }
 
     bool hasSequenceNumberField() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint8At_nocheck(0) & 0x02) != 0);
+        return mHeader.get<GTPv1UHeader::SequenceNumberFlag>();
     }
 
     bool hasNPDUField() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint8At_nocheck(0) & 0x01) != 0);
+        return mHeader.get<GTPv1UHeader::NPDUFlag>();
     }
 
     unsigned char getMessageType() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint8At_nocheck(messageTypeOffset);
+        return mHeader.get<GTPv1UHeader::MessageType>();
     }
 
     std::uint16_t getMessageLength() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(messageLengthOffset);
+        return mHeader.get<GTPv1UHeader::MessageLength>();
     }
 
     GTP_TEID::Number getTEID() const {
-        // Bounds already checked on construction
-        return GTP_TEID::Number(mBufferView.getUint32At_nocheck(teidOffset));
+        return GTP_TEID::Number(mHeader.get<GTPv1UHeader::TEID>());
     }
 
     ///@}
 
     ///@name Read access to **optional** GTPv1-U header fields
+    ///
+    /// Each returns the field actual value only if the corresponding
+    /// flag tells that the value is there and is significant (bounds
+    /// already checked on construction), and 0 otherwise.
+    ///
     ///@{
 
     std::uint16_t getSequenceNumber() const {
-        // Return the field actual value only if the corresponding
-        // flag tells that the value is there and is significant.
         return hasSequenceNumberField()
-                   ? mBufferView.getUint16At(sequenceNumberOffset)
+                   ? mHeader.get_nocheck<GTPv1UHeader::SequenceNumber>()
                    : 0;
     }
 
     unsigned char getNPDUNumber() const {
-        // Return the field actual value only if the corresponding
-        // flag tells that the value is there and is significant.
-        return hasNPDUField() ? mBufferView.getUint8At(npduNumberOffset) : 0;
+        return hasNPDUField() ? mHeader.get_nocheck<GTPv1UHeader::NPDUNumber>()
+                              : 0;
     }
 
     unsigned char getFirstNextExtensionType() const {
-        // Return the field actual value only if the corresponding
-        // flag tells that the value is there and is significant.
         return hasNextExtensionField()
-                   ? mBufferView.getUint8At(nextExtensionTypeOffset)
+                   ? mHeader.get_nocheck<GTPv1UHeader::NextExtensionType>()
                    : 0;
     }
 
@@ -187,26 +323,50 @@ class GTPv1UDecoder {
         // Brief version. It's logically equivalent to
         // (hasSequenceNumberField() || hasNPDUField() ||
         // hasNextExtensionField())
-        return (mBufferView.getUint8At(0) & 0x03) != 0;
+        return mHeader.get<GTPv1UHeader::OptionalFieldsFlags>() != 0;
     }
 
+    /// @brief Get the payload offset, in bytes (i.e. the length of
+    ///        the header, with optional fields and extension headers)
+    std::size_t getDataOffset() const { return mDataOffset; }
+
     /// @brief Get the payload length, in bytes
     std::size_t getDataLengthBytes() const { return mDataLengthBytes; }
 
+    /// @brief Get the original BufferView back.
+    ///
+    /// That's useful if all you are passed is a GTPv1UDecoder
+    /// instance, like in the context passed down by
+    /// EthPacketProcessor, and you want back the BufferView.
+    const BufferView &getGTPv1UMessage() const { return mBufferView; }
+
     /// @brief Return a BufferView with the payload.
     BufferView getData() const {
         return mBufferView.getSub(mDataOffset, mDataLengthBytes);
     }
 
+    /// @brief Check, without throwing, that getData() can be called:
+    ///        return DecodeStatus::Ok if the message length matches
+    ///        the buffer, or DecodeStatus::GTPv1UBadLength.
+    DecodeStatus checkData() const noexcept {
+        // Note: mDataOffset is within the buffer (see
+        //       findExtensionHeadersAndPayload()), while
+        //       mDataLengthBytes may have wrapped around.
+        return (mDataLengthBytes <= mBufferView.size() - mDataOffset)
+                   ? DecodeStatus::Ok
+                   : DecodeStatus::GTPv1UBadLength;
+    }
+
     /// @brief Read access to the portions of the buffer storing the
     ///        Extension Headers in this packet, if any.
     ///
     /// Note that the first byte of each portion tells the extension
     /// header type, followed by the actual extension header, and
     /// without the finale 'next extension header' byte (see comments
-    /// about 'mExtensionHeaders').
-    const std::vector<BufferView> &getExtensionHeaders() const {
-        return mExtensionHeaders;
+    /// about 'mExtensionHeadersEnd').
+    ExtensionHeaders getExtensionHeaders() const {
+        return ExtensionHeaders(mBufferView, mExtensionHeadersEnd,
+                                mExtensionHeaderCount);
     }
 
     /// @brief True if the payload is a IPv4 packet/fragment.
@@ -215,30 +375,23 @@ class GTPv1UDecoder {
     ///@}
 
   private:
-    // Constant offsets, in bytes, of common header fields
-    enum {
-        messageTypeOffset = 1,
-        messageLengthOffset = 2,
-        teidOffset = 4,
-    };
-
-    // Constant offsets, in bytes, of optional header fields
+    // Offsets, in bytes, of the end of the header parts
     enum {
-        sequenceNumberOffset = 8,
-        npduNumberOffset = 10,
-        nextExtensionTypeOffset = 11,
-    };
-
-    // Other offsets
-    enum {
-        endOfCommonHeaderOffset = 8,
-        endOfOptionalFieldsOffset = 11,
+        endOfCommonHeaderOffset = GTPv1UHeader::minSize,
+        endOfOptionalFieldsOffset = GTPv1UHeader::NextExtensionType::offset,
     };
 
     // Proper data.
     BufferView mBufferView;
 
-    // A vector pointing to each Extension header, if any.
+    // The header, checked on construction (including optional fields,
+    // when there).
+    const HeaderOverlay<GTPv1UHeader> mHeader;
+
+    // The offset of the end of the Extension headers, if any (i.e. of
+    // the 'Next Extension Header Type' byte telling there are no
+    // more), and how many they are. They start at
+    // endOfOptionalFieldsOffset.
     //
     // In order to keep things sane, Extention headers are stored
     // differently from what could be expected: the first byte is not
@@ -261,7 +414,8 @@ class GTPv1UDecoder {
     // | header type | Length    | ...      |
     // +-------------+-----------+----------+
     //
-    std::vector<BufferView> mExtensionHeaders;
+    std::size_t mExtensionHeadersEnd = endOfOptionalFieldsOffset;
+    std::size_t mExtensionHeaderCount = 0;
 
     // In GTP1-U the payload starts after the common header,
     // after the optional fields of the common header, and
@@ -269,8 +423,19 @@ class GTPv1UDecoder {
     mutable std::size_t mDataOffset;
     mutable std::size_t mDataLengthBytes;
 
-    // Helper method
+    // Helper methods
     void extractExtensionHeadersAndFindPayload() {
+        if (findExtensionHeadersAndPayload() != DecodeStatus::Ok) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": extension header with length 0, or past the end of "
+                   "the buffer (BufferView.size() == "
+                << mBufferView.size() << ")";
+            throw std::runtime_error(err.str());
+        }
+    }
+
+    DecodeStatus findExtensionHeadersAndPayload() noexcept {
         std::size_t offset = endOfCommonHeaderOffset;
 
         if (hasOptionalFields()) {
@@ -278,30 +443,20 @@ class GTPv1UDecoder {
             offset = endOfOptionalFieldsOffset;
 
             if (hasNextExtensionField()) {
+                const DecodeStatus status = extractExtensionHeaders(offset);
 
-                // Ok there could be zero or more extension headers at
-                // this offset.
-                //
-                // Let's look at the 'Next Extension Header Field
-                // value': as for 3GPP TS 29.060 sect. 6, a value of 0
-                // means 'No more extension headers'.
-                while (mBufferView.getUint8At(offset) != 0) {
-                    // There's an extension header at this offset
-
-                    // As for 3GPP TS 29.060 sec. 6:
-                    //
-                    // | The length of the Extension header shall be
-                    // | defined in a variable length of 4 octets,
-                    // | i.e. m+1 = n*4 octets, where n is a positive
-                    // | integer.
-                    const std::size_t extLen =
-                        4 * mBufferView.getUint8At(offset + 1);
-
-                    mExtensionHeaders.push_back(
-                        mBufferView.getSub(offset, extLen));
-                    offset += extLen;
+                if (status != DecodeStatus::Ok) {
+                    return status;
                 }
+
+                mExtensionHeadersEnd = offset;
             }
+
+            // Skip the last 'Next Extension Header Type' (i.e. the
+            // byte at endOfOptionalFieldsOffset when there are no
+            // extension headers, or the one telling there are no
+            // more).
+            ++offset;
         }
 
         // At this point, 'offset' is at the start of the payload.
@@ -317,30 +472,52 @@ class GTPv1UDecoder {
         //
         mDataLengthBytes =
             getMessageLength() - offset + endOfCommonHeaderOffset;
+
+        return DecodeStatus::Ok;
     }
 
-    void throwIfBufferIsUnsuitable(const char *method) {
+    // Out of line: extension headers are not that common.
+    DecodeStatus extractExtensionHeaders(std::size_t &offset) noexcept;
 
-        // Catch some quirks early
-        if (mBufferView.size() < 8) {
-            std::ostringstream err;
-            err << method
-                << ": called with "
-                   "BufferView.size() == "
-                << mBufferView.size() << " (min size is 8)";
-            throw std::length_error(err.str());
+    DecodeStatus checkBuffer() const noexcept {
+        // The minimum size has already been checked by mHeader
+        if (getProtocolAndVersion() != 0x03) {
+            // 0x03 means GTPv1
+            return DecodeStatus::GTPv1UBadVersion;
+        }
+
+        if (hasOptionalFields() &&
+            !mHeader.has<GTPv1UHeader::NextExtensionType>()) {
+            return DecodeStatus::GTPv1UTooShort;
         }
 
-        const std::uint8_t protocolAndVersion =
-            mBufferView.getUint8At_nocheck(0) >> 4;
+        return DecodeStatus::Ok;
+    }
 
-        if (protocolAndVersion != 0x03) {
-            // 0x03 means GTPv1
+    std::uint8_t getProtocolAndVersion() const noexcept {
+        return mHeader.get<GTPv1UHeader::Flags>() >> 4;
+    }
+
+    void throwIfBufferIsUnsuitable(const char *method) {
+        // Catch some quirks early
+        const DecodeStatus status = checkBuffer();
+
+        if (status == DecodeStatus::GTPv1UBadVersion) {
             std::ostringstream err;
             err << method << ": not GTPv1 data (protocol+version is "
-                << asHex8(protocolAndVersion) << ", expected 0x03)";
+                << asHex8(getProtocolAndVersion()) << ", expected 0x03)";
             throw std::runtime_error(err.str());
         }
+
+        if (status != DecodeStatus::Ok) {
+            std::ostringstream err;
+            err << method
+                << ": called with "
+                   "BufferView.size() == "
+                << mBufferView.size()
+                << " (min size is 12 with optional fields)";
+            throw std::length_error(err.str());
+        }
     }
 };
 } // namespace NetworkLib
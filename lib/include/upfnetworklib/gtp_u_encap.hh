@@ -78,6 +78,11 @@ namespace NetworkLib {
  *       the final ethernet frame can be obtained by calling
  *       'getEthFrame()' (same as the other way).
  *
+ * A variant of the second way doesn't even need the payload to be at
+ * the right offset of the encapsulation buffer: 'initInPlace()' writes
+ * the headers in the headroom in front of a received IPv4 packet (see
+ * BufferWritableView::prepend()), in place of 'init()'.
+ *
  * Computing the UDP checksum can be disabled (see
  * 'enableUDPChecksum(bool)').
  */
@@ -91,7 +96,7 @@ class GTPv1UEthEncap {
     /// Throws exceptions if the BufferWritableView is unsuitable
     /// (empty, too short, etc.).
     GTPv1UEthEncap(const BufferWritableView &buffer)
-        : mBufferWritableView(buffer),
+        : mEncapBuffer(buffer), mBufferWritableView(buffer),
           mPayloadArea(buffer.getSub(payload_startOffset)) {
         throwIfBufferIsUnsuitable(
             NETWORKLIB_CURRENT_FUNCTION);
@@ -123,12 +128,33 @@ class GTPv1UEthEncap {
     ///
     /// @return A reference to self, so method calls can be chained.
     GTPv1UEthEncap &init() {
+        // Go back to the buffer given on construction, if needed.
+        if (mInPlace) {
+            mBufferWritableView = mEncapBuffer;
+            mInPlace = false;
+        }
+
         // Initialize the headers in the buffer with the
         // predefined values.
         initHeaders();
         return *this;
     }
 
+    /// @brief Initialize the encapsulator for a new packet, to be
+    ///        encapsulated **in place**: the headers are written in
+    ///        the headroom in front of the given IPv4 packet (see
+    ///        BufferView::getHeadroom()), rather than in the buffer
+    ///        given on construction.
+    ///
+    /// Then go on as with the no-copy strategy, calling
+    /// 'setPayload()' with no arguments.
+    ///
+    /// Throws std::length_error if the headroom is smaller than
+    /// 'GTPv1UEthEncap::payload_startOffset', or the packet is too big.
+    ///
+    /// @return A reference to self, so method calls can be chained.
+    GTPv1UEthEncap &initInPlace(const BufferWritableView &ipv4Data);
+
     ///@name Ethernet
     ///@{
 
@@ -298,12 +324,19 @@ class GTPv1UEthEncap {
         gtp_teidOffset = gtp_startOffset + 4,
     };
 
-    // The whole buffer
-    const BufferWritableView mBufferWritableView;
+    // The buffer given on construction
+    const BufferWritableView mEncapBuffer;
+
+    // The whole buffer: either mEncapBuffer, or the headers in front
+    // of the payload when encapsulating in place
+    BufferWritableView mBufferWritableView;
 
     // The area for the payload
     const BufferWritableView mPayloadArea;
 
+    // Whether we are encapsulating in place
+    bool mInPlace = false;
+
     // The actual length of the payload
     std::size_t mPayloadActualLength;
 
@@ -348,6 +381,8 @@ class GTPv1UEthEncap {
 /**
  * @brief A class that encapsulates a IPv4 payload in a IPv4 packet
  *        using GTPv1-U on IPv4.
+ *
+ * It works just like a GTPv1UEthEncap, without the Ethernet header.
  */
 class GTPv1UIPv4Encap {
   public:
@@ -359,7 +394,7 @@ class GTPv1UIPv4Encap {
     /// Throws exceptions if the BufferWritableView is unsuitable
     /// (empty, too short, etc.).
     GTPv1UIPv4Encap(const BufferWritableView &buffer)
-        : mBufferWritableView(buffer),
+        : mEncapBuffer(buffer), mBufferWritableView(buffer),
           mPayloadArea(buffer.getSub(payload_startOffset)) {
         throwIfBufferIsUnsuitable(
             NETWORKLIB_CURRENT_FUNCTION);
@@ -391,12 +426,33 @@ class GTPv1UIPv4Encap {
     ///
     /// @return A reference to self, so method calls can be chained.
     GTPv1UIPv4Encap &init() {
+        // Go back to the buffer given on construction, if needed.
+        if (mInPlace) {
+            mBufferWritableView = mEncapBuffer;
+            mInPlace = false;
+        }
+
         // Initialize the headers in the buffer with the
         // predefined values.
         initHeaders();
         return *this;
     }
 
+    /// @brief Initialize the encapsulator for a new packet, to be
+    ///        encapsulated **in place**: the headers are written in
+    ///        the headroom in front of the given IPv4 packet (see
+    ///        BufferView::getHeadroom()), rather than in the buffer
+    ///        given on construction.
+    ///
+    /// Then go on as with the no-copy strategy, calling
+    /// 'setPayload()' with no arguments.
+    ///
+    /// Throws std::length_error if the headroom is smaller than
+    /// 'GTPv1UIPv4Encap::payload_startOffset', or the packet is too big.
+    ///
+    /// @return A reference to self, so method calls can be chained.
+    GTPv1UIPv4Encap &initInPlace(const BufferWritableView &ipv4Data);
+
     ///@name IPv4 Header
     ///@{
 
@@ -540,12 +596,19 @@ class GTPv1UIPv4Encap {
         gtp_teidOffset = gtp_startOffset + 4,
     };
 
-    // The whole buffer
-    const BufferWritableView mBufferWritableView;
+    // The buffer given on construction
+    const BufferWritableView mEncapBuffer;
+
+    // The whole buffer: either mEncapBuffer, or the headers in front
+    // of the payload when encapsulating in place
+    BufferWritableView mBufferWritableView;
 
     // The area for the payload
     const BufferWritableView mPayloadArea;
 
+    // Whether we are encapsulating in place
+    bool mInPlace = false;
+
     // The actual length of the payload
     std::size_t mPayloadActualLength;
 
@@ -0,0 +1,239 @@
+#ifndef UPFNETWORKLIB_HEADERLAYOUT_HH
+#define UPFNETWORKLIB_HEADERLAYOUT_HH
+
+#include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/decodestatus.hh>
+#include <upfnetworklib/utils.hh>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uintXX_t
+#include <cstdint>
+
+// For std::length_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+namespace UPF {
+namespace NetworkLib {
+
+/// @brief Read a value of type T, ``size`` bytes long, stored in
+///        network order.
+///
+/// Specialized for ``std::uint8_t``, ``std::uint16_t``,
+/// ``std::uint32_t``, IPv4Address and MACAddress.
+template <typename T> struct HeaderFieldReader;
+
+template <> struct HeaderFieldReader<std::uint8_t> {
+    static constexpr std::size_t size = 1;
+
+    static std::uint8_t read(const unsigned char *p) noexcept { return *p; }
+};
+
+template <> struct HeaderFieldReader<std::uint16_t> {
+    static constexpr std::size_t size = 2;
+
+    static std::uint16_t read(const unsigned char *p) noexcept {
+        return getUint16At(p);
+    }
+};
+
+template <> struct HeaderFieldReader<std::uint32_t> {
+    static constexpr std::size_t size = 4;
+
+    static std::uint32_t read(const unsigned char *p) noexcept {
+        return getUint32At(p);
+    }
+};
+
+template <> struct HeaderFieldReader<IPv4Address> {
+    static constexpr std::size_t size = 4;
+
+    static IPv4Address read(const unsigned char *p) noexcept {
+        return IPv4Address(p[0], p[1], p[2], p[3]);
+    }
+};
+
+template <> struct HeaderFieldReader<MACAddress> {
+    static constexpr std::size_t size = 6;
+
+    static MACAddress read(const unsigned char *p) noexcept {
+        return MACAddress(p[0], p[1], p[2], p[3], p[4], p[5]);
+    }
+};
+
+/// @brief A header field of type T, at the given offset (in bytes)
+///        from the start of the header.
+template <std::size_t Offset, typename T> struct HeaderField {
+    /// @brief Type of the field value.
+    using Type = T;
+
+    /// @brief Offset of the first byte of the field.
+    static constexpr std::size_t offset = Offset;
+
+    /// @brief Offset of the first byte past the field.
+    static constexpr std::size_t end = Offset + HeaderFieldReader<T>::size;
+
+    /// @brief Read the field out of the given header.
+    static T read(const unsigned char *header) noexcept {
+        return HeaderFieldReader<T>::read(header + Offset);
+    }
+};
+
+/// @brief Some bits of a (integer) header field: `Width` bits,
+///        starting at bit `Shift` (where bit 0 is the least
+///        significant bit of the field value).
+template <typename Field, unsigned Shift, unsigned Width> struct HeaderBits {
+    /// @brief Type of the field value.
+    using Type = typename Field::Type;
+
+    static_assert(Shift + Width <= 8 * sizeof(Type),
+                  "HeaderBits: bits past the end of the field");
+
+    ///@name Same as HeaderField
+    ///@{
+    static constexpr std::size_t offset = Field::offset;
+    static constexpr std::size_t end = Field::end;
+    ///@}
+
+    /// @brief Mask of the bits, once shifted.
+    static constexpr Type mask =
+        static_cast<Type>((std::uint64_t{1} << Width) - 1);
+
+    /// @brief Read the bits out of the given header.
+    static Type read(const unsigned char *header) noexcept {
+        return static_cast<Type>((Field::read(header) >> Shift) & mask);
+    }
+};
+
+/// @brief Base class of header layouts, telling the minimum size of
+///        the header.
+///
+/// Fields past the minimum size (e.g. optional ones) can be read
+/// only after checking that they are actually there (see
+/// HeaderOverlay::get_nocheck()).
+template <std::size_t MinSize> struct HeaderLayout {
+    /// @brief Minimum size of the header, in bytes.
+    static constexpr std::size_t minSize = MinSize;
+};
+
+/**
+ * @brief A typed view of a header with the given layout, at the start
+ *        of a BufferView.
+ *
+ * Decoders use it to check the header length once, on construction,
+ * and then read fields with no further checks.
+ *
+ * A layout is a struct deriving from HeaderLayout, telling the
+ * minimum header size, and listing its fields as HeaderField (or
+ * HeaderBits) types:
+ *
+ *     struct UDPHeader : HeaderLayout<8> {
+ *         using SrcPort = HeaderField<0, std::uint16_t>;
+ *         using DstPort = HeaderField<2, std::uint16_t>;
+ *         // ...
+ *     };
+ *
+ *     HeaderOverlay<UDPHeader> header(udpData, NETWORKLIB_CURRENT_FUNCTION);
+ *
+ *     const std::uint16_t dstPort = header.get<UDPHeader::DstPort>();
+ *
+ * Offsets and sizes are all known at compile time, so each get()
+ * compiles to a single load (plus a byte swap for multi-byte
+ * fields), and reading a field past the minimum size doesn't
+ * compile.
+ *
+ * It doesn't keep the underlying buffer alive: that's up to the
+ * owner of the HeaderOverlay (usually a decoder keeping the
+ * BufferView as well).
+ */
+template <typename Layout> class HeaderOverlay {
+  public:
+    ///@name Constructors
+    ///@{
+
+    /// @brief Constructor attaching to the start of the given
+    ///        BufferView.
+    ///
+    /// Throws std::length_error if the BufferView is shorter than the
+    /// minimum size of the header, telling it was called by
+    /// `method`.
+    HeaderOverlay(const BufferView &buffer, const char *method)
+        : mHeader(buffer.getUnderlyingBufferPtr()), mSize(buffer.size()) {
+        if (mSize < Layout::minSize) {
+            std::ostringstream err;
+            err << method
+                << ": called with "
+                   "BufferView.size() == "
+                << mSize << " (min size is " << Layout::minSize << ")";
+            throw std::length_error(err.str());
+        }
+    }
+
+    /// @brief Non-throwing constructor attaching to the start of the
+    ///        given BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or to `tooShort` if the
+    /// BufferView is shorter than the minimum size of the header (and
+    /// then the HeaderOverlay is as default constructed).
+    HeaderOverlay(const BufferView &buffer, DecodeStatus &status,
+                  DecodeStatus tooShort) noexcept
+        : mHeader(buffer.getUnderlyingBufferPtr()), mSize(buffer.size()) {
+        status = DecodeStatus::Ok;
+
+        if (mSize < Layout::minSize) {
+            status = tooShort;
+            mHeader = getZeros();
+            mSize = 0;
+        }
+    }
+
+    /// @brief Default constructor: all the fields of the minimum
+    ///        header read as 0, and size() is 0.
+    ///
+    /// @note This allows arrays and other collections of decoders.
+    HeaderOverlay() noexcept : mHeader(getZeros()), mSize(0) {}
+
+    ///@}
+
+    /// @brief Read a field within the minimum header size (checked at
+    ///        compile time).
+    template <typename Field> typename Field::Type get() const noexcept {
+        static_assert(Field::end <= Layout::minSize,
+                      "HeaderOverlay: field past the minimum header size "
+                      "(use get_nocheck())");
+        return Field::read(mHeader);
+    }
+
+    /// @brief Read a field past the minimum header size, which the
+    ///        caller made sure is within the buffer (see has()).
+    template <typename Field>
+    typename Field::Type get_nocheck() const noexcept {
+        return Field::read(mHeader);
+    }
+
+    /// @brief Return true if the given field is within the buffer.
+    template <typename Field> bool has() const noexcept {
+        return Field::end <= mSize;
+    }
+
+    /// @brief Return the size of the underlying buffer.
+    std::size_t size() const noexcept { return mSize; }
+
+  private:
+    const unsigned char *mHeader;
+    std::size_t mSize;
+
+    static const unsigned char *getZeros() noexcept {
+        static const unsigned char zeros[Layout::minSize] = {};
+        return zeros;
+    }
+};
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
@@ -1,11 +1,96 @@
 #ifndef UPFNETWORKLIB_INTERFACES_HH
 #define UPFNETWORKLIB_INTERFACES_HH
 
+#include <upfnetworklib/bufferchain.hh>
 #include <upfnetworklib/buffers.hh>
 
+// For std::size_t
+#include <cstddef>
+
+// For std::uint8_t and std::uint16_t
+#include <cstdint>
+
 namespace UPF {
 namespace NetworkLib {
 
+/// @brief A namespace for segmentation offload types.
+namespace GSOType {
+/// @brief Type of segmentation a packet is subject to.
+enum Type : std::uint8_t {
+    /// @brief Not a GSO super-packet.
+    NONE = 0,
+    TCPV4 = 1,
+    UDP = 2,
+    TCPV6 = 3,
+    /// @brief UDP segmentation (i.e. `UDP_SEGMENT`).
+    UDP_L4 = 4,
+};
+} // namespace GSOType
+
+/**
+ * @brief Checksum and segmentation offload metadata of an Ethernet
+ *        frame or IP packet, as exchanged with devices supporting
+ *        offloads (e.g. ``virtio_net_hdr`` on TAP devices).
+ *
+ * Offsets are relative to the start of the frame/packet it refers
+ * to: code building a different frame/packet out of it (e.g. by
+ * encapsulation) must update or reset it.
+ */
+struct OffloadInfo {
+    /// @brief When `true`, the L4 checksum is partial: it must be
+    ///        computed from checksumStart to the end of the packet,
+    ///        and stored at checksumStart + checksumOffset.
+    bool checksumPartial = false;
+
+    /// @brief When `true`, checksums have already been verified.
+    bool checksumValid = false;
+
+    /// @brief See checksumPartial.
+    std::uint16_t checksumStart = 0;
+
+    /// @brief See checksumPartial.
+    std::uint16_t checksumOffset = 0;
+
+    /// @brief Segmentation type, when it's a GSO super-packet.
+    GSOType::Type gsoType = GSOType::NONE;
+
+    /// @brief Payload size of each segment (e.g. the TCP MSS), when
+    ///        it's a GSO super-packet.
+    std::uint16_t gsoSize = 0;
+
+    /// @brief Length of the headers replicated in each segment, when
+    ///        it's a GSO super-packet (0 if unknown).
+    std::uint16_t headerLength = 0;
+
+    /// @brief True if there's anything to be described (i.e. it's not
+    ///        the same as a default-constructed one).
+    bool isSet() const {
+        return checksumPartial || checksumValid || gsoType != GSOType::NONE;
+    }
+
+    /// @brief Update the offsets after `length` bytes of headers have
+    ///        been put in front of the frame/packet (e.g. an Ethernet
+    ///        header in front of a IPv4 packet).
+    void addHeaders(std::size_t length);
+
+    /// @brief Update the offsets after the first `length` bytes of
+    ///        the frame/packet have been stripped (e.g. to get the
+    ///        packet carried by a tunnel).
+    ///
+    /// What referred to the stripped headers (e.g. a partial checksum
+    /// in one of them, or the segmentation of the outer packet) is
+    /// reset, and so is checksumValid.
+    void removeHeaders(std::size_t length);
+
+    /// @brief If the checksum is partial, compute it in software and
+    ///        store it in the given frame/packet, which must be the
+    ///        one this refers to.
+    ///
+    /// Needed before the frame/packet gets covered by some other
+    /// checksum (e.g. it's carried in a UDP tunnel).
+    void completeChecksum(const BufferWritableView &data);
+};
+
 /**
  * @brief User data optionally passed down together with Ethernet
  *        frames or IP packets.
@@ -13,6 +98,10 @@ namespace NetworkLib {
 struct ContextUserData {
     void *ptrUserData = nullptr;
     int intUserData = 0;
+
+    /// @brief Offload metadata of the frame/packet, if any (see e.g.
+    ///        RawSocketsUtil::TapQueue).
+    OffloadInfo offloadInfo;
 };
 
 /// @brief Instance for default arguments (for when we don't want to
@@ -42,6 +131,19 @@ class IPv4PacketSink {
     virtual void
     consumeIPv4Packet(const BufferView &ipv4Data,
                       ContextUserData &userData = defaultContextUserData) = 0;
+
+    /// @brief Write out a IPv4 packet made of several segments
+    ///        (e.g. headers and payload).
+    ///
+    /// The default implementation passes the packet to
+    /// consumeIPv4Packet(), copying it into a single buffer if needed
+    /// (see BufferChain::flatten()): implementations able to write
+    /// out segments as they are should override it.
+    virtual void
+    consumeIPv4PacketChain(const BufferChain &ipv4Data,
+                           ContextUserData &userData = defaultContextUserData) {
+        consumeIPv4Packet(ipv4Data.flatten(), userData);
+    }
 };
 
 /**
@@ -95,6 +197,41 @@ class EthPacketSink {
     virtual void
     consumeEthPacket(const BufferView &ethData,
                      ContextUserData &userData = defaultContextUserData) = 0;
+
+    /// @brief Write out a Ethernet frame made of several segments
+    ///        (e.g. headers and payload).
+    ///
+    /// The default implementation passes the frame to
+    /// consumeEthPacket(), copying it into a single buffer if needed
+    /// (see BufferChain::flatten()): implementations able to write
+    /// out segments as they are should override it.
+    virtual void
+    consumeEthPacketChain(const BufferChain &ethData,
+                          ContextUserData &userData = defaultContextUserData) {
+        consumeEthPacket(ethData.flatten(), userData);
+    }
+
+    /// @brief Write out several Ethernet frames (e.g. a batch just
+    ///        received).
+    ///
+    /// The default implementation passes frames one at a time to
+    /// consumeEthPacket(): implementations able to amortize work over
+    /// several frames (e.g. EthPacketProcessor) should override it.
+    ///
+    /// @param ethData An array of `count` BufferView objects with the
+    ///        frames.
+    ///
+    /// @param count The number of frames.
+    ///
+    /// @param userData As in consumeEthPacket(), the same for all the
+    ///        frames.
+    virtual void
+    consumeEthPackets(const BufferView *ethData, std::size_t count,
+                      ContextUserData &userData = defaultContextUserData) {
+        for (std::size_t i = 0; i < count; ++i) {
+            consumeEthPacket(ethData[i], userData);
+        }
+    }
 };
 
 /**
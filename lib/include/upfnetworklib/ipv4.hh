@@ -9,6 +9,12 @@
 // For IPv4PacketSink
 #include <upfnetworklib/interfaces.hh>
 
+// For HeaderOverlay
+#include <upfnetworklib/headerlayout.hh>
+
+// For DecodeStatus
+#include <upfnetworklib/decodestatus.hh>
+
 // For std::array<>
 #include <array>
 
@@ -180,6 +186,24 @@ class IPv4IdentificationSource {
     std::uint16_t mIdentification = 0;
 };
 
+/// @brief Layout of the IPv4 header (without options).
+struct IPv4Header : HeaderLayout<20> {
+    using VersionAndIHL = HeaderField<0, std::uint8_t>;
+    using Version = HeaderBits<VersionAndIHL, 4, 4>;
+    using IHL = HeaderBits<VersionAndIHL, 0, 4>;
+    using TotalLength = HeaderField<2, std::uint16_t>;
+    using Identification = HeaderField<4, std::uint16_t>;
+    using FlagsAndFragmentOffset = HeaderField<6, std::uint16_t>;
+    using DontFragmentFlag = HeaderBits<FlagsAndFragmentOffset, 14, 1>;
+    using MoreFragmentsFlag = HeaderBits<FlagsAndFragmentOffset, 13, 1>;
+    using FragmentOffset = HeaderBits<FlagsAndFragmentOffset, 0, 13>;
+    using TTL = HeaderField<8, std::uint8_t>;
+    using Protocol = HeaderField<9, std::uint8_t>;
+    using HeaderChecksum = HeaderField<10, std::uint16_t>;
+    using SrcAddress = HeaderField<12, IPv4Address>;
+    using DstAddress = HeaderField<16, IPv4Address>;
+};
+
 /**
  * @brief Decode IPv4 packets or fragments stored in a BufferView.
  */
@@ -198,16 +222,33 @@ class IPv4Decoder {
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    IPv4Decoder(const BufferView &ipv4data) : mBufferView(ipv4data) {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
+    IPv4Decoder(const BufferView &ipv4data)
+        : mBufferView(ipv4data),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {
+        throwIfNotIPv4(NETWORKLIB_CURRENT_FUNCTION);
     }
 
     /// @brief Constructor from the given BufferView (moved).
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    IPv4Decoder(BufferView &&ipv4data) : mBufferView{std::move(ipv4data)} {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
+    IPv4Decoder(BufferView &&ipv4data)
+        : mBufferView{std::move(ipv4data)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {
+        throwIfNotIPv4(NETWORKLIB_CURRENT_FUNCTION);
+    }
+
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or tells why the BufferView
+    /// is unsuitable (and then the decoder mustn't be used).
+    IPv4Decoder(const BufferView &ipv4data, DecodeStatus &status) noexcept
+        : mBufferView(ipv4data),
+          mHeader(mBufferView, status, DecodeStatus::IPv4TooShort) {
+        if (status == DecodeStatus::Ok && getVersion() != 4) {
+            status = DecodeStatus::IPv4BadVersion;
+        }
     }
 
     ///@}
@@ -233,65 +274,47 @@ class IPv4Decoder {
     ///@{
 
     std::uint8_t getVersion() const {
-        // Bounds already checked on construction
-        return (mBufferView.getUint8At_nocheck(0) >> 4) & 0x0F;
+        return mHeader.get<IPv4Header::Version>();
     }
 
     std::size_t getHeaderLengthBytes() const {
-        // Bounds already checked on construction
-        return (mBufferView.getUint8At_nocheck(0) & 0x0F) * 4;
+        return mHeader.get<IPv4Header::IHL>() * 4;
     }
 
     std::size_t getTotalLengthBytes() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(totalLengthOffset);
+        return mHeader.get<IPv4Header::TotalLength>();
     }
 
     std::uint16_t getIdentification() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(identificationOffset);
+        return mHeader.get<IPv4Header::Identification>();
     }
 
     std::uint16_t getFragmentOffsetBytes() const {
-        // Bounds already checked on construction
-        return (mBufferView.getUint16At_nocheck(fragmentOffsetOffset) &
-                0x1FFF) *
-               8;
+        return mHeader.get<IPv4Header::FragmentOffset>() * 8;
     }
 
     bool getMoreFragmentsFlag() const {
-        // Bounds already checked on construction
-        return (mBufferView.getUint16At_nocheck(fragmentOffsetOffset) >> 13) &
-               1;
+        return mHeader.get<IPv4Header::MoreFragmentsFlag>();
     }
 
     bool getDontFragmentFlag() const {
-        // Bounds already checked on construction
-        return (mBufferView.getUint16At_nocheck(fragmentOffsetOffset) >> 14) &
-               1;
+        return mHeader.get<IPv4Header::DontFragmentFlag>();
     }
 
-    unsigned char getTTL() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint8At_nocheck(ttlOffset);
-    }
+    unsigned char getTTL() const { return mHeader.get<IPv4Header::TTL>(); }
 
     IPv4Protocol::Type getProtocol() const {
-        // Bounds already checked on construction
-        return IPv4Protocol::Type(
-            mBufferView.getUint8At_nocheck(protocolOffset));
+        return IPv4Protocol::Type(mHeader.get<IPv4Header::Protocol>());
     }
 
     /// @brief Get source IPv4 address
     IPv4Address getSrcAddress() const {
-        // Bounds already checked on construction
-        return mBufferView.getIPv4AddressAt_nocheck(srcAddressOffset);
+        return mHeader.get<IPv4Header::SrcAddress>();
     }
 
     /// @brief Get destination IPv4 address
     IPv4Address getDstAddress() const {
-        // Bounds already checked on construction
-        return mBufferView.getIPv4AddressAt_nocheck(dstAddressOffset);
+        return mHeader.get<IPv4Header::DstAddress>();
     }
 
     ///@}
@@ -309,6 +332,24 @@ class IPv4Decoder {
         return mBufferView.getSub(getHeaderLengthBytes(), getDataLengthBytes());
     }
 
+    /// @brief Check, without throwing, that getData() can be called:
+    ///        return DecodeStatus::Ok if the header length and the
+    ///        total length match the buffer, or
+    ///        DecodeStatus::IPv4BadLength.
+    ///
+    /// Constructors don't check that, so that truncated packets
+    /// (e.g. from captures) can still be looked at.
+    DecodeStatus checkData() const noexcept {
+        const std::size_t headerLength = getHeaderLengthBytes();
+        const std::size_t totalLength = getTotalLengthBytes();
+
+        return (headerLength >= IPv4Header::minSize &&
+                headerLength <= totalLength &&
+                totalLength <= mBufferView.size())
+                   ? DecodeStatus::Ok
+                   : DecodeStatus::IPv4BadLength;
+    }
+
     /// @brief True when this is a UDP packet/fragment.
     bool isUDP() const { return (getProtocol() == IPv4Protocol::UDP); }
 
@@ -355,33 +396,14 @@ class IPv4Decoder {
     ///@}
 
   private:
-    // Constant offsets, in bytes, of header fields
-    enum {
-        totalLengthOffset = 2,
-        identificationOffset = 4,
-        fragmentOffsetOffset = 6,
-        ttlOffset = 8,
-        protocolOffset = 9,
-        srcAddressOffset = 12,
-        dstAddressOffset = 16,
-    };
-
     // Proper data.
     const BufferView mBufferView;
 
-    void throwIfBufferIsUnsuitable(const char *method) {
-        // Catch some quirks early
-        if (mBufferView.size() < 20) {
-            std::ostringstream err;
-            err << method
-                << ": called with "
-                   "BufferView.size() == "
-                << mBufferView.size() << " (min size is 20)";
-            throw std::length_error(err.str());
-        }
+    // The header, checked on construction.
+    const HeaderOverlay<IPv4Header> mHeader;
 
-        // Note: same as getVersion()
-        if ((mBufferView.getUint8At_nocheck(0) >> 4) != 4) {
+    void throwIfNotIPv4(const char *method) {
+        if (getVersion() != 4) {
             std::ostringstream err;
             err << method << ": not IPV4 header (version is " << +(getVersion())
                 << ", should b 4)";
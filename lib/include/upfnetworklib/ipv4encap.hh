@@ -11,6 +11,13 @@ namespace NetworkLib {
 /**
  * @brief A class acting as a IPv4 sink, encapsulating IPV4 traffic in
  *        a Ethernet frame and sending it to a Ethernet sink.
+ *
+ * Frames are sent out as a BufferChain made of the Ethernet header
+ * and the IPv4 packet, which isn't copied (see
+ * EthPacketSink::consumeEthPacketChain()).
+ *
+ * The offload metadata in the given ContextUserData (see
+ * ContextUserData::offloadInfo) is updated to refer to the frame.
  */
 class IPv4EncapSink : public NetworkLib::IPv4PacketSink {
   public:
@@ -20,18 +27,23 @@ class IPv4EncapSink : public NetworkLib::IPv4PacketSink {
     /// @brief Constructor.
     ///
     /// @param destination The EthPacketSink to be used as the
+    ///        destination of the encapsulated packets.
+    explicit IPv4EncapSink(EthPacketSink &destination)
+        : mDestination(destination) {
+        initHeaders();
+    }
+
+    /// @brief Constructor taking an encapsulation buffer, which isn't
+    ///        needed any more (kept for compatibility).
+    ///
+    /// @param destination The EthPacketSink to be used as the
     ///        destination of the encapsulated packets;
     ///
-    /// @param bufferWritableView The Bufferwritableview to be used
-    ///        to encapsulate IPv4 packets.
+    /// @param bufferWritableView Ignored.
     IPv4EncapSink(EthPacketSink &destination,
                   BufferWritableView &bufferWritableView)
-        : mDestination(destination), mBufferWritableView(bufferWritableView),
-
-          // Note: if size is less than eth_headerLength, we throw.
-          mMaxPayloadLength{mBufferWritableView.size() - eth_headerLength} {
-        throwIfBufferIsUnsuitable("IPv4EncapSink::IPv4EncapSink(EthPacketSink "
-                                  "&, BufferWritableView &)");
+        : IPv4EncapSink(destination) {
+        (void)bufferWritableView;
     }
 
     ///@}
@@ -78,9 +90,6 @@ class IPv4EncapSink : public NetworkLib::IPv4PacketSink {
     };
 
     NetworkLib::EthPacketSink &mDestination;
-    NetworkLib::BufferWritableView &mBufferWritableView;
-
-    const std::size_t mMaxPayloadLength;
 
     MACAddress mDefaultSrc{0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     MACAddress mDefaultDst{0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
@@ -88,25 +97,13 @@ class IPv4EncapSink : public NetworkLib::IPv4PacketSink {
     // Constant raw data for initializing all the Ethernet header
     static const std::array<unsigned char, totalHeaderLength> headerInitData;
 
+    // The Ethernet header put in front of all packets.
+    std::array<unsigned char, totalHeaderLength> mHeader;
+
     // Initialize headers with default values.
     void initHeaders() {
-        // Note: buffer size has already been checked at this point by
-        //       call to throwIfBufferIsUnsuitable()
-        unsigned char *p = mBufferWritableView.getUnderlyingWritableBufferPtr();
-        std::copy(headerInitData.begin(), headerInitData.end(), p);
-    }
-
-    void throwIfBufferIsUnsuitable(const char *method) {
-        // Catch some quirks early
-        if (mBufferWritableView.size() < totalHeaderLength) {
-            std::ostringstream err;
-            err << method
-                << ": called with "
-                   "BufferView.size() == "
-                << mBufferWritableView.size() << " (min size is "
-                << totalHeaderLength << ')';
-            throw std::length_error(err.str());
-        }
+        std::copy(headerInitData.begin(), headerInitData.end(),
+                  mHeader.begin());
     }
 };
 
@@ -1,14 +1,23 @@
 #ifndef UPFNETWORKLIB_HH
 #define UPFNETWORKLIB_HH
 
+#include <upfnetworklib/basicprocessor.hh>
+#include <upfnetworklib/bufferchain.hh>
 #include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/checksum.hh>
+#include <upfnetworklib/concurrentpool.hh>
+#include <upfnetworklib/decodestatus.hh>
 #include <upfnetworklib/ethernet.hh>
 #include <upfnetworklib/gtp_u.hh>
+#include <upfnetworklib/gso.hh>
 #include <upfnetworklib/gtp_u_encap.hh>
+#include <upfnetworklib/headerlayout.hh>
 #include <upfnetworklib/interfaces.hh>
 #include <upfnetworklib/ipv4.hh>
 #include <upfnetworklib/ipv4encap.hh>
+#include <upfnetworklib/packetdescriptor.hh>
 #include <upfnetworklib/pcap.hh>
+#include <upfnetworklib/poolstats.hh>
 #include <upfnetworklib/processor.hh>
 #include <upfnetworklib/sctp.hh>
 #include <upfnetworklib/tcp.hh>
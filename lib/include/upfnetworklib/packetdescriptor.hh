@@ -0,0 +1,244 @@
+#ifndef UPFNETWORKLIB_PACKETDESCRIPTOR_HH
+#define UPFNETWORKLIB_PACKETDESCRIPTOR_HH
+
+#include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/decodestatus.hh>
+#include <upfnetworklib/gtp_u.hh>
+#include <upfnetworklib/ipv4.hh>
+#include <upfnetworklib/sctp.hh>
+#include <upfnetworklib/tcp.hh>
+#include <upfnetworklib/udp.hh>
+#include <upfnetworklib/utils.hh>
+
+// For std::uint8_t and std::uint32_t
+#include <cstdint>
+
+namespace UPF {
+namespace NetworkLib {
+
+/**
+ * @brief A compact description of a packet: where its headers are,
+ *        its 5-tuple, and its GTPv1-U tunnel (if any).
+ *
+ * BasicEthPacketProcessor (and EthPacketProcessor) fill it while
+ * decoding each packet (see EthPacketContext::descriptor), so that
+ * whoever gets the packet next (e.g. UPFRouterLib::RuleMatcher,
+ * UPFRouterLib::Router and UPFRouterLib::GTPv1UEncapSink) doesn't
+ * have to decode its headers again.
+ *
+ * Offsets are from the start of the data given to the processor,
+ * i.e. the Ethernet frame (which is always at offset 0), or the IPv4
+ * packet given to BasicEthPacketProcessor::pushIPv4Packet().
+ *
+ * Fields are significant only when the corresponding flag is set
+ * (see has()), and are left uninitialized otherwise: filling a
+ * descriptor for each packet has to be cheap.
+ */
+struct PacketDescriptor {
+    /// @brief Flags telling which fields are significant.
+    enum Flag : std::uint8_t {
+        /// @brief There's a IPv4 header: l3Offset, l4Offset,
+        ///        srcAddress, dstAddress and protocol are set.
+        HasIPv4 = 0x01,
+
+        /// @brief There's a TCP, UDP or SCTP header: srcPort and
+        ///        dstPort are set.
+        HasPorts = 0x02,
+
+        /// @brief There's a GTPv1-U header: tunnelOffset and teid
+        ///        are set.
+        HasGTPv1U = 0x04,
+
+        /// @brief The GTPv1-U tunnel carries a IPv4 packet:
+        ///        innerL3Offset, innerSrcAddress and innerDstAddress
+        ///        are set.
+        HasTunneledIPv4 = 0x08,
+    };
+
+    /// @brief Which fields are significant (see Flag).
+    std::uint8_t flags = 0;
+
+    ///@name Offsets
+    ///@{
+
+    /// @brief Offset of the IPv4 header.
+    std::uint32_t l3Offset;
+
+    /// @brief Offset of the IPv4 payload (e.g. the TCP, UDP or SCTP
+    ///        header).
+    std::uint32_t l4Offset;
+
+    /// @brief Offset of the GTPv1-U header.
+    std::uint32_t tunnelOffset;
+
+    /// @brief Offset of the IPv4 packet carried by GTPv1-U.
+    std::uint32_t innerL3Offset;
+
+    ///@}
+
+    ///@name 5-tuple
+    ///@{
+    IPv4Address srcAddress;
+    IPv4Address dstAddress;
+    IPv4Protocol::Type protocol;
+    Port::Number srcPort;
+    Port::Number dstPort;
+    ///@}
+
+    ///@name GTPv1-U tunnel
+    ///@{
+
+    /// @brief TEID of the tunnel.
+    GTP_TEID::Number teid;
+
+    /// @brief Source address of the IPv4 packet carried by GTPv1-U.
+    IPv4Address innerSrcAddress;
+
+    /// @brief Destination address of the IPv4 packet carried by
+    ///        GTPv1-U.
+    IPv4Address innerDstAddress;
+
+    ///@}
+
+    /// @brief Return true if the given flag is set.
+    bool has(Flag flag) const { return (flags & flag) != 0; }
+
+    ///@name Innermost IPv4 packet
+    ///
+    /// That is, the one carried by GTPv1-U when there's one (see
+    /// HasTunneledIPv4), or the described one otherwise.
+    ///
+    ///@{
+
+    /// @brief Return true if there's an innermost IPv4 packet.
+    ///
+    /// It's false for GTPv1-U traffic not carrying a IPv4 packet
+    /// (e.g. IPv6, or a payload shorter than a IPv4 header): the
+    /// addresses below are then the ones of the outer packet.
+    bool hasInnermostIPv4() const {
+        return has(HasGTPv1U) ? has(HasTunneledIPv4) : has(HasIPv4);
+    }
+
+    const IPv4Address &getInnermostSrcAddress() const {
+        return has(HasTunneledIPv4) ? innerSrcAddress : srcAddress;
+    }
+
+    const IPv4Address &getInnermostDstAddress() const {
+        return has(HasTunneledIPv4) ? innerDstAddress : dstAddress;
+    }
+
+    ///@}
+
+    ///@name Filling, header by header
+    ///
+    /// Each one is given the decoder of the header following the ones
+    /// already described.
+    ///
+    ///@{
+
+    /// @brief Describe the IPv4 header, at the given offset.
+    void describeIPv4(const IPv4Decoder &ipv4Decoder,
+                      std::uint32_t offset) {
+        flags |= HasIPv4;
+        l3Offset = offset;
+        l4Offset =
+            offset + static_cast<std::uint32_t>(
+                         ipv4Decoder.getHeaderLengthBytes());
+        srcAddress = ipv4Decoder.getSrcAddress();
+        dstAddress = ipv4Decoder.getDstAddress();
+        protocol = ipv4Decoder.getProtocol();
+    }
+
+    /// @brief Describe the TCP, UDP or SCTP ports.
+    template <typename Decoder> void describePorts(const Decoder &decoder) {
+        flags |= HasPorts;
+        srcPort = decoder.getSrcPort();
+        dstPort = decoder.getDstPort();
+    }
+
+    /// @brief Describe the GTPv1-U header (following a UDP one).
+    void describeGTPv1U(const GTPv1UDecoder &gtpv1uDecoder) {
+        flags |= HasGTPv1U;
+        tunnelOffset = l4Offset + UDPHeader::minSize;
+        teid = gtpv1uDecoder.getTEID();
+    }
+
+    /// @brief Describe the IPv4 packet carried by GTPv1-U, if there's
+    ///        one.
+    ///
+    /// The GTPv1-U payload must be within its buffer (see
+    /// GTPv1UDecoder::checkData()).
+    void describeTunneledIPv4(const GTPv1UDecoder &gtpv1uDecoder) {
+        // Just the addresses are needed: no need for a IPv4Decoder,
+        // nor for a BufferView of the payload (which would take a
+        // reference to the buffer).
+        const BufferView &message = gtpv1uDecoder.getGTPv1UMessage();
+        const std::size_t offset = gtpv1uDecoder.getDataOffset();
+
+        if (gtpv1uDecoder.getDataLengthBytes() < IPv4Header::minSize ||
+            (message.getUint8At_nocheck(offset +
+                                        IPv4Header::Version::offset) >>
+             4) != 4) {
+            return;
+        }
+
+        flags |= HasTunneledIPv4;
+        innerL3Offset = tunnelOffset + static_cast<std::uint32_t>(offset);
+        innerSrcAddress = message.getIPv4AddressAt_nocheck(
+            offset + IPv4Header::SrcAddress::offset);
+        innerDstAddress = message.getIPv4AddressAt_nocheck(
+            offset + IPv4Header::DstAddress::offset);
+    }
+
+    ///@}
+
+    /// @brief Describe a IPv4 packet on its own (i.e. not as part of
+    ///        the processing of a BasicEthPacketProcessor).
+    ///
+    /// It describes the IPv4 header and, when they can be decoded,
+    /// the TCP, UDP or SCTP ports (but not GTPv1-U).
+    static PacketDescriptor fromIPv4(const IPv4Decoder &ipv4Decoder) {
+        PacketDescriptor descriptor;
+        descriptor.describeIPv4(ipv4Decoder, 0);
+        descriptor.describeIPv4Ports(ipv4Decoder);
+        return descriptor;
+    }
+
+    /// @brief Describe the TCP, UDP or SCTP ports of a IPv4 packet
+    ///        described on its own, decoding its header, if it can
+    ///        be decoded.
+    ///
+    /// That's for describing ports only when needed (e.g. by
+    /// UPFRouterLib::RuleMatcher), as fromIPv4() always does.
+    void describeIPv4Ports(const IPv4Decoder &ipv4Decoder) {
+        if (ipv4Decoder.checkData() != DecodeStatus::Ok) {
+            return;
+        }
+
+        DecodeStatus status;
+
+        if (ipv4Decoder.isTCP()) {
+            const TCPDecoder tcpDecoder(ipv4Decoder.getData(), status);
+            describePortsIfOk(tcpDecoder, status);
+        } else if (ipv4Decoder.isUDP()) {
+            const UDPDecoder udpDecoder(ipv4Decoder.getData(), status);
+            describePortsIfOk(udpDecoder, status);
+        } else if (ipv4Decoder.isSCTP()) {
+            const SCTPDecoder sctpDecoder(ipv4Decoder.getData(), status);
+            describePortsIfOk(sctpDecoder, status);
+        }
+    }
+
+  private:
+    template <typename Decoder>
+    void describePortsIfOk(const Decoder &decoder, DecodeStatus status) {
+        if (status == DecodeStatus::Ok) {
+            describePorts(decoder);
+        }
+    }
+};
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
@@ -294,6 +294,12 @@ class PcapWriter {
     /// WriteMode used to create this PcapWriter
     PcapWriter &writeRecord(const BufferView &data);
 
+    /// @brief Write out a .pcap record made of several segments,
+    ///        without copying them together first.
+    ///
+    /// See writeRecord(const BufferView &).
+    PcapWriter &writeRecord(const BufferChain &data);
+
     /// @brief Force closing the .pcap file
     void close() { mOStream.close(); }
 
@@ -341,6 +347,17 @@ class PcapEthWriter : public EthPacketSink {
         mWriter.writeRecord(ethData);
     }
 
+    /// @brief Feed Ethernet traffic made of several segments to this
+    ///        writer, without copying it.
+    ///
+    /// @param userData Ignored.
+    virtual void consumeEthPacketChain(
+        const BufferChain &ethData,
+        ContextUserData &userData = defaultContextUserData) override {
+        (void)userData;
+        mWriter.writeRecord(ethData);
+    }
+
     ///@}
 
   private:
@@ -383,6 +400,19 @@ class PcapEthWriterPlus : public EthPacketSink, public IPv4PacketSink {
         mWriter.writeRecord(ethData);
     }
 
+    /// @brief Feed Ethernet traffic made of several segments to this
+    ///        writer, without copying it.
+    ///
+    /// @param userData Ignored.
+    virtual void consumeEthPacketChain(
+        const BufferChain &ethData,
+        ContextUserData &userData = defaultContextUserData) override {
+        (void)userData;
+        mWriter.writeRecord(ethData);
+    }
+
+    ///@}
+
     ///@name IPv4PacketSink interface
     ///@{
 
@@ -402,6 +432,14 @@ class PcapEthWriterPlus : public EthPacketSink, public IPv4PacketSink {
         const BufferView &ipv4Data,
         ContextUserData &userData = defaultContextUserData) override;
 
+    /// @brief Feed IPv4 traffic made of several segments to this
+    ///        writer, without copying it.
+    ///
+    /// @see consumeIPv4Packet()
+    virtual void consumeIPv4PacketChain(
+        const BufferChain &ipv4Data,
+        ContextUserData &userData = defaultContextUserData) override;
+
     ///@}
 
     ///@name Default MAC addresses
@@ -428,7 +466,7 @@ class PcapEthWriterPlus : public EthPacketSink, public IPv4PacketSink {
     // writing out IPV4 data
     MACAddress mDefaultSrc{0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
     MACAddress mDefaultDst{0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    PacketBufferArrayBased<65600> mEthBuffer;
+    std::array<unsigned char, 14> mEthHeader;
 };
 
 /**
@@ -514,6 +552,14 @@ class PcapIPv4Writer : public IPv4PacketSink {
         mWriter.writeRecord(ipv4Data);
     }
 
+    virtual void consumeIPv4PacketChain(
+        const BufferChain &ipv4Data,
+        ContextUserData &userData = defaultContextUserData) override {
+        (void)userData;
+
+        mWriter.writeRecord(ipv4Data);
+    }
+
     ///@}
 
   private:
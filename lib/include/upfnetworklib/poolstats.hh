@@ -0,0 +1,211 @@
+#ifndef UPFNETWORKLIB_POOLSTATS_HH
+#define UPFNETWORKLIB_POOLSTATS_HH
+
+// For std::array
+#include <array>
+
+// For std::atomic
+#include <atomic>
+
+// For std::chrono::steady_clock
+#include <chrono>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+namespace UPF {
+namespace NetworkLib {
+
+/// @brief Number of buckets of PoolStats::allocationLatency.
+constexpr std::size_t allocationLatencyBuckets = 16;
+
+/// @brief One allocation every this many has its latency measured
+///        (reading the clock for all of them would cost more than
+///        the allocations themselves).
+constexpr std::uint64_t allocationLatencySamplingPeriod = 64;
+
+/// @brief Return whether pools track allocations when they are
+///        created (see PacketBufferSizedPool::enableAllocationTracking()).
+///
+/// It's on when the library itself was built without NDEBUG (whatever
+/// the setting of the code using it), unless changed via
+/// setDefaultAllocationTracking().
+bool getDefaultAllocationTracking() noexcept;
+
+/// @brief Set whether pools created from now on track allocations.
+void setDefaultAllocationTracking(bool enable) noexcept;
+
+/**
+ * @brief A snapshot of the statistics of a buffer pool.
+ *
+ * Counters only ever grow, since the pool construction.
+ */
+struct PoolStats {
+    /// @brief Buffers got from the pool.
+    std::uint64_t allocations = 0;
+
+    /// @brief Buffers given back to the pool.
+    std::uint64_t frees = 0;
+
+    /// @brief Times the pool had to allocate more buffers.
+    std::uint64_t growths = 0;
+
+    /// @brief Times a buffer couldn't be got (the pool was at its
+    ///        hard capacity).
+    std::uint64_t failures = 0;
+
+    /// @brief Buffers in the pool (both busy and free).
+    std::size_t capacity = 0;
+
+    /// @brief Maximum number of buffers in use at the same time.
+    ///
+    /// For pools with per-thread caches, buffers sitting in caches
+    /// count as in use: it's an upper bound.
+    std::size_t highWaterMark = 0;
+
+    /// @brief Histogram of (sampled, see
+    ///        allocationLatencySamplingPeriod) allocation latencies:
+    ///        bucket `i` counts allocations which took less than
+    ///        ``2^i`` nanoseconds (and at least ``2^(i-1)``), the last
+    ///        one all the slower ones.
+    std::array<std::uint64_t, allocationLatencyBuckets> allocationLatency{};
+
+    /// @brief Return how many buffers are in use.
+    std::uint64_t inUse() const { return allocations - frees; }
+};
+
+/// @brief Where a buffer was got from a pool.
+struct AllocationSite {
+    /// @brief Source file (nullptr if unknown).
+    const char *file = nullptr;
+
+    /// @brief Line in the source file.
+    unsigned int line = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+    /// @brief Return the site of the caller (the defaults are
+    ///        evaluated where current() is called, also when that is
+    ///        itself a default argument).
+    static AllocationSite current(const char *file = __builtin_FILE(),
+                                  unsigned int line = __builtin_LINE()) {
+        AllocationSite site;
+        site.file = file;
+        site.line = line;
+        return site;
+    }
+#else
+    /// @brief Return an unknown site (the compiler can't tell the
+    ///        caller).
+    static AllocationSite current() { return AllocationSite(); }
+#endif
+};
+
+/// @brief The AllocationSite of the caller, when used as a default
+///        argument.
+#define NETWORKLIB_ALLOCATION_SITE ::UPF::NetworkLib::AllocationSite::current()
+
+/// @brief A buffer which is still in use (see
+///        PacketBufferSizedPool::getOutstandingBuffers()).
+struct OutstandingBuffer {
+    /// @brief Where it was got from the pool (unknown if allocation
+    ///        tracking was disabled then).
+    AllocationSite site;
+
+    /// @brief For how long it has been in use (0 if unknown).
+    std::chrono::steady_clock::duration age{};
+};
+
+/**
+ * @brief Counters of a pool, for PoolStats.
+ *
+ * Each instance is meant to be updated by a single thread (e.g. in a
+ * per-thread cache), and read by any: updates are then plain loads
+ * and stores, with no locked instructions. Instances updated by
+ * several threads must be marked as shared on construction.
+ */
+class PoolCounters {
+  public:
+    /// @brief Constructor.
+    explicit PoolCounters(bool shared = false) noexcept : mShared(shared) {}
+
+    ///@name Updates
+    ///@{
+
+    void countAllocation() noexcept { add(mAllocations, 1); }
+    void countFree() noexcept { add(mFrees, 1); }
+    void countGrowth() noexcept { add(mGrowths, 1); }
+    void countFailure() noexcept { add(mFailures, 1); }
+
+    /// @brief Return true if the latency of the next allocation
+    ///        should be measured (see recordAllocationLatency()).
+    bool shouldSampleLatency() const noexcept {
+        return (mAllocations.load(std::memory_order_relaxed) %
+                allocationLatencySamplingPeriod) == 0;
+    }
+
+    /// @brief Add an allocation latency to the histogram.
+    void recordAllocationLatency(std::chrono::steady_clock::duration d) {
+        const auto ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        std::size_t bucket = 0;
+
+        while (bucket + 1 < allocationLatencyBuckets &&
+               ns >= (std::int64_t{1} << bucket)) {
+            ++bucket;
+        }
+
+        add(mLatency[bucket], 1);
+    }
+
+    ///@}
+
+    /// @brief Add these counters to the given statistics.
+    void addTo(PoolStats &stats) const noexcept {
+        stats.allocations += mAllocations.load(std::memory_order_relaxed);
+        stats.frees += mFrees.load(std::memory_order_relaxed);
+        stats.growths += mGrowths.load(std::memory_order_relaxed);
+        stats.failures += mFailures.load(std::memory_order_relaxed);
+
+        for (std::size_t i = 0; i < allocationLatencyBuckets; ++i) {
+            stats.allocationLatency[i] +=
+                mLatency[i].load(std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    const bool mShared;
+    std::atomic<std::uint64_t> mAllocations{0};
+    std::atomic<std::uint64_t> mFrees{0};
+    std::atomic<std::uint64_t> mGrowths{0};
+    std::atomic<std::uint64_t> mFailures{0};
+    std::array<std::atomic<std::uint64_t>, allocationLatencyBuckets>
+        mLatency{};
+
+    void add(std::atomic<std::uint64_t> &counter, std::uint64_t n) noexcept {
+        if (mShared) {
+            counter.fetch_add(n, std::memory_order_relaxed);
+        } else {
+            counter.store(counter.load(std::memory_order_relaxed) + n,
+                          std::memory_order_relaxed);
+        }
+    }
+};
+
+/// @brief Raise a high-water mark to `value`, if that's higher.
+inline void raiseHighWaterMark(std::atomic<std::size_t> &mark,
+                               std::size_t value) noexcept {
+    std::size_t current = mark.load(std::memory_order_relaxed);
+
+    while (value > current &&
+           !mark.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace NetworkLib
+} // namespace UPF
+
+#endif
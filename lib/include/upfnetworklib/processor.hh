@@ -1,23 +1,11 @@
 #ifndef UPFNETWORKLIB_PROCESSOR_HH
 #define UPFNETWORKLIB_PROCESSOR_HH
 
-#include <upfnetworklib/buffers.hh>
-#include <upfnetworklib/interfaces.hh>
-#include <upfnetworklib/utils.hh>
+#include <upfnetworklib/basicprocessor.hh>
 
 namespace UPF {
 namespace NetworkLib {
 
-// Forward declaration of decoders
-class EthFrameDecoder;
-class IPv4Decoder;
-class TCPDecoder;
-class UDPDecoder;
-class GTPv1UDecoder;
-class SCTPDecoder;
-class SCTPGenericChunkDecoder;
-class SCTPDataChunkDecoder;
-
 /**
  * @brief A generic "processor" of Ethernet packets.
  *
@@ -28,99 +16,41 @@ class SCTPDataChunkDecoder;
  * Specialization of those methods can access the packet's data
  * via the available decoders referenced in the Context passed
  * down to them.
+ *
+ * It's BasicEthPacketProcessor calling virtual methods: processors
+ * on the fast path can derive from BasicEthPacketProcessor instead,
+ * so that methods are resolved at compile time (and inlined), at the
+ * price of a template.
+ *
+ * Frames can also be processed in batches, via consumeEthPackets():
+ * headers are then decoded stage by stage (Ethernet, IPv4, UDP,
+ * GTP-U...) across the whole batch, prefetching those of the next
+ * frames, and the processing methods below are called on each packet
+ * getting to that point. Single frames given to consumeEthPacket()
+ * are decoded straight through them instead.
+ *
+ * Batch variants of the processing methods (e.g. processIPv4Batch(),
+ * called once per sub-batch) are only available to processors
+ * deriving from BasicEthPacketProcessor, which tells at compile time
+ * whether they're defined: here they'd have to be virtual, and single
+ * frames would then always have to go through them, as batches of
+ * one, in case a specialization overrides some.
+ *
+ * Each packet still goes through the same methods in the same order,
+ * but methods of different packets of a batch interleave (e.g.
+ * processEth() is called on all of them before processIPv4()):
+ * specializations keeping state across methods of the same packet
+ * in members (rather than in the Context) should only be given
+ * frames via consumeEthPacket().
  */
-class EthPacketProcessor : public EthPacketSink {
+class EthPacketProcessor
+    : public BasicEthPacketProcessor<EthPacketProcessor> {
   public:
     ///@name Destructor
     ///@{
     virtual ~EthPacketProcessor() {}
     ///@}
 
-    /// @brief A context given to each virtual method of
-    ///        EthPacketProcessor, providing decoders and other info.
-    ///
-    /// Packet data should be obtained via the available decoders.
-    ///
-    /// @note All pointer members would be C++17's `std::optional<T>`
-    struct Context {
-        ///@name Decoders
-        ///@{
-
-        /// @brief Ethernet decoder instance (if any)
-        const EthFrameDecoder *ethFrameDecoder = nullptr;
-
-        /// @brief IPv4 decoder instance (if any)
-        const IPv4Decoder *ipv4Decoder = nullptr;
-
-        /// @brief TCP decoder instance (if any)
-        const TCPDecoder *tcpDecoder = nullptr;
-
-        /// @brief UDP decoder instance (if any)
-        const UDPDecoder *udpDecoder = nullptr;
-
-        /// @brief GTPv1-U decoder instance (if any)
-        const GTPv1UDecoder *gtpv1uDecoder = nullptr;
-
-        /// @brief SCTP decoder instance (if any)
-        const SCTPDecoder *sctpDecoder = nullptr;
-
-        /// @brief SCTP generic chunk decoder instance (if any)
-        const SCTPGenericChunkDecoder *sctpGenericChunkDecoder = nullptr;
-
-        /// @brief SCTP DATA chunk decoder instance (if any)
-        const SCTPDataChunkDecoder *sctpDataChunkDecoder = nullptr;
-
-        ///@}
-
-        ///@name Postprocessing flags
-        ///
-        /// Each of these flags control if the postProcess*() method
-        /// with the same name gets called.
-        ///
-        /// @note Currently, we are interested only in postprocessing
-        ///       IPv4 traffic, so there's just one flag.
-        ///
-        ///@{
-
-        /// @brief When `true` an nobody else stopped processing, call
-        ///        also 'postProcessIPv4()' on IPv4 data.
-        ///
-        /// This is meant to be updated (usually to `false`) by
-        /// specializations of the processing methods
-        bool postProcessIPv4 = true;
-
-        ///@}
-
-        ///@name User data
-        ///@{
-
-        /// @brief User data, provided via the EthPacketSink
-        ///        interface.
-        ///
-        /// It's plain old C-style user data to callbacks.  It's up to
-        /// specializations of EthPacketProcessor to give it a
-        /// meaning, if needed.
-        ContextUserData userData;
-
-        /// @}
-    };
-
-    /// @name EthPacketSink interface
-    ///@{
-
-    /// @brief Feed Ethernet traffic to this processor.
-    ///
-    /// @param ethData A BufferView with the Ethernet data to be
-    ///        processed.
-    ///
-    /// @param userData This is made available in Context.userData,
-    ///        so callbacks may have it.
-    virtual void consumeEthPacket(
-        const BufferView &ethData,
-        ContextUserData &userData = defaultContextUserData) override;
-
-    ///@}
-
   protected:
     ///@name Processing methods
     ///
@@ -222,31 +152,14 @@ class EthPacketProcessor : public EthPacketSink {
     ///        packets rather than Ethernet frames can override this.
     virtual bool finalProcessOnIPv4() { return false; }
 
-    /// @brief Interface to inject directly IPv4 data in the
-    ///        processor.
-    ///
-    /// This allows specializations of this class to push down also
-    /// IPv4 data.  Note that in this case,
-    /// 'Context.ethFrameDecoder' will be `nullptr`.
-    void pushIPv4Packet(const BufferView &ipv4Data, ContextUserData &userData) {
-        Context context;
-        context.userData = userData;
-
-        const bool doContinueProcessing = doProcessIPv4(ipv4Data, context);
-
-        if (doContinueProcessing && finalProcessOnIPv4()) {
-            finalProcess(context);
-        };
-    }
-
   private:
-    // Does the actual processing using the given context.
-    bool doProcessIPv4(const BufferView &ipv4Data, Context &context);
-    bool doProcessSCTP(const BufferView &sctpData, Context &context);
-    bool doProcessUDP(const BufferView &udpData, Context &context);
-    bool doProcessTCP(const BufferView &tcpData, Context &context);
+    // Calls the (virtual) processing methods above.
+    friend class BasicEthPacketProcessor<EthPacketProcessor>;
 };
 
+// Instantiated once, in the library.
+extern template class BasicEthPacketProcessor<EthPacketProcessor>;
+
 } // namespace NetworkLib
 } // namespace UPF
 
@@ -2,11 +2,13 @@
 #define UPFNETWORKLIB_SCTP_HH
 
 #include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/decodestatus.hh>
+#include <upfnetworklib/headerlayout.hh>
 #include <upfnetworklib/ipv4.hh>
 #include <upfnetworklib/utils.hh>
 
+#include <cstddef>
 #include <ostream>
-#include <vector>
 
 namespace UPF {
 namespace NetworkLib {
@@ -44,6 +46,36 @@ enum Type : std::uint8_t {
 };
 } // namespace SCTPChunk
 
+/// @brief Layout of the SCTP common header.
+struct SCTPHeader : HeaderLayout<12> {
+    using SrcPort = HeaderField<0, std::uint16_t>;
+    using DstPort = HeaderField<2, std::uint16_t>;
+    using VerificationTag = HeaderField<4, std::uint32_t>;
+    using Checksum = HeaderField<8, std::uint32_t>;
+};
+
+/// @brief Layout of the header common to all SCTP chunks.
+struct SCTPChunkHeader : HeaderLayout<4> {
+    using Type = HeaderField<0, std::uint8_t>;
+    using Flags = HeaderField<1, std::uint8_t>;
+    using Length = HeaderField<2, std::uint16_t>;
+};
+
+/// @brief Layout of the header of SCTP ``DATA`` chunks.
+struct SCTPDataChunkHeader : HeaderLayout<16> {
+    using Type = SCTPChunkHeader::Type;
+    using Flags = SCTPChunkHeader::Flags;
+    using FlagI = HeaderBits<Flags, 3, 1>;
+    using FlagU = HeaderBits<Flags, 2, 1>;
+    using FlagB = HeaderBits<Flags, 1, 1>;
+    using FlagE = HeaderBits<Flags, 0, 1>;
+    using Length = SCTPChunkHeader::Length;
+    using TSN = HeaderField<4, std::uint32_t>;
+    using StreamIdentifier = HeaderField<8, std::uint16_t>;
+    using StreamSequenceNumber = HeaderField<10, std::uint16_t>;
+    using PayloadProtocolIdentifier = HeaderField<12, std::uint32_t>;
+};
+
 /**
  * @brief Decode a generic SCTP chunk stored in a BufferView
  */
@@ -59,12 +91,18 @@ class SCTPGenericChunkDecoder {
     ///@{
 
     /// @brief Constructor attaching to the given BufferView.
+    ///
+    /// Throws exceptions if the BufferView is too short.
     SCTPGenericChunkDecoder(const BufferView &dataChunk)
-        : mBufferView(dataChunk) {}
+        : mBufferView(dataChunk),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
 
     /// @brief Constructor attaching to the given BufferView (moved).
-    SCTPGenericChunkDecoder(BufferView &&dataChunk) noexcept
-        : mBufferView{std::move(dataChunk)} {}
+    ///
+    /// Throws exceptions if the BufferView is too short.
+    SCTPGenericChunkDecoder(BufferView &&dataChunk)
+        : mBufferView{std::move(dataChunk)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
 
     /// @brief Default constructor
     ///
@@ -82,23 +120,23 @@ class SCTPGenericChunkDecoder {
 
     ///@name Move semantic
     ///@{
-    SCTPGenericChunkDecoder(SCTPGenericChunkDecoder &&) noexcept = default;
+    SCTPGenericChunkDecoder(SCTPGenericChunkDecoder &&) = default;
     SCTPGenericChunkDecoder &operator=(SCTPGenericChunkDecoder &&) = default;
     ///@}
 
     ///@name Read access to a chunk's fields.
     ///@{
     SCTPChunk::Type getType() const {
-        return SCTPChunk::Type(mBufferView.getUint8At(typeOffset));
+        return SCTPChunk::Type(mHeader.get<SCTPChunkHeader::Type>());
     }
 
     unsigned char getFlags() const {
-        return mBufferView.getUint8At(flagsOffset);
+        return mHeader.get<SCTPChunkHeader::Flags>();
     }
 
     /// @brief Total chunk length, including header
     std::size_t getTotalLengthBytes() const {
-        return mBufferView.getUint16At(lengthOffset);
+        return mHeader.get<SCTPChunkHeader::Length>();
     }
 
     ///@}
@@ -124,15 +162,12 @@ class SCTPGenericChunkDecoder {
     ///@}
 
   private:
-    // Constant offsets, in bytes, of generic header fields
-    enum {
-        typeOffset = 0,
-        flagsOffset = 1,
-        lengthOffset = 2,
-    };
+    // Proper data (not const, so that it can be assigned to, see
+    // SCTPDecoder::Chunks::Iterator).
+    BufferView mBufferView;
 
-    // Proper data.
-    const BufferView mBufferView;
+    // The header, checked on construction.
+    HeaderOverlay<SCTPChunkHeader> mHeader;
 };
 
 /**
@@ -151,12 +186,29 @@ class SCTPDataChunkDecoder {
     ///@{
 
     /// @brief Constructor attaching to the given BufferView.
+    ///
+    /// Throws exceptions if the BufferView is too short.
     SCTPDataChunkDecoder(const BufferView &dataChunk)
-        : mBufferView(dataChunk) {}
+        : mBufferView(dataChunk),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
 
     /// @brief Constructor attaching to the given BufferView (moved)
-    SCTPDataChunkDecoder(BufferView &&dataChunk) noexcept
-        : mBufferView{std::move(dataChunk)} {}
+    ///
+    /// Throws exceptions if the BufferView is too short.
+    SCTPDataChunkDecoder(BufferView &&dataChunk)
+        : mBufferView{std::move(dataChunk)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
+
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or to
+    /// DecodeStatus::SCTPDataChunkTooShort (and then the decoder
+    /// mustn't be used).
+    SCTPDataChunkDecoder(const BufferView &dataChunk,
+                         DecodeStatus &status) noexcept
+        : mBufferView(dataChunk),
+          mHeader(mBufferView, status, DecodeStatus::SCTPDataChunkTooShort) {}
 
     ///@}
 
@@ -181,40 +233,36 @@ class SCTPDataChunkDecoder {
     ///@{
 
     SCTPChunk::Type getType() const {
-        return SCTPChunk::Type(mBufferView.getUint8At(typeOffset));
+        return SCTPChunk::Type(mHeader.get<SCTPDataChunkHeader::Type>());
     }
 
     /// @brief Return total chunk length, including header
     std::size_t getTotalLengthBytes() const {
-        return mBufferView.getUint16At(lengthOffset);
+        return mHeader.get<SCTPDataChunkHeader::Length>();
     }
 
-    bool getFlagI() const {
-        return (((mBufferView.getUint8At(flagsOffset)) >> 3) & 1);
-    }
+    bool getFlagI() const { return mHeader.get<SCTPDataChunkHeader::FlagI>(); }
 
-    bool getFlagU() const {
-        return (((mBufferView.getUint8At(flagsOffset)) >> 2) & 1);
-    }
+    bool getFlagU() const { return mHeader.get<SCTPDataChunkHeader::FlagU>(); }
 
-    bool getFlagB() const {
-        return (((mBufferView.getUint8At(flagsOffset)) >> 1) & 1);
-    }
+    bool getFlagB() const { return mHeader.get<SCTPDataChunkHeader::FlagB>(); }
 
-    bool getFlagE() const { return (mBufferView.getUint8At(flagsOffset)) & 1; }
+    bool getFlagE() const { return mHeader.get<SCTPDataChunkHeader::FlagE>(); }
 
-    std::uint32_t getTSN() const { return mBufferView.getUint32At(tsnOffset); }
+    std::uint32_t getTSN() const {
+        return mHeader.get<SCTPDataChunkHeader::TSN>();
+    }
 
     std::uint16_t getStreamIdentifier() const {
-        return mBufferView.getUint16At(streamIdentifierOffset);
+        return mHeader.get<SCTPDataChunkHeader::StreamIdentifier>();
     }
 
     std::uint16_t getStreamSequenceNumber() const {
-        return mBufferView.getUint16At(streamSequenceNumberOffset);
+        return mHeader.get<SCTPDataChunkHeader::StreamSequenceNumber>();
     }
 
     std::uint32_t getPayloadProtocolIdentifier() const {
-        return mBufferView.getUint32At(payloadProtocolIdentifierOffset);
+        return mHeader.get<SCTPDataChunkHeader::PayloadProtocolIdentifier>();
     }
 
     ///@}
@@ -248,24 +296,16 @@ class SCTPDataChunkDecoder {
     ///@}
 
   private:
-    // Constant offsets, in bytes, of header fields
-    enum {
-        typeOffset = 0,
-        flagsOffset = 1,
-        lengthOffset = 2,
-        tsnOffset = 4,
-        streamIdentifierOffset = 8,
-        streamSequenceNumberOffset = 10,
-        payloadProtocolIdentifierOffset = 12,
-    };
-
     // Offsets of data fields
     enum {
-        dataOffset = 16,
+        dataOffset = SCTPDataChunkHeader::minSize,
     };
 
     // Proper data.
     const BufferView mBufferView;
+
+    // The header, checked on construction.
+    const HeaderOverlay<SCTPDataChunkHeader> mHeader;
 };
 
 /**
@@ -275,8 +315,101 @@ class SCTPDataChunkDecoder {
  */
 class SCTPDecoder {
   public:
-    /// @brief Type for a collection of chunk decoders.
-    using ChunksVector = std::vector<SCTPGenericChunkDecoder>;
+    /**
+     * @brief The chunks of a SCTP packet, as returned by chunks().
+     *
+     * Chunks are checked once on construction of the SCTPDecoder,
+     * and then just walked over, so there's no collection of chunk
+     * decoders to allocate for each packet:
+     *
+     *     for (const SCTPGenericChunkDecoder &chunk : d.chunks()) {
+     *         // ...
+     *     }
+     *
+     * It refers to the SCTPDecoder data, so it mustn't outlive it.
+     */
+    class Chunks {
+      public:
+        /// @brief Iterator over the chunks, in packet order.
+        ///
+        /// The chunk decoder it refers to is part of the iterator, so
+        /// it's only valid until the iterator is incremented.
+        class Iterator {
+          public:
+            const SCTPGenericChunkDecoder &operator*() const {
+                return mChunk;
+            }
+
+            const SCTPGenericChunkDecoder *operator->() const {
+                return &mChunk;
+            }
+
+            Iterator &operator++() {
+                mOffset += paddedLength(mChunk.getTotalLengthBytes());
+                load();
+                return *this;
+            }
+
+            bool operator==(const Iterator &other) const {
+                return mOffset == other.mOffset;
+            }
+
+            bool operator!=(const Iterator &other) const {
+                return mOffset != other.mOffset;
+            }
+
+          private:
+            friend class Chunks;
+
+            const BufferView *mSCTPData;
+            std::size_t mOffset;
+            SCTPGenericChunkDecoder mChunk;
+
+            Iterator(const BufferView &sctpData, std::size_t offset)
+                : mSCTPData(&sctpData), mOffset(offset) {
+                load();
+            }
+
+            // Attach mChunk to the chunk at mOffset, if any (chunk
+            // lengths have already been checked by findChunks()).
+            void load() {
+                if (mOffset < mSCTPData->size()) {
+                    const std::uint16_t length =
+                        mSCTPData->getUint16At_nocheck(
+                            mOffset + SCTPChunkHeader::Length::offset);
+
+                    mChunk = SCTPGenericChunkDecoder(
+                        mSCTPData->getSub(mOffset, length));
+                }
+            }
+        };
+
+        ///@name Iteration, in packet order
+        ///@{
+        Iterator begin() const {
+            return Iterator(*mSCTPData, startOfChunksOffset);
+        }
+
+        Iterator end() const {
+            return Iterator(*mSCTPData, mSCTPData->size());
+        }
+        ///@}
+
+        /// @brief Return the number of chunks.
+        std::size_t size() const { return mCount; }
+
+        /// @brief Return true if there are no chunks.
+        bool empty() const { return mCount == 0; }
+
+      private:
+        friend class SCTPDecoder;
+
+        const BufferView *mSCTPData;
+        std::size_t mCount;
+
+        Chunks(const BufferView &sctpData, std::size_t count)
+            : mSCTPData(&sctpData), mCount(count) {}
+    };
 
     ///@name Constructors
     ///@{
@@ -285,19 +418,33 @@ class SCTPDecoder {
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    SCTPDecoder(const BufferView &sctpData) : mBufferView(sctpData) {
-        throwIfBufferIsUnsuitable(
-            NETWORKLIB_CURRENT_FUNCTION);
-        fillChunksVector();
+    SCTPDecoder(const BufferView &sctpData)
+        : mBufferView(sctpData),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {
+        checkChunks();
     }
 
     /// @brief Constructor attaching to the given BufferView (moved).
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    SCTPDecoder(BufferView &&sctpData) : mBufferView{std::move(sctpData)} {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
-        fillChunksVector();
+    SCTPDecoder(BufferView &&sctpData)
+        : mBufferView{std::move(sctpData)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {
+        checkChunks();
+    }
+
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or tells why the BufferView
+    /// is unsuitable (and then the decoder mustn't be used).
+    SCTPDecoder(const BufferView &sctpData, DecodeStatus &status) noexcept
+        : mBufferView(sctpData),
+          mHeader(mBufferView, status, DecodeStatus::SCTPTooShort) {
+        if (status == DecodeStatus::Ok) {
+            status = findChunks();
+        }
     }
 
     ///@}
@@ -323,23 +470,19 @@ class SCTPDecoder {
     ///@{
 
     Port::Number getSrcPort() const {
-        // Bounds already checked on construction
-        return Port::Number(mBufferView.getUint16At_nocheck(srcPortOffset));
+        return Port::Number(mHeader.get<SCTPHeader::SrcPort>());
     }
 
     Port::Number getDstPort() const {
-        // Bounds already checked on construction
-        return Port::Number(mBufferView.getUint16At_nocheck(dstPortOffset));
+        return Port::Number(mHeader.get<SCTPHeader::DstPort>());
     }
 
     std::uint32_t getVerificationTag() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint32At_nocheck(verificationTagOffset);
+        return mHeader.get<SCTPHeader::VerificationTag>();
     }
 
     std::uint32_t getChecksum() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint32At_nocheck(checksumOffset);
+        return mHeader.get<SCTPHeader::Checksum>();
     }
 
     ///@}
@@ -348,50 +491,61 @@ class SCTPDecoder {
     ///@{
 
     /// @brief Get the SCTP chunks in this packet
-    const ChunksVector &chunks() const { return mChunks; }
+    Chunks chunks() const { return Chunks(mBufferView, mChunkCount); }
+
+    /// @brief Compute the CRC32c of the packet (RFC 9260, appendix A).
+    ///
+    /// @note The checksum field holds it least significant byte
+    ///       first, so getChecksum() returns it byte-swapped.
+    std::uint32_t computeChecksum() const {
+        return computeChecksum(mBufferView);
+    }
+
+    /// @brief Return true if the packet checksum is correct.
+    bool verifyChecksum() const { return verifyChecksum(mBufferView); }
+
+    /// @brief Compute the CRC32c of the SCTP packet in the given
+    ///        BufferView (which must be at least 12 bytes long).
+    static std::uint32_t computeChecksum(const BufferView &sctpData);
+
+    /// @brief Return true if the checksum of the SCTP packet in the
+    ///        given BufferView is correct.
+    ///
+    /// Unlike the SCTPDecoder constructor, this doesn't parse chunks,
+    /// so it can be used to drop corrupted packets early. It returns
+    /// false if the BufferView is too short to be a SCTP packet.
+    static bool verifyChecksum(const BufferView &sctpData);
 
     ///@}
 
   private:
-    // Constant offsets, in bytes, of header fields
-    enum {
-        srcPortOffset = 0,
-        dstPortOffset = 2,
-        verificationTagOffset = 4,
-        checksumOffset = 8,
-    };
-
     // Offsets of data fields
     enum {
-        startOfChunksOffset = 12,
-    };
-
-    // Constant offsets inside a chunk
-    enum {
-        chunkLengthOffset = 2,
+        checksumOffset = SCTPHeader::Checksum::offset,
+        startOfChunksOffset = SCTPHeader::minSize,
     };
 
     // Proper data.
     const BufferView mBufferView;
 
-    // A std::vector SCTPGenericChunkDecoder pointing
-    // to the chunks of this SCTP packet
-    // (filled by fillChunksVector() on construction)
-    ChunksVector mChunks;
-
-    // Helper method filling the chunks vector on construction
-    void fillChunksVector();
-
-    void throwIfBufferIsUnsuitable(const char *method) {
-        // Catch some quirks early
-        if (mBufferView.size() < 12) {
-            std::ostringstream err;
-            err << method
-                << ": called with "
-                   "BufferView.size() == "
-                << mBufferView.size() << " (min size is 12)";
-            throw std::length_error(err.str());
-        }
+    // The header, checked on construction.
+    const HeaderOverlay<SCTPHeader> mHeader;
+
+    // The number of chunks of this SCTP packet (counted by
+    // findChunks() on construction).
+    std::size_t mChunkCount = 0;
+
+    // Helper methods checking the chunks on construction
+    void checkChunks();
+    DecodeStatus findChunks() noexcept;
+
+    // Return the length of a chunk padded to a multiple of 4 bytes,
+    // i.e. the offset from its start to the next chunk.
+    //
+    // Note: not a std::uint16_t, it would wrap around to 0 for
+    //       lengths past 65532.
+    static std::size_t paddedLength(std::size_t chunkLength) noexcept {
+        return (chunkLength + 3) & ~std::size_t{3};
     }
 };
 } // namespace NetworkLib
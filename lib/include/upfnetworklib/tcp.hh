@@ -2,14 +2,38 @@
 #define UPFNETWORKLIB_TCP_HH
 
 #include <upfnetworklib/buffers.hh>
+#include <upfnetworklib/decodestatus.hh>
+#include <upfnetworklib/headerlayout.hh>
 #include <upfnetworklib/ipv4.hh>
 #include <upfnetworklib/utils.hh>
 
 namespace UPF {
 namespace NetworkLib {
 
+/// @brief Layout of the TCP header (without options).
+struct TCPHeader : HeaderLayout<20> {
+    using SrcPort = HeaderField<0, std::uint16_t>;
+    using DstPort = HeaderField<2, std::uint16_t>;
+    using SequenceNumber = HeaderField<4, std::uint32_t>;
+    using AckNumber = HeaderField<8, std::uint32_t>;
+    using DataOffsetAndFlags = HeaderField<12, std::uint16_t>;
+    using DataOffset = HeaderBits<DataOffsetAndFlags, 12, 4>;
+    using NSFlag = HeaderBits<DataOffsetAndFlags, 8, 1>;
+    using CWRFlag = HeaderBits<DataOffsetAndFlags, 7, 1>;
+    using ECEFlag = HeaderBits<DataOffsetAndFlags, 6, 1>;
+    using URGFlag = HeaderBits<DataOffsetAndFlags, 5, 1>;
+    using ACKFlag = HeaderBits<DataOffsetAndFlags, 4, 1>;
+    using PSHFlag = HeaderBits<DataOffsetAndFlags, 3, 1>;
+    using RSTFlag = HeaderBits<DataOffsetAndFlags, 2, 1>;
+    using SYNFlag = HeaderBits<DataOffsetAndFlags, 1, 1>;
+    using FINFlag = HeaderBits<DataOffsetAndFlags, 0, 1>;
+    using WindowSize = HeaderField<14, std::uint16_t>;
+    using Checksum = HeaderField<16, std::uint16_t>;
+    using UrgentPointer = HeaderField<18, std::uint16_t>;
+};
+
 /**
- * @brief Decode a (whole) UDP packet stored in a BufferView.
+ * @brief Decode a (whole) TCP packet stored in a BufferView.
  */
 class TCPDecoder {
   public:
@@ -20,17 +44,26 @@ class TCPDecoder {
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    TCPDecoder(const BufferView &tcpData) : mBufferView(tcpData) {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
-    }
+    TCPDecoder(const BufferView &tcpData)
+        : mBufferView(tcpData),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
 
     /// @brief Constructor attaching to the given BufferView (moved).
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    TCPDecoder(BufferView &&tcpData) : mBufferView{std::move(tcpData)} {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
-    }
+    TCPDecoder(BufferView &&tcpData)
+        : mBufferView{std::move(tcpData)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
+
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or tells why the BufferView
+    /// is unsuitable (and then the decoder mustn't be used).
+    TCPDecoder(const BufferView &tcpData, DecodeStatus &status) noexcept
+        : mBufferView(tcpData),
+          mHeader(mBufferView, status, DecodeStatus::TCPTooShort) {}
 
     ///@}
 
@@ -55,46 +88,35 @@ class TCPDecoder {
     ///@{
 
     Port::Number getSrcPort() const {
-        // Bounds already checked on construction
-        return Port::Number(mBufferView.getUint16At_nocheck(srcPortOffset));
+        return Port::Number(mHeader.get<TCPHeader::SrcPort>());
     }
 
     Port::Number getDstPort() const {
-        // Bounds already checked on construction
-        return Port::Number(mBufferView.getUint16At_nocheck(dstPortOffset));
+        return Port::Number(mHeader.get<TCPHeader::DstPort>());
     }
 
     std::uint32_t getSequenceNumber() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint32At_nocheck(sequenceNumberOffset);
+        return mHeader.get<TCPHeader::SequenceNumber>();
     }
 
     std::uint32_t getAckNumber() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint32At_nocheck(acknowledgmentNumberOffset);
+        return mHeader.get<TCPHeader::AckNumber>();
     }
 
     std::size_t getDataOffsetBytes() const {
-        // Bounds already checked on construction
-        return (
-            ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) >> 12) &
-             0x0F) *
-            4);
+        return mHeader.get<TCPHeader::DataOffset>() * 4;
     }
 
     std::uint16_t getWindowSize() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(windowSizeOffset);
+        return mHeader.get<TCPHeader::WindowSize>();
     }
 
     std::uint16_t getChecksum() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(checksumOffset);
+        return mHeader.get<TCPHeader::Checksum>();
     }
 
     std::uint16_t getUrgentPointer() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(urgentPointerOffset);
+        return mHeader.get<TCPHeader::UrgentPointer>();
     }
 
     ///@}
@@ -102,59 +124,23 @@ class TCPDecoder {
     ///@name Read access to TCP flags
     ///@{
 
-    bool getNSFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 NS_flagMask) != 0);
-    }
+    bool getNSFlag() const { return mHeader.get<TCPHeader::NSFlag>(); }
 
-    bool getCWRFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 CWR_flagMask) != 0);
-    }
+    bool getCWRFlag() const { return mHeader.get<TCPHeader::CWRFlag>(); }
 
-    bool getECEFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 ECE_flagMask) != 0);
-    }
+    bool getECEFlag() const { return mHeader.get<TCPHeader::ECEFlag>(); }
 
-    bool getURGFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 URG_flagMask) != 0);
-    }
+    bool getURGFlag() const { return mHeader.get<TCPHeader::URGFlag>(); }
 
-    bool getACKFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 ACK_flagMask) != 0);
-    }
+    bool getACKFlag() const { return mHeader.get<TCPHeader::ACKFlag>(); }
 
-    bool getPSHFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 PSH_flagMask) != 0);
-    }
+    bool getPSHFlag() const { return mHeader.get<TCPHeader::PSHFlag>(); }
 
-    bool getRSTFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 RST_flagMask) != 0);
-    }
+    bool getRSTFlag() const { return mHeader.get<TCPHeader::RSTFlag>(); }
 
-    bool getSYNFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 SYN_flagMask) != 0);
-    }
+    bool getSYNFlag() const { return mHeader.get<TCPHeader::SYNFlag>(); }
 
-    bool getFINFlag() const {
-        // Bounds already checked on construction
-        return ((mBufferView.getUint16At_nocheck(dataOffsetAndFlagsOffset) &
-                 FIN_flagMask) != 0);
-    }
+    bool getFINFlag() const { return mHeader.get<TCPHeader::FINFlag>(); }
 
     ///@}
 
@@ -174,45 +160,11 @@ class TCPDecoder {
     ///@}
 
   private:
-    // Constant offsets, in bytes, of header fields
-    enum {
-        srcPortOffset = 0,
-        dstPortOffset = 2,
-        sequenceNumberOffset = 4,
-        acknowledgmentNumberOffset = 8,
-        dataOffsetAndFlagsOffset = 12,
-        windowSizeOffset = 14,
-        checksumOffset = 16,
-        urgentPointerOffset = 18,
-        optionsOffset = 20,
-    };
-
-    enum FlagMask : std::uint16_t {
-        NS_flagMask = 1 << 8,
-        CWR_flagMask = 1 << 7,
-        ECE_flagMask = 1 << 6,
-        URG_flagMask = 1 << 5,
-        ACK_flagMask = 1 << 4,
-        PSH_flagMask = 1 << 3,
-        RST_flagMask = 1 << 2,
-        SYN_flagMask = 1 << 1,
-        FIN_flagMask = 1,
-    };
-
     // Proper data.
     const BufferView mBufferView;
 
-    void throwIfBufferIsUnsuitable(const char *method) {
-        // Catch some quirks early
-        if (mBufferView.size() < 20) {
-            std::ostringstream err;
-            err << method
-                << ": called with "
-                   "BufferView.size() == "
-                << mBufferView.size() << " (min size is 20)";
-            throw std::length_error(err.str());
-        }
-    }
+    // The header, checked on construction.
+    const HeaderOverlay<TCPHeader> mHeader;
 };
 } // namespace NetworkLib
 } // namespace UPF
@@ -6,6 +6,8 @@
 // For BufferView
 #include <upfnetworklib/buffers.hh>
 
+#include <upfnetworklib/decodestatus.hh>
+#include <upfnetworklib/headerlayout.hh>
 #include <upfnetworklib/ipv4.hh>
 
 #include <vector>
@@ -13,6 +15,14 @@
 namespace UPF {
 namespace NetworkLib {
 
+/// @brief Layout of the UDP header.
+struct UDPHeader : HeaderLayout<8> {
+    using SrcPort = HeaderField<0, std::uint16_t>;
+    using DstPort = HeaderField<2, std::uint16_t>;
+    using TotalLength = HeaderField<4, std::uint16_t>;
+    using Checksum = HeaderField<6, std::uint16_t>;
+};
+
 /**
  * @brief Decode a (whole) UDP packet stored in a BufferView.
  */
@@ -25,17 +35,26 @@ class UDPDecoder {
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    UDPDecoder(const BufferView &udpData) : mBufferView(udpData) {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
-    }
+    UDPDecoder(const BufferView &udpData)
+        : mBufferView(udpData),
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
 
     /// @brief Constructor attaching to the given BufferView (moved).
     ///
     /// Throws exceptions if the BufferView is unsuitable (empty, too
     /// short, etc.).
-    UDPDecoder(BufferView &&udpData) : mBufferView{std::move(udpData)} {
-        throwIfBufferIsUnsuitable(NETWORKLIB_CURRENT_FUNCTION);
-    }
+    UDPDecoder(BufferView &&udpData)
+        : mBufferView{std::move(udpData)},
+          mHeader(mBufferView, NETWORKLIB_CURRENT_FUNCTION) {}
+
+    /// @brief Non-throwing constructor attaching to the given
+    ///        BufferView.
+    ///
+    /// Sets `status` to DecodeStatus::Ok, or tells why the BufferView
+    /// is unsuitable (and then the decoder mustn't be used).
+    UDPDecoder(const BufferView &udpData, DecodeStatus &status) noexcept
+        : mBufferView(udpData),
+          mHeader(mBufferView, status, DecodeStatus::UDPTooShort) {}
 
     ///@}
 
@@ -60,23 +79,19 @@ class UDPDecoder {
     ///@{
 
     Port::Number getSrcPort() const {
-        // Bounds already checked on construction
-        return Port::Number(mBufferView.getUint16At_nocheck(srcPortOffset));
+        return Port::Number(mHeader.get<UDPHeader::SrcPort>());
     }
 
     Port::Number getDstPort() const {
-        // Bounds already checked on construction
-        return Port::Number(mBufferView.getUint16At_nocheck(dstPortOffset));
+        return Port::Number(mHeader.get<UDPHeader::DstPort>());
     }
 
     std::size_t getTotalLengthBytes() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(totalLengthOffset);
+        return mHeader.get<UDPHeader::TotalLength>();
     }
 
     std::uint16_t getChecksum() const {
-        // Bounds already checked on construction
-        return mBufferView.getUint16At_nocheck(checksumOffset);
+        return mHeader.get<UDPHeader::Checksum>();
     }
 
     ///@}
@@ -117,6 +132,7 @@ class UDPDecoder {
     bool isGTPv1U() const {
         const std::size_t udpLen = getDataLengthBytes();
         return ((udpLen > 8) &&
+                (udpLen <= mBufferView.size() - startOfDataOffset) &&
                 ((mBufferView.getUint8At_nocheck(startOfDataOffset) & 0xF0) ==
                  0x30) &&
                 ((mBufferView.getUint16At_nocheck(startOfDataOffset + 2) +
@@ -126,33 +142,16 @@ class UDPDecoder {
     ///@}
 
   private:
-    // Constant offsets, in bytes, of header fields
-    enum {
-        srcPortOffset = 0,
-        dstPortOffset = 2,
-        totalLengthOffset = 4,
-        checksumOffset = 6,
-    };
-
     // Offsets of data fields
     enum {
-        startOfDataOffset = 8,
+        startOfDataOffset = UDPHeader::minSize,
     };
 
     // Proper data.
     const BufferView mBufferView;
 
-    void throwIfBufferIsUnsuitable(const char *method) {
-        // Catch some quirks early
-        if (mBufferView.size() < 8) {
-            std::ostringstream err;
-            err << method
-                << ": called with "
-                   "BufferView.size() == "
-                << mBufferView.size() << " (min size is 8)";
-            throw std::length_error(err.str());
-        }
-    }
+    // The header, checked on construction.
+    const HeaderOverlay<UDPHeader> mHeader;
 };
 } // namespace NetworkLib
 } // namespace UPF
@@ -19,6 +19,9 @@
 // For std::string
 #include <string>
 
+// For std::array
+#include <array>
+
 ///@file
 
 /// @brief Declare packed structures.
@@ -30,6 +33,15 @@
 /// '__attribute__((packed))' is supported both by GCC and CLang.
 #define NETWORKLIB_PACKED_ATTRIBUTE __attribute__((packed))
 
+/// @brief Force inlining of a function.
+///
+/// This macro is used for the few functions on the fast path which
+/// compilers would otherwise leave out of line (e.g. because they are
+/// called from many places), at the price of a call per packet.
+///
+/// '__attribute__((always_inline))' is supported both by GCC and CLang.
+#define NETWORKLIB_ALWAYS_INLINE __attribute__((always_inline))
+
 /// @brief Enable bounds checkings in methods of BufferView and
 ///        BufferWritableView.
 ///
@@ -559,6 +571,12 @@ class IPv4CIDR {
     IPv4CIDR &operator=(IPv4CIDR &&) = default;
     ///@}
 
+    /// @brief Return the network address.
+    const IPv4Address &getAddress() const { return mAddress; }
+
+    /// @brief Return the number of bits in the mask.
+    unsigned int getMaskBits() const { return mMaskBits; }
+
     /// @brief Return true if this CIDR matches the given address
     bool matchAddress(const IPv4Address &address) const {
         return (address.getNetworkByCIDRMask(mMaskBits).
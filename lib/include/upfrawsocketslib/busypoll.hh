@@ -0,0 +1,158 @@
+#ifndef UPFRAWSOCKETSLIB_BUSYPOLL_HH
+#define UPFRAWSOCKETSLIB_BUSYPOLL_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::min()
+#include <algorithm>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief Pin the calling thread to the given CPU.
+///
+/// Throw std::runtime_error on errors.
+void pinThisThreadToCPU(unsigned int cpu);
+
+/**
+ * @brief Kernel busy polling settings of a socket.
+ */
+struct BusyPollConfig {
+    /// @brief How long (in microseconds) a receive on the socket
+    ///        busy-polls the device queue before giving up
+    ///        (``SO_BUSY_POLL``). `0` disables busy polling, and the
+    ///        other settings are ignored.
+    ///
+    /// Values larger than ``net.core.busy_read`` require
+    /// CAP_NET_ADMIN.
+    unsigned int busyPollUs = 0;
+
+    /// @brief Prefer busy polling to interrupts
+    ///        (``SO_PREFER_BUSY_POLL``, since Linux 5.11).
+    bool preferBusyPoll = true;
+
+    /// @brief Maximum number of packets processed by each busy poll
+    ///        (``SO_BUSY_POLL_BUDGET``, since Linux 5.11). `0` keeps
+    ///        the kernel default.
+    unsigned int budget = 0;
+};
+
+/// @brief Apply the given busy polling settings to a socket.
+///
+/// Nothing is done if busy polling is disabled.
+///
+/// Throw std::runtime_error on errors.
+void applyBusyPoll(SocketFD socketfd, const BusyPollConfig &config);
+
+/**
+ * @brief Configuration of an AdaptiveIdlePolicy.
+ *
+ * The defaults make a capture loop block as soon as there's no
+ * traffic, which is the right choice unless latency matters more
+ * than CPU usage.
+ */
+struct IdlePolicyConfig {
+    /// @brief Number of consecutive empty rounds retried right away.
+    std::size_t spinRounds = 0;
+
+    /// @brief Number of further empty rounds retried after a short
+    ///        pause, growing exponentially from one to
+    ///        maxPausesPerRound CPU pause instructions.
+    std::size_t pauseRounds = 0;
+
+    /// @brief See pauseRounds.
+    unsigned int maxPausesPerRound = 64;
+};
+
+/// @brief What a capture loop should do after a round.
+enum IdleAction {
+    /// @brief Run another round of non-blocking receives.
+    IDLE_ACTION_POLL = 0,
+
+    /// @brief Block until there's traffic (e.g. via ``epoll_wait()``).
+    IDLE_ACTION_WAIT = 1
+};
+
+/**
+ * @brief A policy deciding how a capture loop behaves when idle:
+ *        first it spins on non-blocking receives, then it keeps
+ *        polling with growing pauses in between, and eventually it
+ *        blocks until traffic shows up.
+ *
+ * This gives the latency of busy polling under traffic, without
+ * burning a whole core when there's none (e.g. at night).
+ *
+ * Example (the loop used by EventLoop::run()):
+ *
+ *     AdaptiveIdlePolicy idle(config);
+ *     IdleAction action = IDLE_ACTION_POLL;
+ *
+ *     while (running) {
+ *         std::size_t n = (action == IDLE_ACTION_POLL)
+ *                             ? receiveWithoutBlocking()
+ *                             : waitAndReceive();
+ *         action = idle.onRound(n > 0);
+ *     }
+ */
+class AdaptiveIdlePolicy {
+  public:
+    /// @brief Constructor.
+    explicit AdaptiveIdlePolicy(
+        const IdlePolicyConfig &config = IdlePolicyConfig())
+        : mConfig(config) {}
+
+    /// @brief Tell the policy if the last round found some work, and
+    ///        get what to do next.
+    ///
+    /// During the pause phase, it pauses the CPU before returning.
+    IdleAction onRound(bool gotWork) {
+        if (gotWork) {
+            mIdleRounds = 0;
+            return IDLE_ACTION_POLL;
+        }
+
+        if (mIdleRounds < mConfig.spinRounds) {
+            ++mIdleRounds;
+            return IDLE_ACTION_POLL;
+        }
+
+        const std::size_t pauseRound = mIdleRounds - mConfig.spinRounds;
+
+        if (pauseRound < mConfig.pauseRounds) {
+            ++mIdleRounds;
+
+            const unsigned int pauses =
+                (pauseRound < 16) ? std::min(1u << pauseRound,
+                                             mConfig.maxPausesPerRound)
+                                  : mConfig.maxPausesPerRound;
+
+            for (unsigned int i = 0; i < pauses; ++i) {
+                cpuRelax();
+            }
+
+            return IDLE_ACTION_POLL;
+        }
+
+        // Keep on waiting until some work shows up.
+        return IDLE_ACTION_WAIT;
+    }
+
+    /// @brief Tell the CPU we are in a spin loop (e.g. a PAUSE
+    ///        instruction on x86).
+    static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+  private:
+    IdlePolicyConfig mConfig;
+    std::size_t mIdleRounds = 0;
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_BUSYPOLL_HH
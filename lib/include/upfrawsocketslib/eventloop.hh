@@ -0,0 +1,247 @@
+#ifndef UPFRAWSOCKETSLIB_EVENTLOOP_HH
+#define UPFRAWSOCKETSLIB_EVENTLOOP_HH
+
+#include <upfrawsocketslib/busypoll.hh>
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::array
+#include <array>
+
+// For std::atomic
+#include <atomic>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+// For std::unique_ptr
+#include <memory>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+class PacketMMapTxRing;
+
+/**
+ * @brief Configuration of an EventLoop.
+ */
+struct EventLoopConfig {
+    /// @brief Maximum number of frames read from a single interface
+    ///        before moving on to the next ready one. At most
+    ///        maxBatchSize.
+    std::size_t batchSize = maxBatchSize;
+
+    /// @brief Initial capacity of the PacketBufferPool of the loop.
+    std::size_t poolInitialCapacity = 2 * maxBatchSize;
+
+    /// @brief Bytes left free in front of each received frame (see
+    ///        NetworkLib::BufferView::getHeadroom()), so that sinks can
+    ///        add headers in place.
+    std::size_t headroom = NetworkLib::defaultHeadroom;
+
+    /// @brief Kernel busy polling settings applied to the sockets
+    ///        when they are added.
+    BusyPollConfig busyPoll;
+
+    /// @brief How run() behaves when there's no traffic.
+    IdlePolicyConfig idlePolicy;
+
+    /// @brief CPU the thread calling run() is pinned to (-1 = don't
+    ///        pin).
+    int cpu = -1;
+};
+
+/**
+ * @brief Counters of a single interface of an EventLoop.
+ */
+struct EventLoopInterfaceStats {
+    /// @brief Frames received and passed to the interface sink.
+    std::uint64_t packets = 0;
+
+    /// @brief Calls to receiveBatch() returning frames.
+    std::uint64_t batches = 0;
+
+    /// @brief Frames whose processing threw an exception, plus
+    ///        receive errors.
+    std::uint64_t errors = 0;
+};
+
+/**
+ * @brief A single-threaded, epoll-based event loop serving several
+ *        raw sockets.
+ *
+ * Each registered socket is switched to non-blocking mode and gets
+ * its own EthPacketSink, receiving all the frames read from the
+ * socket. This allows a single thread (and core) to serve e.g. both
+ * the eNodeB-facing and the EPC-facing interfaces of a UPF, without
+ * a thread blocked in receiveData() per interface.
+ *
+ * Ready sockets are drained in round-robin, reading at most
+ * EventLoopConfig::batchSize frames (via receiveBatch()) from each of
+ * them per round, so that a busy interface can't starve the others.
+ *
+ * run() first tries non-blocking receives on all the sockets, and
+ * falls back to waiting via epoll as told by an AdaptiveIdlePolicy
+ * (by default, as soon as a round finds no traffic). Together with
+ * kernel busy polling (see EventLoopConfig::busyPoll) and a pinned
+ * thread, spinning for a while gives the lowest latency.
+ *
+ * Each frame is passed to the sink with ContextUserData::intUserData
+ * set to the index of the interface (i.e. the order in which it was
+ * added, starting from 0) and ContextUserData::ptrUserData set to
+ * nullptr.
+ *
+ * Sinks sending via a PacketMMapTxRing should register it with
+ * addTxRing(): run() then hands its queued frames to the kernel once
+ * their deadline expires, or as soon as a round finds no traffic.
+ *
+ * Example:
+ *
+ *     RawSocketsUtil::EventLoop loop;
+ *     loop.addInterface(enbSocket, uplinkSink);
+ *     loop.addInterface(epcSocket, downlinkSink);
+ *
+ *     loop.run(); // Until loop.stop() is called
+ *
+ * @note Sockets aren't owned by the loop: it's up to the caller to
+ *       close them, after the loop has been destroyed or the sockets
+ *       removed from it.
+ *
+ * @note Apart from stop(), methods must be called from the thread
+ *       running the loop.
+ */
+class EventLoop {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Create an event loop with no interfaces.
+    ///
+    /// Throw std::invalid_argument if the configuration isn't valid,
+    /// std::runtime_error on other errors.
+    explicit EventLoop(const EventLoopConfig &config = EventLoopConfig());
+
+    ~EventLoop();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    EventLoop(EventLoop &&) = delete;
+    EventLoop &operator=(EventLoop &&) = delete;
+    ///@}
+
+    /// @brief Register a socket, whose frames are to be passed to the
+    ///        given sink.
+    ///
+    /// The socket is switched to non-blocking mode. The sink must
+    /// outlive the loop, or the registration.
+    ///
+    /// @return The index of the interface.
+    ///
+    /// Throw std::invalid_argument if the socket is already
+    /// registered, std::runtime_error on other errors.
+    std::size_t addInterface(SocketFD socketfd,
+                             NetworkLib::EthPacketSink &sink);
+
+    /// @brief Unregister a socket.
+    ///
+    /// The indexes of the other interfaces don't change. It must not
+    /// be called from a sink.
+    ///
+    /// Throw std::invalid_argument if the socket isn't registered.
+    void removeInterface(SocketFD socketfd);
+
+    /// @brief Register a transmit ring, whose queued frames run() is
+    ///        to flush (see PacketMMapTxRing::flushIfDeadlineExpired()).
+    ///
+    /// The ring must outlive the loop, or the registration.
+    ///
+    /// Throw std::invalid_argument if the ring is already registered.
+    void addTxRing(PacketMMapTxRing &ring);
+
+    /// @brief Unregister a transmit ring.
+    ///
+    /// Throw std::invalid_argument if the ring isn't registered.
+    void removeTxRing(PacketMMapTxRing &ring);
+
+    /// @brief Wait until at least one socket is ready or the given
+    ///        timeout (in milliseconds, -1 meaning forever) expires,
+    ///        then run a single round over the ready sockets.
+    ///
+    /// @return The number of frames passed to sinks.
+    ///
+    /// Throw std::runtime_error on errors.
+    std::size_t runOnce(int timeoutMs);
+
+    /// @brief Run rounds until stop() is called, pinning the calling
+    ///        thread if told so by the configuration.
+    ///
+    /// Throw std::runtime_error on errors.
+    void run();
+
+    /// @brief Make run() return as soon as the current round is over.
+    ///
+    /// It can be called from any thread, or from a sink.
+    void stop();
+
+    /// @brief Get a snapshot of the counters of the given interface.
+    ///
+    /// Throw std::out_of_range if there's no such interface.
+    EventLoopInterfaceStats getStats(std::size_t interfaceIndex) const;
+
+  private:
+    struct Interface {
+        SocketFD socketfd = -1;
+        NetworkLib::EthPacketSink *sink = nullptr;
+        NetworkLib::ContextUserData userData;
+        EventLoopInterfaceStats stats;
+    };
+
+    EventLoopConfig mConfig;
+
+    int mEpollFD = -1;
+
+    // Written by stop() to wake up epoll_wait().
+    int mStopEventFD = -1;
+    std::atomic<bool> mStopRequested{false};
+
+    // By interface index: removed interfaces are left as nullptr.
+    std::vector<std::unique_ptr<Interface>> mInterfaces;
+
+    std::vector<PacketMMapTxRing *> mTxRings;
+
+    NetworkLib::PacketBufferPool mPool;
+    std::array<NetworkLib::BufferWritableView, maxBatchSize> mBuffers;
+    std::array<std::size_t, maxBatchSize> mSizes;
+
+    Interface *findInterface(SocketFD socketfd);
+
+    // Read a batch from the given interface and dispatch it.
+    std::size_t serve(Interface &interface);
+
+    // Read a batch from every interface, without waiting.
+    std::size_t serveAll();
+
+    // Flush the transmit rings whose deadline has expired, or all of
+    // them.
+    void flushTxRings(bool all);
+
+    void drainStopEvent();
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_EVENTLOOP_HH
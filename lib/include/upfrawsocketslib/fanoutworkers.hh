@@ -0,0 +1,231 @@
+#ifndef UPFRAWSOCKETSLIB_FANOUTWORKERS_HH
+#define UPFRAWSOCKETSLIB_FANOUTWORKERS_HH
+
+#include <upfrawsocketslib/busypoll.hh>
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::atomic
+#include <atomic>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+// For std::function
+#include <functional>
+
+// For std::unique_ptr
+#include <memory>
+
+// For std::thread
+#include <thread>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+class PacketMMapTxRing;
+
+/**
+ * @brief Configuration of a FanoutWorkers runtime.
+ */
+struct FanoutWorkersConfig {
+    /// @brief Number of workers (i.e. threads and sockets).
+    std::size_t workers = 1;
+
+    /// @brief How traffic is spread among workers.
+    FanoutMode fanoutMode = FANOUT_MODE_HASH;
+
+    /// @brief PACKET_FANOUT group id. `0` means "pick one out of
+    ///        the process id".
+    std::uint16_t groupId = 0;
+
+    /// @brief Promiscuous mode of the sockets.
+    PromiscuousMode promiscuousMode = PROMISCUOS_MODE_DISABLED;
+
+    /// @brief CPU each worker is pinned to: worker `i` is pinned to
+    ///        `cpus[i]`. When empty, worker `i` is pinned to CPU `i`;
+    ///        workers beyond the end of a non-empty list aren't
+    ///        pinned.
+    std::vector<unsigned int> cpus;
+
+    /// @brief When `cpus` is empty, pin workers to the CPUs of the
+    ///        NUMA node of the interface (see getNUMANodeByIfName())
+    ///        instead, wrapping around if there are more workers than
+    ///        CPUs, so that frames and buffers stay on the memory
+    ///        local to the NIC. Ignored when the node is unknown.
+    bool placeOnInterfaceNUMANode = false;
+
+    /// @brief Initial capacity of the PacketBufferPool of each
+    ///        worker.
+    std::size_t poolInitialCapacity = 2 * maxBatchSize;
+
+    /// @brief Bytes left free in front of each received frame (see
+    ///        NetworkLib::BufferView::getHeadroom()), so that sinks can
+    ///        add headers in place.
+    std::size_t headroom = NetworkLib::defaultHeadroom;
+
+    /// @brief Kernel busy polling settings of the sockets.
+    BusyPollConfig busyPoll;
+
+    /// @brief How workers behave when there's no traffic.
+    IdlePolicyConfig idlePolicy;
+};
+
+/**
+ * @brief Counters of a single FanoutWorkers worker.
+ */
+struct FanoutWorkerStats {
+    /// @brief Frames received and passed to the processing chain.
+    std::uint64_t packets = 0;
+
+    /// @brief Calls to receiveBatch() returning frames.
+    std::uint64_t batches = 0;
+
+    /// @brief Batches whose processing threw an exception, plus
+    ///        receive errors.
+    std::uint64_t errors = 0;
+};
+
+/**
+ * @brief A multi-threaded capture runtime based on PACKET_FANOUT.
+ *
+ * It opens one raw socket per worker on the given interface, all in
+ * the same PACKET_FANOUT group, so the kernel spreads incoming
+ * traffic among them. Each worker runs in its own thread, pinned to
+ * its own CPU, with its own NetworkLib::PacketBufferPool and its own
+ * processing chain (e.g. a UPFRouterLib::Router wrapped in an
+ * EthPacketSink), so that workers don't share any state on the fast
+ * path.
+ *
+ * Processing chains are created by a user-provided factory, called
+ * once per worker from within the worker thread itself, so that the
+ * memory they allocate is local to the worker CPU.
+ *
+ * Each batch received is passed to the chain at once, via
+ * NetworkLib::EthPacketSink::consumeEthPackets() (so processors such
+ * as NetworkLib::EthPacketProcessor process it as a batch), with
+ * ContextUserData::intUserData set to the worker index.
+ *
+ * Chains sending via a PacketMMapTxRing should have the factory
+ * register it with addTxRing(): the worker then hands its queued
+ * frames to the kernel once their deadline expires, or as soon as a
+ * round finds no traffic.
+ *
+ * For the lowest latency, enable kernel busy polling and let workers
+ * spin when idle, e.g.:
+ *
+ *     config.busyPoll.busyPollUs = 50;
+ *     config.idlePolicy.spinRounds = 10000;
+ *     config.idlePolicy.pauseRounds = 1000;
+ *
+ * Example:
+ *
+ *     RawSocketsUtil::FanoutWorkersConfig config;
+ *     config.workers = 16;
+ *
+ *     RawSocketsUtil::FanoutWorkers workers(ifIdx, config,
+ *         [](std::size_t workerIndex) {
+ *             return std::unique_ptr<NetworkLib::EthPacketSink>(
+ *                 new MyChain(workerIndex));
+ *         });
+ *
+ *     workers.start();
+ *     ...
+ *     workers.stop();
+ */
+class FanoutWorkers {
+  public:
+    /// @brief Type of the factory of processing chains.
+    using ChainFactory_t =
+        std::function<std::unique_ptr<NetworkLib::EthPacketSink>(
+            std::size_t workerIndex)>;
+
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Open all the sockets in a new fanout group, without
+    ///        starting the workers yet.
+    ///
+    /// Throw std::invalid_argument if there are no workers or the
+    /// headroom doesn't fit in NetworkLib::PacketBufferPool buffers,
+    /// std::runtime_error on other errors.
+    FanoutWorkers(IfIndex ifIdx, const FanoutWorkersConfig &config,
+                  ChainFactory_t chainFactory);
+
+    /// @brief Stop the workers (if running) and close all the sockets.
+    ~FanoutWorkers();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    FanoutWorkers(const FanoutWorkers &) = delete;
+    FanoutWorkers &operator=(const FanoutWorkers &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    FanoutWorkers(FanoutWorkers &&) = delete;
+    FanoutWorkers &operator=(FanoutWorkers &&) = delete;
+    ///@}
+
+    /// @brief Start all the workers.
+    void start();
+
+    /// @brief Stop all the workers and wait for them to terminate.
+    ///
+    /// Frames being processed are completed first.
+    void stop();
+
+    /// @brief Register a transmit ring of the chain of the given
+    ///        worker, whose queued frames the worker is to flush (see
+    ///        PacketMMapTxRing::flushIfDeadlineExpired()).
+    ///
+    /// It must be called by the chain factory for that worker (i.e.
+    /// from within the worker thread). The registration lasts until
+    /// the worker stops, and the ring must outlive it.
+    ///
+    /// Throw std::out_of_range if there's no such worker.
+    void addTxRing(std::size_t workerIndex, PacketMMapTxRing &ring);
+
+    /// @brief Number of workers.
+    std::size_t size() const { return mWorkers.size(); }
+
+    /// @brief Get a snapshot of the counters of the given worker.
+    FanoutWorkerStats getStats(std::size_t workerIndex) const;
+
+  private:
+    struct Worker {
+        SocketFD socketfd = -1;
+        std::thread thread;
+
+        std::atomic<std::uint64_t> packets{0};
+        std::atomic<std::uint64_t> batches{0};
+        std::atomic<std::uint64_t> errors{0};
+
+        // Only used by the worker thread.
+        std::vector<PacketMMapTxRing *> txRings;
+    };
+
+    FanoutWorkersConfig mConfig;
+    ChainFactory_t mChainFactory;
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::atomic<bool> mRunning{false};
+
+    void run(std::size_t workerIndex);
+
+    // Flush the transmit rings of the worker whose deadline has
+    // expired, or all of them.
+    void flushTxRings(Worker &w, bool all);
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_FANOUTWORKERS_HH
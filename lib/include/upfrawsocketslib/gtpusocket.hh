@@ -0,0 +1,254 @@
+#ifndef UPFRAWSOCKETSLIB_GTPUSOCKET_HH
+#define UPFRAWSOCKETSLIB_GTPUSOCKET_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For GTPv1UEndPoint
+#include <upfnetworklib/gtp_u.hh>
+
+// For std::array
+#include <array>
+
+// For std::chrono::steady_clock
+#include <chrono>
+
+// For std::size_t
+#include <cstddef>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief Maximum number of GTPv1-U packets sent by a single
+///        ``UDP_SEGMENT`` send, or received by a single ``UDP_GRO``
+///        receive.
+constexpr std::size_t maxUDPSegments = 64;
+
+/**
+ * @brief Configuration of a GTPv1USocketEndpoint.
+ */
+struct GTPv1USocketEndpointConfig {
+    /// @brief Local address to bind to: the default (``0.0.0.0``)
+    ///        means any address.
+    NetworkLib::IPv4Address localAddress;
+
+    /// @brief Local UDP port to bind to.
+    NetworkLib::Port::Number localPort = NetworkLib::Port::GTPv1U;
+
+    /// @brief Send packets of the same size to the same peer as a
+    ///        single ``UDP_SEGMENT`` (UDP GSO) datagram, segmented by
+    ///        the kernel or by the network card (since Linux 4.18).
+    bool segmentationOffload = true;
+
+    /// @brief Receive datagrams of the same flow coalesced by the
+    ///        kernel (``UDP_GRO``, since Linux 5.0).
+    bool receiveOffload = true;
+
+    /// @brief Maximum number of packets queued before sending them
+    ///        (1 to maxUDPSegments).
+    std::size_t maxSegments = maxUDPSegments;
+
+    /// @brief Maximum time (in microseconds) a queued packet may wait
+    ///        before being sent, even when more could be sent along.
+    ///
+    /// See also GTPv1USocketEndpoint::flushIfDeadlineExpired().
+    unsigned int maxLatencyUs = 100;
+
+    /// @brief Open the socket in non-blocking mode.
+    bool nonBlocking = false;
+};
+
+/// @brief Result of GTPv1USocketEndpoint::receive().
+struct GTPv1UReceiveResult {
+    /// @brief Outcome of the call.
+    IOStatus status = IO_STATUS_OK;
+
+    /// @brief Number of GTPv1-U packets received.
+    std::size_t count = 0;
+
+    /// @brief Address and port of the sender (the TEID is left
+    ///        unspecified, as it's per packet).
+    NetworkLib::GTPv1UEndPoint peer;
+
+    /// @brief Value of errno when status is IO_STATUS_ERROR, 0
+    ///        otherwise.
+    int errorNumber = 0;
+};
+
+/**
+ * @brief A GTPv1-U endpoint using a regular UDP socket, for
+ *        deployments where the kernel owns the S1-U address.
+ *
+ * Outer IPv4/UDP headers and their checksums are taken care of by the
+ * kernel, and system calls are amortized over several packets:
+ *
+ * - send() adds the GTPv1-U header to a T-PDU and queues it: packets
+ *   to the same peer are sent as a single ``UDP_SEGMENT`` datagram,
+ *   as soon as the peer or the packet size changes, the queue is
+ *   full, the oldest packet has waited for
+ *   GTPv1USocketEndpointConfig::maxLatencyUs, or flush() is called.
+ *   T-PDUs aren't copied, but the views on them are held until sent:
+ *   their memory must not be rewritten (e.g. reused for another
+ *   packet) until then, i.e. until pending() is 0 again.
+ *
+ * - The deadline is only checked by send(), by
+ *   flushIfDeadlineExpired() and by receive(), which sends the queued
+ *   packets first when it finds no datagram waiting. When nothing is
+ *   received on the endpoint, it's up to the caller to call
+ *   flushIfDeadlineExpired() periodically (or flush()).
+ *
+ * - receive() gets a single datagram, possibly made of several
+ *   GTPv1-U packets coalesced by ``UDP_GRO``, and splits it into
+ *   views on each GTPv1-U packet.
+ *
+ * When the kernel doesn't support an offload, it's just not used.
+ *
+ * Example (in a specialization of NetworkLib::EthPacketProcessor):
+ *
+ *     std::array<NetworkLib::BufferView, maxUDPSegments> packets;
+ *     auto result = endpoint.receive(buffer, packets.data());
+ *
+ *     for (std::size_t i = 0; i < result.count; ++i) {
+ *         NetworkLib::GTPv1UDecoder gtpu(packets[i]);
+ *
+ *         if (gtpu.isIPv4PDU()) {
+ *             pushIPv4Packet(gtpu.getData(), userData);
+ *         }
+ *     }
+ *
+ * @note Instances are not thread safe.
+ */
+class GTPv1USocketEndpoint {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Open and bind the socket.
+    ///
+    /// Throw std::invalid_argument if the configuration isn't valid,
+    /// std::runtime_error on other errors.
+    explicit GTPv1USocketEndpoint(
+        const GTPv1USocketEndpointConfig &config =
+            GTPv1USocketEndpointConfig());
+
+    /// @brief Close the socket, dropping queued packets.
+    ~GTPv1USocketEndpoint();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    GTPv1USocketEndpoint(const GTPv1USocketEndpoint &) = delete;
+    GTPv1USocketEndpoint &operator=(const GTPv1USocketEndpoint &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    GTPv1USocketEndpoint(GTPv1USocketEndpoint &&) = delete;
+    GTPv1USocketEndpoint &operator=(GTPv1USocketEndpoint &&) = delete;
+    ///@}
+
+    ///@name Sending
+    ///@{
+
+    /// @brief Encapsulate a T-PDU (usually an IPv4 packet) into a
+    ///        GTPv1-U packet for the given peer, and queue it.
+    ///
+    /// Queued packets may be sent right away (see the class
+    /// description). The memory of `tpdu` must be left untouched
+    /// until it's sent.
+    ///
+    /// Throw std::invalid_argument if the T-PDU is too large,
+    /// std::runtime_error on errors.
+    void send(const NetworkLib::GTPv1UEndPoint &peer,
+              const NetworkLib::BufferView &tpdu);
+
+    /// @brief Send all the queued packets.
+    ///
+    /// Throw std::runtime_error on errors.
+    void flush();
+
+    /// @brief Send all the queued packets if the oldest one has been
+    ///        waiting for more than
+    ///        GTPv1USocketEndpointConfig::maxLatencyUs.
+    ///
+    /// Throw std::runtime_error on errors.
+    void flushIfDeadlineExpired() {
+        if (mPendingCount > 0 &&
+            std::chrono::steady_clock::now() >= mDeadline) {
+            flush();
+        }
+    }
+
+    /// @brief Number of queued packets.
+    std::size_t pending() const { return mPendingCount; }
+
+    ///@}
+
+    ///@name Receiving
+    ///@{
+
+    /// @brief Receive a datagram into `buffer`, storing a view on each
+    ///        GTPv1-U packet it's made of into `packets` (which must
+    ///        have room for maxUDPSegments views).
+    ///
+    /// `buffer` should be large enough for a coalesced datagram (up
+    /// to 64 KB; e.g. NetworkLib::PacketBufferPool buffers are).
+    ///
+    /// If there's no datagram waiting, the queued packets are sent
+    /// first (and status is IO_STATUS_ERROR if that fails), so that
+    /// they don't wait on a blocking receive.
+    ///
+    /// Packets aren't validated: use NetworkLib::GTPv1UDecoder on
+    /// them.
+    GTPv1UReceiveResult receive(const NetworkLib::BufferWritableView &buffer,
+                                NetworkLib::BufferView *packets) noexcept;
+
+    ///@}
+
+    /// @brief True if sending uses ``UDP_SEGMENT``.
+    bool segmentationOffload() const { return mSegmentationOffload; }
+
+    /// @brief True if receiving uses ``UDP_GRO``.
+    bool receiveOffload() const { return mReceiveOffload; }
+
+    /// @brief Get the socket file descriptor (e.g. to poll() it).
+    int getFD() const { return mFD; }
+
+  private:
+    // Size of the GTPv1-U header added by send().
+    enum { headerSize = 8 };
+
+    int mFD;
+    std::size_t mMaxSegments;
+    std::chrono::microseconds mMaxLatency;
+    bool mNonBlocking;
+    bool mSegmentationOffload;
+    bool mReceiveOffload;
+
+    // Queued packets: all to mPendingPeer, all with the size of the
+    // first one, but the last one which may be shorter.
+    NetworkLib::GTPv1UEndPoint mPendingPeer;
+    std::size_t mPendingCount = 0;
+    std::size_t mPendingBytes = 0;
+    std::size_t mSegmentSize = 0;
+    bool mLastSegmentShorter = false;
+    std::chrono::steady_clock::time_point mDeadline;
+    std::array<NetworkLib::BufferView, maxUDPSegments> mPendingTPDUs;
+    std::array<std::array<unsigned char, headerSize>, maxUDPSegments>
+        mPendingHeaders;
+
+    // Send `count` queued packets starting from `first`, as a single
+    // UDP_SEGMENT datagram if `segment`. Return 0, or the errno of the
+    // send (EINVAL or EIO if the kernel refused to segment them).
+    int sendPending(std::size_t first, std::size_t count,
+                    bool segment) noexcept;
+
+    // Send all the queued packets, as flush() does. Return 0, or the
+    // errno of the send which failed.
+    int flushPending() noexcept;
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_GTPUSOCKET_HH
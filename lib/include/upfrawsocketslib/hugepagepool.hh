@@ -0,0 +1,263 @@
+#ifndef UPFRAWSOCKETSLIB_HUGEPAGEPOOL_HH
+#define UPFRAWSOCKETSLIB_HUGEPAGEPOOL_HH
+
+#include <upfrawsocketslib/numa.hh>
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::array
+#include <array>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::deque
+#include <deque>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief Size classes of a HugePagePacketBufferPool.
+enum BufferSizeClass {
+    /// @brief 2 KB buffers, for frames of interfaces with a standard
+    ///        MTU.
+    BUFFER_SIZE_CLASS_2K = 0,
+
+    /// @brief 9 KB buffers, for jumbo frames.
+    BUFFER_SIZE_CLASS_9K = 1,
+
+    /// @brief 65 KB buffers, for anything up to a 64 KB IPv4 packet
+    ///        in a VLAN tagged frame, including GSO/GRO super-packets
+    ///        (as NetworkLib::PacketBufferPool buffers).
+    BUFFER_SIZE_CLASS_64K = 2
+};
+
+/// @brief Number of size classes.
+constexpr std::size_t bufferSizeClassCount = 3;
+
+/// @brief Size of the buffers of the given class.
+std::size_t getBufferSize(BufferSizeClass sizeClass);
+
+/// @brief Smallest size class whose buffers can hold a frame received
+///        on an interface with the given MTU (e.g. from getMTU()),
+///        allowing for a Ethernet header with up to two VLAN tags.
+BufferSizeClass getBufferSizeClassForMTU(std::size_t mtu);
+
+/**
+ * @brief Configuration of a HugePagePacketBufferPool.
+ */
+struct HugePagePoolConfig {
+    /// @brief Size of each arena mapped by the pool, rounded up to a
+    ///        multiple of the huge page size. Each arena holds buffers
+    ///        of a single class.
+    std::size_t arenaSize = 2 * 1024 * 1024;
+
+    /// @brief Map arenas with ``MAP_HUGETLB`` when huge pages are
+    ///        available (see ``vm.nr_hugepages``), falling back to
+    ///        transparent huge pages otherwise. When false, just use
+    ///        regular pages.
+    bool hugePages = true;
+
+    /// @brief Hard limit on the memory mapped by the pool, in bytes.
+    ///        `0` means no limit.
+    std::size_t maxMappedBytes = 0;
+};
+
+/**
+ * @brief A pool of packet buffers of a few size classes, whose memory
+ *        is mapped in large arenas backed by huge pages.
+ *
+ * Unlike a NetworkLib::PacketBufferPool, where each buffer takes
+ * 66500 bytes whatever it's going to hold, buffers are taken from the
+ * class fitting their use: e.g. a 1500-byte frame takes a 2 KB buffer.
+ * This cuts the memory taken by in-flight packets by up to 30 times,
+ * and huge pages cut TLB misses.
+ *
+ * Arenas are mapped as needed, one at a time, and only unmapped when
+ * the pool is destroyed.
+ *
+ * On NUMA systems each arena is bound to a node (see preferNUMANode()),
+ * and buffers are kept in per-node free lists: by default buffers are
+ * taken from the node of the calling thread, so a worker pinned to the
+ * node of its NIC (see FanoutWorkersConfig::placeOnInterfaceNUMANode)
+ * only touches local memory.
+ *
+ * Example:
+ *
+ *     RawSocketsUtil::HugePagePacketBufferPool pool;
+ *     const auto mtu = RawSocketsUtil::getMTU(fd, "eth0");
+ *
+ *     auto buffer = pool.getBufferWritableViewForMTU(mtu);
+ *     auto frame = RawSocketsUtil::receiveData(fd, buffer);
+ *
+ * @note Instances are not thread safe, and, as with
+ *       NetworkLib::PacketBufferSizedPool, the pool must outlive all
+ *       the views it gave out.
+ */
+class HugePagePacketBufferPool {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Constructor. No arena is mapped until needed (see also
+    ///        reserve()).
+    explicit HugePagePacketBufferPool(
+        const HugePagePoolConfig &config = HugePagePoolConfig());
+
+    /// @brief Unmap all the arenas.
+    ~HugePagePacketBufferPool();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    HugePagePacketBufferPool(const HugePagePacketBufferPool &) = delete;
+    HugePagePacketBufferPool &
+    operator=(const HugePagePacketBufferPool &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    HugePagePacketBufferPool(HugePagePacketBufferPool &&) = delete;
+    HugePagePacketBufferPool &operator=(HugePagePacketBufferPool &&) = delete;
+    ///@}
+
+    /// @brief Get a buffer of the given class, from the NUMA node of
+    ///        the calling thread.
+    ///
+    /// Release to the pool is automatic when all the views on the
+    /// buffer are destroyed.
+    ///
+    /// Throw std::runtime_error if a new arena is needed, but it
+    /// can't be mapped (or the memory limit has been reached).
+    NetworkLib::BufferWritableView
+    getBufferWritableView(BufferSizeClass sizeClass) {
+        return getBufferWritableView(sizeClass, getThisThreadNUMANode());
+    }
+
+    /// @brief Get a buffer of the given class, from the given NUMA
+    ///        node (e.g. the one of the interface it's going to be
+    ///        used with, see getNUMANodeByIfName()). anyNUMANode, or
+    ///        a node out of range, means the node of the calling
+    ///        thread.
+    ///
+    /// See getBufferWritableView(BufferSizeClass).
+    NetworkLib::BufferWritableView
+    getBufferWritableView(BufferSizeClass sizeClass, int node);
+
+    /// @brief Get a buffer large enough for a frame received on an
+    ///        interface with the given MTU.
+    ///
+    /// See getBufferWritableView(BufferSizeClass).
+    NetworkLib::BufferWritableView
+    getBufferWritableViewForMTU(std::size_t mtu) {
+        return getBufferWritableView(getBufferSizeClassForMTU(mtu));
+    }
+
+    /// @brief Map arenas until there are at least `count` buffers of
+    ///        the given class on the given NUMA node (by default, the
+    ///        one of the calling thread).
+    ///
+    /// Throw std::runtime_error on errors.
+    void reserve(BufferSizeClass sizeClass, std::size_t count,
+                 int node = anyNUMANode);
+
+    ///@name Info on the pool
+    ///@{
+
+    /// @brief Return how many buffers of the given class there are
+    ///        (both busy and free).
+    std::size_t capacity(BufferSizeClass sizeClass) const {
+        return mBuffers[sizeClass].size();
+    }
+
+    /// @brief Return how many free buffers of the given class there
+    ///        are, on all NUMA nodes.
+    std::size_t free_count(BufferSizeClass sizeClass) const {
+        std::size_t result = 0;
+
+        for (const auto &n : mNodes) {
+            result += n.free[sizeClass].size();
+        }
+
+        return result;
+    }
+
+    /// @brief Return the memory mapped for arenas, in bytes.
+    std::size_t getMappedBytes() const { return mMappedBytes; }
+
+    /// @brief Return the part of getMappedBytes() backed by
+    ///        ``MAP_HUGETLB`` huge pages (the rest may still be backed
+    ///        by transparent huge pages).
+    std::size_t getHugeTLBBytes() const { return mHugeTLBBytes; }
+
+    ///@}
+
+  private:
+    // A buffer in an arena, going back to the pool when the last
+    // reference to it is dropped. As the pool isn't thread safe
+    // anyway, a plain reference count is enough.
+    class Buffer : public NetworkLib::PacketBuffer {
+      public:
+        Buffer(HugePagePacketBufferPool *pool, BufferSizeClass sizeClass,
+               std::size_t node, unsigned char *ptr, std::size_t size)
+            : mPool(pool), mSizeClass(sizeClass), mNode(node), mPtr(ptr),
+              mSize(size) {
+            setThreadSafeReferences(false);
+        }
+        virtual std::size_t size() const override { return mSize; }
+        unsigned char *data() override { return mPtr; }
+
+      protected:
+        void recycle() noexcept override {
+            mPool->mNodes[mNode].free[mSizeClass].push_back(this);
+        }
+
+      private:
+        HugePagePacketBufferPool *mPool;
+        BufferSizeClass mSizeClass;
+        std::size_t mNode;
+        unsigned char *mPtr;
+        std::size_t mSize;
+    };
+
+    struct Arena {
+        void *address;
+        std::size_t size;
+    };
+
+    HugePagePoolConfig mConfig;
+    std::size_t mMappedBytes = 0;
+    std::size_t mHugeTLBBytes = 0;
+
+    std::vector<Arena> mArenas;
+
+    // Buffers of each class (a deque, so they never move).
+    std::array<std::deque<Buffer>, bufferSizeClassCount> mBuffers;
+
+    // Buffers of each class on a NUMA node, and the free ones. Free
+    // lists are reserved for all the buffers of the node, so giving
+    // back a buffer never allocates.
+    struct Node {
+        std::array<std::size_t, bufferSizeClassCount> capacity{};
+        std::array<std::vector<Buffer *>, bufferSizeClassCount> free;
+    };
+
+    // One per NUMA node (just one when NUMA isn't supported); never
+    // resized after construction.
+    std::vector<Node> mNodes;
+
+    // Map the index in mNodes to use for the given node.
+    std::size_t getNodeIndex(int node) const;
+
+    // Map a new arena on the given node, and carve buffers of the given
+    // class out of it.
+    void addArena(BufferSizeClass sizeClass, std::size_t node);
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_HUGEPAGEPOOL_HH
@@ -0,0 +1,54 @@
+#ifndef UPFRAWSOCKETSLIB_NUMA_HH
+#define UPFRAWSOCKETSLIB_NUMA_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::string
+#include <string>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief Value meaning "no NUMA node in particular", or "unknown".
+constexpr int anyNUMANode = -1;
+
+/// @brief Get the number of NUMA nodes the system can have (i.e. one
+///        more than the highest node number), or 1 when NUMA isn't
+///        supported.
+std::size_t getNUMANodeCount();
+
+/// @brief Get the NUMA node the calling thread is currently running
+///        on (0 when NUMA isn't supported).
+///
+/// It's cheap enough to be called per packet.
+int getThisThreadNUMANode();
+
+/// @brief Get the NUMA node of the device behind the given interface
+///        (from ``/sys/class/net/<ifName>/device/numa_node``), or
+///        anyNUMANode when unknown (e.g. virtual interfaces, or
+///        single node systems).
+int getNUMANodeByIfName(const std::string &ifName);
+
+/// @brief Get the CPUs of the given NUMA node (empty if there's no
+///        such node).
+std::vector<unsigned int> getCPUsOfNUMANode(int node);
+
+/// @brief Ask the kernel to take the memory backing the given area,
+///        which must be page-aligned and not touched yet, from the
+///        given NUMA node (``mbind()`` with ``MPOL_PREFERRED``: other
+///        nodes are used when the node runs out of memory).
+///
+/// @return false if the policy couldn't be set (e.g. NUMA isn't
+///         supported).
+bool preferNUMANode(void *address, std::size_t size, int node);
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_NUMA_HH
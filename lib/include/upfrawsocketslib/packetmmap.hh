@@ -0,0 +1,413 @@
+#ifndef UPFRAWSOCKETSLIB_PACKETMMAP_HH
+#define UPFRAWSOCKETSLIB_PACKETMMAP_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::chrono::steady_clock
+#include <chrono>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/**
+ * @brief Geometry of a PACKET_MMAP (TPACKET_V3) receive ring.
+ *
+ * The ring is made of `blockCount` blocks of `blockSize` bytes
+ * each. The kernel fills one block at a time with as many
+ * variable-length frames as they fit, and hands it over to userspace
+ * either when it's full or when `blockTimeoutMs` milliseconds have
+ * passed since the first frame was stored in it.
+ */
+struct RxRingConfig {
+    /// @brief Size of a single block. Must be a multiple of the page
+    ///        size.
+    std::size_t blockSize = 1 << 20;
+
+    /// @brief Number of blocks in the ring.
+    std::size_t blockCount = 64;
+
+    /// @brief Nominal frame size. With TPACKET_V3 frames are
+    ///        variable-length, so this is only used by the kernel to
+    ///        size some internal data. Must be a multiple of 16.
+    std::size_t frameSize = 2048;
+
+    /// @brief Block retire timeout, in milliseconds.
+    unsigned int blockTimeoutMs = 10;
+};
+
+/**
+ * @brief Statistics about a receive ring, as reported by the kernel.
+ *
+ * Note that the kernel resets its counters each time they are read.
+ */
+struct RxRingStatistics {
+    /// @brief Frames received by the socket.
+    std::uint64_t packets = 0;
+
+    /// @brief Frames dropped because the ring was full.
+    std::uint64_t drops = 0;
+
+    /// @brief Times the ring was found full by the kernel.
+    std::uint64_t freezes = 0;
+};
+
+/**
+ * @brief A zero-copy receive ring on a raw socket, implemented via
+ *        PACKET_MMAP with TPACKET_V3.
+ *
+ * Frames are handed out as NetworkLib::BufferWritableView objects
+ * pointing straight into the memory shared with the kernel: no copy
+ * and no system call is involved as long as there are frames already
+ * stored in the ring.
+ *
+ * Each block of the ring is handed back to the kernel as soon as all
+ * the BufferView and BufferWritableView objects referring to frames
+ * in it have been destroyed. This means that holding on to a frame
+ * for a long time prevents the kernel from reusing its block: when
+ * frames need to be retained, copy them into a buffer taken from a
+ * NetworkLib::PacketBufferPool instead.
+ *
+ * The given BufferWritableView passed to getEthPacket() is not used
+ * at all, as data already resides in the ring.
+ *
+ * Example:
+ *
+ *     auto fd = RawSocketsUtil::openByIfIndex(ifIdx, mode);
+ *     RawSocketsUtil::PacketMMapRxRing ring(fd);
+ *     NetworkLib::BufferWritableView unused;
+ *
+ *     while (running) {
+ *         if (!ring.packetAvailable()) {
+ *             ring.waitForPacket(100);
+ *             continue;
+ *         }
+ *
+ *         processor.consumeEthPacket(ring.getEthPacket(unused));
+ *     }
+ *
+ * @note As with NetworkLib::PacketBufferSizedPool, the ring must
+ *       outlive all the views it gave out.
+ *
+ * @note The ring doesn't own the socket: closing it (after having
+ *       destroyed the ring) is up to the caller.
+ */
+class PacketMMapRxRing : public NetworkLib::EthPacketSource {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Set up a TPACKET_V3 receive ring on the given raw socket
+    ///        (e.g. as returned by openByIfIndex()).
+    ///
+    /// Throw std::invalid_argument if the ring geometry isn't valid,
+    /// std::runtime_error on other errors.
+    explicit PacketMMapRxRing(SocketFD socketfd,
+                              const RxRingConfig &config = RxRingConfig());
+
+    virtual ~PacketMMapRxRing();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    PacketMMapRxRing(const PacketMMapRxRing &) = delete;
+    PacketMMapRxRing &operator=(const PacketMMapRxRing &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    PacketMMapRxRing(PacketMMapRxRing &&) = delete;
+    PacketMMapRxRing &operator=(PacketMMapRxRing &&) = delete;
+    ///@}
+
+    ///@name Implement EthPacketSource interface.
+    ///@{
+
+    /// @brief True if a frame is ready to be read from the ring.
+    ///
+    /// It never blocks and never performs system calls.
+    virtual bool packetAvailable() override;
+
+    /// @brief Get the next frame in the ring, or an empty
+    ///        BufferWritableView if there's none.
+    ///
+    /// The given BufferWritableView is ignored.
+    virtual NetworkLib::BufferWritableView
+    getEthPacket(NetworkLib::BufferWritableView &) override;
+
+    ///@}
+
+    /// @brief Wait until a frame is available or the given timeout
+    ///        (in milliseconds, -1 meaning forever) expires.
+    ///
+    /// @return true if a frame is available.
+    ///
+    /// Throw std::runtime_error on errors.
+    bool waitForPacket(int timeoutMs);
+
+    /// @brief Get (and reset) the ring statistics.
+    ///
+    /// Throw std::runtime_error on errors.
+    RxRingStatistics getStatistics();
+
+    /// @brief Get the underlying socket.
+    SocketFD getSocket() const { return mSocketFD; }
+
+  private:
+    // A PacketBuffer wrapping one block of the ring, given back to
+    // the kernel when the last reference to it is dropped.
+    class Block : public NetworkLib::PacketBuffer {
+      public:
+        Block(PacketMMapRxRing *ring, unsigned char *ptr, std::size_t size)
+            : mRing(ring), mPtr(ptr), mSize(size) {}
+        virtual std::size_t size() const override { return mSize; }
+        unsigned char *data() override { return mPtr; }
+
+        // True from when the block is opened until the last view on
+        // it goes away. The kernel status of such a block is still
+        // TP_STATUS_USER, but its frames were already handed out.
+        bool isHandedOut() const {
+            return __atomic_load_n(&mHandedOut, __ATOMIC_ACQUIRE);
+        }
+
+        void setHandedOut(bool handedOut) {
+            __atomic_store_n(&mHandedOut, handedOut, __ATOMIC_RELEASE);
+        }
+
+      protected:
+        void recycle() noexcept override { mRing->releaseBlock(this); }
+
+      private:
+        PacketMMapRxRing *mRing;
+        unsigned char *mPtr;
+        std::size_t mSize;
+        bool mHandedOut = false;
+    };
+
+    SocketFD mSocketFD;
+    RxRingConfig mConfig;
+
+    // The mmap()ed ring.
+    unsigned char *mRing = nullptr;
+    std::size_t mRingSize = 0;
+
+    std::vector<Block> mBlocks;
+
+    // Index of the next block to be read.
+    std::size_t mNextBlock = 0;
+
+    // View on the whole block currently being read; it keeps the
+    // block away from the kernel as long as we are reading it.
+    NetworkLib::BufferWritableView mCurrentBlockView;
+
+    // Frames yet to be read in the current block, and offset of the
+    // next one.
+    std::size_t mFramesLeft = 0;
+    std::size_t mNextFrameOffset = 0;
+
+    // Move on to the next block, if the kernel has handed it over to
+    // us.
+    bool openNextBlock();
+
+    // Give back a block to the kernel.
+    void releaseBlock(NetworkLib::PacketBuffer *p) noexcept;
+};
+
+/**
+ * @brief Geometry and flush policy of a PACKET_MMAP transmit ring.
+ */
+struct TxRingConfig {
+    /// @brief Size of a single slot, including a small header used by
+    ///        the kernel. Must be a multiple of 16 and large enough
+    ///        for the largest frame (i.e. MTU plus Ethernet header)
+    ///        plus 32 bytes.
+    std::size_t frameSize = 2048;
+
+    /// @brief Number of slots in the ring.
+    std::size_t frameCount = 1024;
+
+    /// @brief Number of frames queued before they are handed to the
+    ///        kernel with a single system call.
+    std::size_t batchSize = 64;
+
+    /// @brief Maximum time (in microseconds) a queued frame may wait
+    ///        before being handed to the kernel, even when the batch
+    ///        isn't full yet.
+    ///
+    /// See also PacketMMapTxRing::flushIfDeadlineExpired().
+    unsigned int maxLatencyUs = 100;
+
+    /// @brief Bypass the kernel queueing discipline layer
+    ///        (PACKET_QDISC_BYPASS).
+    bool bypassQdisc = false;
+};
+
+/**
+ * @brief A batched transmit ring on a raw socket, implemented via
+ *        PACKET_MMAP (PACKET_TX_RING).
+ *
+ * Frames are stored in slots of memory shared with the kernel, and
+ * handed over to it with a single ``sendto()`` each
+ * TxRingConfig::batchSize frames or, at most, after
+ * TxRingConfig::maxLatencyUs microseconds.
+ *
+ * Frames can be passed to consumeEthPacket() as usual, in which case
+ * they are copied into the next free slot. But the ring also exposes
+ * its next free slot via getFrameBuffer(): frames built directly into
+ * it are sent without any copy. The returned reference stays valid
+ * for the whole life of the ring, and it's updated to point to a new
+ * free slot each time a frame is queued. This allows, for example:
+ *
+ *     NetworkLib::GTPv1UEthEncap encap(txRing.getFrameBuffer());
+ *
+ * Frames made of several segments (see consumeEthPacketChain(), e.g.
+ * from a NetworkLib::IPv4EncapSink) are gathered straight into the
+ * slot. For each packet:
+ *
+ *     NetworkLib::GTPv1UEthEncap encap(txRing.getFrameBuffer());
+ *     encap.init() ... .computeAndSetChecksums();
+ *     txRing.consumeEthPacket(encap.getEthFrame());
+ *
+ * Frames still queued when the ring is destroyed are flushed.
+ *
+ * @note The PACKET_MMAP version is a per-socket setting, so use a
+ *       socket dedicated to sending, as returned by
+ *       openForSendingByIfIndex(), rather than a socket also used by
+ *       a PacketMMapRxRing.
+ *
+ * @note The ring doesn't own the socket: closing it (after having
+ *       destroyed the ring) is up to the caller.
+ */
+class PacketMMapTxRing : public NetworkLib::EthPacketSink {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Set up a transmit ring on the given raw socket.
+    ///
+    /// Throw std::invalid_argument if the ring geometry isn't valid,
+    /// std::runtime_error on other errors.
+    explicit PacketMMapTxRing(SocketFD socketfd,
+                              const TxRingConfig &config = TxRingConfig());
+
+    virtual ~PacketMMapTxRing();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    PacketMMapTxRing(const PacketMMapTxRing &) = delete;
+    PacketMMapTxRing &operator=(const PacketMMapTxRing &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    PacketMMapTxRing(PacketMMapTxRing &&) = delete;
+    PacketMMapTxRing &operator=(PacketMMapTxRing &&) = delete;
+    ///@}
+
+    ///@name Implement EthPacketSink interface.
+    ///@{
+
+    /// @brief Queue a frame for transmission.
+    ///
+    /// If the frame was built in place in the slot returned by
+    /// getFrameBuffer(), no copy is done. If it was built further on
+    /// in that slot (e.g. leaving some headroom), it's moved to the
+    /// start of the slot.
+    ///
+    /// Throw std::length_error if the frame doesn't fit a slot,
+    /// std::runtime_error on errors.
+    virtual void consumeEthPacket(
+        const NetworkLib::BufferView &ethData,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    /// @brief Queue a frame made of several segments for
+    ///        transmission, gathering them into the next slot.
+    ///
+    /// Throw std::length_error if the frame doesn't fit a slot,
+    /// std::runtime_error on errors.
+    virtual void consumeEthPacketChain(
+        const NetworkLib::BufferChain &ethData,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    ///@}
+
+    /// @brief Get the next free slot of the ring.
+    ///
+    /// The reference stays valid for the whole life of the ring,
+    /// while the view it refers to changes each time a frame is
+    /// queued.
+    NetworkLib::BufferWritableView &getFrameBuffer() { return mFrameBuffer; }
+
+    /// @brief Hand all the queued frames to the kernel now.
+    ///
+    /// Throw std::runtime_error on errors.
+    void flush();
+
+    /// @brief Hand all the queued frames to the kernel if the oldest
+    ///        one has been waiting for more than
+    ///        TxRingConfig::maxLatencyUs.
+    ///
+    /// Someone must call this periodically, or frames may be left
+    /// queued for good once traffic stops: EventLoop and
+    /// FanoutWorkers do it for the rings registered with them (see
+    /// EventLoop::addTxRing() and FanoutWorkers::addTxRing()), after
+    /// each round with traffic, and flush the rings altogether as
+    /// soon as a round finds none. Otherwise, it's up to the owner of
+    /// the ring, e.g. from its own receive loop.
+    ///
+    /// Throw std::runtime_error on errors.
+    void flushIfDeadlineExpired() {
+        if (mQueued > 0 && std::chrono::steady_clock::now() >= mDeadline) {
+            flush();
+        }
+    }
+
+    /// @brief Number of frames queued and not yet handed to the
+    ///        kernel.
+    std::size_t queued() const { return mQueued; }
+
+    /// @brief Get the underlying socket.
+    SocketFD getSocket() const { return mSocketFD; }
+
+  private:
+    SocketFD mSocketFD;
+    TxRingConfig mConfig;
+
+    // The mmap()ed ring.
+    unsigned char *mRing = nullptr;
+    std::size_t mRingSize = 0;
+
+    // Start of each slot.
+    std::vector<unsigned char *> mSlots;
+
+    // Index of the next free slot, and a view on its data area.
+    std::size_t mCurrentSlot = 0;
+    NetworkLib::BufferWritableView mFrameBuffer;
+
+    // Frames queued since the last flush, and when they must be
+    // flushed at most.
+    std::size_t mQueued = 0;
+    std::chrono::steady_clock::time_point mDeadline;
+
+    // Wait for the current slot to be available to userspace, and
+    // update mFrameBuffer accordingly.
+    void acquireCurrentSlot();
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_PACKETMMAP_HH
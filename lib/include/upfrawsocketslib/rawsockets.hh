@@ -6,6 +6,9 @@
 // For std::size_t
 #include <cstddef>
 
+// For std::uint16_t
+#include <cstdint>
+
 // For std::string
 #include <string>
 
@@ -27,12 +30,89 @@ enum PromiscuousMode {
     PROMISCUOS_MODE_ENABLED = 1
 };
 
+/// @brief How a PACKET_FANOUT group spreads traffic among its
+///        sockets.
+enum FanoutMode {
+    /// @brief By flow hash, so all frames of a flow reach the same
+    ///        socket. IP fragments are reassembled by the kernel
+    ///        before hashing.
+    FANOUT_MODE_HASH = 0,
+
+    /// @brief By the CPU the frame was received on.
+    FANOUT_MODE_CPU = 1,
+
+    /// @brief Round-robin.
+    FANOUT_MODE_ROUND_ROBIN = 2
+};
+
+/// @brief Outcome of the non-throwing batch I/O functions.
+enum IOStatus {
+    /// @brief At least one frame was received or sent.
+    IO_STATUS_OK = 0,
+
+    /// @brief Nothing to do right now (EAGAIN/EWOULDBLOCK on a
+    ///        non-blocking socket).
+    IO_STATUS_WOULD_BLOCK = 1,
+
+    /// @brief Interrupted by a signal before any frame was
+    ///        received or sent (EINTR).
+    IO_STATUS_INTERRUPTED = 2,
+
+    /// @brief Any other error: see BatchResult::errorNumber.
+    IO_STATUS_ERROR = 3
+};
+
+/// @brief Result of receiveBatch() and sendBatch().
+struct BatchResult {
+    /// @brief Outcome of the call.
+    IOStatus status = IO_STATUS_OK;
+
+    /// @brief Number of frames received or sent.
+    std::size_t count = 0;
+
+    /// @brief Value of errno when status is IO_STATUS_ERROR, 0
+    ///        otherwise.
+    int errorNumber = 0;
+};
+
+/// @brief Maximum number of frames handled by a single call to
+///        receiveBatch() or sendBatch().
+constexpr std::size_t maxBatchSize = 64;
+
 /// @brief Open a raw socket for getting all traffic received by the
 ///         interface with the given ifIndex.
 ///
 /// Throw std::runtime_error on errors.
 SocketFD openByIfIndex(IfIndex ifIdx, PromiscuousMode mode);
 
+/// @brief Add a raw socket to a PACKET_FANOUT group.
+///
+/// All the sockets bound to the same interface and joining the same
+/// group (with the same mode) share the traffic received by the
+/// interface, instead of each getting a copy of it.
+///
+/// Throw std::runtime_error on errors.
+void joinFanoutGroup(SocketFD socketfd, std::uint16_t groupId,
+                     FanoutMode mode);
+
+/// @brief Open a raw socket via openByIfIndex(), and add it to the
+///        given PACKET_FANOUT group.
+///
+/// Throw std::runtime_error on errors.
+SocketFD openByIfIndexInFanoutGroup(IfIndex ifIdx, PromiscuousMode mode,
+                                    std::uint16_t groupId,
+                                    FanoutMode fanoutMode);
+
+/// @brief Open a raw socket for sending traffic only on the
+///        interface with the given ifIndex.
+///
+/// Unlike openByIfIndex(), the socket doesn't get any of the traffic
+/// received by the interface, so the kernel doesn't waste time
+/// queueing frames nobody is going to read.
+///
+/// Throw std::runtime_error on errors.
+SocketFD openForSendingByIfIndex(IfIndex ifIdx);
+
 /// @brief Get an ifIndex out of an ifName.
 ///
 /// Throws std::runtime_error if the specified interface can't be
@@ -60,6 +140,44 @@ receiveData(SocketFD socketfd,
 /// Throws std::runtime_error on errors
 void sendData(SocketFD, const NetworkLib::BufferView &bufferView);
 
+/// @brief Send a frame made of several segments (e.g. headers and
+///        payload) to a raw socket, with a single ``sendmsg()``
+///        gathering them, so that they don't need to be copied
+///        together first.
+///
+/// Throws std::runtime_error on errors
+void sendData(SocketFD, const NetworkLib::BufferChain &bufferChain);
+
+/// @brief Receive up to `count` frames from a raw socket with a
+///        single system call (``recvmmsg()``).
+///
+/// Frame `i` is stored at the start of `buffers[i]` (e.g. a
+/// BufferWritableView taken from a NetworkLib::PacketBufferPool), and
+/// its size is stored in `sizes[i]`, so that
+/// ``buffers[i].getSub(0, sizes[i])`` is a view on the frame.
+///
+/// At most maxBatchSize frames are received. On a blocking socket,
+/// the call waits only for the first frame. When no frame is received
+/// without an error (e.g. `count` is 0), the status is
+/// IO_STATUS_WOULD_BLOCK, so IO_STATUS_OK always comes with frames.
+///
+/// Errors are reported via the result, as EAGAIN and EINTR are part
+/// of normal operation on busy loops: this never throws.
+BatchResult receiveBatch(SocketFD socketfd,
+                         const NetworkLib::BufferWritableView *buffers,
+                         std::size_t *sizes, std::size_t count) noexcept;
+
+/// @brief Send up to `count` frames to a raw socket with a single
+///        system call (``sendmmsg()``).
+///
+/// At most maxBatchSize frames are sent. When BatchResult::count is
+/// less than `count`, the remaining frames haven't been sent and
+/// should be retried by the caller.
+///
+/// Errors are reported via the result: this never throws.
+BatchResult sendBatch(SocketFD socketfd, const NetworkLib::BufferView *frames,
+                      std::size_t count) noexcept;
+
 /// @brief Close a raw socket.
 void closeSocket(SocketFD socketfd);
 
@@ -0,0 +1,198 @@
+#ifndef UPFRAWSOCKETSLIB_SOCKETFILTER_HH
+#define UPFRAWSOCKETSLIB_SOCKETFILTER_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint8_t, std::uint16_t and std::uint32_t
+#include <cstdint>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief A single classic BPF instruction, with the same layout as
+///        the kernel ``struct sock_filter``.
+struct SocketFilterInstruction {
+    std::uint16_t code;
+    std::uint8_t jt;
+    std::uint8_t jf;
+    std::uint32_t k;
+};
+
+/**
+ * @brief A tiny assembler of classic BPF socket filters.
+ *
+ * Instructions are appended one after the other; jumps refer to
+ * labels, which can be bound to the next instruction after the jump
+ * has been added (classic BPF only allows forward jumps), and are
+ * resolved by assemble().
+ *
+ * Loads from the frame use offsets from the start of the Ethernet
+ * header. When a filter returns 0 the frame is dropped by the kernel,
+ * otherwise it's passed to the socket, truncated to the returned
+ * size.
+ *
+ * Example (accepting IPv4 frames only):
+ *
+ *     SocketFilterProgram p;
+ *     auto reject = p.makeLabel();
+ *     auto accept = p.makeLabel();
+ *
+ *     p.loadHalfWord(12);
+ *     p.jumpIfEqual(0x0800, accept, reject);
+ *     p.bindLabel(accept);
+ *     p.returnValue(SocketFilterProgram::acceptFrame);
+ *     p.bindLabel(reject);
+ *     p.returnValue(SocketFilterProgram::rejectFrame);
+ *
+ *     attachFilter(socketfd, p);
+ */
+class SocketFilterProgram {
+  public:
+    /// @brief A type identifying a jump target.
+    using Label = std::size_t;
+
+    /// @brief Value returned to accept a whole frame.
+    static constexpr std::uint32_t acceptFrame = 0xFFFFFFFF;
+
+    /// @brief Value returned to drop a frame.
+    static constexpr std::uint32_t rejectFrame = 0;
+
+    /// @brief Create a new label, not bound to any instruction yet.
+    Label makeLabel();
+
+    /// @brief Bind a label to the next instruction to be added.
+    ///
+    /// Throw std::logic_error if the label is already bound.
+    void bindLabel(Label label);
+
+    ///@name Instructions
+    ///@{
+
+    /// @brief A = byte at `offset`
+    void loadByte(std::uint32_t offset);
+
+    /// @brief A = 16-bit word at `offset`
+    void loadHalfWord(std::uint32_t offset);
+
+    /// @brief A = 32-bit word at `offset`
+    void loadWord(std::uint32_t offset);
+
+    /// @brief A = byte at `X + offset`
+    void loadByteIndirect(std::uint32_t offset);
+
+    /// @brief A = 16-bit word at `X + offset`
+    void loadHalfWordIndirect(std::uint32_t offset);
+
+    /// @brief A = 32-bit word at `X + offset`
+    void loadWordIndirect(std::uint32_t offset);
+
+    /// @brief A = `value`
+    void loadValue(std::uint32_t value);
+
+    /// @brief A = length of the frame
+    void loadLength();
+
+    /// @brief Scratch memory slot `slot` (0 to 15) = A
+    void storeScratch(std::uint32_t slot);
+
+    /// @brief X = scratch memory slot `slot` (0 to 15)
+    void loadIndexFromScratch(std::uint32_t slot);
+
+    /// @brief A = A & `value`
+    void andValue(std::uint32_t value);
+
+    /// @brief A = A << `value`
+    void shiftLeft(std::uint32_t value);
+
+    /// @brief A = A + `value`
+    void addValue(std::uint32_t value);
+
+    /// @brief A = A + X
+    void addIndex();
+
+    /// @brief Jump to `ifTrue` if A == `value`, to `ifFalse` otherwise.
+    void jumpIfEqual(std::uint32_t value, Label ifTrue, Label ifFalse);
+
+    /// @brief Jump to `ifTrue` if (A & `value`) != 0, to `ifFalse`
+    ///        otherwise.
+    void jumpIfAnySet(std::uint32_t value, Label ifTrue, Label ifFalse);
+
+    /// @brief Jump to `ifTrue` if A >= X, to `ifFalse` otherwise.
+    void jumpIfGreaterOrEqualIndex(Label ifTrue, Label ifFalse);
+
+    /// @brief Unconditional jump.
+    void jump(Label target);
+
+    /// @brief Return `value` (see acceptFrame and rejectFrame).
+    void returnValue(std::uint32_t value);
+
+    ///@}
+
+    /// @brief Number of instructions added so far.
+    std::size_t size() const { return mInstructions.size(); }
+
+    /// @brief Resolve the labels and return the program.
+    ///
+    /// Throw std::logic_error if a label hasn't been bound, or it
+    /// isn't reachable by a classic BPF jump (which can go only
+    /// forward, and at most 255 instructions away when conditional),
+    /// std::length_error if the program is too long to be loaded by
+    /// the kernel.
+    std::vector<SocketFilterInstruction> assemble() const;
+
+  private:
+    struct PendingInstruction {
+        SocketFilterInstruction instruction;
+
+        // Jump targets, when the instruction is a jump.
+        bool isJump;
+        Label jt;
+        Label jf;
+    };
+
+    // Label values: index of the instruction they are bound to.
+    std::vector<std::size_t> mLabels;
+    std::vector<PendingInstruction> mInstructions;
+
+    void add(std::uint16_t code, std::uint32_t k);
+    void addJump(std::uint16_t code, std::uint32_t k, Label jt, Label jf);
+};
+
+/// @brief Attach a classic BPF filter to a raw socket, so unwanted
+///        frames are dropped by the kernel before reaching user space.
+///
+/// If a filter is already attached, it's atomically replaced: there's
+/// no time window in which no filter (or both) apply. Frames queued on
+/// the socket before the filter is attached aren't filtered, though.
+///
+/// Throw std::runtime_error on errors (including the socket filter
+/// being locked by lockFilter(), or the program exceeding the
+/// ``net.core.optmem_max`` limit), std::logic_error and
+/// std::length_error as SocketFilterProgram::assemble().
+void attachFilter(SocketFD socketfd, const SocketFilterProgram &program);
+
+/// @brief Lock the filter attached to a raw socket
+///        (``SO_LOCK_FILTER``), so it can't be replaced or detached
+///        any longer, e.g. by less privileged code the socket is
+///        passed to.
+///
+/// @note The lock can't be undone.
+///
+/// Throw std::runtime_error on errors.
+void lockFilter(SocketFD socketfd);
+
+/// @brief Detach the filter attached to a raw socket, if any.
+///
+/// Throw std::runtime_error on errors.
+void detachFilter(SocketFD socketfd);
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_SOCKETFILTER_HH
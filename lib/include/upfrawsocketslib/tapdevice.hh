@@ -0,0 +1,294 @@
+#ifndef UPFRAWSOCKETSLIB_TAPDEVICE_HH
+#define UPFRAWSOCKETSLIB_TAPDEVICE_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::unique_ptr
+#include <memory>
+
+// For std::string
+#include <string>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief Kind of traffic exchanged with a TapDevice.
+enum TapMode {
+    /// @brief Ethernet frames (a TAP device).
+    TAP_MODE_ETHERNET = 0,
+
+    /// @brief IPv4 packets, with no link-layer header (a TUN device).
+    TAP_MODE_IP = 1
+};
+
+/**
+ * @brief Configuration of a TapDevice.
+ */
+struct TapDeviceConfig {
+    /// @brief Name of the interface: when empty, the kernel picks
+    ///        one. When an interface with this name already exists
+    ///        (e.g. a persistent one), it's attached to.
+    std::string ifName;
+
+    /// @brief Ethernet frames or IPv4 packets.
+    TapMode mode = TAP_MODE_ETHERNET;
+
+    /// @brief Number of queues (``IFF_MULTI_QUEUE``), typically one
+    ///        per thread.
+    std::size_t queues = 1;
+
+    /// @brief Exchange a ``virtio_net_hdr`` with each frame/packet,
+    ///        carrying checksum and segmentation offload metadata
+    ///        (``IFF_VNET_HDR``).
+    bool vnetHeader = true;
+
+    /// @brief Ask the kernel to hand over GSO super-packets (up to
+    ///        64 KB) and packets with partial checksums, rather than
+    ///        segmenting them and computing checksums in software.
+    ///        Requires vnetHeader.
+    bool receiveOffloads = true;
+
+    /// @brief Open queues in non-blocking mode.
+    bool nonBlocking = false;
+};
+
+/**
+ * @brief A single queue of a TapDevice.
+ *
+ * In TAP_MODE_ETHERNET it's a source and a sink of Ethernet frames,
+ * in TAP_MODE_IP it's a source and a sink of IPv4 packets: using the
+ * other interfaces throws std::logic_error.
+ *
+ * When ``virtio_net_hdr`` is in use, its metadata is exchanged
+ * via NetworkLib::ContextUserData::offloadInfo: frames read via
+ * getEthPacket(BufferWritableView &, ContextUserData &) (or its IPv4
+ * counterpart) have it filled in, so that it reaches the Context of
+ * an EthPacketProcessor, and frames written via consumeEthPacket()
+ * (or its IPv4 counterpart) are described by it. This way, a single
+ * read or write can move a GSO super-packet of up to 64 KB, and
+ * checksums can be left to the kernel or to the network card.
+ *
+ * Buffers used for reading must therefore be large enough for a
+ * whole super-packet (up to 64 KB; e.g. NetworkLib::PacketBufferPool
+ * buffers are): a frame/packet which doesn't fit is truncated by the
+ * kernel, and reading it throws std::runtime_error.
+ *
+ * @note Instances are not thread safe: use one queue per thread.
+ */
+class TapQueue : public NetworkLib::EthPacketSource,
+                 public NetworkLib::EthPacketSink,
+                 public NetworkLib::IPv4PacketSource,
+                 public NetworkLib::IPv4PacketSink {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Take ownership of an already set up queue file
+    ///        descriptor (see TapDevice).
+    TapQueue(int fd, TapMode mode, bool vnetHeader);
+
+    /// @brief Close the queue.
+    virtual ~TapQueue();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    TapQueue(const TapQueue &) = delete;
+    TapQueue &operator=(const TapQueue &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    TapQueue(TapQueue &&) = delete;
+    TapQueue &operator=(TapQueue &&) = delete;
+    ///@}
+
+    ///@name Implement EthPacketSource and IPv4PacketSource interfaces.
+    ///@{
+
+    /// @brief True if a frame/packet is ready to be read.
+    virtual bool packetAvailable() override;
+
+    /// @brief Read a frame into the given buffer. The offload metadata
+    ///        is available via getLastOffloadInfo().
+    ///
+    /// @return An empty view if the queue is non-blocking and there's
+    ///         nothing to read.
+    ///
+    /// Throw std::logic_error when not in TAP_MODE_ETHERNET,
+    /// std::runtime_error on errors (including a frame truncated to
+    /// the size of the buffer).
+    virtual NetworkLib::BufferWritableView
+    getEthPacket(NetworkLib::BufferWritableView &buffer) override;
+
+    /// @brief Read a packet into the given buffer. The offload
+    ///        metadata is available via getLastOffloadInfo().
+    ///
+    /// @return An empty view if the queue is non-blocking and there's
+    ///         nothing to read.
+    ///
+    /// Throw std::logic_error when not in TAP_MODE_IP,
+    /// std::runtime_error on errors (including a packet truncated to
+    /// the size of the buffer).
+    virtual NetworkLib::BufferWritableView
+    getIPv4Packet(NetworkLib::BufferWritableView &buffer) override;
+
+    ///@}
+
+    /// @brief As getEthPacket(), also storing the offload metadata
+    ///        into `userData.offloadInfo`.
+    NetworkLib::BufferWritableView
+    getEthPacket(NetworkLib::BufferWritableView &buffer,
+                 NetworkLib::ContextUserData &userData);
+
+    /// @brief As getIPv4Packet(), also storing the offload metadata
+    ///        into `userData.offloadInfo`.
+    NetworkLib::BufferWritableView
+    getIPv4Packet(NetworkLib::BufferWritableView &buffer,
+                  NetworkLib::ContextUserData &userData);
+
+    /// @brief Offload metadata of the last frame/packet read (all
+    ///        defaults when ``virtio_net_hdr`` isn't in use).
+    const NetworkLib::OffloadInfo &getLastOffloadInfo() const {
+        return mLastOffloadInfo;
+    }
+
+    ///@name Implement EthPacketSink and IPv4PacketSink interfaces.
+    ///@{
+
+    /// @brief Write a frame, described by `userData.offloadInfo`.
+    ///
+    /// Throw std::logic_error when not in TAP_MODE_ETHERNET,
+    /// std::runtime_error on errors.
+    virtual void consumeEthPacket(
+        const NetworkLib::BufferView &ethData,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    /// @brief Write a packet, described by `userData.offloadInfo`.
+    ///
+    /// Throw std::logic_error when not in TAP_MODE_IP,
+    /// std::runtime_error on errors.
+    virtual void consumeIPv4Packet(
+        const NetworkLib::BufferView &ipv4Data,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    /// @brief Write a frame made of several segments with a single
+    ///        ``writev()``, without copying them.
+    ///
+    /// See consumeEthPacket().
+    virtual void consumeEthPacketChain(
+        const NetworkLib::BufferChain &ethData,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    /// @brief Write a packet made of several segments with a single
+    ///        ``writev()``, without copying them.
+    ///
+    /// See consumeIPv4Packet().
+    virtual void consumeIPv4PacketChain(
+        const NetworkLib::BufferChain &ipv4Data,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    ///@}
+
+    /// @brief Get the queue file descriptor (e.g. to poll() it).
+    int getFD() const { return mFD; }
+
+  private:
+    int mFD;
+    TapMode mMode;
+    bool mVnetHeader;
+
+    NetworkLib::OffloadInfo mLastOffloadInfo;
+
+    void checkMode(TapMode mode, const char *function) const;
+    NetworkLib::BufferWritableView read(NetworkLib::BufferWritableView &b);
+    void write(const NetworkLib::BufferChain &data,
+               const NetworkLib::OffloadInfo &offloadInfo);
+};
+
+/**
+ * @brief A TAP (or TUN) device, with one or more queues.
+ *
+ * It's meant for exchanging traffic with local applications (e.g. the
+ * local breakout of decapsulated UE traffic to MEC applications)
+ * without the per-MTU packets and the software checksums of raw
+ * sockets on a veth pair: with offloads enabled (the default), each
+ * read or write moves a GSO super-packet.
+ *
+ * The device isn't persistent: it's removed from the system when
+ * destroyed. Configuring it (addresses, MTU, state) is up to the
+ * caller, e.g. via getIfName().
+ *
+ * Example:
+ *
+ *     RawSocketsUtil::TapDeviceConfig config;
+ *     config.ifName = "mec0";
+ *     config.queues = 4;
+ *
+ *     RawSocketsUtil::TapDevice tap(config);
+ *
+ *     // In worker thread i
+ *     RawSocketsUtil::TapQueue &q = tap.getQueue(i);
+ *     NetworkLib::ContextUserData userData;
+ *     auto frame = q.getEthPacket(buffer, userData);
+ *     processor.consumeEthPacket(frame, userData);
+ */
+class TapDevice {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Create the device and open all its queues.
+    ///
+    /// Throw std::invalid_argument if the configuration isn't valid,
+    /// std::runtime_error on other errors.
+    explicit TapDevice(const TapDeviceConfig &config = TapDeviceConfig());
+
+    /// @brief Close all the queues, removing the device.
+    ~TapDevice();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    TapDevice(const TapDevice &) = delete;
+    TapDevice &operator=(const TapDevice &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    TapDevice(TapDevice &&) = delete;
+    TapDevice &operator=(TapDevice &&) = delete;
+    ///@}
+
+    /// @brief Name of the interface.
+    const std::string &getIfName() const { return mIfName; }
+
+    /// @brief Number of queues.
+    std::size_t size() const { return mQueues.size(); }
+
+    /// @brief Get a queue (0 to size() - 1).
+    ///
+    /// Throw std::out_of_range if there's no such queue.
+    TapQueue &getQueue(std::size_t index) { return *mQueues.at(index); }
+
+  private:
+    std::string mIfName;
+    std::vector<std::unique_ptr<TapQueue>> mQueues;
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_TAPDEVICE_HH
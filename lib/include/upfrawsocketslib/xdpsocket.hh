@@ -0,0 +1,286 @@
+#ifndef UPFRAWSOCKETSLIB_XDPSOCKET_HH
+#define UPFRAWSOCKETSLIB_XDPSOCKET_HH
+
+#include <upfrawsocketslib/rawsockets.hh>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint32_t and std::uint64_t
+#include <cstdint>
+
+// For std::vector
+#include <vector>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+/// @brief How the default XDP program is attached to the interface.
+enum XDPAttachMode {
+    /// @brief Generic (SKB) mode: works on any interface (e.g. veth),
+    ///        but frames are still copied by the kernel.
+    XDP_ATTACH_MODE_GENERIC = 0,
+
+    /// @brief Native (driver) mode: requires driver support.
+    XDP_ATTACH_MODE_NATIVE = 1
+};
+
+/**
+ * @brief Configuration of a XDPSocket.
+ */
+struct XDPSocketConfig {
+    /// @brief Number of frames in the UMEM area.
+    std::size_t frameCount = 4096;
+
+    /// @brief Size of a single UMEM frame. Must be a power of two,
+    ///        at least 2048 and at most the page size.
+    std::size_t frameSize = 2048;
+
+    /// @brief Number of entries of each of the fill, completion, RX
+    ///        and TX rings. Must be a power of two, not larger than
+    ///        frameCount.
+    std::size_t ringSize = 2048;
+
+    /// @brief Interface queue the socket is bound to.
+    std::uint32_t queueId = 0;
+
+    /// @brief How to attach the default XDP program.
+    XDPAttachMode attachMode = XDP_ATTACH_MODE_GENERIC;
+
+    /// @brief Ask the driver for zero-copy mode. Requires native
+    ///        mode and driver support.
+    bool zeroCopy = false;
+
+    /// @brief Load and attach the default XDP program, redirecting
+    ///        all the traffic of the bound queue to the socket.
+    ///
+    /// When false, it's up to the caller to provide a XDP program
+    /// redirecting traffic to the socket (see XDPSocket::getSocket()).
+    bool attachDefaultProgram = true;
+};
+
+/**
+ * @brief A AF_XDP socket acting as both a EthPacketSource and a
+ *        EthPacketSink.
+ *
+ * Frames are stored in a UMEM area shared with the kernel, and are
+ * handed out as NetworkLib::BufferWritableView objects pointing
+ * straight into it, so decoders and encapsulators (like
+ * NetworkLib::GTPv1UIPv4Encap) can work in place. A UMEM frame is given
+ * back to the kernel for receiving as soon as all the views on it
+ * have been destroyed.
+ *
+ * When a view on a UMEM frame (e.g. a received frame modified in
+ * place) is passed to consumeEthPacket(), it's transmitted without
+ * any copy. Frames can also be built from scratch in place, in a
+ * free UMEM frame returned by getFrameBuffer(). Anything else is
+ * copied into a free UMEM frame.
+ *
+ * Unless told otherwise, a minimal XDP program is loaded and attached
+ * to the interface, redirecting all the traffic of the bound queue
+ * to the socket, so it bypasses the kernel network stack entirely.
+ * Traffic of other queues goes on through the kernel. The program is
+ * detached when the socket is destroyed.
+ *
+ * Transmission is batched: frames are handed to the kernel when
+ * flush() is called, when a batch is full, and before waiting for
+ * traffic in waitForPacket().
+ *
+ * @note Instances are not thread safe: use one XDPSocket per queue
+ *       and per thread.
+ *
+ * @note As with NetworkLib::PacketBufferSizedPool, the socket must
+ *       outlive all the views it gave out.
+ */
+class XDPSocket : public NetworkLib::EthPacketSource,
+                  public NetworkLib::EthPacketSink {
+  public:
+    ///@name Constructors and destructor
+    ///@{
+
+    /// @brief Create a AF_XDP socket bound to the given interface
+    ///        queue.
+    ///
+    /// Throw std::invalid_argument if the configuration isn't valid,
+    /// std::runtime_error on other errors.
+    explicit XDPSocket(IfIndex ifIdx,
+                       const XDPSocketConfig &config = XDPSocketConfig());
+
+    virtual ~XDPSocket();
+
+    ///@}
+
+    ///@name Copy semantic (disabled)
+    ///@{
+    XDPSocket(const XDPSocket &) = delete;
+    XDPSocket &operator=(const XDPSocket &) = delete;
+    ///@}
+
+    ///@name Move semantic (disabled)
+    ///@{
+    XDPSocket(XDPSocket &&) = delete;
+    XDPSocket &operator=(XDPSocket &&) = delete;
+    ///@}
+
+    ///@name Implement EthPacketSource interface.
+    ///@{
+
+    /// @brief True if a frame is ready to be read.
+    ///
+    /// It never blocks. When there's none, it tops up the fill ring
+    /// and, if the kernel asks for it (XDP_RING_NEED_WAKEUP), wakes it
+    /// up with a non-blocking system call.
+    ///
+    /// Throw std::runtime_error on errors.
+    virtual bool packetAvailable() override;
+
+    /// @brief Get the next received frame, or an empty
+    ///        BufferWritableView if there's none.
+    ///
+    /// The given BufferWritableView is ignored.
+    virtual NetworkLib::BufferWritableView
+    getEthPacket(NetworkLib::BufferWritableView &) override;
+
+    ///@}
+
+    ///@name Implement EthPacketSink interface.
+    ///@{
+
+    /// @brief Queue a frame for transmission.
+    ///
+    /// Views on UMEM frames are transmitted without copies.
+    ///
+    /// Throw std::length_error if the frame doesn't fit a UMEM frame,
+    /// std::runtime_error if no UMEM frame can be found to copy it
+    /// into, or on other errors.
+    virtual void consumeEthPacket(
+        const NetworkLib::BufferView &ethData,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    /// @brief Queue a frame made of several segments for
+    ///        transmission, gathering them into a free UMEM frame.
+    ///
+    /// Throw as consumeEthPacket().
+    virtual void consumeEthPacketChain(
+        const NetworkLib::BufferChain &ethData,
+        NetworkLib::ContextUserData &userData =
+            NetworkLib::defaultContextUserData) override;
+
+    ///@}
+
+    /// @brief Get a view on a whole free UMEM frame, to build a frame
+    ///        to be transmitted in place, or an empty view if there
+    ///        are no free frames.
+    NetworkLib::BufferWritableView getFrameBuffer();
+
+    /// @brief Hand all the queued frames to the kernel, and reclaim
+    ///        the ones already transmitted.
+    ///
+    /// Throw std::runtime_error on errors.
+    void flush();
+
+    /// @brief Wait until a frame is available or the given timeout
+    ///        (in milliseconds, -1 meaning forever) expires.
+    ///
+    /// @return true if a frame is available.
+    ///
+    /// Throw std::runtime_error on errors.
+    bool waitForPacket(int timeoutMs);
+
+    /// @brief Get the underlying AF_XDP socket.
+    SocketFD getSocket() const { return mSocketFD; }
+
+  private:
+    // A PacketBuffer wrapping one UMEM frame, given back to the socket
+    // when the last reference to it is dropped. As the socket isn't
+    // thread safe anyway, a plain reference count is enough.
+    class Frame : public NetworkLib::PacketBuffer {
+      public:
+        Frame(XDPSocket *socket, unsigned char *ptr, std::size_t size)
+            : mSocket(socket), mPtr(ptr), mSize(size) {
+            setThreadSafeReferences(false);
+        }
+        virtual std::size_t size() const override { return mSize; }
+        unsigned char *data() override { return mPtr; }
+
+      protected:
+        void recycle() noexcept override { mSocket->releaseFrame(this); }
+
+      private:
+        XDPSocket *mSocket;
+        unsigned char *mPtr;
+        std::size_t mSize;
+    };
+
+    // One of the four rings shared with the kernel.
+    struct Ring {
+        std::uint32_t *producer = nullptr;
+        std::uint32_t *consumer = nullptr;
+        std::uint32_t *flags = nullptr;
+        void *descriptors = nullptr;
+        std::uint32_t mask = 0;
+
+        void *map = nullptr;
+        std::size_t mapSize = 0;
+    };
+
+    XDPSocketConfig mConfig;
+    IfIndex mIfIndex;
+    SocketFD mSocketFD = -1;
+
+    // XDP program, XSKMAP and the link attaching the program to the
+    // interface (-1 when not used).
+    int mProgramFD = -1;
+    int mMapFD = -1;
+    int mLinkFD = -1;
+
+    unsigned char *mUmem = nullptr;
+    std::size_t mUmemSize = 0;
+
+    Ring mFillRing;
+    Ring mCompletionRing;
+    Ring mRxRing;
+    Ring mTxRing;
+
+    std::vector<Frame> mFrames;
+
+    // Addresses of free UMEM frames.
+    std::vector<std::uint64_t> mFreeFrames;
+
+    // Views on frames being transmitted, by frame index: they keep
+    // frames alive until the kernel is done with them.
+    std::vector<NetworkLib::BufferView> mTxInFlight;
+
+    // Frames queued on the TX ring and not yet handed to the kernel.
+    std::size_t mTxQueued = 0;
+
+    void setUpUmemAndRings();
+    void cleanUp() noexcept;
+    void attachDefaultProgram();
+
+    // Make a view on the whole UMEM frame with the given index.
+    NetworkLib::BufferWritableView makeFrameView(std::size_t frameIndex);
+
+    // Give back a UMEM frame when the last view on it is gone.
+    void releaseFrame(NetworkLib::PacketBuffer *p) noexcept;
+
+    // Move free frames to the fill ring.
+    void refillFillRing();
+
+    // Kick the kernel if it's waiting to be told that there are
+    // frames in the fill ring.
+    void wakeUpRxIfNeeded();
+
+    // Reclaim frames already transmitted.
+    void reapCompletions();
+
+    // Get a free UMEM frame to copy a frame to be transmitted into,
+    // flushing if needed, or throw std::runtime_error.
+    NetworkLib::BufferWritableView getTxFrameBuffer(const char *function);
+};
+
+} // namespace RawSocketsUtil
+} // namespace UPF
+
+#endif // UPFRAWSOCKETSLIB_XDPSOCKET_HH
@@ -28,6 +28,22 @@ namespace UPFRouterLib {
  *    frame to the destination (i.e. an empty NetworkLib::BufferView),
  *    so it can be intercepted at a later stage (for example by a
  *    NetworkLib::IPv4PacketTap).
+ *
+ * By default, packets are copied into the encapsulation buffer. With
+ * in-place encapsulation enabled (see enableInPlaceEncap(bool)),
+ * packets with enough headroom (see NetworkLib::defaultHeadroom) get
+ * the outer headers written right in front of them instead, and
+ * nothing is copied.
+ *
+ * The offload metadata in the given ContextUserData (see
+ * NetworkLib::ContextUserData::offloadInfo) can't describe the
+ * encapsulated packet: a partial checksum of the packet is completed
+ * in software before the outer UDP checksum is computed, then the
+ * metadata is reset. GSO super-packets (e.g. from a
+ * RawSocketsUtil::TapQueue with offloads) are segmented in software
+ * (see NetworkLib::GSOSegmenter), and each segment is encapsulated
+ * and sent on its own: the encapsulation buffer must then have room
+ * for a whole segment.
  */
 class GTPv1UEncapSink : public NetworkLib::IPv4PacketSink {
   public:
@@ -52,7 +68,9 @@ class GTPv1UEncapSink : public NetworkLib::IPv4PacketSink {
                     NetworkLib::IPv4IdentificationSource &identificationSource)
         : mDestination(destination), mRouter(router),
           mIdentificationSource(identificationSource),
-          mGTPIPv4Encapper(bufferWritableView) {}
+          mGTPIPv4Encapper(bufferWritableView),
+          mSegmentArea(bufferWritableView.getSub(
+              NetworkLib::GTPv1UIPv4Encap::payload_startOffset)) {}
 
     ///@}
 
@@ -64,6 +82,15 @@ class GTPv1UEncapSink : public NetworkLib::IPv4PacketSink {
         mGTPIPv4Encapper.enableUDPChecksum(enable);
     }
 
+    /// @brief Enable/disable encapsulating packets in place, when
+    ///        they have enough headroom (default is disabled).
+    ///
+    /// The bytes in front of the packets given to the sink get
+    /// overwritten: only enable it when nothing else is going to look
+    /// at them (e.g. the sink is the last stage for the frames the
+    /// packets came in).
+    void enableInPlaceEncap(bool enable) { mInPlaceEncap = enable; }
+
     ///@name NetworkLib::IPv4PacketSink interface
     ///@{
 
@@ -73,6 +100,72 @@ class GTPv1UEncapSink : public NetworkLib::IPv4PacketSink {
                           NetworkLib::defaultContextUserData) override {
         const NetworkLib::IPv4Decoder ipv4Decoder(ipv4Data);
 
+        encap(ipv4Data, ipv4Decoder.getSrcAddress(),
+              ipv4Decoder.getDstAddress(), userData);
+    }
+
+    ///@}
+
+    /// @brief Encapsulate a IPv4 packet already described by a
+    ///        NetworkLib::EthPacketProcessor, without decoding it
+    ///        again.
+    ///
+    /// `ipv4Data` must be the innermost IPv4 packet of `descriptor`
+    /// (see NetworkLib::PacketDescriptor::getInnermostSrcAddress()),
+    /// e.g. ``context.gtpv1uDecoder->getData()`` for GTPv1-U
+    /// traffic. Packets with no innermost IPv4 packet described
+    /// (e.g. GTPv1-U traffic not carrying IPv4) are decoded as by the
+    /// NetworkLib::IPv4PacketSink interface.
+    void consumeIPv4Packet(const NetworkLib::BufferView &ipv4Data,
+                           const NetworkLib::PacketDescriptor &descriptor,
+                           NetworkLib::ContextUserData &userData =
+                               NetworkLib::defaultContextUserData) {
+        if (!descriptor.hasInnermostIPv4()) {
+            consumeIPv4Packet(ipv4Data, userData);
+            return;
+        }
+
+        encap(ipv4Data, descriptor.getInnermostSrcAddress(),
+              descriptor.getInnermostDstAddress(), userData);
+    }
+
+    ///@name Callbacks
+    ///@{
+
+    /// @brief Type of the callback to call when we find IPv4 traffic
+    ///        from/to and unknown UE.
+    ///
+    /// If the function returns true, send an empty BufferView down the sink.
+    using UnknownUECbk_t = std::function<bool(const NetworkLib::BufferView &)>;
+
+    /// @brief Set the callback to call when we find IPv4 traffic
+    ///        from/to and unknown UE.
+    void onUnknownUE(const UnknownUECbk_t &f) { mUnknownUECbk = f; }
+
+    ///@}
+
+  private:
+    NetworkLib::IPv4PacketSink &mDestination;
+    const Router &mRouter;
+    NetworkLib::IPv4IdentificationSource &mIdentificationSource;
+    NetworkLib::GTPv1UIPv4Encap mGTPIPv4Encapper;
+    UnknownUECbk_t mUnknownUECbk;
+
+    // Where segments of GSO super-packets are written, right past the
+    // headers in the encapsulation buffer.
+    const NetworkLib::BufferWritableView mSegmentArea;
+
+    // Whether in-place encapsulation is enabled, and whether it's
+    // being used for the current packet.
+    bool mInPlaceEncap = false;
+    bool mEncapInPlace = false;
+
+    // Encapsulate the given packet, with the given addresses, and
+    // send it to the destination.
+    void encap(const NetworkLib::BufferView &ipv4Data,
+               const NetworkLib::IPv4Address &srcAddress,
+               const NetworkLib::IPv4Address &dstAddress,
+               NetworkLib::ContextUserData &userData) {
         // Alias for the Router map
         const auto &ueMap = mRouter.getUEMap();
 
@@ -81,28 +174,26 @@ class GTPv1UEncapSink : public NetworkLib::IPv4PacketSink {
         // We assume there's way more traffic **to** a UE than **from** a
         // UE. Therefore, first let's check if this is traffic **to** an
         // UE.
-        auto it = ueMap.find(ipv4Decoder.getDstAddress());
+        const NetworkLib::GTPv1UEndPoint *src = nullptr;
+        const NetworkLib::GTPv1UEndPoint *dst = nullptr;
+
+        auto it = ueMap.find(dstAddress);
         if (it != ueMap.end()) {
 
             // The packet goes to an UE, thus it goes
             // from a EPC to a eNodeB
-            mGTPIPv4Encapper.init()
-                .setSrcAddress(it->second.epcEndPoint.ipAddress)
-                .setDstAddress(it->second.eNBEndPoint.ipAddress)
-                .setTEID(it->second.eNBEndPoint.teid);
+            src = &it->second.epcEndPoint;
+            dst = &it->second.eNBEndPoint;
 
             // Save in the user data that this goes to a eNodeB.
             userData.intUserData = 1;
 
-        } else if ((it = ueMap.find(ipv4Decoder.getSrcAddress())) !=
-                   ueMap.end()) {
+        } else if ((it = ueMap.find(srcAddress)) != ueMap.end()) {
 
             // The packet comes from an UE, thus it goes
             // from a eNodeB to the EPC
-            mGTPIPv4Encapper.init()
-                .setSrcAddress(it->second.eNBEndPoint.ipAddress)
-                .setDstAddress(it->second.epcEndPoint.ipAddress)
-                .setTEID(it->second.epcEndPoint.teid);
+            src = &it->second.eNBEndPoint;
+            dst = &it->second.epcEndPoint;
 
             // Save in the user data that this goes to a eNodeB.
             userData.intUserData = 0;
@@ -124,40 +215,87 @@ class GTPv1UEncapSink : public NetworkLib::IPv4PacketSink {
             return;
         }
 
+        if (userData.offloadInfo.gsoType != NetworkLib::GSOType::NONE) {
+            encapSegments(ipv4Data, *src, *dst, userData);
+            return;
+        }
+
+        initEncapper(ipv4Data)
+            .setSrcAddress(src->ipAddress)
+            .setDstAddress(dst->ipAddress)
+            .setTEID(dst->teid);
+
         // Set the IPv4 identification field, payload, and compute
         // checksums.
-        mGTPIPv4Encapper.setIdentiifcation(mIdentificationSource.get())
-            .setPayload(ipv4Data)
-            .computeAndSetChecksums();
+        mGTPIPv4Encapper.setIdentiifcation(mIdentificationSource.get());
+
+        if (mEncapInPlace) {
+            mGTPIPv4Encapper.setPayload();
+        } else {
+            mGTPIPv4Encapper.setPayload(ipv4Data);
+        }
+
+        // The outer UDP checksum covers the packet, so its own
+        // checksum can't be left to someone else.
+        NetworkLib::OffloadInfo &offloadInfo = userData.offloadInfo;
+        if (offloadInfo.isSet()) {
+            offloadInfo.addHeaders(
+                NetworkLib::GTPv1UIPv4Encap::payload_startOffset);
+            offloadInfo.completeChecksum(mGTPIPv4Encapper.getIPv4Packet());
+            offloadInfo = NetworkLib::OffloadInfo();
+        }
+
+        mGTPIPv4Encapper.computeAndSetChecksums();
 
         // Our IPv4 packet is ready to be sent out.
         mDestination.consumeIPv4Packet(mGTPIPv4Encapper.getIPv4Packet(),
                                        userData);
     }
 
-    ///@}
+    // Segment the given GSO super-packet, then encapsulate each
+    // segment in place, right where it's written, and send it to the
+    // destination.
+    void encapSegments(const NetworkLib::BufferView &ipv4Data,
+                       const NetworkLib::GTPv1UEndPoint &src,
+                       const NetworkLib::GTPv1UEndPoint &dst,
+                       NetworkLib::ContextUserData &userData) {
+        const NetworkLib::GSOSegmenter segmenter(ipv4Data,
+                                                 userData.offloadInfo);
 
-    ///@name Callbacks
-    ///@{
+        // Segments come with complete checksums.
+        userData.offloadInfo = NetworkLib::OffloadInfo();
 
-    /// @brief Type of the callback to call when we find IPv4 traffic
-    ///        from/to and unknown UE.
-    ///
-    /// If the function returns true, send an empty BufferView down the sink.
-    using UnknownUECbk_t = std::function<bool(const NetworkLib::BufferView &)>;
+        for (std::size_t i = 0; i < segmenter.getSegmentCount(); ++i) {
+            mGTPIPv4Encapper
+                .initInPlace(segmenter.writeSegment(i, mSegmentArea))
+                .setSrcAddress(src.ipAddress)
+                .setDstAddress(dst.ipAddress)
+                .setTEID(dst.teid)
+                .setIdentiifcation(mIdentificationSource.get())
+                .setPayload()
+                .computeAndSetChecksums();
 
-    /// @brief Set the callback to call when we find IPv4 traffic
-    ///        from/to and unknown UE.
-    void onUnknownUE(const UnknownUECbk_t &f) { mUnknownUECbk = f; }
+            mDestination.consumeIPv4Packet(mGTPIPv4Encapper.getIPv4Packet(),
+                                           userData);
+        }
+    }
 
-    ///@}
+    // Initialize the encapsulator for the given packet, in place if
+    // possible.
+    NetworkLib::GTPv1UIPv4Encap &
+    initEncapper(const NetworkLib::BufferView &ipv4Data) {
+        mEncapInPlace =
+            mInPlaceEncap &&
+            ipv4Data.getHeadroom() >=
+                NetworkLib::GTPv1UIPv4Encap::payload_startOffset;
 
-  private:
-    NetworkLib::IPv4PacketSink &mDestination;
-    const Router &mRouter;
-    NetworkLib::IPv4IdentificationSource &mIdentificationSource;
-    NetworkLib::GTPv1UIPv4Encap mGTPIPv4Encapper;
-    UnknownUECbk_t mUnknownUECbk;
+        if (mEncapInPlace) {
+            return mGTPIPv4Encapper.initInPlace(
+                NetworkLib::BufferWritableView::makeWritable(ipv4Data));
+        }
+
+        return mGTPIPv4Encapper.init();
+    }
 };
 
 } // namespace UPFRouterLib
@@ -244,13 +244,35 @@ class Processor : public S1APLib::S1APProcessor {
     virtual bool processS1AP(Context &ctx) override;
 
     /// @brief Specialize NetworkLib::EthPacketProcessor interface for GTPv1-U
+    ///
+    /// The callback gets offload metadata (see
+    /// NetworkLib::ContextUserData::offloadInfo) referring to the
+    /// tunneled packet rather than to the frame.
     virtual bool processGTPv1U_IPv4(
         NetworkLib::EthPacketProcessor::Context &context) override {
-        if (mGTPv1UIPv4Cbk) {
+        if (!mGTPv1UIPv4Cbk) {
+            return true;
+        }
+
+        NetworkLib::OffloadInfo &offloadInfo = context.userData.offloadInfo;
+
+        if (!offloadInfo.isSet()) {
             return mGTPv1UIPv4Cbk(context);
         }
 
-        return true;
+        const NetworkLib::OffloadInfo frameOffloadInfo = offloadInfo;
+        const NetworkLib::PacketDescriptor &descriptor = context.descriptor;
+
+        if (descriptor.has(NetworkLib::PacketDescriptor::HasTunneledIPv4)) {
+            offloadInfo.removeHeaders(descriptor.innerL3Offset);
+        } else {
+            offloadInfo = NetworkLib::OffloadInfo();
+        }
+
+        const bool result = mGTPv1UIPv4Cbk(context);
+        offloadInfo = frameOffloadInfo;
+
+        return result;
     }
 
     /// @brief Specialize NetworkLib::EthPacketProcessor::postProcessIPv4()
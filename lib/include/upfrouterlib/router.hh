@@ -168,6 +168,28 @@ class Router : public NetworkLib::IPv4PacketSink {
         return found;
     }
 
+    /// @brief Check if the packet described by the given
+    ///        NetworkLib::PacketDescriptor comes from, or is destined
+    ///        to, some entry in the UE map.
+    ///
+    /// For GTPv1-U traffic, it's the IPv4 packet in the tunnel which
+    /// is looked at (see
+    /// NetworkLib::PacketDescriptor::getInnermostSrcAddress()).
+    /// Nothing is decoded, unlike with the NetworkLib::BufferView
+    /// version: packets with no innermost IPv4 packet described
+    /// (e.g. GTPv1-U traffic carrying IPv6) are never of a known UE.
+    bool isIPv4TrafficOfKnownUE(
+        const NetworkLib::PacketDescriptor &descriptor) const {
+        if (!descriptor.hasInnermostIPv4()) {
+            return false;
+        }
+
+        return mUEMap.find(descriptor.getInnermostSrcAddress()) !=
+                   mUEMap.end() ||
+               mUEMap.find(descriptor.getInnermostDstAddress()) !=
+                   mUEMap.end();
+    }
+
     ///@}
 
     ///@name Callbacks
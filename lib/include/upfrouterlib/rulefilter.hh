@@ -0,0 +1,51 @@
+#ifndef UPFROUTER_UPFROUTERLIB_RULEFILTER_HH
+#define UPFROUTER_UPFROUTERLIB_RULEFILTER_HH
+
+#include <upfrawsocketslib/socketfilter.hh>
+#include <upfrouterlib/rulematcher.hh>
+
+namespace UPF {
+namespace UPFRouterLib {
+
+/**
+ * @brief What compileSocketFilter() lets through, besides frames
+ *        matched by the rules.
+ */
+struct RuleFilterConfig {
+    /// @brief Accept UDP datagrams from or to the GTPv1-U port.
+    bool acceptGTPv1U = true;
+
+    /// @brief Accept SCTP packets from or to the S1AP port.
+    bool acceptS1AP = true;
+
+    /// @brief Accept frames not carrying IPv4 (e.g. ARP).
+    bool acceptNonIPv4 = false;
+};
+
+/// @brief Compile the rules of a RuleMatcher into a classic BPF
+///        socket filter, to be attached to a raw socket with
+///        RawSocketsUtil::attachFilter().
+///
+/// The filter accepts the IPv4 packets matched by any of the rules
+/// (with the same semantic as RuleMatcher::match()), plus the GTPv1-U
+/// and S1AP traffic and the non-IPv4 frames as told by the given
+/// configuration, and drops everything else in the kernel.
+///
+/// IPv4 packets are looked for right after the Ethernet header and
+/// after one or two 802.1Q/802.1ad tags (tags stripped by the network
+/// card don't get in the way either).
+///
+/// Since ports can't be checked on them, fragments other than the
+/// first one are always accepted.
+///
+/// Each rule takes about ten instructions: filters which are too long
+/// (i.e. with hundreds of rules) are refused by
+/// RawSocketsUtil::attachFilter().
+RawSocketsUtil::SocketFilterProgram
+compileSocketFilter(const RuleMatcher &ruleMatcher,
+                    const RuleFilterConfig &config = RuleFilterConfig());
+
+} // namespace UPFRouterLib
+} // namespace UPF
+
+#endif
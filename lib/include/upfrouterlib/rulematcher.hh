@@ -42,11 +42,56 @@ class RuleMatcher {
   public:
     /// @brief Given a NetworkLib::IPv4Decoder attached to a IPv4 packet, tell
     ///        if there's any matching rule matching the given packet.
+    ///
+    /// Its TCP/UDP/SCTP header is decoded only when a rule with a
+    /// port needs it, and then once for all the rules: when the
+    /// packet comes from a NetworkLib::EthPacketProcessor, prefer
+    /// match(const NetworkLib::PacketDescriptor &), which doesn't
+    /// decode anything.
+    ///
+    /// Throws exceptions if that header can't be decoded (e.g. the
+    /// packet is truncated), as the decoders do.
     bool match(const NetworkLib::IPv4Decoder &ipv4Decoder) const {
+        NetworkLib::PacketDescriptor descriptor;
+        descriptor.describeIPv4(ipv4Decoder, 0);
+
+        bool portsDescribed = false;
 
         // Iterate over rules to find a matching one.
         for (auto &&rule : mRules) {
-            if (match(ipv4Decoder, rule)) {
+            if (!matchAddress(descriptor, rule)) {
+                continue;
+            }
+
+            if (rule.dstPort != NetworkLib::Port::Invalid &&
+                !portsDescribed) {
+                describePorts(descriptor, ipv4Decoder);
+                portsDescribed = true;
+            }
+
+            if (matchPort(descriptor, rule)) {
+                return true;
+            }
+        }
+
+        // No rule matched.
+        return false;
+    }
+
+    /// @brief Given the NetworkLib::PacketDescriptor of a packet (e.g.
+    ///        NetworkLib::EthPacketProcessor::Context::descriptor),
+    ///        tell if there's any matching rule matching the IPv4
+    ///        packet it describes.
+    ///
+    /// Packets which aren't IPv4 never match.
+    bool match(const NetworkLib::PacketDescriptor &descriptor) const {
+        if (!descriptor.has(NetworkLib::PacketDescriptor::HasIPv4)) {
+            return false;
+        }
+
+        // Iterate over rules to find a matching one.
+        for (auto &&rule : mRules) {
+            if (match(descriptor, rule)) {
                 return true;
             }
         }
@@ -111,42 +156,61 @@ class RuleMatcher {
   private:
     std::list<MatchingRule> mRules;
 
-    bool match(const NetworkLib::IPv4Decoder &ipv4Decoder,
+    bool match(const NetworkLib::PacketDescriptor &descriptor,
                const MatchingRule &matchingRule) const {
+        return matchAddress(descriptor, matchingRule) &&
+               matchPort(descriptor, matchingRule);
+    }
+
+    // Describe the ports of the given IPv4 packet, if it's a TCP, UDP
+    // or SCTP one, decoding its header with the throwing decoders.
+    static void describePorts(NetworkLib::PacketDescriptor &descriptor,
+                              const NetworkLib::IPv4Decoder &ipv4Decoder) {
+        if (ipv4Decoder.isTCP()) {
+            descriptor.describePorts(
+                NetworkLib::TCPDecoder(ipv4Decoder.getData()));
+        } else if (ipv4Decoder.isUDP()) {
+            descriptor.describePorts(
+                NetworkLib::UDPDecoder(ipv4Decoder.getData()));
+        } else if (ipv4Decoder.isSCTP()) {
+            descriptor.describePorts(
+                NetworkLib::SCTPDecoder(ipv4Decoder.getData()));
+        }
+    }
+
+    // Match the protocol and the destination address.
+    bool matchAddress(const NetworkLib::PacketDescriptor &descriptor,
+                      const MatchingRule &matchingRule) const {
 
         // Try to match the protocol, if specified.
         if ((matchingRule.protocol != NetworkLib::IPv4Protocol::NONE) &&
-            (matchingRule.protocol != ipv4Decoder.getProtocol())) {
+            (matchingRule.protocol != descriptor.protocol)) {
             return false;
         }
 
         // Always match on destination address
-        const NetworkLib::IPv4Address addressToMatch =
-            ipv4Decoder.getDstAddress();
+        const NetworkLib::IPv4Address &addressToMatch = descriptor.dstAddress;
 
         // Try to match the address
-        if (!matchingRule.dstCidr.matchAddress(addressToMatch)) {
-            return false;
-        }
+        return matchingRule.dstCidr.matchAddress(addressToMatch);
+    }
+
+    // Match the destination port: the ports of the descriptor must
+    // have been described, if they can be, when the rule has one.
+    bool matchPort(const NetworkLib::PacketDescriptor &descriptor,
+                   const MatchingRule &matchingRule) const {
 
         // Try to match a TCP/UDP/SCTP port if specified
         //
         // Note that specifying a port with protocols which are
         // neither TCP, nor UDP, nor SCTP will never result in a
-        // match.
+        // match (and neither will packets whose TCP/UDP/SCTP header
+        // couldn't be decoded).
         if (matchingRule.dstPort != NetworkLib::Port::Invalid) {
-            NetworkLib::Port::Number packetPort = {NetworkLib::Port::Invalid};
-
-            if (ipv4Decoder.isTCP()) {
-                NetworkLib::TCPDecoder tcpDecoder(ipv4Decoder.getData());
-                packetPort = tcpDecoder.getDstPort();
-            } else if (ipv4Decoder.isUDP()) {
-                NetworkLib::UDPDecoder udpDecoder(ipv4Decoder.getData());
-                packetPort = udpDecoder.getDstPort();
-            } else if (ipv4Decoder.isSCTP()) {
-                NetworkLib::SCTPDecoder sctpDecoder(ipv4Decoder.getData());
-                packetPort = sctpDecoder.getDstPort();
-            }
+            const NetworkLib::Port::Number packetPort =
+                descriptor.has(NetworkLib::PacketDescriptor::HasPorts)
+                    ? descriptor.dstPort
+                    : NetworkLib::Port::Invalid;
 
             if (matchingRule.dstPort != packetPort) {
                 return false;
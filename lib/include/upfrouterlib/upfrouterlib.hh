@@ -4,6 +4,7 @@
 #include <upfrouterlib/gtpencapsink.hh>
 #include <upfrouterlib/processor.hh>
 #include <upfrouterlib/router.hh>
+#include <upfrouterlib/rulefilter.hh>
 #include <upfrouterlib/rulematcher.hh>
 
 #endif
@@ -33,6 +33,13 @@ class S1APDecoder {
     ///        S1AP-PDU data.
     S1APDecoder(const NetworkLib::BufferView &s1apData);
 
+    /// @brief Non-throwing constructor: sets `status` to
+    ///        NetworkLib::DecodeStatus::Ok, or to
+    ///        NetworkLib::DecodeStatus::S1APBadPDU if the data can't
+    ///        be decoded (and then the decoder mustn't be used).
+    S1APDecoder(const NetworkLib::BufferView &s1apData,
+                NetworkLib::DecodeStatus &status) noexcept;
+
     ///@}
 
     ///@name No default constructor
@@ -67,6 +74,9 @@ class S1APDecoder {
     // Note: not a std::unique_ptr because it has its custom C
     //       functions to allocate/deallocate it.
     S1AP_S1AP_PDU_t *mPDU;
+
+    // Decode the buffer into mPDU, returning false on errors.
+    bool decode() noexcept;
 };
 
 /**
@@ -6,6 +6,9 @@
 #include <upfnetworklib/udp.hh>
 #include <upfs1aplib/s1aplib.hh>
 
+// For std::chrono::duration_cast
+#include <chrono>
+
 // For std::hex and such
 #include <iomanip>
 
@@ -265,6 +268,104 @@ std::ostream &operator<<(std::ostream &ostr, const PcapRecord::Header &header) {
     return ostr;
 }
 
+std::ostream &operator<<(std::ostream &ostr, const PoolStats &stats) {
+    ostr << "   Capacity: " << stats.capacity << '\n'
+         << "     In use: " << stats.inUse() << '\n'
+         << " High-water: " << stats.highWaterMark << '\n'
+         << "Allocations: " << stats.allocations << '\n'
+         << "      Frees: " << stats.frees << '\n'
+         << "    Growths: " << stats.growths << '\n'
+         << "   Failures: " << stats.failures << '\n'
+         << "    Latency:";
+
+    // Only the non-empty buckets, by upper bound
+    for (std::size_t i = 0; i < stats.allocationLatency.size(); ++i) {
+        if (stats.allocationLatency[i] == 0) {
+            continue;
+        }
+
+        if (i + 1 < stats.allocationLatency.size()) {
+            ostr << " <" << (std::uint64_t{1} << i) << "ns:";
+        } else {
+            ostr << " >=" << (std::uint64_t{1} << (i - 1)) << "ns:";
+        }
+
+        ostr << stats.allocationLatency[i];
+    }
+
+    return ostr;
+}
+
+std::string to_string(DecodeStatus status) {
+    switch (status) {
+    case DecodeStatus::Ok:
+        return "ok";
+    case DecodeStatus::EthFrameTooShort:
+        return "Ethernet frame too short";
+    case DecodeStatus::EthMissingEtherType:
+        return "Ethernet frame without EtherType";
+    case DecodeStatus::IPv4TooShort:
+        return "IPv4 packet too short";
+    case DecodeStatus::IPv4BadVersion:
+        return "IPv4 packet with bad version";
+    case DecodeStatus::IPv4BadLength:
+        return "IPv4 packet with bad length";
+    case DecodeStatus::UDPTooShort:
+        return "UDP packet too short";
+    case DecodeStatus::TCPTooShort:
+        return "TCP packet too short";
+    case DecodeStatus::GTPv1UTooShort:
+        return "GTPv1-U packet too short";
+    case DecodeStatus::GTPv1UBadVersion:
+        return "GTPv1-U packet with bad version";
+    case DecodeStatus::GTPv1UBadExtensionHeader:
+        return "GTPv1-U packet with bad extension header";
+    case DecodeStatus::GTPv1UBadLength:
+        return "GTPv1-U packet with bad length";
+    case DecodeStatus::SCTPTooShort:
+        return "SCTP packet too short";
+    case DecodeStatus::SCTPBadChecksum:
+        return "SCTP packet with bad checksum";
+    case DecodeStatus::SCTPBadChunk:
+        return "SCTP packet with bad chunk";
+    case DecodeStatus::SCTPDataChunkTooShort:
+        return "SCTP DATA chunk too short";
+    case DecodeStatus::S1APBadPDU:
+        return "S1AP PDU not decoded";
+    }
+
+    std::ostringstream o;
+    o << '(' << +static_cast<std::uint8_t>(status) << ')';
+    return o.str();
+}
+
+std::ostream &operator<<(std::ostream &ostr, const DropCounters &counters) {
+    ostr << "Dropped: " << counters.total();
+
+    for (std::size_t i = 1; i < decodeStatusCount; ++i) {
+        const DecodeStatus status = static_cast<DecodeStatus>(i);
+
+        if (counters.get(status) != 0) {
+            ostr << "\n  " << status << ": " << counters.get(status);
+        }
+    }
+
+    return ostr;
+}
+
+std::ostream &operator<<(std::ostream &ostr, const OutstandingBuffer &b) {
+    if (b.site.file == nullptr) {
+        ostr << "(unknown site)";
+        return ostr;
+    }
+
+    ostr << b.site.file << ':' << b.site.line << ", for "
+         << std::chrono::duration_cast<std::chrono::microseconds>(b.age)
+                .count()
+         << " us";
+    return ostr;
+}
+
 } // namespace NetworkLib
 
 namespace DumperLib {
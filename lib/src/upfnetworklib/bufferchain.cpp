@@ -0,0 +1,69 @@
+#include <upfnetworklib/bufferchain.hh>
+#include <upfnetworklib/concurrentpool.hh>
+
+// For std::unique_ptr
+#include <memory>
+
+namespace UPF {
+namespace NetworkLib {
+
+namespace {
+
+// A heap allocated PacketBuffer of any size.
+class HeapPacketBuffer : public PacketBuffer {
+  public:
+    explicit HeapPacketBuffer(std::size_t size)
+        : mData(new unsigned char[size]), mSize(size) {}
+    virtual std::size_t size() const override { return mSize; }
+    unsigned char *data() override { return mData.get(); }
+
+  private:
+    std::unique_ptr<unsigned char[]> mData;
+    std::size_t mSize;
+};
+
+// Buffers for flattened chains up to maxPooledFlattenSize bytes,
+// which may be released by any thread.
+using FlattenPool = ConcurrentPacketBufferSizedPool<maxPooledFlattenSize>;
+
+FlattenPool &getFlattenPool() {
+    // Never destroyed, as views on its buffers may outlive static
+    // objects.
+    static FlattenPool *pool = [] {
+        ConcurrentPoolConfig config;
+        config.initialCapacity = 0;
+        config.maxCapacity = 16384;
+        config.growBy = 64;
+        return new FlattenPool(config);
+    }();
+
+    return *pool;
+}
+
+} // namespace
+
+BufferView BufferChain::flatten() const {
+    if (mCount == 0) {
+        return BufferView();
+    } else if (mCount == 1) {
+        return mSegments[0];
+    }
+
+    if (mSize <= maxPooledFlattenSize) {
+        const BufferWritableView b =
+            getFlattenPool().tryGetBufferWritableView();
+
+        if (!b.empty()) {
+            copyTo(b.getUnderlyingWritableBufferPtr());
+            return b.getSub(0, mSize);
+        }
+    }
+
+    PacketBufferRef b(new HeapPacketBuffer(mSize));
+    copyTo(b->data());
+
+    return BufferView(std::move(b));
+}
+
+} // namespace NetworkLib
+} // namespace UPF
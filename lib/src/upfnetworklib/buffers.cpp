@@ -1 +1,33 @@
 #include <upfnetworklib/buffers.hh>
+
+namespace UPF {
+namespace NetworkLib {
+
+namespace {
+
+// A PacketBuffer forwarding to one owned by a std::shared_ptr, which
+// is released when the last reference is dropped.
+class SharedPtrPacketBuffer : public PacketBuffer {
+  public:
+    explicit SharedPtrPacketBuffer(std::shared_ptr<PacketBuffer> b)
+        : mBuffer(std::move(b)) {}
+
+    virtual std::size_t size() const override { return mBuffer->size(); }
+    unsigned char *data() override { return mBuffer->data(); }
+
+  private:
+    std::shared_ptr<PacketBuffer> mBuffer;
+};
+
+} // namespace
+
+PacketBufferRef PacketBufferRef::fromSharedPtr(std::shared_ptr<PacketBuffer> b) {
+    if (!b) {
+        return PacketBufferRef();
+    }
+
+    return PacketBufferRef(new SharedPtrPacketBuffer(std::move(b)));
+}
+
+} // namespace NetworkLib
+} // namespace UPF
@@ -0,0 +1,463 @@
+#include <upfnetworklib/checksum.hh>
+
+// For std::atomic
+#include <atomic>
+
+// For std::memcpy()
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NETWORKLIB_X86_DISPATCH 1
+
+// For SSE2, SSE4.2, AVX2 and AVX-512 intrinsics
+#include <immintrin.h>
+#else
+#define NETWORKLIB_X86_DISPATCH 0
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define NETWORKLIB_LITTLE_ENDIAN 1
+#else
+#define NETWORKLIB_LITTLE_ENDIAN 0
+#endif
+
+namespace UPF {
+namespace NetworkLib {
+
+namespace {
+
+// All the kernels sum bytes at even offsets (i.e. the high bytes of
+// the 16-bit values) and at odd offsets separately, then combine
+// them: unlike summing 16-bit words, this needs no byte swapping,
+// and the sums can't overflow.
+//
+// SIMD kernels use PSADBW (the sum of absolute differences against
+// zero), which sums 8 bytes at a time into a 64-bit lane: summing
+// all the bytes, and then the odd ones shifted into the low byte of
+// each 16-bit word, gives both sums.
+
+// Combine the sums of bytes at even and odd offsets, plus the tail
+// of the data not handled by a SIMD kernel.
+std::uint32_t combine(std::uint64_t all, std::uint64_t odd,
+                      const unsigned char *tail, std::size_t tailSize) {
+    std::uint64_t even = all - odd;
+
+    // The tail always starts at an even offset.
+    for (std::size_t i = 0; i + 1 < tailSize; i += 2) {
+        even += tail[i];
+        odd += tail[i + 1];
+    }
+
+    if (tailSize % 2 != 0) {
+        // Add the last byte as if a 0 was appended to make the size
+        // even.
+        even += tail[tailSize - 1];
+    }
+
+    return static_cast<std::uint32_t>((even << 8) + odd);
+}
+
+#if NETWORKLIB_X86_DISPATCH
+
+__attribute__((target("sse2"))) std::uint32_t
+sum16SSE2(const unsigned char *data, std::size_t size) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i all = _mm_setzero_si128();
+    __m128i odd = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        all = _mm_add_epi64(all, _mm_sad_epu8(v, zero));
+        odd = _mm_add_epi64(odd, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+    }
+
+    alignas(16) std::uint64_t a[2];
+    alignas(16) std::uint64_t o[2];
+    _mm_store_si128(reinterpret_cast<__m128i *>(a), all);
+    _mm_store_si128(reinterpret_cast<__m128i *>(o), odd);
+
+    return combine(a[0] + a[1], o[0] + o[1], data + i, size - i);
+}
+
+__attribute__((target("avx2"))) std::uint32_t
+sum16AVX2(const unsigned char *data, std::size_t size) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i all = _mm256_setzero_si256();
+    __m256i odd = _mm256_setzero_si256();
+    std::size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        all = _mm256_add_epi64(all, _mm256_sad_epu8(v, zero));
+        odd = _mm256_add_epi64(odd,
+                               _mm256_sad_epu8(_mm256_srli_epi16(v, 8), zero));
+    }
+
+    alignas(32) std::uint64_t a[4];
+    alignas(32) std::uint64_t o[4];
+    _mm256_store_si256(reinterpret_cast<__m256i *>(a), all);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(o), odd);
+
+    return combine(a[0] + a[1] + a[2] + a[3], o[0] + o[1] + o[2] + o[3],
+                   data + i, size - i);
+}
+
+// Sum the 64-bit lanes of a vector.
+//
+// Note: _mm512_reduce_add_epi64() (or extracting its halves) would
+//       do, but with GCC 12 it triggers a spurious -Wuninitialized
+//       warning: go through memory, as sum16AVX2() does.
+__attribute__((target("avx512f"))) std::uint64_t reduceAdd64(__m512i v) {
+    alignas(64) std::uint64_t lanes[8];
+    _mm512_store_si512(lanes, v);
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] +
+           lanes[6] + lanes[7];
+}
+
+__attribute__((target("avx512f,avx512bw"))) std::uint32_t
+sum16AVX512(const unsigned char *data, std::size_t size) {
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i all = _mm512_setzero_si512();
+    __m512i odd = _mm512_setzero_si512();
+    std::size_t i = 0;
+
+    for (; i + 64 <= size; i += 64) {
+        const __m512i v = _mm512_loadu_si512(data + i);
+        all = _mm512_add_epi64(all, _mm512_sad_epu8(v, zero));
+        odd = _mm512_add_epi64(odd,
+                               _mm512_sad_epu8(_mm512_srli_epi16(v, 8), zero));
+    }
+
+    return combine(reduceAdd64(all), reduceAdd64(odd), data + i, size - i);
+}
+
+#endif // NETWORKLIB_X86_DISPATCH
+
+using Sum16Function = std::uint32_t (*)(const unsigned char *, std::size_t);
+
+struct Sum16Implementation {
+    Sum16Function function;
+    const char *name;
+};
+
+// Pick the best implementation for this CPU.
+Sum16Implementation selectSum16() {
+#if NETWORKLIB_X86_DISPATCH
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512bw")) {
+        return {sum16AVX512, "avx512"};
+    } else if (__builtin_cpu_supports("avx2")) {
+        return {sum16AVX2, "avx2"};
+    } else if (__builtin_cpu_supports("sse2")) {
+        return {sum16SSE2, "sse2"};
+    }
+#endif
+
+    return {sum16Scalar, "scalar"};
+}
+
+std::uint32_t resolveSum16(const unsigned char *data, std::size_t size);
+
+// The implementation in use: resolved on first call, so that it also
+// works from static initializers.
+std::atomic<Sum16Function> sum16Function{resolveSum16};
+
+std::uint32_t resolveSum16(const unsigned char *data, std::size_t size) {
+    const Sum16Function f = selectSum16().function;
+    sum16Function.store(f, std::memory_order_relaxed);
+    return f(data, size);
+}
+
+// Below this size, calling a SIMD kernel doesn't pay off.
+const std::size_t minSIMDSize = 64;
+
+//////////////
+//  CRC32c  //
+//////////////
+
+// The Castagnoli polynomial, reflected.
+const std::uint32_t crc32cPolynomial = 0x82F63B78;
+
+// Read 8 bytes from a maybe unaligned address.
+inline std::uint64_t loadUint64(const unsigned char *p) {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Tables for the slicing-by-8 software implementation: entry n of
+// table k is the CRC of byte n followed by k zero bytes.
+struct CRC32cTables {
+    std::uint32_t t[8][256];
+
+    CRC32cTables() {
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            std::uint32_t crc = n;
+
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ crc32cPolynomial : crc >> 1;
+            }
+
+            t[0][n] = crc;
+        }
+
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            std::uint32_t crc = t[0][n];
+
+            for (int k = 1; k < 8; ++k) {
+                crc = t[0][crc & 0xFF] ^ (crc >> 8);
+                t[k][n] = crc;
+            }
+        }
+    }
+};
+
+const CRC32cTables &getCRC32cTables() {
+    static const CRC32cTables tables;
+    return tables;
+}
+
+// Multiply a vector by a 32x32 matrix over GF(2).
+std::uint32_t gf2MatrixTimes(const std::uint32_t *matrix,
+                             std::uint32_t vector) {
+    std::uint32_t sum = 0;
+
+    while (vector != 0) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+
+        vector >>= 1;
+        ++matrix;
+    }
+
+    return sum;
+}
+
+// square = matrix * matrix, over GF(2).
+void gf2MatrixSquare(std::uint32_t *square, const std::uint32_t *matrix) {
+    for (int n = 0; n < 32; ++n) {
+        square[n] = gf2MatrixTimes(matrix, matrix[n]);
+    }
+}
+
+// Tables shifting the raw CRC register over `size` zero bytes, which
+// must be a power of 2 (see CRC32cShift::apply()). That's what lets
+// independent CRCs of consecutive blocks be combined.
+struct CRC32cShift {
+    std::uint32_t t[4][256];
+
+    explicit CRC32cShift(std::size_t size) {
+        std::uint32_t even[32];
+        std::uint32_t odd[32];
+
+        // The operator for one zero bit...
+        odd[0] = crc32cPolynomial;
+
+        for (int n = 1; n < 32; ++n) {
+            odd[n] = 1U << (n - 1);
+        }
+
+        // ... then two, four, eight (i.e. a byte), etc.
+        gf2MatrixSquare(even, odd);
+        gf2MatrixSquare(odd, even);
+
+        const std::uint32_t *op = nullptr;
+
+        for (;;) {
+            gf2MatrixSquare(even, odd);
+            size >>= 1;
+
+            if (size == 0) {
+                op = even;
+                break;
+            }
+
+            gf2MatrixSquare(odd, even);
+            size >>= 1;
+
+            if (size == 0) {
+                op = odd;
+                break;
+            }
+        }
+
+        for (std::uint32_t n = 0; n < 256; ++n) {
+            t[0][n] = gf2MatrixTimes(op, n);
+            t[1][n] = gf2MatrixTimes(op, n << 8);
+            t[2][n] = gf2MatrixTimes(op, n << 16);
+            t[3][n] = gf2MatrixTimes(op, n << 24);
+        }
+    }
+
+    std::uint32_t apply(std::uint32_t crc) const {
+        return t[0][crc & 0xFF] ^ t[1][(crc >> 8) & 0xFF] ^
+               t[2][(crc >> 16) & 0xFF] ^ t[3][crc >> 24];
+    }
+};
+
+#if NETWORKLIB_X86_DISPATCH
+
+// Block sizes of the 3-way interleaved hardware implementation: the
+// ``crc32`` instruction has a latency of 3 cycles but a throughput
+// of one per cycle, so three independent streams keep it busy.
+const std::size_t crc32cLongBlock = 8192;
+const std::size_t crc32cShortBlock = 256;
+
+const CRC32cShift &getCRC32cLongShift() {
+    static const CRC32cShift shift(crc32cLongBlock);
+    return shift;
+}
+
+const CRC32cShift &getCRC32cShortShift() {
+    static const CRC32cShift shift(crc32cShortBlock);
+    return shift;
+}
+
+// Run three interleaved streams over as many `3 * block` bytes chunks
+// as possible, advancing `data` and `size`.
+__attribute__((target("sse4.2"))) std::uint64_t
+crc32cHardware3Way(std::uint64_t crc0, const unsigned char *&data,
+                   std::size_t &size, std::size_t block,
+                   const CRC32cShift &shift) {
+    while (size >= 3 * block) {
+        std::uint64_t crc1 = 0;
+        std::uint64_t crc2 = 0;
+        const unsigned char *end = data + block;
+
+        do {
+            crc0 = _mm_crc32_u64(crc0, loadUint64(data));
+            crc1 = _mm_crc32_u64(crc1, loadUint64(data + block));
+            crc2 = _mm_crc32_u64(crc2, loadUint64(data + 2 * block));
+            data += 8;
+        } while (data != end);
+
+        crc0 = shift.apply(static_cast<std::uint32_t>(crc0)) ^ crc1;
+        crc0 = shift.apply(static_cast<std::uint32_t>(crc0)) ^ crc2;
+        data += 2 * block;
+        size -= 3 * block;
+    }
+
+    return crc0;
+}
+
+__attribute__((target("sse4.2"))) std::uint32_t
+crc32cHardware(const unsigned char *data, std::size_t size,
+               std::uint32_t crc) {
+    std::uint64_t crc0 = crc ^ 0xFFFFFFFF;
+
+    // Not needed for correctness, but unaligned loads crossing cache
+    // lines are slower.
+    while (size != 0 && (reinterpret_cast<std::uintptr_t>(data) & 7) != 0) {
+        crc0 = _mm_crc32_u8(static_cast<std::uint32_t>(crc0), *data++);
+        --size;
+    }
+
+    crc0 = crc32cHardware3Way(crc0, data, size, crc32cLongBlock,
+                              getCRC32cLongShift());
+    crc0 = crc32cHardware3Way(crc0, data, size, crc32cShortBlock,
+                              getCRC32cShortShift());
+
+    for (; size >= 8; size -= 8, data += 8) {
+        crc0 = _mm_crc32_u64(crc0, loadUint64(data));
+    }
+
+    std::uint32_t crc32 = static_cast<std::uint32_t>(crc0);
+
+    for (; size != 0; --size) {
+        crc32 = _mm_crc32_u8(crc32, *data++);
+    }
+
+    return crc32 ^ 0xFFFFFFFF;
+}
+
+#endif // NETWORKLIB_X86_DISPATCH
+
+using CRC32cFunction = std::uint32_t (*)(const unsigned char *, std::size_t,
+                                         std::uint32_t);
+
+struct CRC32cImplementation {
+    CRC32cFunction function;
+    const char *name;
+};
+
+CRC32cImplementation selectCRC32c() {
+#if NETWORKLIB_X86_DISPATCH
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse4.2")) {
+        return {crc32cHardware, "sse4.2"};
+    }
+#endif
+
+    return {crc32cSoftware, "software"};
+}
+
+std::uint32_t resolveCRC32c(const unsigned char *data, std::size_t size,
+                            std::uint32_t crc);
+
+std::atomic<CRC32cFunction> crc32cFunction{resolveCRC32c};
+
+std::uint32_t resolveCRC32c(const unsigned char *data, std::size_t size,
+                            std::uint32_t crc) {
+    const CRC32cFunction f = selectCRC32c().function;
+    crc32cFunction.store(f, std::memory_order_relaxed);
+    return f(data, size, crc);
+}
+
+} // namespace
+
+std::uint32_t sum16Scalar(const unsigned char *data, std::size_t size) {
+    return combine(0, 0, data, size);
+}
+
+std::uint32_t sum16(const unsigned char *data, std::size_t size) {
+    if (size < minSIMDSize) {
+        return sum16Scalar(data, size);
+    }
+
+    return sum16Function.load(std::memory_order_relaxed)(data, size);
+}
+
+const char *getSum16Implementation() { return selectSum16().name; }
+
+std::uint32_t crc32cSoftware(const unsigned char *data, std::size_t size,
+                             std::uint32_t crc) {
+    const auto &t = getCRC32cTables().t;
+
+    crc ^= 0xFFFFFFFF;
+
+#if NETWORKLIB_LITTLE_ENDIAN
+    // Slicing-by-8: one table lookup per byte, but no dependency
+    // between the lookups of the same 8 bytes.
+    for (; size >= 8; size -= 8, data += 8) {
+        const std::uint64_t v = loadUint64(data) ^ crc;
+
+        crc = t[7][v & 0xFF] ^ t[6][(v >> 8) & 0xFF] ^
+              t[5][(v >> 16) & 0xFF] ^ t[4][(v >> 24) & 0xFF] ^
+              t[3][(v >> 32) & 0xFF] ^ t[2][(v >> 40) & 0xFF] ^
+              t[1][(v >> 48) & 0xFF] ^ t[0][v >> 56];
+    }
+#endif
+
+    for (; size != 0; --size) {
+        crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+std::uint32_t crc32c(const unsigned char *data, std::size_t size,
+                     std::uint32_t crc) {
+    return crc32cFunction.load(std::memory_order_relaxed)(data, size, crc);
+}
+
+const char *getCRC32cImplementation() { return selectCRC32c().name; }
+
+} // namespace NetworkLib
+} // namespace UPF
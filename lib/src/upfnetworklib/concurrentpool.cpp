@@ -0,0 +1,108 @@
+#include <upfnetworklib/concurrentpool.hh>
+
+// For posix_memalign() and std::free()
+#include <cstdlib>
+
+// For sysconf()
+#include <unistd.h>
+
+namespace UPF {
+namespace NetworkLib {
+
+namespace {
+
+// One bit per cache slot, set when taken by a thread.
+std::atomic<std::uint64_t> takenSlots[maxThreadCacheSlots / 64];
+
+static_assert(maxThreadCacheSlots % 64 == 0,
+              "maxThreadCacheSlots must be a multiple of 64");
+
+// Set once the ThreadCacheSlot of the thread is gone: destructors of
+// other thread_local objects may still get and release buffers after
+// that, and must not use the slot (which may already belong to some
+// other thread). Being trivially destructible, it outlives them all.
+thread_local bool threadCacheSlotGone = false;
+
+// Takes a slot on construction (i.e. on the first call to
+// getThisThreadCacheSlot() from a thread), gives it back on thread
+// exit.
+class ThreadCacheSlot {
+  public:
+    ThreadCacheSlot() : mSlot(noThreadCacheSlot) {
+        for (std::size_t w = 0; w < maxThreadCacheSlots / 64; ++w) {
+            std::uint64_t taken = takenSlots[w].load(std::memory_order_relaxed);
+
+            while (taken != ~std::uint64_t(0)) {
+                const unsigned int bit =
+                    static_cast<unsigned int>(__builtin_ctzll(~taken));
+
+                if (takenSlots[w].compare_exchange_weak(
+                        taken, taken | (std::uint64_t(1) << bit),
+                        std::memory_order_acquire,
+                        std::memory_order_relaxed)) {
+                    mSlot = w * 64 + bit;
+                    return;
+                }
+            }
+        }
+    }
+
+    ~ThreadCacheSlot() {
+        threadCacheSlotGone = true;
+
+        // The next thread taking the slot sees the caches as left by
+        // this one.
+        if (mSlot != noThreadCacheSlot) {
+            releaseThreadCacheSlot(mSlot);
+        }
+    }
+
+    std::size_t get() const { return mSlot; }
+
+  private:
+    std::size_t mSlot;
+};
+
+} // namespace
+
+std::size_t getThisThreadCacheSlot() noexcept {
+    if (threadCacheSlotGone) {
+        return noThreadCacheSlot;
+    }
+
+    static thread_local ThreadCacheSlot slot;
+    return slot.get();
+}
+
+bool tryTakeThreadCacheSlot(std::size_t slot) noexcept {
+    const std::uint64_t bit = std::uint64_t(1) << (slot % 64);
+
+    return (takenSlots[slot / 64].fetch_or(bit, std::memory_order_acquire) &
+            bit) == 0;
+}
+
+void releaseThreadCacheSlot(std::size_t slot) noexcept {
+    takenSlots[slot / 64].fetch_and(~(std::uint64_t(1) << (slot % 64)),
+                                    std::memory_order_release);
+}
+
+void *allocatePoolMemory(std::size_t size) {
+    static const std::size_t pageSize =
+        static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+    // Round up to whole pages, so that no other allocation gets the
+    // rest of the last one.
+    const std::size_t pagesSize = (size + pageSize - 1) / pageSize * pageSize;
+    void *memory = nullptr;
+
+    if (posix_memalign(&memory, pageSize, pagesSize) != 0) {
+        throw std::bad_alloc();
+    }
+
+    return memory;
+}
+
+void freePoolMemory(void *memory) noexcept { std::free(memory); }
+
+} // namespace NetworkLib
+} // namespace UPF
@@ -7,12 +7,20 @@ namespace NetworkLib {
 const MACAddress MACAddress::broadcast(0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF);
 
 void EthFrameDecoder::computeDynamicData() {
+    if (!findEtherType()) {
+        // Throw an exception
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": can't find proper EthType";
+        throw std::runtime_error(err.str());
+    }
+}
+
+bool EthFrameDecoder::findEtherType() noexcept {
     unsigned int currentOffset = dynamicHeadersOffset;
     std::uint16_t rawType;
 
-    // Note: we already checked that the mBufferView.size() is >= 14
-    //       on construction (via call to throwIfBufferIsUnsuitable()),
-    //       so there's no underflow risk.
+    // Note: the constructors check that the mBufferView.size() is
+    //       >= 14 before calling us, so there's no underflow risk.
     const std::size_t maxOffset = mBufferView.size() - 2;
 
     while (currentOffset <= maxOffset) {
@@ -30,16 +38,11 @@ void EthFrameDecoder::computeDynamicData() {
             // This is actually an etherType/size. Stop here.
             mActualEtherType = rawType;
             mDataOffset = currentOffset + 2;
-            break;
+            return true;
         }
     }
 
-    if (currentOffset > maxOffset) {
-        // Throw an exception
-        std::ostringstream err;
-        err << NETWORKLIB_CURRENT_FUNCTION << ": can't find proper EthType";
-        throw std::runtime_error(err.str());
-    }
+    return false;
 }
 
 } // namespace NetworkLib
@@ -0,0 +1,181 @@
+#include <upfnetworklib/checksum.hh>
+#include <upfnetworklib/gso.hh>
+#include <upfnetworklib/ipv4.hh>
+#include <upfnetworklib/tcp.hh>
+#include <upfnetworklib/utils.hh>
+
+// For std::min()
+#include <algorithm>
+
+// For std::memcpy()
+#include <cstring>
+
+// For std::invalid_argument and std::out_of_range
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+namespace UPF {
+namespace NetworkLib {
+
+namespace {
+
+// Offsets in the IPv4 header.
+constexpr std::size_t ipv4TotalLengthOffset = 2;
+constexpr std::size_t ipv4IdentificationOffset = 4;
+constexpr std::size_t ipv4ChecksumOffset = 10;
+constexpr std::size_t ipv4SrcAddressOffset = 12;
+
+// Offsets in the TCP and UDP headers.
+constexpr std::size_t tcpSequenceNumberOffset = 4;
+constexpr std::size_t tcpFlagsOffset = 13;
+constexpr std::size_t tcpChecksumOffset = 16;
+constexpr std::size_t udpLengthOffset = 4;
+constexpr std::size_t udpChecksumOffset = 6;
+
+constexpr std::size_t tcpMinHeaderLength = 20;
+constexpr std::size_t udpHeaderLength = 8;
+
+// TCP flags set only in some of the segments.
+constexpr unsigned char tcpFINFlag = 0x01;
+constexpr unsigned char tcpPSHFlag = 0x08;
+constexpr unsigned char tcpCWRFlag = 0x80;
+
+} // namespace
+
+GSOSegmenter::GSOSegmenter(const BufferView &ipv4Data,
+                           const OffloadInfo &offloadInfo)
+    : mType(offloadInfo.gsoType), mSegmentSize(offloadInfo.gsoSize) {
+    const IPv4Decoder ipv4Decoder(ipv4Data);
+    const BufferView l4Data = ipv4Decoder.getData();
+
+    std::size_t l4HeaderLength = 0;
+
+    if (mType == GSOType::TCPV4 && ipv4Decoder.isTCP()) {
+        l4HeaderLength = TCPDecoder(l4Data).getDataOffsetBytes();
+
+        if (l4HeaderLength < tcpMinHeaderLength ||
+            l4HeaderLength > l4Data.size()) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": TCP data offset out of bounds (" << l4HeaderLength
+                << " bytes, TCP segment is " << l4Data.size() << " bytes)";
+            throw std::invalid_argument(err.str());
+        }
+    } else if (mType == GSOType::UDP_L4 && ipv4Decoder.isUDP() &&
+               l4Data.size() >= udpHeaderLength) {
+        l4HeaderLength = udpHeaderLength;
+    } else {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": can't segment GSO type "
+            << static_cast<int>(mType) << " with IPv4 protocol "
+            << static_cast<int>(ipv4Decoder.getProtocol())
+            << " (only TCPV4 with TCP and UDP_L4 with UDP are supported)";
+        throw std::invalid_argument(err.str());
+    }
+
+    if (mSegmentSize == 0) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": GSO segment size is 0";
+        throw std::invalid_argument(err.str());
+    }
+
+    mPacket = ipv4Data.getSub(0, ipv4Decoder.getTotalLengthBytes());
+    mIPv4HeaderLength = ipv4Decoder.getHeaderLengthBytes();
+    mHeaderLength = mIPv4HeaderLength + l4HeaderLength;
+
+    // Even with no payload at all, there's one segment.
+    const std::size_t payloadLength = mPacket.size() - mHeaderLength;
+    mSegmentCount =
+        std::max<std::size_t>(1, (payloadLength + mSegmentSize - 1) /
+                                     mSegmentSize);
+}
+
+std::size_t GSOSegmenter::getSegmentLength(std::size_t i) const {
+    if (i >= mSegmentCount) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": segment " << i
+            << " requested (there are " << mSegmentCount << ')';
+        throw std::out_of_range(err.str());
+    }
+
+    const std::size_t payloadOffset = mHeaderLength + i * mSegmentSize;
+
+    return mHeaderLength +
+           std::min(mSegmentSize, mPacket.size() - payloadOffset);
+}
+
+BufferWritableView
+GSOSegmenter::writeSegment(std::size_t i,
+                           const BufferWritableView &buffer) const {
+    const std::size_t length = getSegmentLength(i);
+    const BufferWritableView segment = buffer.getSub(0, length);
+
+    const unsigned char *const packet = mPacket.getUnderlyingBufferPtr();
+    unsigned char *const p = segment.getUnderlyingWritableBufferPtr();
+
+    std::memcpy(p, packet, mHeaderLength);
+    std::memcpy(p + mHeaderLength, packet + mHeaderLength + i * mSegmentSize,
+                length - mHeaderLength);
+
+    // IPv4 header: the kernel numbers segments consecutively.
+    setUint16At(p + ipv4TotalLengthOffset, static_cast<std::uint16_t>(length));
+    setUint16At(p + ipv4IdentificationOffset,
+                static_cast<std::uint16_t>(
+                    getUint16At(packet + ipv4IdentificationOffset) + i));
+    setUint16At(p + ipv4ChecksumOffset, 0);
+    setUint16At(p + ipv4ChecksumOffset,
+                static_cast<std::uint16_t>(
+                    ~foldSum16(sum16(p, mIPv4HeaderLength))));
+
+    // TCP/UDP header
+    unsigned char *const l4 = p + mIPv4HeaderLength;
+    const std::size_t l4Length = length - mIPv4HeaderLength;
+    std::size_t checksumOffset = 0;
+    std::uint32_t protocol = 0;
+
+    if (mType == GSOType::TCPV4) {
+        setUint32At(l4 + tcpSequenceNumberOffset,
+                    static_cast<std::uint32_t>(
+                        getUint32At(l4 + tcpSequenceNumberOffset) +
+                        i * mSegmentSize));
+
+        // FIN and PSH belong to the last segment, CWR to the first.
+        if (i + 1 < mSegmentCount) {
+            l4[tcpFlagsOffset] &= static_cast<unsigned char>(
+                ~(tcpFINFlag | tcpPSHFlag));
+        }
+
+        if (i > 0) {
+            l4[tcpFlagsOffset] &= static_cast<unsigned char>(~tcpCWRFlag);
+        }
+
+        checksumOffset = tcpChecksumOffset;
+        protocol = IPv4Protocol::TCP;
+    } else {
+        setUint16At(l4 + udpLengthOffset,
+                    static_cast<std::uint16_t>(l4Length));
+
+        checksumOffset = udpChecksumOffset;
+        protocol = IPv4Protocol::UDP;
+    }
+
+    // Pseudo-header (addresses, protocol and length), then the
+    // segment.
+    setUint16At(l4 + checksumOffset, 0);
+
+    const std::uint16_t checksum = static_cast<std::uint16_t>(
+        ~foldSum16(std::uint64_t{sum16(p + ipv4SrcAddressOffset, 8)} +
+                   protocol + l4Length + sum16(l4, l4Length)));
+
+    // A UDP checksum of 0 means "no checksum".
+    setUint16At(l4 + checksumOffset,
+                (checksum == 0 && mType == GSOType::UDP_L4) ? 0xFFFF
+                                                            : checksum);
+
+    return segment;
+}
+
+} // namespace NetworkLib
+} // namespace UPF
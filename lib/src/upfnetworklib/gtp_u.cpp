@@ -1 +1,51 @@
 #include <upfnetworklib/gtp_u.hh>
+
+namespace UPF {
+namespace NetworkLib {
+
+DecodeStatus
+GTPv1UDecoder::extractExtensionHeaders(std::size_t &offset) noexcept {
+    const std::size_t size = mBufferView.size();
+
+    // Ok there could be zero or more extension headers at this
+    // offset.
+    //
+    // Let's look at the 'Next Extension Header Field value': as for
+    // 3GPP TS 29.060 sect. 6, a value of 0 means 'No more extension
+    // headers'.
+    //
+    // Note: the first one is within the buffer (see checkBuffer()),
+    //       the following ones are the last byte of the previous
+    //       extension header.
+    while (mBufferView.getUint8At_nocheck(offset) != 0) {
+        // There's an extension header at this offset
+
+        // As for 3GPP TS 29.060 sec. 6:
+        //
+        // | The length of the Extension header shall be defined in a
+        // | variable length of 4 octets, i.e. m+1 = n*4 octets, where
+        // | n is a positive integer.
+        //
+        // It must be followed by the next 'Next Extension Header
+        // Type' byte, as well.
+        if (offset + 1 >= size) {
+            return DecodeStatus::GTPv1UBadExtensionHeader;
+        }
+
+        const std::size_t extLen =
+            4 * mBufferView.getUint8At_nocheck(offset + 1);
+
+        if (extLen == 0 || extLen >= size - offset) {
+            return DecodeStatus::GTPv1UBadExtensionHeader;
+        }
+
+        // One more (they are walked over by getExtensionHeaders())
+        ++mExtensionHeaderCount;
+        offset += extLen;
+    }
+
+    return DecodeStatus::Ok;
+}
+
+} // namespace NetworkLib
+} // namespace UPF
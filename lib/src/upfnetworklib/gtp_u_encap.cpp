@@ -119,6 +119,15 @@ GTPv1UEthEncap::setPayload(const NetworkLib::BufferView &ipv4Data) {
     // Note: we assume that ipv4Data.size() has the same value as
     //       the length in the IPv4 header. We don't check this.
 
+    // The payload is already in place after initInPlace().
+    if (mInPlace) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called after initInPlace() (use setPayload() with no "
+               "arguments)";
+        throw std::logic_error(err.str());
+    }
+
     // Check if the packet isn't too big
     if (ipv4Data.size() > maxPayloadLength) {
         std::ostringstream err;
@@ -173,6 +182,36 @@ GTPv1UEthEncap::setPayload(const NetworkLib::BufferView &ipv4Data) {
     return *this;
 }
 
+GTPv1UEthEncap &
+GTPv1UEthEncap::initInPlace(const BufferWritableView &ipv4Data) {
+    // Check if the packet isn't too big
+    if (ipv4Data.size() > maxPayloadLength) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called with BufferWritableView.size() == " << ipv4Data.size()
+            << " (max allowed payload size for GTPv1-U encap is "
+            << maxPayloadLength << ')';
+        throw std::length_error(err.str());
+    }
+
+    // Check if there's enough room for the headers
+    if (ipv4Data.getHeadroom() < totalHeaderLength) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called with BufferWritableView.getHeadroom() == "
+            << ipv4Data.getHeadroom() << " (min headroom is "
+            << totalHeaderLength << ')';
+        throw std::length_error(err.str());
+    }
+
+    // From now on, the headers go in front of the payload.
+    mBufferWritableView = ipv4Data.prepend(totalHeaderLength);
+    mInPlace = true;
+
+    initHeaders();
+    return *this;
+}
+
 GTPv1UEthEncap &GTPv1UEthEncap::setPayload() {
     // Check and complain if the data at the expected payload offset
     // doesn't look like an IPV4 packet. Here we check that the
@@ -436,6 +475,15 @@ GTPv1UIPv4Encap::setPayload(const NetworkLib::BufferView &ipv4Data) {
     // Note: we assume that ipv4Data.size() has the same value as
     //       the length in the IPv4 header. We don't check this.
 
+    // The payload is already in place after initInPlace().
+    if (mInPlace) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called after initInPlace() (use setPayload() with no "
+               "arguments)";
+        throw std::logic_error(err.str());
+    }
+
     // Check if the packet isn't too big
     if (ipv4Data.size() > maxPayloadLength) {
         std::ostringstream err;
@@ -490,6 +538,36 @@ GTPv1UIPv4Encap::setPayload(const NetworkLib::BufferView &ipv4Data) {
     return *this;
 }
 
+GTPv1UIPv4Encap &
+GTPv1UIPv4Encap::initInPlace(const BufferWritableView &ipv4Data) {
+    // Check if the packet isn't too big
+    if (ipv4Data.size() > maxPayloadLength) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called with BufferWritableView.size() == " << ipv4Data.size()
+            << " (max allowed payload size for GTPv1-U encap is "
+            << maxPayloadLength << ')';
+        throw std::length_error(err.str());
+    }
+
+    // Check if there's enough room for the headers
+    if (ipv4Data.getHeadroom() < totalHeaderLength) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called with BufferWritableView.getHeadroom() == "
+            << ipv4Data.getHeadroom() << " (min headroom is "
+            << totalHeaderLength << ')';
+        throw std::length_error(err.str());
+    }
+
+    // From now on, the headers go in front of the payload.
+    mBufferWritableView = ipv4Data.prepend(totalHeaderLength);
+    mInPlace = true;
+
+    initHeaders();
+    return *this;
+}
+
 GTPv1UIPv4Encap &GTPv1UIPv4Encap::setPayload() {
     // Check and complain if the data at the expected payload offset
     // doesn't look like an IPV4 packet. Here we check that the
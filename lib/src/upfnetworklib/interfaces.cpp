@@ -1,9 +1,73 @@
 #include <upfnetworklib/interfaces.hh>
+#include <upfnetworklib/checksum.hh>
 
 namespace UPF {
 namespace NetworkLib {
 
 ContextUserData defaultContextUserData;
 
+void OffloadInfo::addHeaders(std::size_t length) {
+    if (checksumPartial) {
+        checksumStart = static_cast<std::uint16_t>(checksumStart + length);
+    }
+
+    if (gsoType != GSOType::NONE && headerLength != 0) {
+        headerLength = static_cast<std::uint16_t>(headerLength + length);
+    }
+}
+
+void OffloadInfo::removeHeaders(std::size_t length) {
+    if (checksumPartial) {
+        if (checksumStart >= length) {
+            checksumStart = static_cast<std::uint16_t>(checksumStart - length);
+        } else {
+            // The checksum is in a stripped header: whoever gets the
+            // rest doesn't care about it.
+            checksumPartial = false;
+            checksumStart = 0;
+            checksumOffset = 0;
+        }
+    }
+
+    // Checksums of the stripped headers may have been verified, but
+    // not necessarily the ones in what's left.
+    checksumValid = false;
+
+    if (gsoType != GSOType::NONE) {
+        if (headerLength > length) {
+            headerLength = static_cast<std::uint16_t>(headerLength - length);
+        } else {
+            // Segmentation of the outer packet (or we don't know where
+            // its headers end): it doesn't apply to what's left.
+            gsoType = GSOType::NONE;
+            gsoSize = 0;
+            headerLength = 0;
+        }
+    }
+}
+
+void OffloadInfo::completeChecksum(const BufferWritableView &data) {
+    if (!checksumPartial) {
+        return;
+    }
+
+    const std::size_t start = checksumStart;
+    const std::size_t at = start + checksumOffset;
+
+    if (at + 2 <= data.size()) {
+        // The checksum field already holds the sum of the
+        // pseudo-header, so summing from checksumStart to the end is
+        // all is needed.
+        const std::uint16_t checksum = static_cast<std::uint16_t>(
+            ~foldSum16(sum16(data.getUnderlyingBufferPtr() + start,
+                             data.size() - start)));
+        data.setUint16At_nocheck(at, checksum);
+    }
+
+    checksumPartial = false;
+    checksumStart = 0;
+    checksumOffset = 0;
+}
+
 } // namespace NetworkLib
 } // namespace UPF
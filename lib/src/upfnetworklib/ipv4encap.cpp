@@ -22,37 +22,22 @@ const std::array<unsigned char, IPv4EncapSink::totalHeaderLength>
 
 void IPv4EncapSink::consumeIPv4Packet(const BufferView &ipv4Data,
                                       ContextUserData &userData) {
-    // Throw exception if the payload doesn't fit the buffer
-    if (ipv4Data.size() > mMaxPayloadLength) {
-        std::ostringstream err;
-        err << "IPv4EncapSink::consumeIPv4Packet(const BufferView &, "
-               "ContextUserData &): "
-               "data too large ("
-            << "required " << ipv4Data.size() << ", available "
-            << mMaxPayloadLength << ')';
-        throw std::length_error(err.str());
-    }
-
-    // Copy the default Ethernet header
-    initHeaders();
-
     // Set destination and source MAC addresses
-    mBufferWritableView.setMACAddressAt_nocheck(eth_dstAddressOffset,
-                                                mDefaultDst);
-    mBufferWritableView.setMACAddressAt_nocheck(eth_srcAddressOffset,
-                                                mDefaultSrc);
-
-    // Copy the payload into the buffer.
-    unsigned char *p =
-        mBufferWritableView.getUnderlyingWritableBufferPtr() + eth_headerLength;
+    const BufferWritableView header =
+        BufferWritableView::makeNonOwningBufferWritableView(mHeader.data(),
+                                                            mHeader.size());
+    header.setMACAddressAt_nocheck(eth_dstAddressOffset, mDefaultDst);
+    header.setMACAddressAt_nocheck(eth_srcAddressOffset, mDefaultSrc);
 
-    ipv4Data.copyTo(0, ipv4Data.size(), p);
+    // Our Ethernet frame is ready to be sent out via Ethernet: the
+    // header, followed by the payload, which stays where it is.
+    BufferChain finalEthFrame(header);
+    finalEthFrame.append(ipv4Data);
 
-    const NetworkLib::BufferWritableView finalEthFrame =
-        mBufferWritableView.getSub(0, eth_headerLength + ipv4Data.size());
+    // Offload metadata is now about the frame, not the packet.
+    userData.offloadInfo.addHeaders(totalHeaderLength);
 
-    // Our Ethernet frame is ready to be sent out via Ethernet.
-    mDestination.consumeEthPacket(finalEthFrame, userData);
+    mDestination.consumeEthPacketChain(finalEthFrame, userData);
 }
 
 } // namespace NetworkLib
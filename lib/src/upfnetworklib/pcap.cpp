@@ -234,6 +234,10 @@ void PcapWriter::writeHeader() {
 }
 
 PcapWriter &PcapWriter::writeRecord(const BufferView &data) {
+    return writeRecord(BufferChain(data));
+}
+
+PcapWriter &PcapWriter::writeRecord(const BufferChain &data) {
     // Write out header if not already written
     if (!mHeaderWritten) {
         writeHeader();
@@ -290,11 +294,15 @@ PcapWriter &PcapWriter::writeRecord(const BufferView &data) {
                        sizeof(linuxCooked));
     }
 
-    mOStream.write(
-        reinterpret_cast<const char *>(data.getUnderlyingBufferPtr()),
-        data.size());
+    // Write out segments one after the other, with no need to put
+    // them together first.
+    for (const auto &segment : data) {
+        mOStream.write(
+            reinterpret_cast<const char *>(segment.getUnderlyingBufferPtr()),
+            segment.size());
+    }
+
     return *this;
-    ;
 }
 
 /////////////////////////
@@ -392,35 +400,36 @@ BufferWritableView PcapIPv4Reader::getIPv4Packet(BufferWritableView &buffer) {
 /////////////////////////////
 
 void PcapEthWriterPlus::consumeIPv4Packet(const BufferView &ipv4Data,
-                                          ContextUserData &) {
-    constexpr std::size_t ethHeaderLength = 14;
+                                          ContextUserData &userData) {
+    consumeIPv4PacketChain(BufferChain(ipv4Data), userData);
+}
+
+void PcapEthWriterPlus::consumeIPv4PacketChain(const BufferChain &ipv4Data,
+                                               ContextUserData &) {
     constexpr std::size_t srcMACAddressOffset = 6;
     constexpr std::size_t dstMACAddressOffset = 0;
     constexpr std::size_t etherTypeOffset = 12;
     constexpr std::uint16_t ipv4EtherType = 0x0800;
 
-    // Check there's enough room in the Ethernet buffer
-    // for the given IPv4 data
-    if ((ipv4Data.size() + ethHeaderLength) > mEthBuffer.size()) {
-        std::ostringstream err;
-        err << NETWORKLIB_CURRENT_FUNCTION
-            << ": skipping record which is too long for buffer ("
-            << "(" << (ipv4Data.size() + ethHeaderLength) << " required, "
-            << mEthBuffer.size() << " available)";
-        throw std::length_error(err.str());
-    }
+    // Just a fake Ethernet header in front of the IPv4 data: no need
+    // to copy the IPv4 data next to it.
+    BufferWritableView ethHeader =
+        BufferWritableView::makeNonOwningBufferWritableView(
+            mEthHeader.data(), mEthHeader.size());
+    ethHeader.setMACAddressAt_nocheck(dstMACAddressOffset, mDefaultDst);
+    ethHeader.setMACAddressAt_nocheck(srcMACAddressOffset, mDefaultSrc);
+    ethHeader.setUint16At_nocheck(etherTypeOffset, ipv4EtherType);
+
+    BufferChain ethData(ethHeader);
 
-    BufferWritableView ethData =
-        BufferWritableView::makeNonOwningBufferWritableView(mEthBuffer.data(),
-                                                            mEthBuffer.size());
-    ethData.setMACAddressAt_nocheck(dstMACAddressOffset, mDefaultDst);
-    ethData.setMACAddressAt_nocheck(srcMACAddressOffset, mDefaultSrc);
-    ethData.setUint16At_nocheck(etherTypeOffset, ipv4EtherType);
-
-    // Copy the IPv4 data into the Ethernet buffer.
-    ipv4Data.copyTo(0, ipv4Data.size(),
-                    ethData.getUnderlyingWritableBufferPtr() + ethHeaderLength);
-    ethData.shrinkTo(ipv4Data.size() + ethHeaderLength);
+    if (ipv4Data.getSegmentCount() < maxBufferChainSegments) {
+        for (const auto &segment : ipv4Data) {
+            ethData.append(segment);
+        }
+    } else {
+        // No room left for the header: put the IPv4 data together.
+        ethData.append(ipv4Data.flatten());
+    }
 
     mWriter.writeRecord(ethData);
 }
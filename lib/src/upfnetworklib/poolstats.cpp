@@ -0,0 +1,27 @@
+#include <upfnetworklib/poolstats.hh>
+
+namespace UPF {
+namespace NetworkLib {
+
+namespace {
+
+// Decided here, once, so that code built with a different NDEBUG
+// setting than the library still agrees on it.
+#ifdef NDEBUG
+std::atomic<bool> defaultAllocationTracking{false};
+#else
+std::atomic<bool> defaultAllocationTracking{true};
+#endif
+
+} // namespace
+
+bool getDefaultAllocationTracking() noexcept {
+    return defaultAllocationTracking.load(std::memory_order_relaxed);
+}
+
+void setDefaultAllocationTracking(bool enable) noexcept {
+    defaultAllocationTracking.store(enable, std::memory_order_relaxed);
+}
+
+} // namespace NetworkLib
+} // namespace UPF
@@ -1,4 +1,8 @@
 #include <upfnetworklib/sctp.hh>
+#include <upfnetworklib/checksum.hh>
+
+// For std::runtime_error
+#include <stdexcept>
 
 // For std::string
 #include <string>
@@ -9,32 +13,92 @@
 namespace UPF {
 namespace NetworkLib {
 
-void SCTPDecoder::fillChunksVector() {
+void SCTPDecoder::checkChunks() {
+    if (findChunks() != DecodeStatus::Ok) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": invalid chunk length, or chunk past the end of the "
+               "packet (BufferView.size() == "
+            << mBufferView.size() << ")";
+        throw std::runtime_error(err.str());
+    }
+}
+
+DecodeStatus SCTPDecoder::findChunks() noexcept {
     std::size_t offset = startOfChunksOffset;
     const std::size_t size = mBufferView.size();
 
     while (offset < size) {
+        // The chunk header must be within the buffer (chunks are
+        // padded to 4 bytes, so at least its length should be).
+        if (size - offset < SCTPChunkHeader::minSize) {
+            return DecodeStatus::SCTPBadChunk;
+        }
+
         // This is the unpadded length of the chunk
-        const std::uint16_t chunkLength =
-            mBufferView.getUint16At(offset + chunkLengthOffset);
+        const std::uint16_t chunkLength = mBufferView.getUint16At_nocheck(
+            offset + SCTPChunkHeader::Length::offset);
+
+        // The length includes the chunk header: anything shorter
+        // (e.g. 0) would also get us stuck here.
+        if (chunkLength < SCTPChunkHeader::minSize) {
+            return DecodeStatus::SCTPBadChunk;
+        }
 
         // This is the padded length of the chunk (multiple of 4), to
         // know where the next chunk starts (if any).
-        const std::uint16_t chunkLengthWithPadding =
-            ((chunkLength % 4) == 0) ? chunkLength
-                                     : (((chunkLength / 4) + 1) * 4);
+        const std::size_t chunkLengthWithPadding = paddedLength(chunkLength);
 
         // Check that the chunk is entirely within the buffer
-        mBufferView.throwExceptionIfOutOfBounds(NETWORKLIB_CURRENT_FUNCTION,
-                                                offset, chunkLengthWithPadding);
+        if (chunkLengthWithPadding > size - offset) {
+            return DecodeStatus::SCTPBadChunk;
+        }
 
-        // Add the chunk to our vector
-        mChunks.push_back(
-            SCTPGenericChunkDecoder(mBufferView.getSub(offset, chunkLength)));
+        // One more chunk (they are walked over by chunks())
+        ++mChunkCount;
 
         // Advance to next chunk
         offset += chunkLengthWithPadding;
     }
+
+    return DecodeStatus::Ok;
+}
+
+std::uint32_t SCTPDecoder::computeChecksum(const BufferView &sctpData) {
+    const unsigned char zeros[4] = {0, 0, 0, 0};
+    const unsigned char *p = sctpData.getUnderlyingBufferPtr();
+    const std::size_t size = sctpData.size();
+
+    if (size < startOfChunksOffset) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": called with "
+               "BufferView.size() == "
+            << size << " (min size is " << startOfChunksOffset << ")";
+        throw std::length_error(err.str());
+    }
+
+    // The checksum is computed as if the checksum field was 0.
+    std::uint32_t crc = crc32c(p, checksumOffset);
+    crc = crc32c(zeros, sizeof(zeros), crc);
+    crc = crc32c(p + startOfChunksOffset, size - startOfChunksOffset, crc);
+
+    return crc;
+}
+
+bool SCTPDecoder::verifyChecksum(const BufferView &sctpData) {
+    if (sctpData.size() < startOfChunksOffset) {
+        return false;
+    }
+
+    // The CRC32c is stored least significant byte first (unlike
+    // everything else).
+    const unsigned char *c = sctpData.getUnderlyingBufferPtr() + checksumOffset;
+    const std::uint32_t checksum =
+        std::uint32_t{c[0]} | (std::uint32_t{c[1]} << 8) |
+        (std::uint32_t{c[2]} << 16) | (std::uint32_t{c[3]} << 24);
+
+    return computeChecksum(sctpData) == checksum;
 }
 
 } // namespace NetworkLib
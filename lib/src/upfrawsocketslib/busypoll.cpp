@@ -0,0 +1,91 @@
+#include <upfrawsocketslib/busypoll.hh>
+
+// For pthread_setaffinity_np()
+#include <pthread.h>
+#include <sched.h>
+
+// For setsockopt()
+#include <sys/socket.h>
+
+// For errno
+#include <cerrno>
+
+// For std::strerror()
+#include <cstring>
+
+// For std::runtime_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+// Not defined by older headers
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+#ifndef SO_BUSY_POLL_BUDGET
+#define SO_BUSY_POLL_BUDGET 70
+#endif
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Set an integer SOL_SOCKET option, throwing a std::runtime_error on
+// errors.
+void setSocketOption(const char *function, SocketFD socketfd, int option,
+                     const char *optionName, int value) {
+    if (setsockopt(socketfd, SOL_SOCKET, option, &value, sizeof(value)) < 0) {
+        const int saved_errno = errno;
+        std::ostringstream err;
+        err << function << ": setsockopt(" << optionName
+            << ") error on raw socket with fd " << socketfd
+            << ": errno: " << saved_errno << ": "
+            << std::strerror(saved_errno);
+        throw std::runtime_error(err.str());
+    }
+}
+
+} // namespace
+
+void pinThisThreadToCPU(unsigned int cpu) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+
+    const int rc =
+        pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+
+    if (rc != 0) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": pthread_setaffinity_np() error pinning thread to CPU " << cpu
+            << ": errno: " << rc << ": " << std::strerror(rc);
+        throw std::runtime_error(err.str());
+    }
+}
+
+void applyBusyPoll(SocketFD socketfd, const BusyPollConfig &config) {
+    if (config.busyPollUs == 0) {
+        return;
+    }
+
+    setSocketOption(NETWORKLIB_CURRENT_FUNCTION, socketfd, SO_BUSY_POLL,
+                    "SO_BUSY_POLL", static_cast<int>(config.busyPollUs));
+
+    if (config.preferBusyPoll) {
+        setSocketOption(NETWORKLIB_CURRENT_FUNCTION, socketfd,
+                        SO_PREFER_BUSY_POLL, "SO_PREFER_BUSY_POLL", 1);
+    }
+
+    if (config.budget != 0) {
+        setSocketOption(NETWORKLIB_CURRENT_FUNCTION, socketfd,
+                        SO_BUSY_POLL_BUDGET, "SO_BUSY_POLL_BUDGET",
+                        static_cast<int>(config.budget));
+    }
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
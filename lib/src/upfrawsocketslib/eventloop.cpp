@@ -0,0 +1,346 @@
+#include <upfrawsocketslib/eventloop.hh>
+
+#include <upfrawsocketslib/packetmmap.hh>
+
+// For epoll_create1(), epoll_ctl() and epoll_wait()
+#include <sys/epoll.h>
+
+// For eventfd()
+#include <sys/eventfd.h>
+
+// For fcntl()
+#include <fcntl.h>
+
+// For close(), read() and write()
+#include <unistd.h>
+
+// For std::find()
+#include <algorithm>
+
+// For errno
+#include <cerrno>
+
+// For std::memset() and std::strerror()
+#include <cstring>
+
+// For std::runtime_error, std::invalid_argument and std::out_of_range
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Throw a std::runtime_error describing the failure of the given
+// system call, using the current value of errno.
+[[noreturn]] void throwSystemError(const char *function, const char *call,
+                                   int fd) {
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": " << call << "() error on fd " << fd
+        << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+// Value of epoll_event::data.u64 for the stop eventfd. Interfaces use
+// their index plus one.
+const std::uint64_t stopEventKey = 0;
+
+// Maximum number of events returned by a single epoll_wait().
+const int maxEvents = 16;
+
+} // namespace
+
+EventLoop::EventLoop(const EventLoopConfig &config)
+    : mConfig(config), mPool(config.poolInitialCapacity, config.headroom) {
+
+    if (mConfig.batchSize == 0 || mConfig.batchSize > maxBatchSize) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": invalid batch size "
+            << mConfig.batchSize << " (must be between 1 and "
+            << maxBatchSize << ")";
+        throw std::invalid_argument(err.str());
+    }
+
+    mEpollFD = epoll_create1(EPOLL_CLOEXEC);
+
+    if (mEpollFD < 0) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "epoll_create1",
+                         mEpollFD);
+    }
+
+    mStopEventFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (mStopEventFD < 0) {
+        const int saved_errno = errno;
+        close(mEpollFD);
+        errno = saved_errno;
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "eventfd", mStopEventFD);
+    }
+
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = stopEventKey;
+
+    if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, mStopEventFD, &ev) < 0) {
+        const int saved_errno = errno;
+        close(mStopEventFD);
+        close(mEpollFD);
+        errno = saved_errno;
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "epoll_ctl",
+                         mStopEventFD);
+    }
+
+    for (std::size_t i = 0; i < mConfig.batchSize; ++i) {
+        mBuffers[i] = mPool.getBufferWritableView();
+    }
+}
+
+EventLoop::~EventLoop() {
+    close(mStopEventFD);
+    close(mEpollFD);
+}
+
+std::size_t EventLoop::addInterface(SocketFD socketfd,
+                                    NetworkLib::EthPacketSink &sink) {
+    if (findInterface(socketfd) != nullptr) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": raw socket with fd "
+            << socketfd << " already registered";
+        throw std::invalid_argument(err.str());
+    }
+
+    const int flags = fcntl(socketfd, F_GETFL);
+
+    if (flags < 0 || fcntl(socketfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "fcntl", socketfd);
+    }
+
+    applyBusyPoll(socketfd, mConfig.busyPoll);
+
+    std::unique_ptr<Interface> interface(new Interface());
+    interface->socketfd = socketfd;
+    interface->sink = &sink;
+    interface->userData.ptrUserData = nullptr;
+    interface->userData.intUserData = static_cast<int>(mInterfaces.size());
+
+    // Level-triggered: a socket which still has frames after its
+    // batch is reported again by the next epoll_wait(), after the
+    // other ready sockets have been served.
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = mInterfaces.size() + 1;
+
+    if (epoll_ctl(mEpollFD, EPOLL_CTL_ADD, socketfd, &ev) < 0) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "epoll_ctl", socketfd);
+    }
+
+    mInterfaces.push_back(std::move(interface));
+
+    return mInterfaces.size() - 1;
+}
+
+void EventLoop::removeInterface(SocketFD socketfd) {
+    for (auto &i : mInterfaces) {
+        if (i && i->socketfd == socketfd) {
+            // Errors are ignored: the socket may have already been
+            // closed, which removes it from the epoll set anyway.
+            epoll_ctl(mEpollFD, EPOLL_CTL_DEL, socketfd, nullptr);
+            i.reset();
+            return;
+        }
+    }
+
+    std::ostringstream err;
+    err << NETWORKLIB_CURRENT_FUNCTION << ": raw socket with fd " << socketfd
+        << " not registered";
+    throw std::invalid_argument(err.str());
+}
+
+void EventLoop::addTxRing(PacketMMapTxRing &ring) {
+    if (std::find(mTxRings.begin(), mTxRings.end(), &ring) !=
+        mTxRings.end()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": transmit ring on raw socket with fd " << ring.getSocket()
+            << " already registered";
+        throw std::invalid_argument(err.str());
+    }
+
+    mTxRings.push_back(&ring);
+}
+
+void EventLoop::removeTxRing(PacketMMapTxRing &ring) {
+    const auto i = std::find(mTxRings.begin(), mTxRings.end(), &ring);
+
+    if (i == mTxRings.end()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": transmit ring on raw socket with fd " << ring.getSocket()
+            << " not registered";
+        throw std::invalid_argument(err.str());
+    }
+
+    mTxRings.erase(i);
+}
+
+std::size_t EventLoop::runOnce(int timeoutMs) {
+    struct epoll_event events[maxEvents];
+
+    const int n = epoll_wait(mEpollFD, events, maxEvents, timeoutMs);
+
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "epoll_wait", mEpollFD);
+    }
+
+    std::size_t dispatched = 0;
+
+    for (int e = 0; e < n; ++e) {
+        const std::uint64_t key = events[e].data.u64;
+
+        if (key == stopEventKey) {
+            drainStopEvent();
+            continue;
+        }
+
+        const std::size_t index = static_cast<std::size_t>(key - 1);
+
+        // The interface may have been removed in the meantime.
+        if (index < mInterfaces.size() && mInterfaces[index]) {
+            dispatched += serve(*mInterfaces[index]);
+        }
+    }
+
+    return dispatched;
+}
+
+void EventLoop::run() {
+    if (mConfig.cpu >= 0) {
+        pinThisThreadToCPU(static_cast<unsigned int>(mConfig.cpu));
+    }
+
+    AdaptiveIdlePolicy idle(mConfig.idlePolicy);
+    IdleAction action = IDLE_ACTION_POLL;
+
+    while (!mStopRequested.load(std::memory_order_relaxed)) {
+        const std::size_t dispatched =
+            (action == IDLE_ACTION_POLL) ? serveAll() : runOnce(-1);
+
+        // Without traffic, there's nothing worth waiting for before
+        // sending what's queued (and the loop may block next).
+        flushTxRings(dispatched == 0);
+
+        action = idle.onRound(dispatched > 0);
+    }
+
+    mStopRequested = false;
+    drainStopEvent();
+}
+
+void EventLoop::stop() {
+    mStopRequested = true;
+
+    const std::uint64_t one = 1;
+
+    // Can't fail, short of a counter overflow, meaning that a wake-up
+    // is already pending.
+    const ssize_t rc = write(mStopEventFD, &one, sizeof(one));
+    (void)rc;
+}
+
+EventLoopInterfaceStats
+EventLoop::getStats(std::size_t interfaceIndex) const {
+    if (interfaceIndex >= mInterfaces.size() || !mInterfaces[interfaceIndex]) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": no interface with index "
+            << interfaceIndex;
+        throw std::out_of_range(err.str());
+    }
+
+    return mInterfaces[interfaceIndex]->stats;
+}
+
+EventLoop::Interface *EventLoop::findInterface(SocketFD socketfd) {
+    for (auto &i : mInterfaces) {
+        if (i && i->socketfd == socketfd) {
+            return i.get();
+        }
+    }
+
+    return nullptr;
+}
+
+std::size_t EventLoop::serve(Interface &interface) {
+    const BatchResult result = receiveBatch(
+        interface.socketfd, mBuffers.data(), mSizes.data(), mConfig.batchSize);
+
+    if (result.status == IO_STATUS_ERROR) {
+        ++interface.stats.errors;
+        return 0;
+    } else if (result.status != IO_STATUS_OK) {
+        // Spurious wake-up or signal: the socket is reported again if
+        // it's still ready.
+        return 0;
+    }
+
+    for (std::size_t i = 0; i < result.count; ++i) {
+        try {
+            interface.sink->consumeEthPacket(mBuffers[i].getSub(0, mSizes[i]),
+                                             interface.userData);
+        } catch (...) {
+            ++interface.stats.errors;
+        }
+
+        // The sink may still hold on to the frame: use a fresh buffer
+        // for the next batch.
+        mBuffers[i] = NetworkLib::BufferWritableView();
+        mBuffers[i] = mPool.getBufferWritableView();
+    }
+
+    interface.stats.packets += result.count;
+    ++interface.stats.batches;
+
+    return result.count;
+}
+
+std::size_t EventLoop::serveAll() {
+    std::size_t dispatched = 0;
+
+    for (auto &i : mInterfaces) {
+        if (i) {
+            dispatched += serve(*i);
+        }
+    }
+
+    return dispatched;
+}
+
+void EventLoop::flushTxRings(bool all) {
+    for (PacketMMapTxRing *ring : mTxRings) {
+        if (!all) {
+            ring->flushIfDeadlineExpired();
+        } else if (ring->queued() > 0) {
+            ring->flush();
+        }
+    }
+}
+
+void EventLoop::drainStopEvent() {
+    std::uint64_t value;
+
+    // Fails with EAGAIN when there's nothing to drain.
+    const ssize_t rc = read(mStopEventFD, &value, sizeof(value));
+    (void)rc;
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
@@ -0,0 +1,256 @@
+#include <upfrawsocketslib/fanoutworkers.hh>
+
+#include <upfrawsocketslib/numa.hh>
+#include <upfrawsocketslib/packetmmap.hh>
+
+// For poll()
+#include <poll.h>
+
+// For fcntl()
+#include <fcntl.h>
+
+// For getpid()
+#include <unistd.h>
+
+// For std::array
+#include <array>
+
+// For std::memset()
+#include <cstring>
+
+// For std::invalid_argument
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+FanoutWorkers::FanoutWorkers(IfIndex ifIdx, const FanoutWorkersConfig &config,
+                             ChainFactory_t chainFactory)
+    : mConfig(config), mChainFactory(chainFactory) {
+
+    if (config.workers == 0) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": no workers requested";
+        throw std::invalid_argument(err.str());
+    }
+
+    // Checked here, as the worker threads couldn't report it.
+    if (config.headroom >= NetworkLib::PacketBufferPool::bufferSize) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": headroom "
+            << config.headroom << " leaves no room in buffers of "
+            << NetworkLib::PacketBufferPool::bufferSize << " bytes";
+        throw std::invalid_argument(err.str());
+    }
+
+    if (mConfig.groupId == 0) {
+        mConfig.groupId = static_cast<std::uint16_t>(getpid() & 0xffff);
+    }
+
+    if (mConfig.placeOnInterfaceNUMANode && mConfig.cpus.empty()) {
+        const std::vector<unsigned int> nodeCPUs = getCPUsOfNUMANode(
+            getNUMANodeByIfName(getIfNameByIfIndex(ifIdx)));
+
+        for (std::size_t i = 0; !nodeCPUs.empty() && i < mConfig.workers;
+             ++i) {
+            mConfig.cpus.push_back(nodeCPUs[i % nodeCPUs.size()]);
+        }
+    }
+
+    try {
+        for (std::size_t i = 0; i < mConfig.workers; ++i) {
+            std::unique_ptr<Worker> worker(new Worker());
+            worker->socketfd = openByIfIndexInFanoutGroup(
+                ifIdx, mConfig.promiscuousMode, mConfig.groupId,
+                mConfig.fanoutMode);
+            mWorkers.push_back(std::move(worker));
+
+            // Workers poll() for traffic, so they can notice when
+            // they are asked to stop.
+            const SocketFD fd = mWorkers.back()->socketfd;
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+            applyBusyPoll(fd, mConfig.busyPoll);
+        }
+    } catch (...) {
+        for (auto &w : mWorkers) {
+            close(w->socketfd);
+        }
+        throw;
+    }
+}
+
+FanoutWorkers::~FanoutWorkers() {
+    stop();
+
+    for (auto &w : mWorkers) {
+        close(w->socketfd);
+    }
+}
+
+void FanoutWorkers::start() {
+    if (mRunning.exchange(true)) {
+        // Already running
+        return;
+    }
+
+    for (std::size_t i = 0; i < mWorkers.size(); ++i) {
+        mWorkers[i]->thread = std::thread(&FanoutWorkers::run, this, i);
+    }
+}
+
+void FanoutWorkers::stop() {
+    mRunning = false;
+
+    for (auto &w : mWorkers) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+}
+
+void FanoutWorkers::addTxRing(std::size_t workerIndex,
+                              PacketMMapTxRing &ring) {
+    mWorkers.at(workerIndex)->txRings.push_back(&ring);
+}
+
+FanoutWorkerStats FanoutWorkers::getStats(std::size_t workerIndex) const {
+    const Worker &w = *mWorkers.at(workerIndex);
+
+    FanoutWorkerStats result;
+    result.packets = w.packets.load(std::memory_order_relaxed);
+    result.batches = w.batches.load(std::memory_order_relaxed);
+    result.errors = w.errors.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+void FanoutWorkers::flushTxRings(Worker &w, bool all) {
+    for (PacketMMapTxRing *ring : w.txRings) {
+        try {
+            if (!all) {
+                ring->flushIfDeadlineExpired();
+            } else if (ring->queued() > 0) {
+                ring->flush();
+            }
+        } catch (...) {
+            w.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void FanoutWorkers::run(std::size_t workerIndex) {
+    Worker &w = *mWorkers[workerIndex];
+
+    // How long to wait for traffic before checking again if we've
+    // been asked to stop, in milliseconds.
+    const int pollTimeout = 100;
+
+    try {
+        if (mConfig.cpus.empty()) {
+            pinThisThreadToCPU(static_cast<unsigned int>(workerIndex));
+        } else if (workerIndex < mConfig.cpus.size()) {
+            pinThisThreadToCPU(mConfig.cpus[workerIndex]);
+        }
+    } catch (...) {
+        // Not fatal: just keep running unpinned.
+        w.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Everything the worker needs is created here, by the worker
+    // thread itself.
+    std::unique_ptr<NetworkLib::PacketBufferPool> pool;
+    std::unique_ptr<NetworkLib::EthPacketSink> chain;
+
+    // Rings registered by the factory go away with the chain.
+    auto f = NetworkLib::finally([&w] { w.txRings.clear(); });
+
+    try {
+        pool.reset(new NetworkLib::PacketBufferPool(
+            mConfig.poolInitialCapacity, mConfig.headroom));
+        chain = mChainFactory(workerIndex);
+    } catch (...) {
+        w.errors.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (!chain) {
+        return;
+    }
+
+    NetworkLib::ContextUserData userData;
+    userData.intUserData = static_cast<int>(workerIndex);
+
+    std::array<NetworkLib::BufferWritableView, maxBatchSize> buffers;
+    std::array<std::size_t, maxBatchSize> sizes;
+    std::array<NetworkLib::BufferView, maxBatchSize> frames;
+
+    for (auto &b : buffers) {
+        b = pool->getBufferWritableView();
+    }
+
+    struct pollfd pfd;
+    std::memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = w.socketfd;
+    pfd.events = POLLIN;
+
+    AdaptiveIdlePolicy idle(mConfig.idlePolicy);
+
+    while (mRunning.load(std::memory_order_relaxed)) {
+        const BatchResult result =
+            receiveBatch(w.socketfd, buffers.data(), sizes.data(),
+                         buffers.size());
+
+        if (result.status == IO_STATUS_WOULD_BLOCK) {
+            // Without traffic, there's nothing worth waiting for
+            // before sending what's queued (and the worker may block
+            // next).
+            flushTxRings(w, true);
+
+            if (idle.onRound(false) == IDLE_ACTION_WAIT) {
+                poll(&pfd, 1, pollTimeout);
+            }
+            continue;
+        } else if (result.status == IO_STATUS_INTERRUPTED) {
+            continue;
+        } else if (result.status == IO_STATUS_ERROR) {
+            w.errors.fetch_add(1, std::memory_order_relaxed);
+            poll(nullptr, 0, pollTimeout);
+            continue;
+        }
+
+        for (std::size_t i = 0; i < result.count; ++i) {
+            frames[i] = buffers[i].getSub(0, sizes[i]);
+        }
+
+        // The whole batch at once, so that processors (see
+        // NetworkLib::EthPacketProcessor) can amortize their work
+        // over it.
+        try {
+            chain->consumeEthPackets(frames.data(), result.count, userData);
+        } catch (...) {
+            w.errors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        for (std::size_t i = 0; i < result.count; ++i) {
+            // The chain may still hold on to the frame: use a fresh
+            // buffer for the next batch (this is just a swap with
+            // the pool when it doesn't).
+            frames[i] = NetworkLib::BufferView();
+            buffers[i] = NetworkLib::BufferWritableView();
+            buffers[i] = pool->getBufferWritableView();
+        }
+
+        flushTxRings(w, false);
+        idle.onRound(true);
+
+        w.packets.fetch_add(result.count, std::memory_order_relaxed);
+        w.batches.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
@@ -0,0 +1,384 @@
+#include <upfrawsocketslib/gtpusocket.hh>
+
+// For socket(), bind(), setsockopt(), sendmsg() and recvmsg()
+#include <sys/socket.h>
+
+// For struct iovec
+#include <sys/uio.h>
+
+// For struct sockaddr_in and IPPROTO_UDP
+#include <netinet/in.h>
+
+// For close()
+#include <unistd.h>
+
+// For std::min()
+#include <algorithm>
+
+// For std::uint16_t and std::uint32_t
+#include <cstdint>
+
+// For errno
+#include <cerrno>
+
+// For std::memset(), std::memcpy() and std::strerror()
+#include <cstring>
+
+// For std::runtime_error and std::invalid_argument
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+// Not defined by older headers
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Throw a std::runtime_error describing the failure of the given
+// system call, using the current value of errno.
+[[noreturn]] void throwSystemError(const char *function, const char *call,
+                                   int fd) {
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": " << call << "() error on fd " << fd
+        << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+// Largest UDP payload on IPv4 (65535 - 20 - 8), which is also the
+// limit for a whole UDP_SEGMENT datagram.
+const std::size_t maxUDPPayload = 65507;
+
+// Enable an IPPROTO_UDP option. Return false if the kernel doesn't
+// support it, throw std::runtime_error on other errors.
+bool enableUDPOption(const char *function, int fd, int option,
+                     const char *optionName, int value) {
+    if (setsockopt(fd, IPPROTO_UDP, option, &value, sizeof(value)) == 0) {
+        return true;
+    }
+
+    if (errno == ENOPROTOOPT) {
+        return false;
+    }
+
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": setsockopt(" << optionName
+        << ") error on fd " << fd << ": errno: " << saved_errno << ": "
+        << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+void fillSockAddr(struct sockaddr_in &sa, const NetworkLib::IPv4Address &a,
+                  NetworkLib::Port::Number port) {
+    std::memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(port);
+    sa.sin_addr.s_addr = htonl(static_cast<std::uint32_t>(a));
+}
+
+} // namespace
+
+GTPv1USocketEndpoint::GTPv1USocketEndpoint(
+    const GTPv1USocketEndpointConfig &config)
+    : mMaxSegments(config.maxSegments), mMaxLatency(config.maxLatencyUs),
+      mNonBlocking(config.nonBlocking), mSegmentationOffload(false),
+      mReceiveOffload(false) {
+
+    if (mMaxSegments == 0 || mMaxSegments > maxUDPSegments) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": invalid maximum segments "
+            << mMaxSegments << " (must be between 1 and " << maxUDPSegments
+            << ")";
+        throw std::invalid_argument(err.str());
+    }
+
+    mFD = socket(AF_INET,
+                 SOCK_DGRAM | SOCK_CLOEXEC |
+                     (config.nonBlocking ? SOCK_NONBLOCK : 0),
+                 IPPROTO_UDP);
+
+    if (mFD < 0) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "socket", mFD);
+    }
+
+    try {
+        struct sockaddr_in sa;
+        fillSockAddr(sa, config.localAddress, config.localPort);
+
+        if (bind(mFD, reinterpret_cast<struct sockaddr *>(&sa), sizeof(sa)) <
+            0) {
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "bind", mFD);
+        }
+
+        // Setting a 0 segment size (i.e. no segmentation unless asked
+        // for on each send) just checks that the kernel supports it.
+        if (config.segmentationOffload) {
+            mSegmentationOffload =
+                enableUDPOption(NETWORKLIB_CURRENT_FUNCTION, mFD,
+                                UDP_SEGMENT, "UDP_SEGMENT", 0);
+        }
+
+        if (config.receiveOffload) {
+            mReceiveOffload = enableUDPOption(NETWORKLIB_CURRENT_FUNCTION,
+                                              mFD, UDP_GRO, "UDP_GRO", 1);
+        }
+    } catch (...) {
+        close(mFD);
+        throw;
+    }
+}
+
+GTPv1USocketEndpoint::~GTPv1USocketEndpoint() { close(mFD); }
+
+void GTPv1USocketEndpoint::send(const NetworkLib::GTPv1UEndPoint &peer,
+                                const NetworkLib::BufferView &tpdu) {
+    const std::size_t size = headerSize + tpdu.size();
+
+    if (size > maxUDPPayload) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": T-PDU of " << tpdu.size()
+            << " bytes too large";
+        throw std::invalid_argument(err.str());
+    }
+
+    // A UDP_SEGMENT datagram is split every mSegmentSize bytes: only
+    // the last segment may be shorter.
+    if (mPendingCount != 0 &&
+        (peer.ipAddress != mPendingPeer.ipAddress ||
+         peer.port != mPendingPeer.port || mLastSegmentShorter ||
+         size > mSegmentSize || mPendingBytes + size > maxUDPPayload)) {
+        flush();
+    }
+
+    if (mPendingCount == 0) {
+        mPendingPeer = peer;
+        mSegmentSize = size;
+        mDeadline = std::chrono::steady_clock::now() + mMaxLatency;
+    } else if (size < mSegmentSize) {
+        mLastSegmentShorter = true;
+    }
+
+    // GTPv1-U header, with no optional fields: version 1, PT=1, G-PDU.
+    std::array<unsigned char, headerSize> &header =
+        mPendingHeaders[mPendingCount];
+    const std::uint16_t length = static_cast<std::uint16_t>(tpdu.size());
+    const std::uint32_t teid = peer.teid;
+
+    header[0] = 0x30;
+    header[1] = 0xFF;
+    header[2] = static_cast<unsigned char>(length >> 8);
+    header[3] = static_cast<unsigned char>(length & 0xFF);
+    header[4] = static_cast<unsigned char>(teid >> 24);
+    header[5] = static_cast<unsigned char>((teid >> 16) & 0xFF);
+    header[6] = static_cast<unsigned char>((teid >> 8) & 0xFF);
+    header[7] = static_cast<unsigned char>(teid & 0xFF);
+
+    mPendingTPDUs[mPendingCount] = tpdu;
+    ++mPendingCount;
+    mPendingBytes += size;
+
+    if (mPendingCount == mMaxSegments || !mSegmentationOffload ||
+        std::chrono::steady_clock::now() >= mDeadline) {
+        flush();
+    }
+}
+
+void GTPv1USocketEndpoint::flush() {
+    const int error = flushPending();
+
+    if (error != 0) {
+        errno = error;
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "sendmsg", mFD);
+    }
+}
+
+int GTPv1USocketEndpoint::flushPending() noexcept {
+    if (mPendingCount == 0) {
+        return 0;
+    }
+
+    const std::size_t count = mPendingCount;
+
+    mPendingCount = 0;
+    mPendingBytes = 0;
+    mLastSegmentShorter = false;
+
+    int error = (count > 1) ? sendPending(0, count, true) : 0;
+
+    if (count == 1 || error == EINVAL || error == EIO) {
+        // Either a single packet, or the kernel refused to segment
+        // (e.g. packets larger than the path MTU, or no checksum
+        // offload on the way out): send them one by one.
+        error = 0;
+
+        for (std::size_t i = 0; i < count && error == 0; ++i) {
+            error = sendPending(i, 1, false);
+        }
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        mPendingTPDUs[i] = NetworkLib::BufferView();
+    }
+
+    return error;
+}
+
+GTPv1UReceiveResult
+GTPv1USocketEndpoint::receive(const NetworkLib::BufferWritableView &buffer,
+                              NetworkLib::BufferView *packets) noexcept {
+    GTPv1UReceiveResult result;
+
+    struct sockaddr_in sa;
+    struct iovec iov;
+    iov.iov_base = buffer.getUnderlyingWritableBufferPtr();
+    iov.iov_len = buffer.size();
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sa;
+    msg.msg_namelen = sizeof(sa);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t rc = recvmsg(mFD, &msg, mPendingCount > 0 ? MSG_DONTWAIT : 0);
+
+    if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+        mPendingCount > 0) {
+        // Nothing to receive: there's no point in holding the queued
+        // packets any longer, and they mustn't wait on a blocking
+        // receive.
+        const int error = flushPending();
+
+        if (error != 0) {
+            result.status = IO_STATUS_ERROR;
+            result.errorNumber = error;
+            return result;
+        }
+
+        if (mNonBlocking) {
+            errno = EAGAIN;
+        } else {
+            msg.msg_namelen = sizeof(sa);
+            msg.msg_controllen = sizeof(control.buf);
+            rc = recvmsg(mFD, &msg, 0);
+        }
+    }
+
+    if (rc < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            result.status = IO_STATUS_WOULD_BLOCK;
+        } else if (errno == EINTR) {
+            result.status = IO_STATUS_INTERRUPTED;
+        } else {
+            result.status = IO_STATUS_ERROR;
+            result.errorNumber = errno;
+        }
+        return result;
+    }
+
+    if ((msg.msg_flags & MSG_TRUNC) != 0) {
+        result.status = IO_STATUS_ERROR;
+        result.errorNumber = EMSGSIZE;
+        return result;
+    }
+
+    result.peer.ipAddress =
+        NetworkLib::IPv4Address(ntohl(sa.sin_addr.s_addr));
+    result.peer.port = NetworkLib::Port::Number(ntohs(sa.sin_port));
+
+    const std::size_t size = static_cast<std::size_t>(rc);
+    std::size_t segmentSize = size;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int value;
+            std::memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+
+            if (value > 0) {
+                segmentSize = static_cast<std::size_t>(value);
+            }
+        }
+    }
+
+    for (std::size_t offset = 0;
+         offset < size && result.count < maxUDPSegments;
+         offset += segmentSize) {
+        const std::size_t len = std::min(segmentSize, size - offset);
+        packets[result.count++] = buffer.getSub(offset, len);
+    }
+
+    return result;
+}
+
+int GTPv1USocketEndpoint::sendPending(std::size_t first, std::size_t count,
+                                      bool segment) noexcept {
+    struct sockaddr_in sa;
+    fillSockAddr(sa, mPendingPeer.ipAddress, mPendingPeer.port);
+
+    std::array<struct iovec, 2 * maxUDPSegments> iov;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        iov[2 * i].iov_base = mPendingHeaders[first + i].data();
+        iov[2 * i].iov_len = headerSize;
+        iov[2 * i + 1].iov_base = const_cast<unsigned char *>(
+            mPendingTPDUs[first + i].getUnderlyingBufferPtr());
+        iov[2 * i + 1].iov_len = mPendingTPDUs[first + i].size();
+    }
+
+    union {
+        char buf[CMSG_SPACE(sizeof(std::uint16_t))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &sa;
+    msg.msg_namelen = sizeof(sa);
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = 2 * count;
+
+    if (segment) {
+        std::memset(&control, 0, sizeof(control));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = IPPROTO_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+
+        const std::uint16_t segmentSize =
+            static_cast<std::uint16_t>(mSegmentSize);
+        std::memcpy(CMSG_DATA(cmsg), &segmentSize, sizeof(segmentSize));
+    }
+
+    ssize_t rc;
+
+    do {
+        rc = sendmsg(mFD, &msg, 0);
+    } while (rc < 0 && errno == EINTR);
+
+    return (rc < 0) ? errno : 0;
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
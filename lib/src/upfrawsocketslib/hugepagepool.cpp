@@ -0,0 +1,248 @@
+#include <upfrawsocketslib/hugepagepool.hh>
+
+// For mmap(), munmap() and madvise()
+#include <sys/mman.h>
+
+// For std::uintptr_t
+#include <cstdint>
+
+// For errno
+#include <cerrno>
+
+// For std::strerror()
+#include <cstring>
+
+// For std::ifstream
+#include <fstream>
+
+// For std::runtime_error and std::invalid_argument
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+// For std::string
+#include <string>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Buffer sizes, by class.
+const std::size_t bufferSizes[bufferSizeClassCount] = {
+    2 * 1024,
+    9 * 1024,
+    65 * 1024,
+};
+
+// Room for a Ethernet header with two VLAN tags, on top of the MTU.
+const std::size_t maxL2HeaderSize = 14 + 2 * 4;
+
+// Used when the default huge page size can't be found out.
+const std::size_t defaultHugePageSize = 2 * 1024 * 1024;
+
+// Get the default huge page size, from /proc/meminfo.
+std::size_t getHugePageSize() {
+    std::ifstream meminfo("/proc/meminfo");
+    std::string key;
+
+    while (meminfo >> key) {
+        if (key == "Hugepagesize:") {
+            std::size_t kB = 0;
+
+            if (meminfo >> kB && kB != 0) {
+                return kB * 1024;
+            }
+
+            break;
+        }
+
+        meminfo.ignore(256, '\n');
+    }
+
+    return defaultHugePageSize;
+}
+
+// Map `size` bytes aligned to `alignment`, which lets the kernel back
+// them with transparent huge pages. Return nullptr on errors.
+void *mapAligned(std::size_t size, std::size_t alignment) {
+    void *p = mmap(nullptr, size + alignment, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED) {
+        return nullptr;
+    }
+
+    const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(p);
+    const std::uintptr_t aligned = (start + alignment - 1) & ~(alignment - 1);
+    const std::size_t head = aligned - start;
+    const std::size_t tail = alignment - head;
+
+    // Trim the unaligned parts.
+    if (head != 0) {
+        munmap(p, head);
+    }
+
+    if (tail != 0) {
+        munmap(reinterpret_cast<void *>(aligned + size), tail);
+    }
+
+    return reinterpret_cast<void *>(aligned);
+}
+
+} // namespace
+
+std::size_t getBufferSize(BufferSizeClass sizeClass) {
+    return bufferSizes[sizeClass];
+}
+
+BufferSizeClass getBufferSizeClassForMTU(std::size_t mtu) {
+    if (mtu + maxL2HeaderSize <= bufferSizes[BUFFER_SIZE_CLASS_2K]) {
+        return BUFFER_SIZE_CLASS_2K;
+    } else if (mtu + maxL2HeaderSize <= bufferSizes[BUFFER_SIZE_CLASS_9K]) {
+        return BUFFER_SIZE_CLASS_9K;
+    }
+
+    return BUFFER_SIZE_CLASS_64K;
+}
+
+HugePagePacketBufferPool::HugePagePacketBufferPool(
+    const HugePagePoolConfig &config)
+    : mConfig(config), mNodes(getNUMANodeCount()) {
+
+    if (mConfig.arenaSize < bufferSizes[BUFFER_SIZE_CLASS_64K]) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": invalid arena size "
+            << mConfig.arenaSize << " (must be at least "
+            << bufferSizes[BUFFER_SIZE_CLASS_64K] << ")";
+        throw std::invalid_argument(err.str());
+    }
+
+    // Round the arena size up to a multiple of the huge page size.
+    const std::size_t hugePageSize = getHugePageSize();
+
+    mConfig.arenaSize =
+        (mConfig.arenaSize + hugePageSize - 1) / hugePageSize * hugePageSize;
+}
+
+HugePagePacketBufferPool::~HugePagePacketBufferPool() {
+    for (const auto &a : mArenas) {
+        munmap(a.address, a.size);
+    }
+}
+
+NetworkLib::BufferWritableView
+HugePagePacketBufferPool::getBufferWritableView(BufferSizeClass sizeClass,
+                                                int node) {
+    const std::size_t n = getNodeIndex(node);
+    std::vector<Buffer *> &free = mNodes[n].free[sizeClass];
+
+    if (free.empty()) {
+        addArena(sizeClass, n);
+    }
+
+    Buffer *b = free.back();
+    free.pop_back();
+
+    // The buffer comes back to the pool via Buffer::recycle() when the
+    // last reference is dropped.
+    return NetworkLib::BufferWritableView(NetworkLib::PacketBufferRef(b));
+}
+
+void HugePagePacketBufferPool::reserve(BufferSizeClass sizeClass,
+                                       std::size_t count, int node) {
+    const std::size_t n = getNodeIndex(node);
+
+    while (mNodes[n].capacity[sizeClass] < count) {
+        addArena(sizeClass, n);
+    }
+}
+
+std::size_t HugePagePacketBufferPool::getNodeIndex(int node) const {
+    if (node < 0 || static_cast<std::size_t>(node) >= mNodes.size()) {
+        node = getThisThreadNUMANode();
+    }
+
+    // Just in case the topology isn't what it was at construction.
+    return (static_cast<std::size_t>(node) < mNodes.size())
+               ? static_cast<std::size_t>(node)
+               : 0;
+}
+
+void HugePagePacketBufferPool::addArena(BufferSizeClass sizeClass,
+                                        std::size_t node) {
+    const std::size_t size = mConfig.arenaSize;
+
+    if (mConfig.maxMappedBytes != 0 &&
+        mMappedBytes + size > mConfig.maxMappedBytes) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": memory limit of "
+            << mConfig.maxMappedBytes << " bytes reached";
+        throw std::runtime_error(err.str());
+    }
+
+    // Make room first, so that a mapped arena is always tracked (and
+    // unmapped on destruction), and buffers can always be given back.
+    const std::size_t count = size / bufferSizes[sizeClass];
+
+    mArenas.reserve(mArenas.size() + 1);
+    Node &n = mNodes[node];
+    n.free[sizeClass].reserve(n.capacity[sizeClass] + count);
+
+    void *p = MAP_FAILED;
+    bool hugeTLB = false;
+
+    if (mConfig.hugePages) {
+        p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        hugeTLB = (p != MAP_FAILED);
+    }
+
+    if (p == MAP_FAILED) {
+        p = mapAligned(size, defaultHugePageSize);
+
+        if (p == nullptr) {
+            const int saved_errno = errno;
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION << ": mmap() error mapping "
+                << size << " bytes: errno: " << saved_errno << ": "
+                << std::strerror(saved_errno);
+            throw std::runtime_error(err.str());
+        }
+
+        // Just a hint: it fails harmlessly when transparent huge pages
+        // are disabled.
+        if (mConfig.hugePages) {
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+    }
+
+    // Bind the arena before its pages are first touched below. No
+    // need to on single node systems, and a failure just leaves the
+    // pages wherever the kernel puts them.
+    if (mNodes.size() > 1) {
+        preferNUMANode(p, size, static_cast<int>(node));
+    }
+
+    mArenas.push_back(Arena{p, size});
+    mMappedBytes += size;
+
+    if (hugeTLB) {
+        mHugeTLBBytes += size;
+    }
+
+    unsigned char *base = static_cast<unsigned char *>(p);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        mBuffers[sizeClass].emplace_back(this, sizeClass, node,
+                                         base + i * bufferSizes[sizeClass],
+                                         bufferSizes[sizeClass]);
+        n.free[sizeClass].push_back(&mBuffers[sizeClass].back());
+    }
+
+    n.capacity[sizeClass] += count;
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
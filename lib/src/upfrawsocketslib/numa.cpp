@@ -0,0 +1,166 @@
+#include <upfrawsocketslib/numa.hh>
+
+// For MPOL_PREFERRED
+#include <linux/mempolicy.h>
+
+// For SYS_mbind
+#include <sys/syscall.h>
+
+// For syscall()
+#include <unistd.h>
+
+// For sched_getcpu()
+#include <sched.h>
+
+// For std::strtoul() and std::atoi()
+#include <cstdlib>
+
+// For std::ifstream
+#include <fstream>
+
+// For std::getline()
+#include <string>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Read the first line of a sysfs file (empty on errors).
+std::string readFirstLine(const std::string &path) {
+    std::ifstream file(path);
+    std::string line;
+
+    std::getline(file, line);
+
+    return line;
+}
+
+// Parse a sysfs list of numbers (e.g. "0-3,8-11").
+std::vector<unsigned int> parseList(const std::string &list) {
+    std::vector<unsigned int> result;
+    const char *p = list.c_str();
+
+    while (*p != '\0') {
+        char *end;
+        const unsigned long first = std::strtoul(p, &end, 10);
+
+        if (end == p) {
+            break;
+        }
+
+        unsigned long last = first;
+        p = end;
+
+        if (*p == '-') {
+            last = std::strtoul(p + 1, &end, 10);
+            p = end;
+        }
+
+        for (unsigned long i = first; i <= last; ++i) {
+            result.push_back(static_cast<unsigned int>(i));
+        }
+
+        if (*p == ',') {
+            ++p;
+        } else {
+            break;
+        }
+    }
+
+    return result;
+}
+
+// NUMA topology, read once from sysfs.
+struct Topology {
+    std::size_t nodeCount = 1;
+
+    // NUMA node of each CPU.
+    std::vector<int> nodeOfCPU;
+
+    Topology() {
+        const std::vector<unsigned int> nodes =
+            parseList(readFirstLine("/sys/devices/system/node/possible"));
+
+        for (auto n : nodes) {
+            if (n + 1 > nodeCount) {
+                nodeCount = n + 1;
+            }
+
+            for (auto cpu : getCPUsOfNUMANode(static_cast<int>(n))) {
+                if (cpu >= nodeOfCPU.size()) {
+                    nodeOfCPU.resize(cpu + 1, 0);
+                }
+
+                nodeOfCPU[cpu] = static_cast<int>(n);
+            }
+        }
+    }
+};
+
+const Topology &getTopology() {
+    static const Topology topology;
+    return topology;
+}
+
+} // namespace
+
+std::size_t getNUMANodeCount() { return getTopology().nodeCount; }
+
+int getThisThreadNUMANode() {
+    const Topology &topology = getTopology();
+
+    if (topology.nodeCount == 1) {
+        return 0;
+    }
+
+    // Cheap: served by the vDSO (or rseq), with no system call.
+    const int cpu = sched_getcpu();
+
+    if (cpu < 0 ||
+        static_cast<std::size_t>(cpu) >= topology.nodeOfCPU.size()) {
+        return 0;
+    }
+
+    return topology.nodeOfCPU[static_cast<std::size_t>(cpu)];
+}
+
+int getNUMANodeByIfName(const std::string &ifName) {
+    const std::string line =
+        readFirstLine("/sys/class/net/" + ifName + "/device/numa_node");
+
+    if (line.empty()) {
+        return anyNUMANode;
+    }
+
+    // The kernel reports -1 when it doesn't know.
+    const int node = std::atoi(line.c_str());
+
+    return (node >= 0) ? node : anyNUMANode;
+}
+
+std::vector<unsigned int> getCPUsOfNUMANode(int node) {
+    if (node < 0) {
+        return std::vector<unsigned int>();
+    }
+
+    return parseList(readFirstLine("/sys/devices/system/node/node" +
+                                   std::to_string(node) + "/cpulist"));
+}
+
+bool preferNUMANode(void *address, std::size_t size, int node) {
+    const unsigned long maxNode = 8 * sizeof(unsigned long);
+
+    if (node < 0 || static_cast<unsigned long>(node) >= maxNode) {
+        return false;
+    }
+
+    const unsigned long nodeMask = 1UL << node;
+
+    // The kernel reads maxnode - 1 bits of the mask.
+    return syscall(SYS_mbind, address, size, MPOL_PREFERRED, &nodeMask,
+                   maxNode + 1, 0) == 0;
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
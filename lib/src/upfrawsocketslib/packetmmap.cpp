@@ -0,0 +1,450 @@
+#include <upfrawsocketslib/packetmmap.hh>
+
+// For PACKET_MMAP constants and structures
+#include <linux/if_packet.h>
+#include <sys/socket.h>
+
+// For mmap() and munmap()
+#include <sys/mman.h>
+
+// For poll()
+#include <poll.h>
+
+// For getpagesize()
+#include <unistd.h>
+
+// For std::memmove(), std::memset() and std::strerror()
+#include <cstring>
+
+// For std::uintptr_t
+#include <cstdint>
+
+// For std::runtime_error, std::invalid_argument and std::length_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Throw a std::runtime_error describing the failure of the given
+// system call, using the current value of errno.
+[[noreturn]] void throwSystemError(const char *function, const char *call,
+                                   SocketFD socketfd) {
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": " << call << "() error on raw socket with fd "
+        << socketfd << ": errno: " << saved_errno << ": "
+        << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+tpacket_block_desc *blockDescriptor(NetworkLib::PacketBuffer *block) {
+    return reinterpret_cast<tpacket_block_desc *>(block->data());
+}
+
+} // namespace
+
+PacketMMapRxRing::PacketMMapRxRing(SocketFD socketfd,
+                                   const RxRingConfig &config)
+    : mSocketFD(socketfd), mConfig(config) {
+
+    const std::size_t pageSize = static_cast<std::size_t>(getpagesize());
+
+    if (config.blockSize == 0 || (config.blockSize % pageSize) != 0 ||
+        config.blockCount == 0 || config.frameSize < TPACKET3_HDRLEN ||
+        (config.frameSize % TPACKET_ALIGNMENT) != 0 ||
+        config.frameSize > config.blockSize) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": invalid ring geometry (block size: " << config.blockSize
+            << ", block count: " << config.blockCount
+            << ", frame size: " << config.frameSize
+            << ", page size: " << pageSize << ")";
+        throw std::invalid_argument(err.str());
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(mSocketFD, SOL_PACKET, PACKET_VERSION, &version,
+                   sizeof(version)) == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt", mSocketFD);
+    }
+
+    struct tpacket_req3 req;
+    std::memset(&req, 0, sizeof(req));
+    req.tp_block_size = static_cast<unsigned int>(config.blockSize);
+    req.tp_block_nr = static_cast<unsigned int>(config.blockCount);
+    req.tp_frame_size = static_cast<unsigned int>(config.frameSize);
+    req.tp_frame_nr = static_cast<unsigned int>(
+        (config.blockSize / config.frameSize) * config.blockCount);
+    req.tp_retire_blk_tov = config.blockTimeoutMs;
+
+    if (setsockopt(mSocketFD, SOL_PACKET, PACKET_RX_RING, &req,
+                   sizeof(req)) == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt", mSocketFD);
+    }
+
+    mRingSize = config.blockSize * config.blockCount;
+    void *ring = mmap(nullptr, mRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_LOCKED, mSocketFD, 0);
+
+    if (ring == MAP_FAILED) {
+        // MAP_LOCKED may fail because of RLIMIT_MEMLOCK: try again
+        // without it.
+        ring = mmap(nullptr, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    mSocketFD, 0);
+    }
+
+    if (ring == MAP_FAILED) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "mmap", mSocketFD);
+    }
+
+    mRing = static_cast<unsigned char *>(ring);
+
+    mBlocks.reserve(config.blockCount);
+    for (std::size_t i = 0; i < config.blockCount; ++i) {
+        mBlocks.emplace_back(this, mRing + i * config.blockSize,
+                             config.blockSize);
+    }
+}
+
+PacketMMapRxRing::~PacketMMapRxRing() {
+    // Drop our own reference to the current block (if any) before
+    // the ring goes away.
+    mCurrentBlockView = NetworkLib::BufferWritableView();
+
+    if (mRing != nullptr) {
+        munmap(mRing, mRingSize);
+    }
+}
+
+bool PacketMMapRxRing::openNextBlock() {
+    Block &block = mBlocks[mNextBlock];
+
+    if (block.isHandedOut()) {
+        // We wrapped around the ring, but some frames from the last
+        // lap are still referenced: the block is still TP_STATUS_USER
+        // without having been refilled by the kernel.
+        return false;
+    }
+
+    tpacket_block_desc *desc = blockDescriptor(&block);
+
+    const auto status =
+        __atomic_load_n(&desc->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+
+    if ((status & TP_STATUS_USER) == 0) {
+        // Still owned by the kernel.
+        return false;
+    }
+
+    mNextBlock = (mNextBlock + 1) % mBlocks.size();
+
+    mFramesLeft = desc->hdr.bh1.num_pkts;
+    mNextFrameOffset = desc->hdr.bh1.offset_to_first_pkt;
+
+    // The block goes back to the kernel (see Block::recycle()) when
+    // the last view on it goes away.
+    block.setHandedOut(true);
+    mCurrentBlockView =
+        NetworkLib::BufferWritableView(NetworkLib::PacketBufferRef(&block));
+
+    return true;
+}
+
+void PacketMMapRxRing::releaseBlock(NetworkLib::PacketBuffer *p) noexcept {
+    // Hand it back to the kernel first: once it's no longer marked
+    // as handed out, openNextBlock() trusts the kernel status.
+    __atomic_store_n(&blockDescriptor(p)->hdr.bh1.block_status,
+                     TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    static_cast<Block *>(p)->setHandedOut(false);
+}
+
+bool PacketMMapRxRing::packetAvailable() {
+    while (mFramesLeft == 0) {
+        // We are done with the current block: drop our reference, so
+        // it goes back to the kernel as soon as users are done with
+        // its frames too.
+        mCurrentBlockView = NetworkLib::BufferWritableView();
+
+        if (!openNextBlock()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+NetworkLib::BufferWritableView
+PacketMMapRxRing::getEthPacket(NetworkLib::BufferWritableView &) {
+    if (!packetAvailable()) {
+        return NetworkLib::BufferWritableView();
+    }
+
+    const auto *frame = reinterpret_cast<const tpacket3_hdr *>(
+        mCurrentBlockView.getUnderlyingWritableBufferPtr() + mNextFrameOffset);
+
+    const std::size_t dataOffset = mNextFrameOffset + frame->tp_mac;
+    const std::size_t dataLength = frame->tp_snaplen;
+
+    --mFramesLeft;
+    mNextFrameOffset += frame->tp_next_offset;
+
+    return mCurrentBlockView.getSub(dataOffset, dataLength);
+}
+
+bool PacketMMapRxRing::waitForPacket(int timeoutMs) {
+    if (packetAvailable()) {
+        return true;
+    }
+
+    struct pollfd pfd;
+    std::memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = mSocketFD;
+    pfd.events = POLLIN | POLLERR;
+
+    const int rc = poll(&pfd, 1, timeoutMs);
+
+    if (rc == -1 && errno != EINTR) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "poll", mSocketFD);
+    }
+
+    return packetAvailable();
+}
+
+RxRingStatistics PacketMMapRxRing::getStatistics() {
+    struct tpacket_stats_v3 stats;
+    std::memset(&stats, 0, sizeof(stats));
+    socklen_t len = sizeof(stats);
+
+    if (getsockopt(mSocketFD, SOL_PACKET, PACKET_STATISTICS, &stats, &len) ==
+        -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "getsockopt", mSocketFD);
+    }
+
+    RxRingStatistics result;
+    result.packets = stats.tp_packets;
+    result.drops = stats.tp_drops;
+    result.freezes = stats.tp_freeze_q_cnt;
+
+    return result;
+}
+
+namespace {
+
+// Where frame data starts in a TPACKET_V2 transmit slot.
+const std::size_t txDataOffset = TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+
+tpacket2_hdr *txSlotHeader(unsigned char *slot) {
+    return reinterpret_cast<tpacket2_hdr *>(slot);
+}
+
+} // namespace
+
+PacketMMapTxRing::PacketMMapTxRing(SocketFD socketfd,
+                                   const TxRingConfig &config)
+    : mSocketFD(socketfd), mConfig(config) {
+
+    const std::size_t pageSize = static_cast<std::size_t>(getpagesize());
+
+    if (config.frameSize <= txDataOffset ||
+        (config.frameSize % TPACKET_ALIGNMENT) != 0 ||
+        config.frameCount == 0 || config.batchSize == 0) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": invalid ring geometry (frame size: " << config.frameSize
+            << ", frame count: " << config.frameCount
+            << ", batch size: " << config.batchSize << ")";
+        throw std::invalid_argument(err.str());
+    }
+
+    // Slots can't span blocks, and blocks must be made of whole
+    // pages: use the smallest block holding at least one slot.
+    const std::size_t blockSize =
+        ((config.frameSize + pageSize - 1) / pageSize) * pageSize;
+    const std::size_t framesPerBlock = blockSize / config.frameSize;
+    const std::size_t blockCount =
+        (config.frameCount + framesPerBlock - 1) / framesPerBlock;
+
+    int version = TPACKET_V2;
+    if (setsockopt(mSocketFD, SOL_PACKET, PACKET_VERSION, &version,
+                   sizeof(version)) == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt", mSocketFD);
+    }
+
+    if (config.bypassQdisc) {
+        int one = 1;
+        if (setsockopt(mSocketFD, SOL_PACKET, PACKET_QDISC_BYPASS, &one,
+                       sizeof(one)) == -1) {
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt",
+                             mSocketFD);
+        }
+    }
+
+    struct tpacket_req req;
+    std::memset(&req, 0, sizeof(req));
+    req.tp_block_size = static_cast<unsigned int>(blockSize);
+    req.tp_block_nr = static_cast<unsigned int>(blockCount);
+    req.tp_frame_size = static_cast<unsigned int>(config.frameSize);
+    req.tp_frame_nr = static_cast<unsigned int>(blockCount * framesPerBlock);
+
+    if (setsockopt(mSocketFD, SOL_PACKET, PACKET_TX_RING, &req,
+                   sizeof(req)) == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt", mSocketFD);
+    }
+
+    mRingSize = blockSize * blockCount;
+    void *ring = mmap(nullptr, mRingSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      mSocketFD, 0);
+
+    if (ring == MAP_FAILED) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "mmap", mSocketFD);
+    }
+
+    mRing = static_cast<unsigned char *>(ring);
+
+    mSlots.reserve(req.tp_frame_nr);
+    for (std::size_t b = 0; b < blockCount; ++b) {
+        for (std::size_t f = 0; f < framesPerBlock; ++f) {
+            mSlots.push_back(mRing + b * blockSize + f * config.frameSize);
+        }
+    }
+
+    acquireCurrentSlot();
+}
+
+PacketMMapTxRing::~PacketMMapTxRing() {
+    try {
+        flush();
+    } catch (...) {
+        // Don't allow exceptions to propagate out of a destructor.
+    }
+
+    if (mRing != nullptr) {
+        munmap(mRing, mRingSize);
+    }
+}
+
+void PacketMMapTxRing::acquireCurrentSlot() {
+    tpacket2_hdr *hdr = txSlotHeader(mSlots[mCurrentSlot]);
+
+    for (int attempt = 0;; ++attempt) {
+        const auto status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+
+        if (status == TP_STATUS_AVAILABLE) {
+            break;
+        }
+
+        if (status & TP_STATUS_WRONG_FORMAT) {
+            // The kernel refused the frame previously stored here:
+            // just reuse the slot.
+            break;
+        }
+
+        if (attempt == 3) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": transmit ring full on raw socket with fd " << mSocketFD
+                << " (slot status: " << status << ")";
+            throw std::runtime_error(err.str());
+        }
+
+        // The ring wrapped around and the slot is still waiting to be
+        // sent: a blocking flush waits until the kernel is done with
+        // the queued frames.
+        flush();
+    }
+
+    hdr->tp_status = TP_STATUS_AVAILABLE;
+
+    mFrameBuffer =
+        NetworkLib::BufferWritableView::makeNonOwningBufferWritableView(
+            mSlots[mCurrentSlot] + txDataOffset,
+            mConfig.frameSize - txDataOffset);
+}
+
+void PacketMMapTxRing::consumeEthPacket(const NetworkLib::BufferView &ethData,
+                                        NetworkLib::ContextUserData &) {
+    if (ethData.empty()) {
+        return;
+    }
+
+    if (ethData.size() > mFrameBuffer.size()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": frame too large (required "
+            << ethData.size() << ", available " << mFrameBuffer.size() << ')';
+        throw std::length_error(err.str());
+    }
+
+    // Copy the frame, unless it was built in place.
+    const unsigned char *src = ethData.getUnderlyingBufferPtr();
+    unsigned char *dst = mFrameBuffer.getUnderlyingWritableBufferPtr();
+
+    if (src != dst) {
+        const std::uintptr_t srcAddr = reinterpret_cast<std::uintptr_t>(src);
+        const std::uintptr_t dstAddr = reinterpret_cast<std::uintptr_t>(dst);
+
+        if (srcAddr > dstAddr && srcAddr - dstAddr < mFrameBuffer.size()) {
+            // Built in the current slot, but not at its start (e.g.
+            // after some headroom): source and destination overlap.
+            std::memmove(dst, src, ethData.size());
+        } else {
+            ethData.copyTo(0, ethData.size(), dst);
+        }
+    }
+
+    tpacket2_hdr *hdr = txSlotHeader(mSlots[mCurrentSlot]);
+    hdr->tp_len = static_cast<std::uint32_t>(ethData.size());
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST,
+                     __ATOMIC_RELEASE);
+
+    if (mQueued == 0) {
+        mDeadline = std::chrono::steady_clock::now() +
+                    std::chrono::microseconds(mConfig.maxLatencyUs);
+    }
+
+    ++mQueued;
+    mCurrentSlot = (mCurrentSlot + 1) % mSlots.size();
+
+    if (mQueued >= mConfig.batchSize ||
+        std::chrono::steady_clock::now() >= mDeadline) {
+        flush();
+    }
+
+    acquireCurrentSlot();
+}
+
+void PacketMMapTxRing::consumeEthPacketChain(
+    const NetworkLib::BufferChain &ethData,
+    NetworkLib::ContextUserData &userData) {
+    if (ethData.size() > mFrameBuffer.size()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": frame too large (required "
+            << ethData.size() << ", available " << mFrameBuffer.size() << ')';
+        throw std::length_error(err.str());
+    }
+
+    // Gather the segments into the current slot, so that the frame is
+    // then queued as built in place.
+    ethData.copyTo(mFrameBuffer.getUnderlyingWritableBufferPtr());
+    consumeEthPacket(mFrameBuffer.getSub(0, ethData.size()), userData);
+}
+
+void PacketMMapTxRing::flush() {
+    mQueued = 0;
+
+    ssize_t ss;
+    do {
+        ss = sendto(mSocketFD, nullptr, 0, 0, nullptr, 0);
+    } while (ss == -1 && errno == EINTR);
+
+    if (ss == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "sendto", mSocketFD);
+    }
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
@@ -28,6 +28,12 @@
 // For std::array
 #include <array>
 
+// For std::min()
+#include <algorithm>
+
+// For struct iovec
+#include <sys/uio.h>
+
 namespace UPF {
 namespace RawSocketsUtil {
 
@@ -88,7 +94,7 @@ SocketFD openByIfIndex(IfIndex ifIdx, PromiscuousMode pmode) {
             const int saved_errno = errno;
             std::ostringstream err;
             err << NETWORKLIB_CURRENT_FUNCTION
-                << ": bind() error on raw socket with fd" << socketfd
+                << ": bind() error on raw socket with fd " << socketfd
                 << ": errno: " << saved_errno << ": "
                 << std::strerror(saved_errno);
 
@@ -110,7 +116,7 @@ SocketFD openByIfIndex(IfIndex ifIdx, PromiscuousMode pmode) {
                 const int saved_errno = errno;
                 std::ostringstream err;
                 err << NETWORKLIB_CURRENT_FUNCTION
-                    << ": setsockopt() error on raw socket with fd" << socketfd
+                    << ": setsockopt() error on raw socket with fd " << socketfd
                     << ": errno: " << saved_errno << ": "
                     << std::strerror(saved_errno);
                 throw std::runtime_error(err.str());
@@ -128,6 +134,89 @@ SocketFD openByIfIndex(IfIndex ifIdx, PromiscuousMode pmode) {
     return socketfd;
 }
 
+void joinFanoutGroup(SocketFD socketfd, std::uint16_t groupId,
+                     FanoutMode mode) {
+    int type = PACKET_FANOUT_HASH;
+
+    switch (mode) {
+    case FANOUT_MODE_HASH:
+        type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+        break;
+    case FANOUT_MODE_CPU:
+        type = PACKET_FANOUT_CPU;
+        break;
+    case FANOUT_MODE_ROUND_ROBIN:
+        type = PACKET_FANOUT_LB;
+        break;
+    }
+
+    // Group id in the lower 16 bits, type and flags in the upper ones
+    const int arg = static_cast<int>(groupId) | (type << 16);
+
+    int rc = setsockopt(socketfd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg));
+
+    if (rc == -1) {
+        const int saved_errno = errno;
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": setsockopt() error on raw socket with fd " << socketfd
+            << " joining fanout group " << groupId << ": errno: " << saved_errno
+            << ": " << std::strerror(saved_errno);
+        throw std::runtime_error(err.str());
+    }
+}
+
+SocketFD openByIfIndexInFanoutGroup(IfIndex ifIdx, PromiscuousMode mode,
+                                    std::uint16_t groupId,
+                                    FanoutMode fanoutMode) {
+    const SocketFD socketfd = openByIfIndex(ifIdx, mode);
+
+    try {
+        joinFanoutGroup(socketfd, groupId, fanoutMode);
+    } catch (...) {
+        close(socketfd);
+        throw;
+    }
+
+    return socketfd;
+}
+
+SocketFD openForSendingByIfIndex(IfIndex ifIdx) {
+    // Protocol 0 means that no traffic is delivered to the socket.
+    const SocketFD socketfd = socket(AF_PACKET, SOCK_RAW, 0);
+
+    if (socketfd == -1) {
+        const int saved_errno = errno;
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": socket() error opening raw socket on ifIndex " << ifIdx
+            << ": errno " << saved_errno << ": " << std::strerror(saved_errno);
+        throw std::runtime_error(err.str());
+    }
+
+    struct sockaddr_ll socketAddress;
+    std::memset(&socketAddress, 0, sizeof(socketAddress));
+    socketAddress.sll_family = PF_PACKET;
+    socketAddress.sll_ifindex = ifIdx;
+    socketAddress.sll_protocol = 0;
+
+    int rc = bind(socketfd, reinterpret_cast<struct sockaddr *>(&socketAddress),
+                  sizeof(socketAddress));
+
+    if (rc == -1) {
+        const int saved_errno = errno;
+        close(socketfd);
+
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": bind() error on raw socket with fd " << socketfd
+            << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
+        throw std::runtime_error(err.str());
+    }
+
+    return socketfd;
+}
+
 NetworkLib::BufferWritableView
 receiveData(SocketFD socketfd,
             const NetworkLib::BufferWritableView &bufferWritableView) {
@@ -139,13 +228,13 @@ receiveData(SocketFD socketfd,
         const int saved_errno = errno;
         std::ostringstream err;
         err << NETWORKLIB_CURRENT_FUNCTION
-            << ": recv() error on raw socket with fd" << socketfd
+            << ": recv() error on raw socket with fd " << socketfd
             << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
         throw std::runtime_error(err.str());
     } else if (ss < 0) {
         std::ostringstream err;
         err << NETWORKLIB_CURRENT_FUNCTION
-            << ": recv() error on raw socket with fd" << socketfd
+            << ": recv() error on raw socket with fd " << socketfd
             << ": received a negative amount of data (" << ss << ')';
         throw std::runtime_error(err.str());
     }
@@ -161,7 +250,7 @@ void sendData(SocketFD socketfd, const NetworkLib::BufferView &bufferView) {
         const int saved_errno = errno;
         std::ostringstream err;
         err << NETWORKLIB_CURRENT_FUNCTION
-            << ": send() error on raw socket with fd" << socketfd
+            << ": send() error on raw socket with fd " << socketfd
             << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
         throw std::runtime_error(err.str());
     }
@@ -169,13 +258,132 @@ void sendData(SocketFD socketfd, const NetworkLib::BufferView &bufferView) {
     if (static_cast<std::size_t>(ss) < bufferView.size()) {
         std::ostringstream err;
         err << NETWORKLIB_CURRENT_FUNCTION
-            << ": send() less bytes than expected on raw socket with fd"
+            << ": send() less bytes than expected on raw socket with fd "
             << socketfd << " (expected " << bufferView.size() << ", wrote "
             << ss << ")";
         throw std::runtime_error(err.str());
     }
 }
 
+void sendData(SocketFD socketfd, const NetworkLib::BufferChain &bufferChain) {
+    std::array<struct iovec, NetworkLib::maxBufferChainSegments> iov;
+    std::size_t iovcnt = 0;
+
+    // Note: sendmsg() won't change data, even if iov_base isn't
+    //       const.
+    for (const auto &segment : bufferChain) {
+        iov[iovcnt].iov_base =
+            const_cast<unsigned char *>(segment.getUnderlyingBufferPtr());
+        iov[iovcnt].iov_len = segment.size();
+        ++iovcnt;
+    }
+
+    struct msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = iovcnt;
+
+    const ssize_t ss = sendmsg(socketfd, &msg, 0);
+
+    if (ss < 0) {
+        const int saved_errno = errno;
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": sendmsg() error on raw socket with fd " << socketfd
+            << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
+        throw std::runtime_error(err.str());
+    }
+
+    if (static_cast<std::size_t>(ss) < bufferChain.size()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": sendmsg() less bytes than expected on raw socket with fd "
+            << socketfd << " (expected " << bufferChain.size() << ", wrote "
+            << ss << ")";
+        throw std::runtime_error(err.str());
+    }
+}
+
+namespace {
+
+// Translate the outcome of a batch system call into a BatchResult.
+BatchResult makeBatchResult(int rc, int saved_errno) {
+    BatchResult result;
+
+    if (rc >= 0) {
+        result.count = static_cast<std::size_t>(rc);
+    } else if (saved_errno == EAGAIN || saved_errno == EWOULDBLOCK) {
+        result.status = IO_STATUS_WOULD_BLOCK;
+    } else if (saved_errno == EINTR) {
+        result.status = IO_STATUS_INTERRUPTED;
+    } else {
+        result.status = IO_STATUS_ERROR;
+        result.errorNumber = saved_errno;
+    }
+
+    return result;
+}
+
+} // namespace
+
+BatchResult receiveBatch(SocketFD socketfd,
+                         const NetworkLib::BufferWritableView *buffers,
+                         std::size_t *sizes, std::size_t count) noexcept {
+    std::array<struct mmsghdr, maxBatchSize> msgs;
+    std::array<struct iovec, maxBatchSize> iovecs;
+
+    const std::size_t n = std::min(count, maxBatchSize);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        iovecs[i].iov_base = buffers[i].getUnderlyingWritableBufferPtr();
+        iovecs[i].iov_len = buffers[i].size();
+
+        std::memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int rc = recvmmsg(socketfd, msgs.data(), static_cast<unsigned int>(n),
+                            MSG_WAITFORONE, nullptr);
+    BatchResult result = makeBatchResult(rc, errno);
+
+    // IO_STATUS_OK means at least one frame.
+    if (rc == 0) {
+        result.status = IO_STATUS_WOULD_BLOCK;
+    }
+
+    for (std::size_t i = 0; i < result.count; ++i) {
+        sizes[i] = msgs[i].msg_len;
+    }
+
+    return result;
+}
+
+BatchResult sendBatch(SocketFD socketfd, const NetworkLib::BufferView *frames,
+                      std::size_t count) noexcept {
+    std::array<struct mmsghdr, maxBatchSize> msgs;
+    std::array<struct iovec, maxBatchSize> iovecs;
+
+    const std::size_t n = std::min(count, maxBatchSize);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        // Note: sendmmsg() won't change data, even if iov_base isn't
+        //       const.
+        iovecs[i].iov_base =
+            const_cast<unsigned char *>(frames[i].getUnderlyingBufferPtr());
+        iovecs[i].iov_len = frames[i].size();
+
+        std::memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const int rc =
+        sendmmsg(socketfd, msgs.data(), static_cast<unsigned int>(n), 0);
+
+    return makeBatchResult(rc, errno);
+}
+
 void closeSocket(SocketFD socketfd) {
     int rc = close(socketfd);
 
@@ -183,7 +391,7 @@ void closeSocket(SocketFD socketfd) {
         const int saved_errno = errno;
         std::ostringstream err;
         err << NETWORKLIB_CURRENT_FUNCTION
-            << ": close() error on raw socket with fd" << socketfd
+            << ": close() error on raw socket with fd " << socketfd
             << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
         throw std::runtime_error(err.str());
     }
@@ -201,9 +409,9 @@ std::size_t getMTU(SocketFD socketfd, const std::string &ifName) {
     if (ioctl(socketfd, SIOCGIFMTU, &ifr) == -1) {
         const int saved_errno = errno;
         std::ostringstream err;
-        err << function_name << ": ioctl(SIOCGIFMT) error on raw socket with fd"
-            << socketfd << ": errno: " << saved_errno << ": "
-            << std::strerror(saved_errno);
+        err << function_name
+            << ": ioctl(SIOCGIFMTU) error on raw socket with fd " << socketfd
+            << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
         throw std::runtime_error(err.str());
     }
 
@@ -221,7 +429,7 @@ void setMTU(SocketFD socketfd, const std::string &ifName, std::size_t mtu) {
         const int saved_errno = errno;
         std::ostringstream err;
         err << NETWORKLIB_CURRENT_FUNCTION
-            << ": ioctl(SIOCSIFMTU) error on raw socket with fd" << socketfd
+            << ": ioctl(SIOCSIFMTU) error on raw socket with fd " << socketfd
             << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
         throw std::runtime_error(err.str());
     }
@@ -0,0 +1,275 @@
+#include <upfrawsocketslib/socketfilter.hh>
+
+// For struct sock_filter, struct sock_fprog and the BPF_* macros
+#include <linux/filter.h>
+
+// For setsockopt()
+#include <sys/socket.h>
+
+// For errno
+#include <cerrno>
+
+// For std::numeric_limits
+#include <limits>
+
+// For std::strerror()
+#include <cstring>
+
+// For std::runtime_error, std::logic_error and std::length_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+// Not defined by older headers
+#ifndef SO_LOCK_FILTER
+#define SO_LOCK_FILTER 44
+#endif
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+static_assert(sizeof(SocketFilterInstruction) == sizeof(struct sock_filter),
+              "SocketFilterInstruction must match struct sock_filter");
+
+constexpr std::uint32_t SocketFilterProgram::acceptFrame;
+constexpr std::uint32_t SocketFilterProgram::rejectFrame;
+
+namespace {
+
+// Value of a label not bound yet.
+const std::size_t unboundLabel = std::numeric_limits<std::size_t>::max();
+
+// Throw a std::runtime_error describing the failure of setsockopt(),
+// using the current value of errno.
+[[noreturn]] void throwSetsockoptError(const char *function,
+                                       const char *option,
+                                       SocketFD socketfd) {
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": setsockopt(" << option
+        << ") error on raw socket with fd " << socketfd
+        << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+} // namespace
+
+SocketFilterProgram::Label SocketFilterProgram::makeLabel() {
+    mLabels.push_back(unboundLabel);
+    return mLabels.size() - 1;
+}
+
+void SocketFilterProgram::bindLabel(Label label) {
+    if (mLabels.at(label) != unboundLabel) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": label " << label
+            << " already bound";
+        throw std::logic_error(err.str());
+    }
+
+    mLabels[label] = mInstructions.size();
+}
+
+void SocketFilterProgram::loadByte(std::uint32_t offset) {
+    add(BPF_LD | BPF_B | BPF_ABS, offset);
+}
+
+void SocketFilterProgram::loadHalfWord(std::uint32_t offset) {
+    add(BPF_LD | BPF_H | BPF_ABS, offset);
+}
+
+void SocketFilterProgram::loadWord(std::uint32_t offset) {
+    add(BPF_LD | BPF_W | BPF_ABS, offset);
+}
+
+void SocketFilterProgram::loadByteIndirect(std::uint32_t offset) {
+    add(BPF_LD | BPF_B | BPF_IND, offset);
+}
+
+void SocketFilterProgram::loadHalfWordIndirect(std::uint32_t offset) {
+    add(BPF_LD | BPF_H | BPF_IND, offset);
+}
+
+void SocketFilterProgram::loadWordIndirect(std::uint32_t offset) {
+    add(BPF_LD | BPF_W | BPF_IND, offset);
+}
+
+void SocketFilterProgram::loadValue(std::uint32_t value) {
+    add(BPF_LD | BPF_IMM, value);
+}
+
+void SocketFilterProgram::loadLength() { add(BPF_LD | BPF_W | BPF_LEN, 0); }
+
+void SocketFilterProgram::storeScratch(std::uint32_t slot) {
+    add(BPF_ST, slot);
+}
+
+void SocketFilterProgram::loadIndexFromScratch(std::uint32_t slot) {
+    add(BPF_LDX | BPF_MEM, slot);
+}
+
+void SocketFilterProgram::andValue(std::uint32_t value) {
+    add(BPF_ALU | BPF_AND | BPF_K, value);
+}
+
+void SocketFilterProgram::shiftLeft(std::uint32_t value) {
+    add(BPF_ALU | BPF_LSH | BPF_K, value);
+}
+
+void SocketFilterProgram::addValue(std::uint32_t value) {
+    add(BPF_ALU | BPF_ADD | BPF_K, value);
+}
+
+void SocketFilterProgram::addIndex() { add(BPF_ALU | BPF_ADD | BPF_X, 0); }
+
+void SocketFilterProgram::jumpIfEqual(std::uint32_t value, Label ifTrue,
+                                      Label ifFalse) {
+    addJump(BPF_JMP | BPF_JEQ | BPF_K, value, ifTrue, ifFalse);
+}
+
+void SocketFilterProgram::jumpIfAnySet(std::uint32_t value, Label ifTrue,
+                                       Label ifFalse) {
+    addJump(BPF_JMP | BPF_JSET | BPF_K, value, ifTrue, ifFalse);
+}
+
+void SocketFilterProgram::jumpIfGreaterOrEqualIndex(Label ifTrue,
+                                                    Label ifFalse) {
+    addJump(BPF_JMP | BPF_JGE | BPF_X, 0, ifTrue, ifFalse);
+}
+
+void SocketFilterProgram::jump(Label target) {
+    // BPF_JA uses k as offset, not jt/jf: see assemble().
+    addJump(BPF_JMP | BPF_JA, 0, target, target);
+}
+
+void SocketFilterProgram::returnValue(std::uint32_t value) {
+    add(BPF_RET | BPF_K, value);
+}
+
+std::vector<SocketFilterInstruction> SocketFilterProgram::assemble() const {
+    if (mInstructions.empty() || mInstructions.size() > BPF_MAXINSNS) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": invalid program length "
+            << mInstructions.size() << " (must be between 1 and "
+            << BPF_MAXINSNS << ")";
+        throw std::length_error(err.str());
+    }
+
+    std::vector<SocketFilterInstruction> result;
+    result.reserve(mInstructions.size());
+
+    // Offset of the jump to the given label from instruction i.
+    auto jumpOffset = [this](std::size_t i, Label label,
+                             std::size_t maxOffset) {
+        const std::size_t target = mLabels.at(label);
+
+        if (target == unboundLabel || target <= i ||
+            target - i - 1 > maxOffset) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION << ": label " << label
+                << " not reachable from instruction " << i;
+            throw std::logic_error(err.str());
+        }
+
+        return target - i - 1;
+    };
+
+    for (std::size_t i = 0; i < mInstructions.size(); ++i) {
+        const PendingInstruction &p = mInstructions[i];
+        SocketFilterInstruction instruction = p.instruction;
+
+        if (p.isJump) {
+            if (BPF_OP(instruction.code) == BPF_JA) {
+                instruction.k = static_cast<std::uint32_t>(
+                    jumpOffset(i, p.jt, BPF_MAXINSNS));
+            } else {
+                instruction.jt =
+                    static_cast<std::uint8_t>(jumpOffset(i, p.jt, 255));
+                instruction.jf =
+                    static_cast<std::uint8_t>(jumpOffset(i, p.jf, 255));
+            }
+        }
+
+        result.push_back(instruction);
+    }
+
+    // The kernel rejects programs which can run past their end.
+    const std::uint16_t lastCode = result.back().code;
+
+    if (BPF_CLASS(lastCode) != BPF_RET) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": the last instruction must be a return";
+        throw std::logic_error(err.str());
+    }
+
+    return result;
+}
+
+void SocketFilterProgram::add(std::uint16_t code, std::uint32_t k) {
+    PendingInstruction p;
+    p.instruction.code = code;
+    p.instruction.jt = 0;
+    p.instruction.jf = 0;
+    p.instruction.k = k;
+    p.isJump = false;
+    p.jt = 0;
+    p.jf = 0;
+
+    mInstructions.push_back(p);
+}
+
+void SocketFilterProgram::addJump(std::uint16_t code, std::uint32_t k,
+                                  Label jt, Label jf) {
+    add(code, k);
+
+    PendingInstruction &p = mInstructions.back();
+    p.isJump = true;
+    p.jt = jt;
+    p.jf = jf;
+}
+
+void attachFilter(SocketFD socketfd, const SocketFilterProgram &program) {
+    std::vector<SocketFilterInstruction> instructions = program.assemble();
+
+    struct sock_fprog fprog;
+    fprog.len = static_cast<unsigned short>(instructions.size());
+    fprog.filter = reinterpret_cast<struct sock_filter *>(instructions.data());
+
+    // The kernel swaps the old filter (if any) for the new one
+    // atomically.
+    if (setsockopt(socketfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog,
+                   sizeof(fprog)) < 0) {
+        throwSetsockoptError(NETWORKLIB_CURRENT_FUNCTION, "SO_ATTACH_FILTER",
+                             socketfd);
+    }
+}
+
+void lockFilter(SocketFD socketfd) {
+    const int one = 1;
+
+    if (setsockopt(socketfd, SOL_SOCKET, SO_LOCK_FILTER, &one, sizeof(one)) <
+        0) {
+        throwSetsockoptError(NETWORKLIB_CURRENT_FUNCTION, "SO_LOCK_FILTER",
+                             socketfd);
+    }
+}
+
+void detachFilter(SocketFD socketfd) {
+    const int dummy = 0;
+
+    if (setsockopt(socketfd, SOL_SOCKET, SO_DETACH_FILTER, &dummy,
+                   sizeof(dummy)) < 0) {
+        // No filter attached: nothing to do.
+        if (errno == ENOENT) {
+            return;
+        }
+
+        throwSetsockoptError(NETWORKLIB_CURRENT_FUNCTION, "SO_DETACH_FILTER",
+                             socketfd);
+    }
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
@@ -0,0 +1,406 @@
+#include <upfrawsocketslib/tapdevice.hh>
+
+// For struct ifreq
+#include <net/if.h>
+
+// For TUNSETIFF, TUNSETOFFLOAD and the IFF_* and TUN_F_* flags
+#include <linux/if_tun.h>
+
+// For ioctl()
+#include <sys/ioctl.h>
+
+// For readv() and writev()
+#include <sys/uio.h>
+
+// For poll()
+#include <poll.h>
+
+// For open()
+#include <fcntl.h>
+
+// For close()
+#include <unistd.h>
+
+// For std::uint8_t and std::uint16_t
+#include <cstdint>
+
+// For errno
+#include <cerrno>
+
+// For std::memset(), std::strncpy() and std::strerror()
+#include <cstring>
+
+// For std::runtime_error, std::invalid_argument and std::logic_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+// Not defined by older headers
+#ifndef TUN_F_USO4
+#define TUN_F_USO4 0x20
+#endif
+
+#ifndef TUN_F_USO6
+#define TUN_F_USO6 0x40
+#endif
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// The legacy struct virtio_net_hdr (as in <linux/virtio_net.h>, which
+// can't be included in C++ code) in the host byte order, as used by
+// TUN/TAP devices unless told otherwise.
+struct virtio_net_hdr {
+    std::uint8_t flags;
+    std::uint8_t gso_type;
+    std::uint16_t hdr_len;
+    std::uint16_t gso_size;
+    std::uint16_t csum_start;
+    std::uint16_t csum_offset;
+};
+
+static_assert(sizeof(virtio_net_hdr) == 10,
+              "virtio_net_hdr must be 10 bytes long");
+
+const std::uint8_t VIRTIO_NET_HDR_F_NEEDS_CSUM = 1;
+const std::uint8_t VIRTIO_NET_HDR_F_DATA_VALID = 2;
+
+const std::uint8_t VIRTIO_NET_HDR_GSO_NONE = 0;
+const std::uint8_t VIRTIO_NET_HDR_GSO_TCPV4 = 1;
+const std::uint8_t VIRTIO_NET_HDR_GSO_UDP = 3;
+const std::uint8_t VIRTIO_NET_HDR_GSO_TCPV6 = 4;
+const std::uint8_t VIRTIO_NET_HDR_GSO_UDP_L4 = 5;
+const std::uint8_t VIRTIO_NET_HDR_GSO_ECN = 0x80;
+
+// Throw a std::runtime_error describing the failure of the given
+// system call, using the current value of errno.
+[[noreturn]] void throwSystemError(const char *function, const char *call,
+                                   int fd) {
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": " << call << "() error on TUN/TAP fd " << fd
+        << ": errno: " << saved_errno << ": " << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+NetworkLib::OffloadInfo toOffloadInfo(const struct virtio_net_hdr &h) {
+    NetworkLib::OffloadInfo result;
+
+    result.checksumPartial = (h.flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) != 0;
+    result.checksumValid = (h.flags & VIRTIO_NET_HDR_F_DATA_VALID) != 0;
+    result.checksumStart = h.csum_start;
+    result.checksumOffset = h.csum_offset;
+
+    switch (h.gso_type & ~VIRTIO_NET_HDR_GSO_ECN) {
+    case VIRTIO_NET_HDR_GSO_TCPV4:
+        result.gsoType = NetworkLib::GSOType::TCPV4;
+        break;
+    case VIRTIO_NET_HDR_GSO_UDP:
+        result.gsoType = NetworkLib::GSOType::UDP;
+        break;
+    case VIRTIO_NET_HDR_GSO_TCPV6:
+        result.gsoType = NetworkLib::GSOType::TCPV6;
+        break;
+    case VIRTIO_NET_HDR_GSO_UDP_L4:
+        result.gsoType = NetworkLib::GSOType::UDP_L4;
+        break;
+    default:
+        result.gsoType = NetworkLib::GSOType::NONE;
+        break;
+    }
+
+    if (result.gsoType != NetworkLib::GSOType::NONE) {
+        result.gsoSize = h.gso_size;
+        result.headerLength = h.hdr_len;
+    }
+
+    return result;
+}
+
+struct virtio_net_hdr toVirtioNetHdr(const NetworkLib::OffloadInfo &o) {
+    struct virtio_net_hdr result;
+    std::memset(&result, 0, sizeof(result));
+
+    if (o.checksumPartial) {
+        result.flags |= VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        result.csum_start = o.checksumStart;
+        result.csum_offset = o.checksumOffset;
+    } else if (o.checksumValid) {
+        result.flags |= VIRTIO_NET_HDR_F_DATA_VALID;
+    }
+
+    switch (o.gsoType) {
+    case NetworkLib::GSOType::TCPV4:
+        result.gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+        break;
+    case NetworkLib::GSOType::UDP:
+        result.gso_type = VIRTIO_NET_HDR_GSO_UDP;
+        break;
+    case NetworkLib::GSOType::TCPV6:
+        result.gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+        break;
+    case NetworkLib::GSOType::UDP_L4:
+        result.gso_type = VIRTIO_NET_HDR_GSO_UDP_L4;
+        break;
+    default:
+        result.gso_type = VIRTIO_NET_HDR_GSO_NONE;
+        break;
+    }
+
+    if (result.gso_type != VIRTIO_NET_HDR_GSO_NONE) {
+        result.gso_size = o.gsoSize;
+        result.hdr_len = o.headerLength;
+    }
+
+    return result;
+}
+
+} // namespace
+
+TapQueue::TapQueue(int fd, TapMode mode, bool vnetHeader)
+    : mFD(fd), mMode(mode), mVnetHeader(vnetHeader) {}
+
+TapQueue::~TapQueue() { close(mFD); }
+
+bool TapQueue::packetAvailable() {
+    struct pollfd pfd;
+    std::memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = mFD;
+    pfd.events = POLLIN;
+
+    return (poll(&pfd, 1, 0) > 0) && ((pfd.revents & POLLIN) != 0);
+}
+
+NetworkLib::BufferWritableView
+TapQueue::getEthPacket(NetworkLib::BufferWritableView &buffer) {
+    checkMode(TAP_MODE_ETHERNET, NETWORKLIB_CURRENT_FUNCTION);
+    return read(buffer);
+}
+
+NetworkLib::BufferWritableView
+TapQueue::getIPv4Packet(NetworkLib::BufferWritableView &buffer) {
+    checkMode(TAP_MODE_IP, NETWORKLIB_CURRENT_FUNCTION);
+    return read(buffer);
+}
+
+NetworkLib::BufferWritableView
+TapQueue::getEthPacket(NetworkLib::BufferWritableView &buffer,
+                       NetworkLib::ContextUserData &userData) {
+    NetworkLib::BufferWritableView result = getEthPacket(buffer);
+    userData.offloadInfo = mLastOffloadInfo;
+    return result;
+}
+
+NetworkLib::BufferWritableView
+TapQueue::getIPv4Packet(NetworkLib::BufferWritableView &buffer,
+                        NetworkLib::ContextUserData &userData) {
+    NetworkLib::BufferWritableView result = getIPv4Packet(buffer);
+    userData.offloadInfo = mLastOffloadInfo;
+    return result;
+}
+
+void TapQueue::consumeEthPacket(const NetworkLib::BufferView &ethData,
+                                NetworkLib::ContextUserData &userData) {
+    checkMode(TAP_MODE_ETHERNET, NETWORKLIB_CURRENT_FUNCTION);
+    write(NetworkLib::BufferChain(ethData), userData.offloadInfo);
+}
+
+void TapQueue::consumeIPv4Packet(const NetworkLib::BufferView &ipv4Data,
+                                 NetworkLib::ContextUserData &userData) {
+    checkMode(TAP_MODE_IP, NETWORKLIB_CURRENT_FUNCTION);
+    write(NetworkLib::BufferChain(ipv4Data), userData.offloadInfo);
+}
+
+void TapQueue::consumeEthPacketChain(const NetworkLib::BufferChain &ethData,
+                                     NetworkLib::ContextUserData &userData) {
+    checkMode(TAP_MODE_ETHERNET, NETWORKLIB_CURRENT_FUNCTION);
+    write(ethData, userData.offloadInfo);
+}
+
+void TapQueue::consumeIPv4PacketChain(const NetworkLib::BufferChain &ipv4Data,
+                                      NetworkLib::ContextUserData &userData) {
+    checkMode(TAP_MODE_IP, NETWORKLIB_CURRENT_FUNCTION);
+    write(ipv4Data, userData.offloadInfo);
+}
+
+void TapQueue::checkMode(TapMode mode, const char *function) const {
+    if (mMode != mode) {
+        std::ostringstream err;
+        err << function << ": not available in "
+            << ((mMode == TAP_MODE_ETHERNET) ? "Ethernet" : "IP") << " mode";
+        throw std::logic_error(err.str());
+    }
+}
+
+NetworkLib::BufferWritableView
+TapQueue::read(NetworkLib::BufferWritableView &b) {
+    struct virtio_net_hdr hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+
+    // A byte past the buffer, to tell whether the frame/packet fit.
+    unsigned char overflow;
+
+    struct iovec iov[3];
+    int iovcnt = 0;
+
+    if (mVnetHeader) {
+        iov[iovcnt].iov_base = &hdr;
+        iov[iovcnt].iov_len = sizeof(hdr);
+        ++iovcnt;
+    }
+
+    iov[iovcnt].iov_base = b.getUnderlyingWritableBufferPtr();
+    iov[iovcnt].iov_len = b.size();
+    ++iovcnt;
+
+    iov[iovcnt].iov_base = &overflow;
+    iov[iovcnt].iov_len = sizeof(overflow);
+    ++iovcnt;
+
+    const ssize_t rc = readv(mFD, iov, iovcnt);
+
+    if (rc < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            mLastOffloadInfo = NetworkLib::OffloadInfo();
+            return NetworkLib::BufferWritableView();
+        }
+
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "readv", mFD);
+    }
+
+    std::size_t size = static_cast<std::size_t>(rc);
+
+    if (mVnetHeader) {
+        if (size < sizeof(hdr)) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": short read on TUN/TAP fd " << mFD;
+            throw std::runtime_error(err.str());
+        }
+
+        size -= sizeof(hdr);
+        mLastOffloadInfo = toOffloadInfo(hdr);
+    } else {
+        mLastOffloadInfo = NetworkLib::OffloadInfo();
+    }
+
+    // Anything past the buffer (in the extra byte, or as the whole
+    // length, as some kernels tell) means it didn't fit.
+    if (size > b.size()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": frame/packet truncated to the " << b.size()
+            << " bytes of the buffer on TUN/TAP fd " << mFD;
+        throw std::runtime_error(err.str());
+    }
+
+    return b.getSub(0, size);
+}
+
+void TapQueue::write(const NetworkLib::BufferChain &data,
+                     const NetworkLib::OffloadInfo &offloadInfo) {
+    if (data.empty()) {
+        return;
+    }
+
+    struct virtio_net_hdr hdr = toVirtioNetHdr(offloadInfo);
+
+    struct iovec iov[1 + NetworkLib::maxBufferChainSegments];
+    int iovcnt = 0;
+
+    if (mVnetHeader) {
+        iov[iovcnt].iov_base = &hdr;
+        iov[iovcnt].iov_len = sizeof(hdr);
+        ++iovcnt;
+    }
+
+    // Note: writev() won't change data, even if iov_base isn't
+    //       const.
+    for (const auto &segment : data) {
+        iov[iovcnt].iov_base =
+            const_cast<unsigned char *>(segment.getUnderlyingBufferPtr());
+        iov[iovcnt].iov_len = segment.size();
+        ++iovcnt;
+    }
+
+    if (writev(mFD, iov, iovcnt) < 0) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "writev", mFD);
+    }
+}
+
+TapDevice::TapDevice(const TapDeviceConfig &config) : mIfName(config.ifName) {
+    if ((config.queues == 0) || (mIfName.size() >= IFNAMSIZ) ||
+        (config.receiveOffloads && !config.vnetHeader)) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": invalid configuration";
+        throw std::invalid_argument(err.str());
+    }
+
+    for (std::size_t i = 0; i < config.queues; ++i) {
+        int flags = O_RDWR | O_CLOEXEC;
+
+        if (config.nonBlocking) {
+            flags |= O_NONBLOCK;
+        }
+
+        const int fd = open("/dev/net/tun", flags);
+
+        if (fd < 0) {
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "open", fd);
+        }
+
+        // From now on, the queue owns the fd, and the device owns the
+        // queue (so everything is closed if we throw).
+        mQueues.emplace_back(new TapQueue(fd, config.mode, config.vnetHeader));
+
+        struct ifreq ifr;
+        std::memset(&ifr, 0, sizeof(ifr));
+        std::strncpy(ifr.ifr_name, mIfName.c_str(), IFNAMSIZ - 1);
+        ifr.ifr_flags = IFF_NO_PI | IFF_MULTI_QUEUE;
+        ifr.ifr_flags |= (config.mode == TAP_MODE_ETHERNET) ? IFF_TAP : IFF_TUN;
+
+        if (config.vnetHeader) {
+            ifr.ifr_flags |= IFF_VNET_HDR;
+        }
+
+        if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "ioctl(TUNSETIFF)",
+                             fd);
+        }
+
+        // The kernel picks a name if we didn't.
+        mIfName = ifr.ifr_name;
+
+        if (config.vnetHeader) {
+            const int hdrSize = sizeof(struct virtio_net_hdr);
+
+            if (ioctl(fd, TUNSETVNETHDRSZ, &hdrSize) < 0) {
+                throwSystemError(NETWORKLIB_CURRENT_FUNCTION,
+                                 "ioctl(TUNSETVNETHDRSZ)", fd);
+            }
+        }
+
+        // Offloads are a property of the device: set them only once.
+        if (config.receiveOffloads && (i == 0)) {
+            const unsigned int offloads =
+                TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+
+            // UDP segmentation offload isn't supported by older
+            // kernels: try without it, if refused.
+            if ((ioctl(fd, TUNSETOFFLOAD,
+                       offloads | TUN_F_USO4 | TUN_F_USO6) < 0) &&
+                (ioctl(fd, TUNSETOFFLOAD, offloads) < 0)) {
+                throwSystemError(NETWORKLIB_CURRENT_FUNCTION,
+                                 "ioctl(TUNSETOFFLOAD)", fd);
+            }
+        }
+    }
+}
+
+TapDevice::~TapDevice() {}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
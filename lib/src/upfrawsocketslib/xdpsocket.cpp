@@ -0,0 +1,610 @@
+#include <upfrawsocketslib/xdpsocket.hh>
+
+// For AF_XDP constants and structures
+#include <linux/if_xdp.h>
+#include <sys/socket.h>
+
+// For the bpf() system call, XDP programs and XDP_FLAGS_*
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <sys/syscall.h>
+
+// For mmap() and munmap()
+#include <sys/mman.h>
+
+// For poll()
+#include <poll.h>
+
+// For close() and getpagesize()
+#include <unistd.h>
+
+// For offsetof()
+#include <cstddef>
+
+// For std::memset() and std::strerror()
+#include <cstring>
+
+// For std::runtime_error, std::invalid_argument and std::length_error
+#include <stdexcept>
+
+// For std::ostringstream
+#include <sstream>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+namespace UPF {
+namespace RawSocketsUtil {
+
+namespace {
+
+// Throw a std::runtime_error describing the failure of the given
+// system call, using the current value of errno.
+[[noreturn]] void throwSystemError(const char *function, const char *call,
+                                   SocketFD socketfd) {
+    const int saved_errno = errno;
+    std::ostringstream err;
+    err << function << ": " << call << "() error on XDP socket with fd "
+        << socketfd << ": errno: " << saved_errno << ": "
+        << std::strerror(saved_errno);
+    throw std::runtime_error(err.str());
+}
+
+int bpf(int cmd, union bpf_attr *attr) {
+    return static_cast<int>(syscall(__NR_bpf, cmd, attr, sizeof(*attr)));
+}
+
+bool isPowerOfTwo(std::size_t n) { return n != 0 && (n & (n - 1)) == 0; }
+
+std::uint32_t loadAcquire(const std::uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(std::uint32_t *p, std::uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+// Transmission is handed to the kernel at least each this many
+// frames.
+const std::size_t txBatchSize = 64;
+
+} // namespace
+
+XDPSocket::XDPSocket(IfIndex ifIdx, const XDPSocketConfig &config)
+    : mConfig(config), mIfIndex(ifIdx) {
+
+    const std::size_t pageSize = static_cast<std::size_t>(getpagesize());
+
+    if (!isPowerOfTwo(config.frameSize) || config.frameSize < 2048 ||
+        config.frameSize > pageSize || !isPowerOfTwo(config.ringSize) ||
+        config.ringSize > config.frameCount) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION
+            << ": invalid configuration (frame size: " << config.frameSize
+            << ", frame count: " << config.frameCount
+            << ", ring size: " << config.ringSize << ")";
+        throw std::invalid_argument(err.str());
+    }
+
+    mSocketFD = socket(AF_XDP, SOCK_RAW, 0);
+
+    if (mSocketFD == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "socket", mSocketFD);
+    }
+
+    try {
+        setUpUmemAndRings();
+
+        struct sockaddr_xdp address;
+        std::memset(&address, 0, sizeof(address));
+        address.sxdp_family = AF_XDP;
+        address.sxdp_ifindex = ifIdx;
+        address.sxdp_queue_id = config.queueId;
+        address.sxdp_flags = XDP_USE_NEED_WAKEUP |
+                             (config.zeroCopy ? XDP_ZEROCOPY : XDP_COPY);
+
+        if (bind(mSocketFD, reinterpret_cast<struct sockaddr *>(&address),
+                 sizeof(address)) == -1) {
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "bind", mSocketFD);
+        }
+
+        refillFillRing();
+
+        if (config.attachDefaultProgram) {
+            attachDefaultProgram();
+        }
+    } catch (...) {
+        cleanUp();
+        throw;
+    }
+}
+
+XDPSocket::~XDPSocket() { cleanUp(); }
+
+void XDPSocket::cleanUp() noexcept {
+    // Closing the link detaches the program from the interface.
+    for (int *fd : {&mLinkFD, &mProgramFD, &mMapFD, &mSocketFD}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+
+    for (Ring *r : {&mFillRing, &mCompletionRing, &mRxRing, &mTxRing}) {
+        if (r->map != nullptr) {
+            munmap(r->map, r->mapSize);
+            r->map = nullptr;
+        }
+    }
+
+    // Drop the views on frames being transmitted before the UMEM
+    // goes away.
+    mTxInFlight.clear();
+
+    if (mUmem != nullptr) {
+        munmap(mUmem, mUmemSize);
+        mUmem = nullptr;
+    }
+}
+
+void XDPSocket::setUpUmemAndRings() {
+    mUmemSize = mConfig.frameCount * mConfig.frameSize;
+
+    void *umem = mmap(nullptr, mUmemSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (umem == MAP_FAILED) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "mmap", mSocketFD);
+    }
+
+    mUmem = static_cast<unsigned char *>(umem);
+
+    struct xdp_umem_reg umemReg;
+    std::memset(&umemReg, 0, sizeof(umemReg));
+    umemReg.addr = reinterpret_cast<std::uint64_t>(mUmem);
+    umemReg.len = mUmemSize;
+    umemReg.chunk_size = static_cast<std::uint32_t>(mConfig.frameSize);
+    umemReg.headroom = 0;
+
+    if (setsockopt(mSocketFD, SOL_XDP, XDP_UMEM_REG, &umemReg,
+                   sizeof(umemReg)) == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt", mSocketFD);
+    }
+
+    const int ringSize = static_cast<int>(mConfig.ringSize);
+
+    for (int option : {XDP_UMEM_FILL_RING, XDP_UMEM_COMPLETION_RING,
+                       XDP_RX_RING, XDP_TX_RING}) {
+        if (setsockopt(mSocketFD, SOL_XDP, option, &ringSize,
+                       sizeof(ringSize)) == -1) {
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "setsockopt",
+                             mSocketFD);
+        }
+    }
+
+    struct xdp_mmap_offsets offsets;
+    std::memset(&offsets, 0, sizeof(offsets));
+    socklen_t optlen = sizeof(offsets);
+
+    if (getsockopt(mSocketFD, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &optlen) ==
+        -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "getsockopt", mSocketFD);
+    }
+
+    auto mapRing = [this](Ring &ring, const struct xdp_ring_offset &off,
+                          std::size_t descriptorSize, off_t pgoff) {
+        ring.mapSize = off.desc + mConfig.ringSize * descriptorSize;
+        ring.map = mmap(nullptr, ring.mapSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, mSocketFD, pgoff);
+
+        if (ring.map == MAP_FAILED) {
+            ring.map = nullptr;
+            throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "mmap", mSocketFD);
+        }
+
+        auto *base = static_cast<unsigned char *>(ring.map);
+        ring.producer = reinterpret_cast<std::uint32_t *>(base + off.producer);
+        ring.consumer = reinterpret_cast<std::uint32_t *>(base + off.consumer);
+        ring.flags = reinterpret_cast<std::uint32_t *>(base + off.flags);
+        ring.descriptors = base + off.desc;
+        ring.mask = static_cast<std::uint32_t>(mConfig.ringSize - 1);
+    };
+
+    mapRing(mFillRing, offsets.fr, sizeof(std::uint64_t),
+            XDP_UMEM_PGOFF_FILL_RING);
+    mapRing(mCompletionRing, offsets.cr, sizeof(std::uint64_t),
+            XDP_UMEM_PGOFF_COMPLETION_RING);
+    mapRing(mRxRing, offsets.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING);
+    mapRing(mTxRing, offsets.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING);
+
+    mFrames.reserve(mConfig.frameCount);
+    mFreeFrames.reserve(mConfig.frameCount);
+    for (std::size_t i = 0; i < mConfig.frameCount; ++i) {
+        mFrames.emplace_back(this, mUmem + i * mConfig.frameSize,
+                             mConfig.frameSize);
+        mFreeFrames.push_back(i * mConfig.frameSize);
+    }
+
+    mTxInFlight.resize(mConfig.frameCount);
+}
+
+void XDPSocket::attachDefaultProgram() {
+    union bpf_attr attr;
+
+    // A XSKMAP, with one entry per queue.
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(std::uint32_t);
+    attr.value_size = sizeof(std::uint32_t);
+    attr.max_entries = mConfig.queueId + 1;
+
+    mMapFD = bpf(BPF_MAP_CREATE, &attr);
+    if (mMapFD == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "bpf", mSocketFD);
+    }
+
+    // The program, equivalent to:
+    //
+    //   return bpf_redirect_map(&xsks_map, ctx->rx_queue_index, XDP_PASS);
+    //
+    // i.e. frames of queues without a socket go on through the
+    // kernel network stack.
+    const struct bpf_insn program[] = {
+        // r2 = ctx->rx_queue_index
+        {BPF_LDX | BPF_W | BPF_MEM, 2, 1,
+         static_cast<__s16>(offsetof(struct xdp_md, rx_queue_index)), 0},
+        // r1 = xsks_map (64-bit immediate, two instructions)
+        {BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, mMapFD},
+        {0, 0, 0, 0, 0},
+        // r3 = XDP_PASS
+        {BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS},
+        // r0 = bpf_redirect_map(r1, r2, r3)
+        {BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map},
+        // return r0
+        {BPF_JMP | BPF_EXIT, 0, 0, 0, 0},
+    };
+
+    static const char license[] = "GPL";
+
+    std::memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = reinterpret_cast<std::uint64_t>(program);
+    attr.insn_cnt = sizeof(program) / sizeof(program[0]);
+    attr.license = reinterpret_cast<std::uint64_t>(license);
+
+    mProgramFD = bpf(BPF_PROG_LOAD, &attr);
+    if (mProgramFD == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "bpf", mSocketFD);
+    }
+
+    // Register the socket for its queue.
+    std::uint32_t key = mConfig.queueId;
+    std::uint32_t value = static_cast<std::uint32_t>(mSocketFD);
+
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_fd = static_cast<std::uint32_t>(mMapFD);
+    attr.key = reinterpret_cast<std::uint64_t>(&key);
+    attr.value = reinterpret_cast<std::uint64_t>(&value);
+    attr.flags = BPF_ANY;
+
+    if (bpf(BPF_MAP_UPDATE_ELEM, &attr) == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "bpf", mSocketFD);
+    }
+
+    // Attach the program to the interface via a BPF link, so that it
+    // gets detached automatically when the link is closed.
+    std::memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = static_cast<std::uint32_t>(mProgramFD);
+    attr.link_create.target_ifindex = mIfIndex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = (mConfig.attachMode == XDP_ATTACH_MODE_NATIVE)
+                                 ? XDP_FLAGS_DRV_MODE
+                                 : XDP_FLAGS_SKB_MODE;
+
+    mLinkFD = bpf(BPF_LINK_CREATE, &attr);
+    if (mLinkFD == -1) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "bpf", mSocketFD);
+    }
+}
+
+NetworkLib::BufferWritableView XDPSocket::makeFrameView(std::size_t index) {
+    // The frame comes back to us (see Frame::recycle()) when the last
+    // view on it goes away.
+    return NetworkLib::BufferWritableView(
+        NetworkLib::PacketBufferRef(&mFrames[index]));
+}
+
+void XDPSocket::releaseFrame(NetworkLib::PacketBuffer *p) noexcept {
+    // Note: no reallocation can happen, as mFreeFrames has been
+    //       reserved for all the frames.
+    mFreeFrames.push_back(static_cast<std::uint64_t>(p->data() - mUmem));
+}
+
+void XDPSocket::refillFillRing() {
+    const std::uint32_t producer = *mFillRing.producer;
+    const std::uint32_t consumer = loadAcquire(mFillRing.consumer);
+    const std::uint32_t room =
+        static_cast<std::uint32_t>(mConfig.ringSize) - (producer - consumer);
+
+    std::uint32_t n = room;
+    if (n > mFreeFrames.size()) {
+        n = static_cast<std::uint32_t>(mFreeFrames.size());
+    }
+
+    if (n == 0) {
+        return;
+    }
+
+    auto *addresses = static_cast<std::uint64_t *>(mFillRing.descriptors);
+
+    for (std::uint32_t i = 0; i < n; ++i) {
+        addresses[(producer + i) & mFillRing.mask] = mFreeFrames.back();
+        mFreeFrames.pop_back();
+    }
+
+    storeRelease(mFillRing.producer, producer + n);
+}
+
+void XDPSocket::reapCompletions() {
+    const std::uint32_t consumer = *mCompletionRing.consumer;
+    const std::uint32_t producer = loadAcquire(mCompletionRing.producer);
+
+    if (producer == consumer) {
+        return;
+    }
+
+    const auto *addresses =
+        static_cast<const std::uint64_t *>(mCompletionRing.descriptors);
+
+    for (std::uint32_t i = consumer; i != producer; ++i) {
+        const std::uint64_t address = addresses[i & mCompletionRing.mask];
+
+        // Dropping our view gives the frame back, unless someone
+        // else still holds on to it.
+        mTxInFlight[address / mConfig.frameSize] = NetworkLib::BufferView();
+    }
+
+    storeRelease(mCompletionRing.consumer, producer);
+}
+
+void XDPSocket::wakeUpRxIfNeeded() {
+    // With XDP_USE_NEED_WAKEUP the kernel may stop looking at the
+    // fill ring (e.g. when it ran out of frames) until it's kicked.
+    if ((loadAcquire(mFillRing.flags) & XDP_RING_NEED_WAKEUP) == 0) {
+        return;
+    }
+
+    const ssize_t rs =
+        recvfrom(mSocketFD, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+
+    if (rs == -1 && errno != EAGAIN && errno != EWOULDBLOCK &&
+        errno != EBUSY && errno != ENETDOWN && errno != EINTR) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "recvfrom", mSocketFD);
+    }
+}
+
+bool XDPSocket::packetAvailable() {
+    if (loadAcquire(mRxRing.producer) != *mRxRing.consumer) {
+        return true;
+    }
+
+    refillFillRing();
+    wakeUpRxIfNeeded();
+
+    return loadAcquire(mRxRing.producer) != *mRxRing.consumer;
+}
+
+NetworkLib::BufferWritableView
+XDPSocket::getEthPacket(NetworkLib::BufferWritableView &) {
+    if (!packetAvailable()) {
+        return NetworkLib::BufferWritableView();
+    }
+
+    const std::uint32_t consumer = *mRxRing.consumer;
+    const auto &desc = static_cast<const struct xdp_desc *>(
+        mRxRing.descriptors)[consumer & mRxRing.mask];
+
+    const std::size_t index = desc.addr / mConfig.frameSize;
+    const std::size_t offset = desc.addr % mConfig.frameSize;
+    const std::size_t length = desc.len;
+
+    storeRelease(mRxRing.consumer, consumer + 1);
+
+    NetworkLib::BufferWritableView result =
+        makeFrameView(index).getSub(offset, length);
+
+    // Keep the fill ring topped up, in batches.
+    if (mFreeFrames.size() >= txBatchSize) {
+        refillFillRing();
+    }
+
+    return result;
+}
+
+NetworkLib::BufferWritableView XDPSocket::getFrameBuffer() {
+    if (mFreeFrames.empty()) {
+        reapCompletions();
+    }
+
+    if (mFreeFrames.empty()) {
+        return NetworkLib::BufferWritableView();
+    }
+
+    const std::size_t index = mFreeFrames.back() / mConfig.frameSize;
+    mFreeFrames.pop_back();
+
+    return makeFrameView(index);
+}
+
+void XDPSocket::consumeEthPacket(const NetworkLib::BufferView &ethData,
+                                 NetworkLib::ContextUserData &) {
+    if (ethData.empty()) {
+        return;
+    }
+
+    if (ethData.size() > mConfig.frameSize) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": frame too large (required "
+            << ethData.size() << ", available " << mConfig.frameSize << ')';
+        throw std::length_error(err.str());
+    }
+
+    const unsigned char *p = ethData.getUnderlyingBufferPtr();
+    NetworkLib::BufferView frame;
+
+    if (p >= mUmem && p + ethData.size() <= mUmem + mUmemSize) {
+        // Already in the UMEM: transmit in place.
+        frame = ethData;
+    } else {
+        NetworkLib::BufferWritableView buffer =
+            getTxFrameBuffer(NETWORKLIB_CURRENT_FUNCTION);
+
+        ethData.copyTo(0, ethData.size(),
+                       buffer.getUnderlyingWritableBufferPtr());
+        frame = buffer.getSub(0, ethData.size());
+    }
+
+    // Make room in the TX ring, if needed.
+    std::uint32_t producer = *mTxRing.producer;
+
+    if (producer - loadAcquire(mTxRing.consumer) >= mConfig.ringSize) {
+        flush();
+
+        if (producer - loadAcquire(mTxRing.consumer) >= mConfig.ringSize) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": TX ring full on XDP socket with fd " << mSocketFD;
+            throw std::runtime_error(err.str());
+        }
+    }
+
+    const std::uint64_t address =
+        static_cast<std::uint64_t>(frame.getUnderlyingBufferPtr() - mUmem);
+    const std::size_t index = address / mConfig.frameSize;
+
+    // A frame can't be queued twice before the kernel is done with
+    // it: reclaim completed frames, and give up if it's still busy.
+    if (!mTxInFlight[index].empty()) {
+        reapCompletions();
+
+        if (!mTxInFlight[index].empty()) {
+            std::ostringstream err;
+            err << NETWORKLIB_CURRENT_FUNCTION
+                << ": UMEM frame already being transmitted on XDP socket "
+                   "with fd "
+                << mSocketFD;
+            throw std::runtime_error(err.str());
+        }
+    }
+
+    auto &desc =
+        static_cast<struct xdp_desc *>(mTxRing.descriptors)[producer &
+                                                            mTxRing.mask];
+    desc.addr = address;
+    desc.len = static_cast<std::uint32_t>(frame.size());
+    desc.options = 0;
+
+    mTxInFlight[index] = frame;
+    storeRelease(mTxRing.producer, producer + 1);
+
+    if (++mTxQueued >= txBatchSize) {
+        flush();
+    }
+}
+
+void XDPSocket::consumeEthPacketChain(const NetworkLib::BufferChain &ethData,
+                                      NetworkLib::ContextUserData &userData) {
+    // A single segment may already be in the UMEM.
+    if (ethData.getSegmentCount() <= 1) {
+        consumeEthPacket(ethData.flatten(), userData);
+        return;
+    }
+
+    if (ethData.size() > mConfig.frameSize) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": frame too large (required "
+            << ethData.size() << ", available " << mConfig.frameSize << ')';
+        throw std::length_error(err.str());
+    }
+
+    // Gather the segments into a free UMEM frame, which is then
+    // transmitted in place.
+    NetworkLib::BufferWritableView buffer =
+        getTxFrameBuffer(NETWORKLIB_CURRENT_FUNCTION);
+
+    ethData.copyTo(buffer.getUnderlyingWritableBufferPtr());
+    consumeEthPacket(buffer.getSub(0, ethData.size()), userData);
+}
+
+NetworkLib::BufferWritableView
+XDPSocket::getTxFrameBuffer(const char *function) {
+    NetworkLib::BufferWritableView buffer = getFrameBuffer();
+
+    if (buffer.empty()) {
+        flush();
+        buffer = getFrameBuffer();
+    }
+
+    if (buffer.empty()) {
+        std::ostringstream err;
+        err << function << ": no free UMEM frames on XDP socket with fd "
+            << mSocketFD;
+        throw std::runtime_error(err.str());
+    }
+
+    return buffer;
+}
+
+void XDPSocket::flush() {
+    if (mTxQueued > 0) {
+        mTxQueued = 0;
+
+        // In copy mode the kernel always needs a kick to transmit;
+        // otherwise, only when it says so.
+        if (!mConfig.zeroCopy ||
+            (loadAcquire(mTxRing.flags) & XDP_RING_NEED_WAKEUP)) {
+            const ssize_t ss =
+                sendto(mSocketFD, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+
+            if (ss == -1 && errno != EAGAIN && errno != EBUSY &&
+                errno != ENOBUFS && errno != ENETDOWN) {
+                throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "sendto",
+                                 mSocketFD);
+            }
+        }
+    }
+
+    reapCompletions();
+}
+
+bool XDPSocket::waitForPacket(int timeoutMs) {
+    flush();
+    refillFillRing();
+
+    if (packetAvailable()) {
+        return true;
+    }
+
+    // Note: poll() also wakes up the kernel when the fill ring needs
+    //       it.
+    struct pollfd pfd;
+    std::memset(&pfd, 0, sizeof(pfd));
+    pfd.fd = mSocketFD;
+    pfd.events = POLLIN;
+
+    const int rc = poll(&pfd, 1, timeoutMs);
+
+    if (rc == -1 && errno != EINTR) {
+        throwSystemError(NETWORKLIB_CURRENT_FUNCTION, "poll", mSocketFD);
+    }
+
+    return packetAvailable();
+}
+
+} // namespace RawSocketsUtil
+} // namespace UPF
@@ -0,0 +1,245 @@
+#include <upfrouterlib/rulefilter.hh>
+
+// For std::uint32_t
+#include <cstdint>
+
+namespace UPF {
+namespace UPFRouterLib {
+
+namespace {
+
+using RawSocketsUtil::SocketFilterProgram;
+
+// EtherType values of 802.1Q and 802.1ad tags.
+const std::uint32_t etherTypeVLAN = 0x8100;
+const std::uint32_t etherTypeQinQ = 0x88a8;
+
+// Scratch memory slots holding the offsets of the IPv4 header, of
+// the header following it, and of the end of the ports in it.
+const std::uint32_t l3OffsetSlot = 0;
+const std::uint32_t l4OffsetSlot = 1;
+const std::uint32_t l4PortsEndSlot = 2;
+
+// Offsets of IPv4 header fields.
+const std::uint32_t ipv4FlagsAndFragmentOffset = 6;
+const std::uint32_t ipv4Protocol = 9;
+const std::uint32_t ipv4DstAddress = 16;
+
+// Offsets of TCP/UDP/SCTP header fields (same for all of them).
+const std::uint32_t l4SrcPort = 0;
+const std::uint32_t l4DstPort = 2;
+const std::uint32_t l4PortsEnd = 4;
+
+std::uint32_t maskFromBits(unsigned int maskBits) {
+    return (maskBits == 0) ? 0 : (0xFFFFFFFFu << (32 - maskBits));
+}
+
+// Jump to `next` if the frame ends before the ports of the
+// TCP/UDP/SCTP header, or fall through to the next instruction.
+//
+// Loading the ports past the end of the frame would abort the whole
+// program, rejecting the frame, rather than going on with the next
+// check (e.g. a rule without ports).
+void compilePortsBoundsCheck(SocketFilterProgram &p,
+                             SocketFilterProgram::Label next) {
+    const auto portsOk = p.makeLabel();
+
+    p.loadIndexFromScratch(l4PortsEndSlot);
+    p.loadLength();
+    p.jumpIfGreaterOrEqualIndex(portsOk, next);
+    p.bindLabel(portsOk);
+}
+
+// Accept UDP or SCTP packets (as told by protocol) from or to the
+// given port, or fall through to the next instruction.
+void compilePortCheck(SocketFilterProgram &p,
+                      NetworkLib::IPv4Protocol::Type protocol,
+                      NetworkLib::Port::Number port) {
+    const auto checkSrc = p.makeLabel();
+    const auto checkDst = p.makeLabel();
+    const auto accept = p.makeLabel();
+    const auto next = p.makeLabel();
+
+    p.loadIndexFromScratch(l3OffsetSlot);
+    p.loadByteIndirect(ipv4Protocol);
+    p.jumpIfEqual(protocol, checkSrc, next);
+
+    p.bindLabel(checkSrc);
+    compilePortsBoundsCheck(p, next);
+    p.loadIndexFromScratch(l4OffsetSlot);
+    p.loadHalfWordIndirect(l4SrcPort);
+    p.jumpIfEqual(port, accept, checkDst);
+
+    p.bindLabel(checkDst);
+    p.loadHalfWordIndirect(l4DstPort);
+    p.jumpIfEqual(port, accept, next);
+
+    p.bindLabel(accept);
+    p.returnValue(SocketFilterProgram::acceptFrame);
+
+    p.bindLabel(next);
+}
+
+// Accept packets matched by the rule, or fall through to the next
+// instruction. It mirrors RuleMatcher::match().
+void compileRule(SocketFilterProgram &p, const MatchingRule &rule) {
+    const bool hasPort = (rule.dstPort != NetworkLib::Port::Invalid);
+
+    if (hasPort && (rule.protocol != NetworkLib::IPv4Protocol::NONE) &&
+        (rule.protocol != NetworkLib::IPv4Protocol::TCP) &&
+        (rule.protocol != NetworkLib::IPv4Protocol::UDP) &&
+        (rule.protocol != NetworkLib::IPv4Protocol::SCTP)) {
+        // A port with a protocol without ports never matches.
+        return;
+    }
+
+    const auto next = p.makeLabel();
+    const unsigned int maskBits = rule.dstCidr.getMaskBits();
+
+    if ((rule.protocol != NetworkLib::IPv4Protocol::NONE) || hasPort ||
+        (maskBits > 0)) {
+        p.loadIndexFromScratch(l3OffsetSlot);
+    }
+
+    if (rule.protocol != NetworkLib::IPv4Protocol::NONE) {
+        const auto protocolOk = p.makeLabel();
+        p.loadByteIndirect(ipv4Protocol);
+        p.jumpIfEqual(rule.protocol, protocolOk, next);
+        p.bindLabel(protocolOk);
+    } else if (hasPort) {
+        // Any protocol with ports will do.
+        const auto protocolOk = p.makeLabel();
+        const auto notTCP = p.makeLabel();
+        const auto notUDP = p.makeLabel();
+        p.loadByteIndirect(ipv4Protocol);
+        p.jumpIfEqual(NetworkLib::IPv4Protocol::TCP, protocolOk, notTCP);
+        p.bindLabel(notTCP);
+        p.jumpIfEqual(NetworkLib::IPv4Protocol::UDP, protocolOk, notUDP);
+        p.bindLabel(notUDP);
+        p.jumpIfEqual(NetworkLib::IPv4Protocol::SCTP, protocolOk, next);
+        p.bindLabel(protocolOk);
+    }
+
+    if (maskBits > 0) {
+        const auto addressOk = p.makeLabel();
+        p.loadWordIndirect(ipv4DstAddress);
+
+        if (maskBits < 32) {
+            p.andValue(maskFromBits(maskBits));
+        }
+
+        p.jumpIfEqual(static_cast<std::uint32_t>(rule.dstCidr.getAddress()),
+                      addressOk, next);
+        p.bindLabel(addressOk);
+    }
+
+    if (hasPort) {
+        const auto portOk = p.makeLabel();
+        compilePortsBoundsCheck(p, next);
+        p.loadIndexFromScratch(l4OffsetSlot);
+        p.loadHalfWordIndirect(l4DstPort);
+        p.jumpIfEqual(rule.dstPort, portOk, next);
+        p.bindLabel(portOk);
+    }
+
+    p.returnValue(SocketFilterProgram::acceptFrame);
+
+    p.bindLabel(next);
+}
+
+} // namespace
+
+RawSocketsUtil::SocketFilterProgram
+compileSocketFilter(const RuleMatcher &ruleMatcher,
+                    const RuleFilterConfig &config) {
+    SocketFilterProgram p;
+
+    const auto untagged = p.makeLabel();
+    const auto notIPv4Untagged = p.makeLabel();
+    const auto notVLAN = p.makeLabel();
+    const auto tagged = p.makeLabel();
+    const auto oneTag = p.makeLabel();
+    const auto notIPv4OneTag = p.makeLabel();
+    const auto innerTag = p.makeLabel();
+    const auto twoTags = p.makeLabel();
+    const auto notIPv4 = p.makeLabel();
+    const auto ipv4 = p.makeLabel();
+
+    // Find the IPv4 header, skipping up to two 802.1Q/802.1ad tags,
+    // and store its offset.
+    p.loadHalfWord(12);
+    p.jumpIfEqual(NetworkLib::EtherType::IPv4, untagged, notIPv4Untagged);
+    p.bindLabel(notIPv4Untagged);
+    p.jumpIfEqual(etherTypeVLAN, tagged, notVLAN);
+    p.bindLabel(notVLAN);
+    p.jumpIfEqual(etherTypeQinQ, tagged, notIPv4);
+
+    p.bindLabel(tagged);
+    p.loadHalfWord(16);
+    p.jumpIfEqual(NetworkLib::EtherType::IPv4, oneTag, notIPv4OneTag);
+    p.bindLabel(notIPv4OneTag);
+    p.jumpIfEqual(etherTypeVLAN, innerTag, notIPv4);
+
+    p.bindLabel(innerTag);
+    p.loadHalfWord(20);
+    p.jumpIfEqual(NetworkLib::EtherType::IPv4, twoTags, notIPv4);
+
+    p.bindLabel(notIPv4);
+    p.returnValue(config.acceptNonIPv4 ? SocketFilterProgram::acceptFrame
+                                       : SocketFilterProgram::rejectFrame);
+
+    p.bindLabel(untagged);
+    p.loadValue(14);
+    p.jump(ipv4);
+
+    p.bindLabel(oneTag);
+    p.loadValue(18);
+    p.jump(ipv4);
+
+    p.bindLabel(twoTags);
+    p.loadValue(22);
+
+    p.bindLabel(ipv4);
+    p.storeScratch(l3OffsetSlot);
+
+    // Fragments other than the first one carry no ports.
+    const auto accept = p.makeLabel();
+    const auto firstFragment = p.makeLabel();
+    p.loadIndexFromScratch(l3OffsetSlot);
+    p.loadHalfWordIndirect(ipv4FlagsAndFragmentOffset);
+    p.jumpIfAnySet(0x1FFF, accept, firstFragment);
+
+    p.bindLabel(accept);
+    p.returnValue(SocketFilterProgram::acceptFrame);
+
+    // Offset of the header after IPv4 = IPv4 offset + 4 * IHL
+    p.bindLabel(firstFragment);
+    p.loadByteIndirect(0);
+    p.andValue(0x0F);
+    p.shiftLeft(2);
+    p.addIndex();
+    p.storeScratch(l4OffsetSlot);
+    p.addValue(l4PortsEnd);
+    p.storeScratch(l4PortsEndSlot);
+
+    if (config.acceptGTPv1U) {
+        compilePortCheck(p, NetworkLib::IPv4Protocol::UDP,
+                         NetworkLib::Port::GTPv1U);
+    }
+
+    if (config.acceptS1AP) {
+        compilePortCheck(p, NetworkLib::IPv4Protocol::SCTP,
+                         NetworkLib::Port::S1AP);
+    }
+
+    for (const auto &rule : ruleMatcher.getRules()) {
+        compileRule(p, rule);
+    }
+
+    p.returnValue(SocketFilterProgram::rejectFrame);
+
+    return p;
+}
+
+} // namespace UPFRouterLib
+} // namespace UPF
@@ -15,7 +15,15 @@ bool S1APProcessor::chainOnProcessSCTP_DataChunk(
         return true;
 
     } else if (ctx.sctpDataChunkDecoder->isS1AP()) {
-        S1APLib::S1APDecoder s1apDecoder(ctx.sctpDataChunkDecoder->getData());
+        NetworkLib::DecodeStatus status;
+        S1APLib::S1APDecoder s1apDecoder(ctx.sctpDataChunkDecoder->getData(),
+                                         status);
+
+        if (status != NetworkLib::DecodeStatus::Ok) {
+            countDrop(status);
+            return false;
+        }
+
         Context s1apContext(ctx, &s1apDecoder);
         auto f =
             NetworkLib::finally([&] { s1apContext.s1apDecoder = nullptr; });
@@ -19,6 +19,21 @@ namespace UPF {
 namespace S1APLib {
 S1APDecoder::S1APDecoder(const NetworkLib::BufferView &s1apData)
     : mBufferView(s1apData), mPDU(nullptr) {
+    if (!decode()) {
+        std::ostringstream err;
+        err << NETWORKLIB_CURRENT_FUNCTION << ": error decoding S1AP PDU";
+        throw std::runtime_error(err.str());
+    }
+}
+
+S1APDecoder::S1APDecoder(const NetworkLib::BufferView &s1apData,
+                         NetworkLib::DecodeStatus &status) noexcept
+    : mBufferView(s1apData), mPDU(nullptr) {
+    status = decode() ? NetworkLib::DecodeStatus::Ok
+                      : NetworkLib::DecodeStatus::S1APBadPDU;
+}
+
+bool S1APDecoder::decode() noexcept {
     asn_dec_rval_t decodeRC = {RC_OK, 0};
 
     // Try to decode the buffer
@@ -33,10 +48,10 @@ S1APDecoder::S1APDecoder(const NetworkLib::BufferView &s1apData)
             mPDU = nullptr;
         }
 
-        std::ostringstream err;
-        err << NETWORKLIB_CURRENT_FUNCTION << ": error decoding S1AP PDU";
-        throw std::runtime_error(err.str());
+        return false;
     }
+
+    return true;
 }
 
 S1APDecoder::~S1APDecoder() {
@@ -0,0 +1,117 @@
+// Benchmark of the checksum kernels, per size class: sum16() (with
+// whatever SIMD implementation it picked) against sum16Scalar(), and
+// crc32c() against crc32cSoftware().
+//
+// Usage: checksumbench [milliseconds per measure]
+
+#include <upfnetworklib/checksum.hh>
+
+// For std::chrono::steady_clock
+#include <chrono>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint32_t
+#include <cstdint>
+
+// For std::atoi()
+#include <cstdlib>
+
+// For std::cout
+#include <iostream>
+
+// For std::setw() and std::setprecision()
+#include <iomanip>
+
+// For std::vector
+#include <vector>
+
+using namespace UPF::NetworkLib;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keep results alive, so calls aren't optimized away.
+volatile std::uint32_t sink;
+
+// Return the nanoseconds per call of f(data, size), calling it for
+// about the given time.
+template <typename F>
+double measure(F f, const unsigned char *data, std::size_t size,
+               std::chrono::milliseconds duration) {
+    std::size_t calls = 0;
+    std::uint32_t result = 0;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point now;
+
+    do {
+        for (int i = 0; i < 64; ++i) {
+            result += f(data, size);
+        }
+
+        calls += 64;
+        now = Clock::now();
+    } while (now - start < duration);
+
+    sink = result;
+
+    return std::chrono::duration<double, std::nano>(now - start).count() /
+           static_cast<double>(calls);
+}
+
+void printRow(std::size_t size, double fast, double slow) {
+    std::cout << std::setw(7) << size << std::fixed << std::setprecision(1)
+              << std::setw(12) << fast << std::setw(12) << slow
+              << std::setw(10) << (static_cast<double>(size) / fast)
+              << std::setw(9) << (slow / fast) << "x\n";
+}
+
+void printHeader(const char *name, const char *fast, const char *slow) {
+    std::cout << '\n'
+              << name << " (ns/call, GB/s and speed-up of " << fast << ")\n"
+              << std::setw(7) << "size" << std::setw(12) << fast
+              << std::setw(12) << slow << std::setw(10) << "GB/s"
+              << std::setw(10) << "speed-up\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1])
+                                                      : 200);
+
+    // Size classes: minimum frame, small packets, usual MTU, jumbo
+    // frame and GSO super-packet.
+    const std::size_t sizes[] = {20, 64, 128, 256, 576, 1500, 9000, 65535};
+
+    std::vector<unsigned char> buffer(65536);
+    for (std::size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = static_cast<unsigned char>(i * 7 + 3);
+    }
+
+    printHeader("sum16", getSum16Implementation(), "scalar");
+    for (std::size_t size : sizes) {
+        printRow(size,
+                 measure([](const unsigned char *d,
+                            std::size_t s) { return sum16(d, s); },
+                         buffer.data(), size, duration),
+                 measure([](const unsigned char *d,
+                            std::size_t s) { return sum16Scalar(d, s); },
+                         buffer.data(), size, duration));
+    }
+
+    printHeader("crc32c", getCRC32cImplementation(), "software");
+    for (std::size_t size : sizes) {
+        printRow(size,
+                 measure([](const unsigned char *d,
+                            std::size_t s) { return crc32c(d, s); },
+                         buffer.data(), size, duration),
+                 measure([](const unsigned char *d,
+                            std::size_t s) { return crc32cSoftware(d, s); },
+                         buffer.data(), size, duration));
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Randomized validation of the checksum kernels: sum16() (whatever
+// SIMD implementation it picked) against sum16Scalar(), incremental
+// updates against recomputing, and crc32c() against crc32cSoftware().
+
+#include <upfnetworklib/checksum.hh>
+
+#include "testutils.hh"
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint16_t and std::uint32_t
+#include <cstdint>
+
+// For std::cout
+#include <iostream>
+
+// For std::mt19937
+#include <random>
+
+// For std::vector
+#include <vector>
+
+using namespace UPF::NetworkLib;
+
+namespace {
+
+std::mt19937 rng(20240601);
+
+unsigned int randomInt(unsigned int max) {
+    return std::uniform_int_distribution<unsigned int>(0, max)(rng);
+}
+
+void fillRandom(std::vector<unsigned char> &data) {
+    for (auto &b : data) {
+        b = static_cast<unsigned char>(randomInt(255));
+    }
+}
+
+// sum16() must give exactly the same (unfolded) sum as the scalar
+// implementation, for any size and alignment.
+void checkSum16() {
+    // Room for any size at any misalignment, filled with random data.
+    std::vector<unsigned char> buffer(66000 + 128);
+    fillRandom(buffer);
+
+    // Every size up to a few SIMD blocks, at every alignment within a
+    // cache line...
+    for (std::size_t size = 0; size <= 512; ++size) {
+        for (std::size_t offset = 0; offset < 64; ++offset) {
+            const unsigned char *data = buffer.data() + offset;
+            UPFTEST_CHECK_MSG(sum16(data, size) == sum16Scalar(data, size),
+                              "size " << size << ", offset " << offset);
+        }
+    }
+
+    // ...then random sizes up to a GSO super-packet.
+    for (int i = 0; i < 2000; ++i) {
+        const std::size_t size = randomInt(66000);
+        const std::size_t offset = randomInt(127);
+        const unsigned char *data = buffer.data() + offset;
+        UPFTEST_CHECK_MSG(sum16(data, size) == sum16Scalar(data, size),
+                          "size " << size << ", offset " << offset);
+    }
+
+    // All 0xFF bytes: the largest possible partial sums.
+    std::vector<unsigned char> ones(66000, 0xFF);
+    for (std::size_t size : {63u, 64u, 65u, 1500u, 9000u, 65535u, 66000u}) {
+        UPFTEST_CHECK_MSG(sum16(ones.data(), size) ==
+                              sum16Scalar(ones.data(), size),
+                          "all ones, size " << size);
+    }
+}
+
+// A checksum updated via updateChecksum16()/updateChecksum32() must
+// still verify (i.e. the data, checksum included, must sum to 0xFFFF).
+void checkUpdates() {
+    for (int i = 0; i < 10000; ++i) {
+        std::vector<unsigned char> data(2 * (2 + randomInt(200)));
+        fillRandom(data);
+
+        // The checksum goes in the first two bytes.
+        data[0] = data[1] = 0;
+        const std::uint16_t checksum = static_cast<std::uint16_t>(
+            ~foldSum16(sum16Scalar(data.data(), data.size())));
+        data[0] = static_cast<unsigned char>(checksum >> 8);
+        data[1] = static_cast<unsigned char>(checksum);
+
+        // Change a 16-bit field...
+        const std::size_t at16 = 2 + 2 * randomInt(data.size() / 2 - 2);
+        const std::uint16_t old16 =
+            static_cast<std::uint16_t>((data[at16] << 8) | data[at16 + 1]);
+        const std::uint16_t new16 =
+            static_cast<std::uint16_t>(randomInt(65535));
+        data[at16] = static_cast<unsigned char>(new16 >> 8);
+        data[at16 + 1] = static_cast<unsigned char>(new16);
+
+        std::uint16_t updated = updateChecksum16(checksum, old16, new16);
+        data[0] = static_cast<unsigned char>(updated >> 8);
+        data[1] = static_cast<unsigned char>(updated);
+
+        UPFTEST_CHECK_MSG(foldSum16(sum16(data.data(), data.size())) == 0xFFFF,
+                          "16-bit update, size " << data.size());
+
+        // ...then a 32-bit one.
+        if (data.size() < 6) {
+            continue;
+        }
+
+        const std::size_t at32 = 2 + 2 * randomInt(data.size() / 2 - 3);
+        std::uint32_t old32 = 0;
+        for (std::size_t j = 0; j < 4; ++j) {
+            old32 = (old32 << 8) | data[at32 + j];
+        }
+        const std::uint32_t new32 = static_cast<std::uint32_t>(rng());
+        for (std::size_t j = 0; j < 4; ++j) {
+            data[at32 + j] = static_cast<unsigned char>(new32 >> (24 - 8 * j));
+        }
+
+        updated = updateChecksum32(updated, old32, new32);
+        data[0] = static_cast<unsigned char>(updated >> 8);
+        data[1] = static_cast<unsigned char>(updated);
+
+        UPFTEST_CHECK_MSG(foldSum16(sum16(data.data(), data.size())) == 0xFFFF,
+                          "32-bit update, size " << data.size());
+    }
+}
+
+void checkCRC32c() {
+    // RFC 3720, B.4: 32 bytes of zeros.
+    const std::vector<unsigned char> zeros(32, 0);
+    UPFTEST_CHECK(crc32c(zeros.data(), zeros.size()) == 0x8A9136AA);
+    UPFTEST_CHECK(crc32cSoftware(zeros.data(), zeros.size()) == 0x8A9136AA);
+
+    std::vector<unsigned char> buffer(9000 + 64);
+    fillRandom(buffer);
+
+    for (int i = 0; i < 2000; ++i) {
+        const std::size_t size = randomInt(9000);
+        const unsigned char *data = buffer.data() + randomInt(63);
+
+        UPFTEST_CHECK_MSG(crc32c(data, size) == crc32cSoftware(data, size),
+                          "size " << size);
+
+        // Piecewise, as SCTPDecoder does.
+        const std::size_t split = randomInt(static_cast<unsigned int>(size));
+        UPFTEST_CHECK_MSG(crc32c(data + split, size - split,
+                                 crc32c(data, split)) == crc32c(data, size),
+                          "size " << size << ", split " << split);
+    }
+}
+
+} // namespace
+
+int main() {
+    std::cout << "sum16: " << getSum16Implementation()
+              << ", crc32c: " << getCRC32cImplementation() << '\n';
+
+    checkSum16();
+    checkUpdates();
+    checkCRC32c();
+
+    return UPFTest::testResult("checksumtest");
+}
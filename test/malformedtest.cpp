@@ -0,0 +1,292 @@
+// Malformed frames must be dropped, and counted by reason: every
+// truncation of a Ethernet/IPv4/UDP/GTPv1-U frame and of a
+// Ethernet/IPv4/SCTP one, and frames broken at each layer, given to
+// both BasicEthPacketProcessor and EthPacketProcessor, one frame at a
+// time or in batches.
+//
+// UDP datagrams are only taken for GTPv1-U when they look like it
+// (see UDPDecoder::isGTPv1U()): others, e.g. with a truncated GTPv1-U
+// packet, are just UDP, and not dropped.
+
+#include <upfnetworklib/networklib.hh>
+
+#include "testutils.hh"
+
+// For std::size_t
+#include <cstddef>
+
+// For std::uint64_t
+#include <cstdint>
+
+// For std::string and std::to_string()
+#include <string>
+
+// For std::vector
+#include <vector>
+
+using namespace UPF::NetworkLib;
+
+namespace {
+
+using Bytes = std::vector<unsigned char>;
+
+constexpr std::size_t ethHeaderLength = 14;
+constexpr std::size_t ipv4HeaderLength = 20;
+constexpr std::size_t udpHeaderLength = 8;
+
+// An Ethernet frame carrying a IPv4 packet with the given payload.
+Bytes makeFrame(unsigned char protocol, const Bytes &payload) {
+    Bytes frame(12, 0x11);
+    frame.push_back(0x08);
+    frame.push_back(0x00);
+
+    Bytes ipv4 = {0x45, 0, 0,  0, 0, 0, 0, 0, 64, protocol,
+                  0,    0, 10, 0, 0, 1, 10, 0, 0,  2};
+    const std::size_t length = ipv4.size() + payload.size();
+    ipv4[2] = static_cast<unsigned char>(length >> 8);
+    ipv4[3] = static_cast<unsigned char>(length);
+
+    frame.insert(frame.end(), ipv4.begin(), ipv4.end());
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+// An Ethernet frame carrying the given GTPv1-U packet (by default, a
+// G-PDU carrying a IPv4/UDP packet).
+Bytes makeGTPv1UFrame(Bytes gtp = Bytes()) {
+    if (gtp.empty()) {
+        gtp = {0x30, 0xff, 0,  28, 0, 0, 0, 42, 0x45, 0, 0, 28, 0, 0,
+               0,    0,    64, 17, 0, 0, 10, 45, 0,    1, 8, 8,  8, 8,
+               0,    53,   0,  53, 0, 8, 0,  0};
+    }
+
+    Bytes udp = {0x12, 0x34, 0x08, 0x68, 0, 0, 0, 0};
+    udp.insert(udp.end(), gtp.begin(), gtp.end());
+    udp[5] = static_cast<unsigned char>(udp.size());
+    return makeFrame(17, udp);
+}
+
+// An Ethernet frame carrying a SCTP packet with a DATA chunk and a
+// INIT one (with no checksum: see enableSCTPChecksumVerification()).
+Bytes makeSCTPFrame() {
+    return makeFrame(132, {0, 1, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0,
+                           // DATA, 17 bytes and 3 of padding
+                           0, 3, 0, 17, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
+                           18, 1, 0, 0, 0,
+                           // INIT
+                           1, 0, 0, 4});
+}
+
+// Cut the frame to the given length, fixing the IPv4 total length, so
+// that what's truncated is the IPv4 payload, not the IPv4 packet.
+Bytes truncatePayload(Bytes frame, std::size_t length) {
+    frame.resize(length);
+
+    const std::size_t ipv4Length = length - ethHeaderLength;
+    frame[ethHeaderLength + 2] = static_cast<unsigned char>(ipv4Length >> 8);
+    frame[ethHeaderLength + 3] = static_cast<unsigned char>(ipv4Length);
+    return frame;
+}
+
+BufferView makeView(const Bytes &bytes) {
+    return BufferView::makeNonOwningBufferView(bytes.data(), bytes.size());
+}
+
+// A malformed frame, and why it must be dropped (DecodeStatus::Ok if
+// it must not be, as it's not what it seems).
+struct Case {
+    const char *name;
+    Bytes frame;
+    DecodeStatus reason;
+};
+
+// What the processors get to see past the point where malformed
+// frames must have been dropped.
+template <typename Derived>
+class CountingProcessor : public BasicEthPacketProcessor<Derived> {
+  public:
+    std::size_t delivered = 0;
+
+    bool processGTPv1U_IPv4(EthPacketContext &) {
+        ++delivered;
+        return true;
+    }
+
+    bool processSCTP_DataChunk(EthPacketContext &) {
+        ++delivered;
+        return true;
+    }
+};
+
+class CRTPProcessor : public CountingProcessor<CRTPProcessor> {};
+
+class VirtualProcessor : public EthPacketProcessor {
+  public:
+    std::size_t delivered = 0;
+
+  protected:
+    bool processGTPv1U_IPv4(Context &) override {
+        ++delivered;
+        return true;
+    }
+
+    bool processSCTP_DataChunk(Context &) override {
+        ++delivered;
+        return true;
+    }
+};
+
+// Feed the frame to a fresh processor, alone or along with a valid
+// one in a batch, and check that it's dropped for the given reason
+// (and that it doesn't get any further anyway).
+template <typename Processor>
+void checkDropped(const char *processorName, const std::string &name,
+                  const Bytes &frame, DecodeStatus reason,
+                  bool verifySCTPChecksum, const Bytes &validFrame) {
+    const BufferView frames[] = {makeView(validFrame), makeView(frame),
+                                 makeView(validFrame)};
+
+    for (const bool batches : {false, true}) {
+        Processor processor;
+        processor.enableSCTPChecksumVerification(verifySCTPChecksum);
+
+        if (batches) {
+            processor.consumeEthPackets(frames, 3);
+        } else {
+            processor.consumeEthPacket(frames[1]);
+        }
+
+        const DropCounters &drops = processor.getDropCounters();
+        const char *mode = batches ? "batches" : "single frames";
+
+        const std::uint64_t expected = (reason == DecodeStatus::Ok) ? 0 : 1;
+
+        UPFTEST_CHECK_MSG(reason == DecodeStatus::Ok ||
+                              drops.get(reason) == 1,
+                          processorName << ", " << mode << ", " << name);
+        UPFTEST_CHECK_MSG(drops.total() == expected,
+                          processorName << ", " << mode << ", " << name);
+        UPFTEST_CHECK_MSG(processor.delivered == (batches ? 2u : 0u),
+                          processorName << ", " << mode << ", " << name);
+    }
+}
+
+template <typename Processor>
+void checkProcessor(const char *processorName, const std::vector<Case> &cases,
+                    const Bytes &gtpFrame, const Bytes &sctpFrame) {
+    // Every truncation of the valid frames: too short for the
+    // Ethernet header, then for the IPv4 header, then shorter than
+    // the IPv4 total length.
+    for (const Bytes *validFrame : {&gtpFrame, &sctpFrame}) {
+        for (std::size_t length = 0; length < validFrame->size(); ++length) {
+            const Bytes frame(validFrame->begin(),
+                              validFrame->begin() + length);
+            const DecodeStatus reason =
+                (length < ethHeaderLength)
+                    ? DecodeStatus::EthFrameTooShort
+                    : (length < ethHeaderLength + ipv4HeaderLength)
+                          ? DecodeStatus::IPv4TooShort
+                          : DecodeStatus::IPv4BadLength;
+
+            checkDropped<Processor>(
+                processorName,
+                "frame truncated to " + std::to_string(length) + " bytes",
+                frame, reason, false, *validFrame);
+        }
+    }
+
+    for (const Case &c : cases) {
+        checkDropped<Processor>(processorName, c.name, c.frame, c.reason,
+                                c.reason == DecodeStatus::SCTPBadChecksum,
+                                gtpFrame);
+    }
+
+    // And valid frames go through.
+    Processor processor;
+    processor.consumeEthPacket(makeView(gtpFrame));
+    processor.consumeEthPacket(makeView(sctpFrame));
+
+    UPFTEST_CHECK_MSG(processor.getDropCounters().total() == 0,
+                      processorName);
+    UPFTEST_CHECK_MSG(processor.delivered == 2, processorName);
+}
+
+} // namespace
+
+int main() {
+    const Bytes gtpFrame = makeGTPv1UFrame();
+    const Bytes sctpFrame = makeSCTPFrame();
+
+    const std::size_t l4Offset = ethHeaderLength + ipv4HeaderLength;
+    const std::size_t gtpv1uOffset = l4Offset + udpHeaderLength;
+
+    std::vector<Case> cases;
+
+    // 802.1Q tag up to the end of the frame
+    Bytes frame(16, 0x11);
+    frame[12] = 0x81;
+    frame[13] = 0x00;
+    cases.push_back({"802.1Q tag with no EtherType", frame,
+                     DecodeStatus::EthMissingEtherType});
+
+    frame = gtpFrame;
+    frame[ethHeaderLength] = 0x65;
+    cases.push_back({"IPv4 version 6", frame, DecodeStatus::IPv4BadVersion});
+
+    cases.push_back({"truncated UDP header",
+                     truncatePayload(gtpFrame, l4Offset + 4),
+                     DecodeStatus::UDPTooShort});
+
+    cases.push_back({"truncated TCP header",
+                     makeFrame(6, {0x12, 0x34, 0, 80, 0, 0, 0, 1, 0, 0}),
+                     DecodeStatus::TCPTooShort});
+
+    // Only 2 bytes of the 4 of the optional fields.
+    cases.push_back({"truncated GTPv1-U optional fields",
+                     makeGTPv1UFrame({0x32, 0xff, 0, 2, 0, 0, 0, 42, 0, 0}),
+                     DecodeStatus::GTPv1UTooShort});
+
+    // An extension header of 8 bytes, of which only 4 are there.
+    cases.push_back(
+        {"truncated GTPv1-U extension header",
+         makeGTPv1UFrame({0x34, 0xff, 0, 8, 0, 0, 0, 42, 0, 0, 0, 0x85, 2,
+                          0xaa, 0xbb, 0xcc}),
+         DecodeStatus::GTPv1UBadExtensionHeader});
+
+    // Not GTPv1-U, as far as UDPDecoder::isGTPv1U() is concerned.
+    cases.push_back({"truncated GTPv1-U header",
+                     truncatePayload(gtpFrame, gtpv1uOffset + 4),
+                     DecodeStatus::Ok});
+
+    frame = gtpFrame;
+    frame[gtpv1uOffset] = 0x48;
+    cases.push_back({"GTPv2", frame, DecodeStatus::Ok});
+
+    cases.push_back({"truncated T-PDU",
+                     truncatePayload(gtpFrame, gtpFrame.size() - 10),
+                     DecodeStatus::Ok});
+
+    cases.push_back({"truncated SCTP header",
+                     truncatePayload(sctpFrame, l4Offset + 8),
+                     DecodeStatus::SCTPTooShort});
+
+    cases.push_back({"wrong SCTP checksum", sctpFrame,
+                     DecodeStatus::SCTPBadChecksum});
+
+    cases.push_back({"truncated SCTP chunk",
+                     truncatePayload(sctpFrame, sctpFrame.size() - 2),
+                     DecodeStatus::SCTPBadChunk});
+
+    // A DATA chunk of 8 bytes, shorter than its own header.
+    cases.push_back({"truncated SCTP DATA chunk header",
+                     makeFrame(132, {0, 1, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0, 0,
+                                     3, 0, 8, 0, 0, 0, 1}),
+                     DecodeStatus::SCTPDataChunkTooShort});
+
+    checkProcessor<CRTPProcessor>("BasicEthPacketProcessor", cases, gtpFrame,
+                                  sctpFrame);
+    checkProcessor<VirtualProcessor>("EthPacketProcessor", cases, gtpFrame,
+                                     sctpFrame);
+
+    return UPFTest::testResult("malformedtest");
+}
@@ -0,0 +1,296 @@
+// Decoding packets must not allocate: walking GTPv1-U extension
+// headers and SCTP chunks, via either decoder constructor, and through
+// both BasicEthPacketProcessor and EthPacketProcessor, one frame at a
+// time or in batches. Global operator new is replaced to count
+// allocations.
+
+#include <upfnetworklib/networklib.hh>
+
+#include "testutils.hh"
+
+// For std::size_t
+#include <cstddef>
+
+// For std::malloc and std::free
+#include <cstdlib>
+
+// For std::cout
+#include <iostream>
+
+// For std::bad_alloc
+#include <new>
+
+// For std::vector
+#include <vector>
+
+using namespace UPF::NetworkLib;
+
+namespace {
+
+std::size_t allocations = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    ++allocations;
+
+    void *p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Bytes = std::vector<unsigned char>;
+
+// How many times each packet is decoded, once warmed up.
+constexpr int rounds = 1000;
+
+// A GTPv1-U header with two extension headers (of 4 and 8 bytes),
+// carrying a IPv4/UDP packet.
+Bytes makeGTPv1U() {
+    Bytes gtp = {0x34, 0xff, 0,    0,    0,    0,    0,    42,
+                 0,    0,    0,    0x85, 1,    0xaa, 0xbb, 0xc0,
+                 2,    1,    2,    3,    4,    5,    6,    0};
+    const Bytes inner = {0x45, 0, 0, 28, 0, 0, 0, 0, 64, 17, 0, 0, 10, 0,
+                         0,    1, 10, 0, 0, 2, 0, 1, 0,  2,  0, 8, 0,  0};
+
+    gtp.insert(gtp.end(), inner.begin(), inner.end());
+    gtp[3] = static_cast<unsigned char>(gtp.size() - 8);
+    return gtp;
+}
+
+// A SCTP packet with three chunks: DATA (padded), INIT and DATA.
+Bytes makeSCTP() {
+    return {0, 1, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0,
+            // DATA, 17 bytes and 3 of padding
+            0, 3, 0, 17, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 18, 1, 0, 0, 0,
+            // INIT
+            1, 0, 0, 4,
+            // DATA
+            0, 3, 0, 16, 0, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 18};
+}
+
+// An Ethernet frame carrying a IPv4 packet with the given payload.
+Bytes makeFrame(unsigned char protocol, const Bytes &payload) {
+    Bytes frame(12, 0x11);
+    frame.push_back(0x08);
+    frame.push_back(0x00);
+
+    Bytes ipv4 = {0x45, 0, 0,  0, 0, 0, 0, 0, 64, protocol,
+                  0,    0, 10, 0, 0, 1, 10, 0, 0,  2};
+    const std::size_t length = ipv4.size() + payload.size();
+    ipv4[2] = static_cast<unsigned char>(length >> 8);
+    ipv4[3] = static_cast<unsigned char>(length);
+
+    frame.insert(frame.end(), ipv4.begin(), ipv4.end());
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+// An Ethernet frame carrying GTPv1-U over UDP.
+Bytes makeGTPv1UFrame(const Bytes &gtp) {
+    Bytes udp = {0x12, 0x34, 0x08, 0x68, 0, 0, 0, 0};
+    udp.insert(udp.end(), gtp.begin(), gtp.end());
+    udp[5] = static_cast<unsigned char>(udp.size());
+    return makeFrame(17, udp);
+}
+
+BufferView makeView(Bytes &bytes) {
+    return BufferView::makeNonOwningBufferView(bytes.data(), bytes.size());
+}
+
+// What the processors get to see, so we know packets were decoded
+// all the way.
+struct Counts {
+    std::size_t extensionHeaderBytes = 0;
+    std::size_t tunneledIPv4 = 0;
+    std::size_t chunks = 0;
+    std::size_t dataChunks = 0;
+};
+
+void countExtensionHeaders(Counts &counts, const EthPacketContext &context) {
+    for (const BufferView &header :
+         context.gtpv1uDecoder->getExtensionHeaders()) {
+        counts.extensionHeaderBytes += header.size();
+    }
+}
+
+template <typename Derived>
+class CountingProcessor : public BasicEthPacketProcessor<Derived> {
+  public:
+    Counts counts;
+
+    bool processGTPv1U(EthPacketContext &context) {
+        countExtensionHeaders(counts, context);
+        return true;
+    }
+
+    bool processGTPv1U_IPv4(EthPacketContext &) {
+        ++counts.tunneledIPv4;
+        return true;
+    }
+
+    bool processSCTP_GenericChunk(EthPacketContext &) {
+        ++counts.chunks;
+        return true;
+    }
+
+    bool processSCTP_DataChunk(EthPacketContext &) {
+        ++counts.dataChunks;
+        return true;
+    }
+};
+
+class CRTPProcessor : public CountingProcessor<CRTPProcessor> {};
+
+// The same, with a batch method: single frames are then processed as
+// batches of one.
+class BatchingProcessor : public CountingProcessor<BatchingProcessor> {
+  public:
+    std::size_t ethBatches = 0;
+
+    void processEthBatch(Batch &batch) {
+        ++ethBatches;
+        CountingProcessor::processEthBatch(batch);
+    }
+};
+
+class VirtualProcessor : public EthPacketProcessor {
+  public:
+    Counts counts;
+
+  protected:
+    bool processGTPv1U(Context &context) override {
+        countExtensionHeaders(counts, context);
+        return true;
+    }
+
+    bool processGTPv1U_IPv4(Context &) override {
+        ++counts.tunneledIPv4;
+        return true;
+    }
+
+    bool processSCTP_GenericChunk(Context &) override {
+        ++counts.chunks;
+        return true;
+    }
+
+    bool processSCTP_DataChunk(Context &) override {
+        ++counts.dataChunks;
+        return true;
+    }
+};
+
+// Walk the extension headers and the chunks via the decoders, with
+// both constructors.
+void checkDecoders(const BufferView &gtp, const BufferView &sctp) {
+    std::size_t extensionHeaders = 0;
+    std::size_t chunks = 0;
+
+    const std::size_t before = allocations;
+
+    for (int i = 0; i < rounds; ++i) {
+        DecodeStatus status;
+
+        const GTPv1UDecoder gtpDecoder(gtp, status);
+        UPFTEST_CHECK(status == DecodeStatus::Ok);
+        for (const BufferView &header : gtpDecoder.getExtensionHeaders()) {
+            UPFTEST_CHECK(header.size() > 0);
+            ++extensionHeaders;
+        }
+
+        const GTPv1UDecoder throwingGTPDecoder(gtp);
+        extensionHeaders += throwingGTPDecoder.getExtensionHeaders().size();
+
+        const SCTPDecoder sctpDecoder(sctp, status);
+        UPFTEST_CHECK(status == DecodeStatus::Ok);
+        for (const SCTPGenericChunkDecoder &chunk : sctpDecoder.chunks()) {
+            UPFTEST_CHECK(chunk.getTotalLengthBytes() > 0);
+            ++chunks;
+        }
+
+        const SCTPDecoder throwingSCTPDecoder(sctp);
+        chunks += throwingSCTPDecoder.chunks().size();
+    }
+
+    UPFTEST_CHECK_MSG(allocations == before,
+                      allocations - before << " allocation(s)");
+    UPFTEST_CHECK(extensionHeaders == 4 * rounds);
+    UPFTEST_CHECK(chunks == 6 * rounds);
+}
+
+// Feed the frames to a processor, one at a time then in batches.
+template <typename Processor>
+void checkProcessor(const char *name, const BufferView *frames,
+                    std::size_t count) {
+    Processor processor;
+    ContextUserData userData;
+
+    // Warm up: anything allocated once (e.g. on first use) is fine.
+    processor.consumeEthPackets(frames, count, userData);
+    processor.counts = Counts();
+
+    std::size_t before = allocations;
+
+    for (int i = 0; i < rounds; ++i) {
+        for (std::size_t j = 0; j < count; ++j) {
+            processor.consumeEthPacket(frames[j], userData);
+        }
+    }
+
+    UPFTEST_CHECK_MSG(allocations == before, name << ", single frames: "
+                                                  << allocations - before
+                                                  << " allocation(s)");
+
+    before = allocations;
+
+    for (int i = 0; i < rounds; ++i) {
+        processor.consumeEthPackets(frames, count, userData);
+    }
+
+    UPFTEST_CHECK_MSG(allocations == before, name << ", batches: "
+                                                  << allocations - before
+                                                  << " allocation(s)");
+
+    // Twice (single frames, then batches) each GTPv1-U frame, with 12
+    // bytes of extension headers, and the SCTP one, with two DATA
+    // chunks and a INIT one.
+    const Counts &counts = processor.counts;
+    UPFTEST_CHECK_MSG(counts.extensionHeaderBytes == 2 * 2 * 12 * rounds,
+                      name);
+    UPFTEST_CHECK_MSG(counts.tunneledIPv4 == 2 * 2 * rounds, name);
+    UPFTEST_CHECK_MSG(counts.chunks == 2 * 3 * rounds, name);
+    UPFTEST_CHECK_MSG(counts.dataChunks == 2 * 2 * rounds, name);
+    UPFTEST_CHECK_MSG(processor.getDropCounters().total() == 0, name);
+}
+
+} // namespace
+
+int main() {
+    Bytes gtp = makeGTPv1U();
+    Bytes sctp = makeSCTP();
+    Bytes gtpFrame = makeGTPv1UFrame(gtp);
+    Bytes sctpFrame = makeFrame(132, sctp);
+
+    const BufferView frames[] = {makeView(gtpFrame), makeView(sctpFrame),
+                                 makeView(gtpFrame)};
+    const std::size_t frameCount = sizeof(frames) / sizeof(frames[0]);
+
+    checkDecoders(makeView(gtp), makeView(sctp));
+    checkProcessor<CRTPProcessor>("BasicEthPacketProcessor", frames,
+                                  frameCount);
+    checkProcessor<VirtualProcessor>("EthPacketProcessor", frames,
+                                     frameCount);
+    checkProcessor<BatchingProcessor>(
+        "BasicEthPacketProcessor with batch methods", frames, frameCount);
+
+    return UPFTest::testResult("noalloctest");
+}
@@ -0,0 +1,366 @@
+// Benchmark of GTP-U forwarding through the packet processors: the
+// IPv4 packet carried by each GTP-U frame is handed over to a
+// IPv4PacketSink. BasicEthPacketProcessor (methods looked up at
+// compile time) and EthPacketProcessor (virtual methods) are given
+// single frames and batches, and compared against a baseline
+// decoding frames as EthPacketProcessor did before batches: one at a
+// time, with throwing decoders.
+//
+// Frames are either few, and hot in cache, or many, and cold.
+//
+// Usage: processorbench [milliseconds per measure]
+
+#include <upfnetworklib/networklib.hh>
+
+// For std::min() and std::shuffle()
+#include <algorithm>
+
+// For std::chrono::steady_clock
+#include <chrono>
+
+// For std::size_t
+#include <cstddef>
+
+// For std::atoi()
+#include <cstdlib>
+
+// For std::memcpy()
+#include <cstring>
+
+// For std::cout
+#include <iostream>
+
+// For std::setw() and std::setprecision()
+#include <iomanip>
+
+// For std::mt19937
+#include <random>
+
+// For std::vector
+#include <vector>
+
+using namespace UPF::NetworkLib;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using Bytes = std::vector<unsigned char>;
+
+// Frames given to consumeEthPackets() at a time, as received by
+// e.g. RawSocketsUtil::RawSocket::receiveBatch().
+constexpr std::size_t batchSize = 32;
+
+// Where forwarded packets go: a virtual call per packet, as for
+// a real sink (e.g. GTPv1USocketEndpoint).
+class CountingSink : public IPv4PacketSink {
+  public:
+    std::size_t packets = 0;
+    std::size_t bytes = 0;
+
+    void consumeIPv4Packet(const BufferView &ipv4Data,
+                           ContextUserData &) override {
+        ++packets;
+        bytes += ipv4Data.size();
+    }
+};
+
+// What the processors below do with GTP-U frames.
+bool forward(IPv4PacketSink &sink, EthPacketContext &context) {
+    sink.consumeIPv4Packet(context.gtpv1uDecoder->getData(),
+                           context.userData);
+    return true;
+}
+
+} // namespace
+
+// The baseline: the decoding chain of EthPacketProcessor before
+// batches, down to GTP-U (i.e. what this benchmark needs), with
+// throwing decoders and the same virtual methods.
+//
+// Its methods are defined out of line, with external linkage, as they
+// were in the library: built with -fPIC, they're not inlined into
+// each other then, just like the ones of EthPacketProcessor.
+class BaselineProcessor : public EthPacketSink {
+  public:
+    using Context = EthPacketContext;
+
+    explicit BaselineProcessor(IPv4PacketSink &sink) : mSink(sink) {}
+
+    void consumeEthPacket(
+        const BufferView &ethData,
+        ContextUserData &userData = defaultContextUserData) override;
+
+  protected:
+    virtual bool processEth(Context &) { return true; }
+    virtual bool processIPv4(Context &) { return true; }
+    virtual bool processUDP(Context &) { return true; }
+    virtual bool processGTPv1U(Context &) { return true; }
+    virtual bool processNonIPv4(Context &) { return true; }
+
+    virtual bool processGTPv1U_IPv4(Context &context) {
+        return forward(mSink, context);
+    }
+
+    virtual bool chainOnProcessEth(Context &) { return true; }
+    virtual bool chainOnProcessIPv4(Context &) { return true; }
+    virtual bool chainOnProcessUDP(Context &) { return true; }
+    virtual bool chainOnProcessGTPv1U(Context &) { return true; }
+
+    virtual bool postProcessIPv4(Context &) { return true; }
+    virtual void finalProcess(Context &) {}
+
+  private:
+    IPv4PacketSink &mSink;
+
+    bool doProcessIPv4(const BufferView &ipv4Data, Context &context);
+    bool doProcessUDP(const BufferView &udpData, Context &context);
+};
+
+void BaselineProcessor::consumeEthPacket(const BufferView &ethData,
+                                         ContextUserData &userData) {
+    Context context;
+    context.userData = userData;
+    EthFrameDecoder ethFrameDecoder(ethData);
+    context.ethFrameDecoder = &ethFrameDecoder;
+
+    if (processEth(context)) {
+        if (chainOnProcessEth(context)) {
+            if (ethFrameDecoder.isIPv4()) {
+                if (doProcessIPv4(ethFrameDecoder.getData(), context)) {
+                    finalProcess(context);
+                }
+            } else if (processNonIPv4(context)) {
+                finalProcess(context);
+            }
+        }
+    }
+}
+
+bool BaselineProcessor::doProcessIPv4(const BufferView &ipv4Data,
+                                      Context &context) {
+    IPv4Decoder ipv4Decoder(ipv4Data);
+    context.ipv4Decoder = &ipv4Decoder;
+    auto f = finally([&] { context.ipv4Decoder = nullptr; });
+
+    bool doContinueProcessing = false;
+
+    if (processIPv4(context)) {
+        if (chainOnProcessIPv4(context)) {
+            doContinueProcessing =
+                !ipv4Decoder.isUDP() ||
+                doProcessUDP(ipv4Decoder.getData(), context);
+
+            if (doContinueProcessing && context.postProcessIPv4) {
+                doContinueProcessing = postProcessIPv4(context);
+            }
+        }
+    }
+
+    return doContinueProcessing;
+}
+
+bool BaselineProcessor::doProcessUDP(const BufferView &udpData,
+                                     Context &context) {
+    UDPDecoder udpDecoder(udpData);
+    context.udpDecoder = &udpDecoder;
+    auto f = finally([&] { context.udpDecoder = nullptr; });
+
+    if (!processUDP(context) || !chainOnProcessUDP(context)) {
+        return false;
+    }
+
+    if (!udpDecoder.isGTPv1U()) {
+        return true;
+    }
+
+    GTPv1UDecoder gtpv1uDecoder(udpDecoder.getData());
+    context.gtpv1uDecoder = &gtpv1uDecoder;
+    auto g = finally([&] { context.gtpv1uDecoder = nullptr; });
+
+    if (!processGTPv1U(context) || !chainOnProcessGTPv1U(context)) {
+        return false;
+    }
+
+    return !gtpv1uDecoder.isIPv4PDU() || processGTPv1U_IPv4(context);
+}
+
+namespace {
+
+class CRTPProcessor : public BasicEthPacketProcessor<CRTPProcessor> {
+  public:
+    explicit CRTPProcessor(IPv4PacketSink &sink) : mSink(sink) {}
+
+    bool processGTPv1U_IPv4(Context &context) {
+        return forward(mSink, context);
+    }
+
+  private:
+    IPv4PacketSink &mSink;
+};
+
+class VirtualProcessor : public EthPacketProcessor {
+  public:
+    explicit VirtualProcessor(IPv4PacketSink &sink) : mSink(sink) {}
+
+  protected:
+    bool processGTPv1U_IPv4(Context &context) override {
+        return forward(mSink, context);
+    }
+
+  private:
+    IPv4PacketSink &mSink;
+};
+
+// A Ethernet frame carrying GTP-U, carrying a IPv4/UDP packet with
+// 32 bytes of payload.
+Bytes makeGTPv1UFrame() {
+    Bytes frame(12, 0x11);
+    frame.push_back(0x08);
+    frame.push_back(0x00);
+
+    const Bytes inner = {0x45, 0, 0, 60, 0, 0, 0, 0, 64, 17, 0, 0, 10, 45,
+                         0,    1, 8, 8,  8, 8, 0, 53, 0, 53, 0, 40, 0, 0};
+    const Bytes gtp = {0x30, 0xff, 0, 60, 0, 0, 0, 42};
+    const Bytes udp = {0x08, 0x68, 0x08, 0x68, 0, 76, 0, 0};
+    const Bytes ipv4 = {0x45, 0,  0, 96, 0, 0, 0, 0, 64, 17,
+                        0,    0,  10, 0,  0, 1, 10, 0, 0,  2};
+
+    for (const Bytes *header : {&ipv4, &udp, &gtp, &inner}) {
+        frame.insert(frame.end(), header->begin(), header->end());
+    }
+
+    frame.resize(frame.size() + 32, 0x42);
+    return frame;
+}
+
+// Give the frames to the processor once, one at a time or in
+// batches.
+template <typename Processor>
+void consume(Processor &processor, const std::vector<BufferView> &frames,
+             bool batches) {
+    if (batches) {
+        for (std::size_t i = 0; i < frames.size(); i += batchSize) {
+            processor.consumeEthPackets(
+                &frames[i], std::min(batchSize, frames.size() - i));
+        }
+    } else {
+        for (const BufferView &frame : frames) {
+            processor.consumeEthPacket(frame);
+        }
+    }
+}
+
+// Return the nanoseconds per frame of giving the frames to the
+// processor, for about the given time: the best of rounds of at
+// least roundFrames frames, so that other load on the machine (which
+// can only make a round slower) doesn't count.
+template <typename Processor>
+double measure(Processor &processor, const std::vector<BufferView> &frames,
+               bool batches, std::chrono::milliseconds duration) {
+    constexpr std::size_t roundFrames = 4096;
+
+    const Clock::time_point start = Clock::now();
+    Clock::time_point now;
+    double best = 0;
+
+    do {
+        const Clock::time_point roundStart = Clock::now();
+        std::size_t count = 0;
+
+        do {
+            consume(processor, frames, batches);
+            count += frames.size();
+        } while (count < roundFrames);
+
+        now = Clock::now();
+
+        const double perFrame =
+            std::chrono::duration<double, std::nano>(now - roundStart)
+                .count() /
+            static_cast<double>(count);
+
+        if (best == 0 || perFrame < best) {
+            best = perFrame;
+        }
+    } while (now - start < duration);
+
+    return best;
+}
+
+void printRow(const char *name, double single, double batches,
+              double baseline) {
+    std::cout << std::setw(25) << name << std::fixed << std::setprecision(1)
+              << std::setw(10) << single << std::setw(8)
+              << (baseline / single) << 'x' << std::setw(10) << batches
+              << std::setw(8) << (baseline / batches) << "x\n";
+}
+
+template <typename Processor>
+void compare(const char *name, const std::vector<BufferView> &frames,
+             double baseline, std::chrono::milliseconds duration) {
+    CountingSink sink;
+    Processor processor(sink);
+
+    const double single = measure(processor, frames, false, duration);
+    const double batches = measure(processor, frames, true, duration);
+
+    printRow(name, single, batches, baseline);
+
+    if (sink.packets == 0 || processor.getDropCounters().total() != 0) {
+        std::cout << "  (frames weren't all forwarded!)\n";
+    }
+}
+
+void run(const char *name, const std::vector<BufferView> &frames,
+         std::chrono::milliseconds duration) {
+    CountingSink sink;
+    BaselineProcessor baselineProcessor(sink);
+    const double baseline =
+        measure(baselineProcessor, frames, false, duration);
+
+    std::cout << '\n'
+              << name << ", " << frames.size()
+              << " frames (ns/frame and speed-up of single frames and "
+                 "batches of "
+              << batchSize << ")\n";
+
+    printRow("baseline", baseline,
+             measure(baselineProcessor, frames, true, duration), baseline);
+    compare<CRTPProcessor>("BasicEthPacketProcessor", frames, baseline,
+                           duration);
+    compare<VirtualProcessor>("EthPacketProcessor", frames, baseline,
+                              duration);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const std::chrono::milliseconds duration(argc > 1 ? std::atoi(argv[1])
+                                                      : 200);
+
+    // Enough frames, each in its own buffer, not to fit in caches.
+    constexpr std::size_t coldFrames = 16384;
+    constexpr std::size_t hotFrames = 64;
+
+    const Bytes frame = makeGTPv1UFrame();
+
+    PacketBufferSizedPool<2048> pool(coldFrames);
+    std::vector<BufferView> frames;
+
+    for (std::size_t i = 0; i < coldFrames; ++i) {
+        BufferWritableView buffer = pool.getBufferWritableView();
+        std::memcpy(buffer.getUnderlyingWritableBufferPtr(), frame.data(),
+                    frame.size());
+        frames.push_back(buffer.getSub(0, frame.size()));
+    }
+
+    run("hot", std::vector<BufferView>(frames.begin(),
+                                       frames.begin() + hotFrames),
+        duration);
+
+    // Not in buffer order, so that hardware prefetchers don't help.
+    std::shuffle(frames.begin(), frames.end(), std::mt19937(1));
+    run("cold", frames, duration);
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef UPFLIB_TEST_TESTUTILS_HH
+#define UPFLIB_TEST_TESTUTILS_HH
+
+// For std::cerr
+#include <iostream>
+
+// Minimal helpers for the tests: each test is a plain executable,
+// returning non-zero (see testResult()) if any check failed.
+
+namespace UPFTest {
+
+inline int &failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int testResult(const char *name) {
+    if (failures() != 0) {
+        std::cerr << name << ": " << failures() << " check(s) failed\n";
+        return 1;
+    }
+
+    std::cout << name << ": all checks passed\n";
+    return 0;
+}
+
+} // namespace UPFTest
+
+/// Check a condition, reporting where it failed (and going on).
+#define UPFTEST_CHECK(cond)                                                    \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            ++UPFTest::failures();                                             \
+            std::cerr << __FILE__ << ':' << __LINE__                           \
+                      << ": check failed: " #cond "\n";                        \
+        }                                                                      \
+    } while (0)
+
+/// Same as UPFTEST_CHECK(), printing some context on failure.
+#define UPFTEST_CHECK_MSG(cond, msg)                                           \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            ++UPFTest::failures();                                             \
+            std::cerr << __FILE__ << ':' << __LINE__                           \
+                      << ": check failed: " #cond " (" << msg << ")\n";        \
+        }                                                                      \
+    } while (0)
+
+#endif